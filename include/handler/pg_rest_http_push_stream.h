@@ -14,12 +14,35 @@
 #include "pg_rest_core.h"
 #include "pg_rest_http.h"
 
+/* words of a bitmap of workers */
+#define PGREST_HTTP_PUSH_STREAM_WORDS         (PGREST_MAX_WORKERS / 64)
+
+/* bytes of a channel id, percent escapes count as three */
+#define PGREST_HTTP_PUSH_STREAM_ID_MAX        255
+
 typedef struct {
     pgrest_http_handler_t  super;
     void                  *conf;
 } pgrest_http_push_stream_handler_t;
 
+/* a channel right after a publish */
+typedef struct {
+    uint64                 published;
+    uint32                 stored;
+    uint64                 subscribers;
+} pgrest_http_push_stream_info_t;
+
 void pgrest_http_push_stream_conf_register(void);
+void pgrest_http_push_stream_id_append(StringInfo id, const char *part);
+bool pgrest_http_push_stream_id_valid(pgrest_string_t *id);
+int  pgrest_http_push_stream_publish(pgrest_string_t *id,
+                                     const unsigned char *data, size_t len,
+                                     pgrest_string_t *key,
+                                     int max_messages, uint64 *workers,
+                                     pgrest_http_push_stream_info_t *info);
+void pgrest_http_push_stream_notify(uint64 *workers,
+                                    pgrest_ipc_cmd_e command);
+bool pgrest_http_push_stream_attach(void);
 
 
 #endif /* PG_REST_HTTP_PUSH_STREAM_H */
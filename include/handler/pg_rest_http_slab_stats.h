@@ -0,0 +1,23 @@
+/*-------------------------------------------------------------------------
+ *
+ * include/pg_rest_http_slab_stats.h
+ *
+ * http slab stats module.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_REST_HTTP_SLAB_STATS_H
+#define PG_REST_HTTP_SLAB_STATS_H
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+typedef struct {
+    pgrest_http_handler_t  super;
+} pgrest_http_slab_stats_handler_t;
+
+void pgrest_http_slab_stats_conf_register(void);
+
+#endif /* PG_REST_HTTP_SLAB_STATS_H */
@@ -13,6 +13,10 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
+#define PGREST_ACCEPT_MODE_MUTEX       0
+#define PGREST_ACCEPT_MODE_REUSEPORT   1
+#define PGREST_ACCEPT_MODE_EXCLUSIVE   2
+
 extern bool  pgrest_acceptor_use_mutex;
 extern bool  pgrest_acceptor_mutex_held;
 extern int   pgrest_acceptor_disabled;
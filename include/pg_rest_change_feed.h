@@ -0,0 +1,23 @@
+/*-------------------------------------------------------------------------
+ *
+ * include/pg_rest_change_feed.h
+ *
+ * logical decoding change feed routines.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_REST_CHANGE_FEED_H
+#define PG_REST_CHANGE_FEED_H
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+#define PGREST_CHANGE_FEED_TEST_DECODING   0
+#define PGREST_CHANGE_FEED_WAL2JSON        1
+
+void pgrest_change_feed_init(void);
+void pgrest_change_feed_channel(StringInfo id, const char *schema,
+                                const char *table, List *values);
+
+#endif /* PG_REST_CHANGE_FEED_H */
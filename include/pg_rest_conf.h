@@ -12,6 +12,7 @@
 
 #define PGREST_CONF_OBJECT               0x0001
 #define PGREST_CONF_SCALAR               0x0002
+#define PGREST_CONF_AUTO                 0x0004
 #define PGREST_HTTP_LINGERING_OFF        0
 #define PGREST_HTTP_LINGERING_ON         1
 #define PGREST_HTTP_LINGERING_ALWAYS     2
@@ -106,5 +107,7 @@ void pgrest_conf_def_obj(const char           *name,
                          pgrest_conf_create_pt handler);
 
 bool pgrest_conf_parse(pgrest_setting_t *setting, const char *filename);
+bool pgrest_conf_changed(const char *filename);
+void pgrest_conf_commit(void);
 
 #endif /* PG_REST_CONF_H */
@@ -27,6 +27,18 @@ typedef enum {
 } pgrest_tcp_nopush_e;
 
 
+/* every connection of the array starts a cache line of its own */
+#ifdef pg_attribute_aligned
+#define PGREST_CONN_ALIGNED  pg_attribute_aligned(PG_CACHE_LINE_SIZE)
+#else
+#define PGREST_CONN_ALIGNED
+#endif
+
+/*
+ * Hot part of a connection: touched while a request is served. The first
+ * cache line holds what every event touches, up to wev_handler, keep it
+ * so. Everything set up on accept only lives in pgrest_conn_cold_t.
+ */
 struct pgrest_connection_s {
     void                 *data;
 
@@ -34,10 +46,46 @@ struct pgrest_connection_s {
     struct event         *wev;
 
     evutil_socket_t       fd;
-    pgrest_listener_t    *listener;
-    off_t                 sent;
+
+    unsigned              ready:1;
+    unsigned              timedout:1;
+    unsigned              error:1;
+    unsigned              destroyed:1;
+
+    unsigned              idle:1;
+    unsigned              reusable:1;
+    unsigned              close:1;
+    unsigned              event:1;
+    unsigned              channel:1;
+
+    unsigned              tcp_nodelay:2;
+    unsigned              tcp_nopush:2;
 
     pgrest_mpool_t       *pool;
+    pgrest_buffer_t      *buffer;
+
+    event_callback_fn     rev_handler;
+    event_callback_fn     wev_handler;
+
+    /* read timeout, fires rev with EV_TIMEOUT */
+    pgrest_timer_t        timer;
+
+    off_t                 sent;
+
+    /* configuration generation held by the protocol handler */
+    void                 *conf;
+
+    /* rev/wev callbacks deferred while holding the accept mutex */
+    pgrest_event_posted_t posted_rev;
+    pgrest_event_posted_t posted_wev;
+} PGREST_CONN_ALIGNED;
+
+/*
+ * Cold part of a connection: set up on accept and rarely read afterwards.
+ * Stored in an array parallel to pgrest_conn_conns, see pgrest_conn_cold().
+ */
+typedef struct {
+    pgrest_listener_t    *listener;
 
     int                   type;
     struct sockaddr      *sockaddr;
@@ -51,46 +99,46 @@ struct pgrest_connection_s {
     struct sockaddr      *local_sockaddr;
     socklen_t             local_socklen;
 
-    pgrest_buffer_t      *buffer;
-
     /* list link in pgrest_conn_reuse_conns */
     dlist_node            elem;
 
-    event_callback_fn     rev_handler;
-    event_callback_fn     wev_handler;
-    pgrest_uint_t         requests;
-
-    unsigned              ready:1;
-    unsigned              timedout:1;
-    unsigned              error:1;
-    unsigned              destroyed:1;
+    /* protocol teardown of a connection cut off at worker exit */
+    pgrest_conn_handler_pt abort;
 
-    unsigned              idle:1;
-    unsigned              reusable:1;
-    unsigned              close:1;
-    unsigned              event:1;
-    unsigned              channel:1;
+    pgrest_uint_t         requests;
+} pgrest_conn_cold_t;
 
-    unsigned              tcp_nodelay:2;
-    unsigned              tcp_nopush:2;
-};
+extern pgrest_connection_t *pgrest_conn_conns;
+extern pgrest_conn_cold_t  *pgrest_conn_colds;
+extern int                 pgrest_conn_free_noconn;
 
-extern int                pgrest_conn_free_noconn;
+static inline pgrest_conn_cold_t *
+pgrest_conn_cold(pgrest_connection_t *conn)
+{
+    return &pgrest_conn_colds[conn - pgrest_conn_conns];
+}
 
 void pgrest_conn_init(int worker_noconn);
 pgrest_connection_t *pgrest_conn_get(evutil_socket_t fd);
 void pgrest_conn_free(pgrest_connection_t *conn);
 void pgrest_conn_close(pgrest_connection_t *conn);
 void pgrest_conn_reusable(pgrest_connection_t *conn, int reusable);
+void pgrest_conn_close_idle(void);
+int  pgrest_conn_active(void);
 ssize_t pgrest_conn_recv(pgrest_connection_t *conn, 
                          unsigned char *buf, 
                          size_t size);
 ssize_t pgrest_conn_send(pgrest_connection_t *conn, 
                          unsigned char *buf, 
                          size_t size);
+ssize_t pgrest_conn_sendv(pgrest_connection_t *conn,
+                          struct iovec *iov,
+                          int niov);
 bool pgrest_conn_local_sockaddr(pgrest_connection_t *conn, 
                                 pgrest_string_t *s,
                                 bool port);
+bool pgrest_conn_add_read(pgrest_connection_t *conn, int timeout);
+void pgrest_conn_del_timer(pgrest_connection_t *conn);
 int  pgrest_conn_tcp_nopush(pgrest_connection_t *conn);
 int  pgrest_conn_tcp_push(pgrest_connection_t *conn);
 
@@ -32,6 +32,9 @@ typedef void   (*pgrest_conn_handler_pt)  (pgrest_connection_t *conn);
 #include <storage/spin.h>
 #include <fmgr.h>
 #include <utils/builtins.h>
+#include <funcapi.h>
+#include <utils/tuplestore.h>
+#include <access/hash.h>
 #include <tcop/utility.h>
 #include <pgstat.h>
 #include <libpq/ip.h>
@@ -40,6 +43,11 @@ typedef void   (*pgrest_conn_handler_pt)  (pgrest_connection_t *conn);
 #include <lib/stringinfo.h>
 #include <utils/memutils.h>
 #include <utils/guc_tables.h>
+#include <utils/snapmgr.h>
+#include <utils/json.h>
+#include <access/xact.h>
+#include <executor/spi.h>
+#include <catalog/pg_type.h>
 
 #if PGSQL_VERSION >= 95
 #include <port/atomics.h>
@@ -48,6 +56,8 @@ typedef void   (*pgrest_conn_handler_pt)  (pgrest_connection_t *conn);
 #include <limits.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 #ifdef HAVE_NETINET_TCP_H
 #include <netinet/tcp.h>
 #endif
@@ -57,9 +67,13 @@ typedef void   (*pgrest_conn_handler_pt)  (pgrest_connection_t *conn);
 #ifndef WIN32
 #include <sys/mman.h>
 #endif
+#ifdef HAVE_CPU_AFFINITY
+#include <sched.h>
+#endif
 
 #include <event2/event.h>
 #include <jansson.h>
+#include <libpq-fe.h>
 
 #include "pg_rest_util.h"
 #include "pg_rest_string.h"
@@ -75,7 +89,10 @@ typedef void   (*pgrest_conn_handler_pt)  (pgrest_connection_t *conn);
 #include "pg_rest_ipc.h"
 #include "pg_rest_shm.h"
 #include "pg_rest_event.h"
+#include "pg_rest_timer.h"
 #include "pg_rest_worker.h"
+#include "pg_rest_change_feed.h"
+#include "pg_rest_notify_bridge.h"
 
 #include "pg_rest_listener.h"
 #include "pg_rest_acceptor.h"
@@ -14,9 +14,21 @@
 #include "pg_rest_core.h"
 
 #define PGREST_EVENT_PRIORITY        pgrest_acceptor_use_mutex ? 1 : 0
-/* FIXME Maybe we need to modify libevent */
 #define pgrest_event_dispatch(b)     event_base_loop(b, EVLOOP_ONCE)
-#define pgrest_event_run_pending(b)  
+
+/*
+ * An I/O callback deferred while the worker holds the accept mutex,
+ * replayed by pgrest_event_run_pending() once the mutex is released.
+ */
+typedef struct {
+    dlist_node          node;
+    event_callback_fn   handler;
+    evutil_socket_t     fd;
+    short               events;
+    void               *arg;
+} pgrest_event_posted_t;
+
+extern bool pgrest_event_posting;
 
 static inline int 
 pgrest_event_assign(struct event *ev, struct event_base *base, 
@@ -26,6 +38,12 @@ pgrest_event_assign(struct event *ev, struct event_base *base,
     return event_assign(ev, base, fd, events, callback, arg);
 }
 
+static inline size_t
+pgrest_event_size(void)
+{
+    return event_get_struct_event_size();
+}
+
 static inline void
 pgrest_event_loop_once(struct event_base *base)
 {
@@ -89,6 +107,11 @@ void  pgrest_event_base_free(struct event_base *base);
 #if 0
 void  pgrest_event_global_shutdown(void);
 #endif
+void  pgrest_event_post(pgrest_event_posted_t *pev,
+                        event_callback_fn handler,
+                        evutil_socket_t fd, short events, void *arg);
+void  pgrest_event_delete_posted(pgrest_event_posted_t *pev);
+void  pgrest_event_run_pending(void);
 void  pgrest_event_log(int severity, const char *msg);
 void  pgrest_event_fatal(int err);
 
@@ -15,13 +15,38 @@ typedef struct pgrest_setting_s  pgrest_setting_t;
 struct pgrest_setting_s {
     char           *configure_file;
     int             worker_processes;
+    int             worker_processes_max;
+    int             worker_scale_interval;
+    int             worker_scale_up;
+    int             worker_scale_down;
+    int             worker_shutdown_timeout;
+    int             worker_restart_delay;
+    int             worker_restart_delay_max;
     int             worker_priority;
     int             worker_noconn;
     int             worker_nofile;
+    int             worker_timer_resolution;
+    bool            worker_cpu_affinity_auto;
+    pgrest_array_t  worker_cpu_affinity;
+    int             acceptor_mode;
     bool            acceptor_mutex;
     int             acceptor_mutex_delay;
     bool            acceptor_multi_accept;
+    int             acceptor_multi_accept_max;
+    int             acceptor_balance_threshold;
     char            temp_buffer_path[MAXPGPATH];
+    int             push_stream_shm_size;
+    int             push_stream_shm_size_max;
+    char            change_feed_slot[NAMEDATALEN];
+    int             change_feed_plugin;
+    char            change_feed_database[NAMEDATALEN];
+    int             change_feed_naptime;
+    int             change_feed_batch;
+    int             change_feed_max_messages;
+    char           *notify_conninfo;
+    char           *notify_channels;
+    int             notify_max_messages;
+    int             notify_reconnect_delay;
     pgrest_array_t  conf_http_servers;
     pgrest_array_t  conf_listeners;
 };
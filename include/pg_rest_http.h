@@ -15,21 +15,40 @@
 
 typedef struct   pgrest_http_request_s    pgrest_http_request_t;
 typedef struct   pgrest_http_upstream_s   pgrest_http_upstream_t;
+typedef struct   pgrest_http_websocket_s  pgrest_http_websocket_t;
 
 typedef bool (*pgrest_http_header_handler_pt)(pgrest_http_request_t *,
     pgrest_param_t *, size_t);
 
+/*
+ * One generation of the http configuration. Connections hold the one
+ * they were accepted with, a replaced generation is freed once the last
+ * of them has closed.
+ */
+typedef struct {
+    MemoryContext                 mctx;
+    pgrest_uint_t                 refs;
+    pgrest_uint_t                 generation;
+} pgrest_http_conf_t;
+
+extern pgrest_http_conf_t *pgrest_http_conf;
+
 #include "pg_rest_http_core.h"
 #include "pg_rest_http_request.h"
+#include "pg_rest_http_output.h"
 #include "pg_rest_http_header.h"
 #include "pg_rest_http_upstream.h"
+#include "pg_rest_http_websocket.h"
 #include "picohttpparser.h"
 #include "pg_rest_http_v1.h"
 #include "pg_rest_http_v2.h"
 
 void pgrest_http_conn_init(pgrest_connection_t *conn);
 void pgrest_http_conn_close(pgrest_connection_t *conn);
+void pgrest_http_conn_abort(pgrest_connection_t *conn);
 void pgrest_http_init(pgrest_setting_t *setting);
+void pgrest_http_conf_hold(pgrest_connection_t *conn);
+void pgrest_http_conf_release(pgrest_connection_t *conn);
 void pgrest_http_setup_configurators(void);
 pgrest_http_request_t *pgrest_http_create_request(pgrest_connection_t *conn);
 int  pgrest_http_extend_header_buffer(pgrest_http_request_t *req);
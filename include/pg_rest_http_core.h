@@ -15,6 +15,7 @@
 #include "pg_rest_http.h"
 
 #define PGREST_HTTP_MAX_HEADERS               20
+#define PGREST_HTTP_MAX_PARAMS                8
 
 typedef struct   pgrest_http_handler_s        pgrest_http_handler_t;
 typedef struct   pgrest_http_filter_s         pgrest_http_filter_t;
@@ -93,6 +93,9 @@ const pgrest_http_header_token_t *
 pgrest_http_header_find_token(const char *name, size_t len);
 bool pgrest_http_header_is_token(const pgrest_string_t *str);
 bool pgrest_http_header_add(pgrest_array_t *headers, pgrest_param_t **header);
+pgrest_param_t *pgrest_http_header_find(pgrest_array_t *headers,
+                                        const char     *name,
+                                        size_t          len);
 void
 pgrest_http_header_align(pgrest_http_headers_in_t *headers_in, 
                          unsigned char *old,
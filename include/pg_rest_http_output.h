@@ -0,0 +1,35 @@
+/*-------------------------------------------------------------------------
+ *
+ * include/pg_rest_http_output.h
+ *
+ * http response output routines.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_REST_HTTP_OUTPUT_H
+#define PG_REST_HTTP_OUTPUT_H
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+/* at most this many iovecs per pgrest_http_write() */
+#define PGREST_HTTP_OUTPUT_IOVS               16
+
+bool pgrest_http_set_header(pgrest_http_request_t *req,
+                            const char            *key,
+                            const char            *value);
+int  pgrest_http_send_header(pgrest_http_request_t *req);
+int  pgrest_http_write(pgrest_http_request_t *req,
+                       struct iovec          *iov,
+                       int                    niov);
+size_t pgrest_http_output_pending(pgrest_http_request_t *req);
+void pgrest_http_send_response(pgrest_http_request_t *req,
+                               pgrest_uint_t          status,
+                               const char            *content_type,
+                               pgrest_string_t       *body);
+void pgrest_http_special_response(pgrest_http_request_t *req,
+                                  pgrest_int_t           rc);
+
+#endif /* PG_REST_HTTP_OUTPUT_H */
@@ -68,6 +68,7 @@
 #define PGREST_HTTP_UNSUPPORTED_MEDIA_TYPE    415
 #define PGREST_HTTP_RANGE_NOT_SATISFIABLE     416
 #define PGREST_HTTP_MISDIRECTED_REQUEST       421
+#define PGREST_HTTP_UPGRADE_REQUIRED          426
 
 #define PGREST_HTTP_CLOSE                     444
 #define PGREST_HTTP_REQUEST_HEADER_TOO_LARGE  494
@@ -161,6 +162,15 @@ typedef struct {
 } pgrest_http_headers_out_t;
 
 typedef void (*pgrest_http_event_handler_pt) (pgrest_http_request_t *req);
+typedef void (*pgrest_http_cleanup_pt) (void *data);
+
+typedef struct pgrest_http_cleanup_s  pgrest_http_cleanup_t;
+
+struct pgrest_http_cleanup_s {
+    pgrest_http_cleanup_pt            handler;
+    void                             *data;
+    pgrest_http_cleanup_t            *next;
+};
 
 /**
  * HTTP request
@@ -178,8 +188,12 @@ struct pgrest_http_request_s {
     int                               method;
     /* abs-path of the request */
     pgrest_string_t                   path;
+    /* query string, without the '?' */
+    pgrest_string_t                   args;
 
     pgrest_http_upstream_t           *upstream;
+    /* set once the connection switched over to websocket */
+    pgrest_http_websocket_t          *websocket;
     pgrest_array_t                   *upstream_states;
     /* of pgrest_http_upstream_state_t */
 
@@ -195,6 +209,13 @@ struct pgrest_http_request_s {
 
     pgrest_http_connection_t         *http_conn;
     pgrest_conf_http_server_t        *http_conf;
+    pgrest_conf_http_path_t          *path_conf;
+    pgrest_param_t                    params[PGREST_HTTP_MAX_PARAMS];
+    size_t                            num_params;
+
+    /* response bytes the socket did not take yet */
+    pgrest_buffer_t                  *output;
+    pgrest_http_cleanup_t            *cleanup;
 
     pgrest_chain_t                   *out;
     size_t                            request_length;
@@ -209,6 +230,7 @@ struct pgrest_http_request_s {
     unsigned                          lingering_close:1;
     unsigned                          expect_tested:1;
     unsigned                          done:1;
+    unsigned                          header_sent:1;
 };
 
 void pgrest_http_close_request(pgrest_http_request_t *req, pgrest_int_t rc);
@@ -219,6 +241,7 @@ int  pgrest_http_extend_header_buffer(pgrest_http_request_t *req);
 int  pgrest_http_extend_body_buffer(pgrest_http_request_t *req);
 bool pgrest_http_test_expect(pgrest_http_request_t *req);
 void pgrest_http_block_reading(pgrest_http_request_t *req);
+pgrest_http_cleanup_t *pgrest_http_cleanup_add(pgrest_http_request_t *req);
 bool
 pgrest_http_process_host(pgrest_http_request_t *req, 
                          pgrest_param_t        *header,
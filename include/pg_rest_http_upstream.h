@@ -16,7 +16,11 @@
 
 #define PGREST_HTTP_UPSTREAM_CREATE            0x0001
 
+/* the server a request was routed to */
+#define PGREST_HTTP_UPSTREAM_SERVER_HEADER     "X-Pgrest-Upstream"
+
 typedef struct pgrest_http_upstream_srv_conf_s pgrest_http_upstream_srv_conf_t;
+typedef struct pgrest_http_upstream_check_s    pgrest_http_upstream_check_t;
 
 typedef int (*pgrest_http_upstream_init_pt) (pgrest_http_upstream_srv_conf_t *);
 typedef int (*pgrest_http_upstream_initp_pt) (pgrest_http_request_t *,
@@ -34,10 +38,38 @@ typedef struct {
     void                            *data;
 } pgrest_http_upstream_peer_t;
 
+typedef enum {
+    PGREST_HTTP_UPSTREAM_ROLE_UNKNOWN = 0,
+    PGREST_HTTP_UPSTREAM_ROLE_PRIMARY,
+    PGREST_HTTP_UPSTREAM_ROLE_REPLICA
+} pgrest_http_upstream_role_e;
+
+/* the state of a server as the checks of this worker see it */
+struct pgrest_http_upstream_check_s {
+    char                             name[NAMEDATALEN * 2]; /* hash key */
+    pgrest_http_upstream_role_e      role;
+    char                            *conninfo;
+    int                              interval;
+    int                              timeout;
+    PGconn                          *conn;
+    struct event                    *ev;
+    pgrest_timer_t                   timer;
+    /* a check that takes longer fails, armed while one runs */
+    pgrest_timer_t                   expire;
+    /* the last run of pgrest_http_upstream_check_start() using it */
+    uint32                           generation;
+    bool                             connecting;
+    bool                             busy;
+};
+
 typedef struct {
     pgrest_string_t                  name;
     pgrest_addr_t                   *addrs;
     pgrest_uint_t                    naddrs;
+    pgrest_string_t                  host;
+    in_port_t                        port;
+    /* set in the workers for a rw/split upstream */
+    pgrest_http_upstream_check_t    *check;
 } pgrest_http_upstream_server_t;
 
 struct pgrest_http_upstream_srv_conf_s {
@@ -49,6 +81,12 @@ struct pgrest_http_upstream_srv_conf_s {
     in_port_t                        port;
     in_port_t                        default_port;
     pgrest_uint_t                    no_port;
+    /* how the servers of a rw/split upstream are checked */
+    pgrest_string_t                  check_conninfo;
+    int                              check_interval;
+    int                              check_timeout;
+    /* the replica a read went to last */
+    pgrest_uint_t                    next;
 };
 
 typedef struct {
@@ -71,5 +109,11 @@ pgrest_http_upstream_add(pgrest_url_t *u,
                          pgrest_http_upstream_srv_conf_t **conf);
 void pgrest_http_upstream_conf_register(void);
 bool pgrest_http_upstream_init(void);
+pgrest_array_t *pgrest_http_upstream_swap(pgrest_array_t *upstreams);
+void pgrest_http_upstream_check_init(void);
+pgrest_http_upstream_server_t *
+pgrest_http_upstream_route(pgrest_http_request_t           *req,
+                           pgrest_http_upstream_srv_conf_t *us,
+                           bool                             read_only);
 
 #endif /* PG_REST_HTTP_UPSTREAM_H */
@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------
+ *
+ * include/pg_rest_http_websocket.h
+ *
+ * websocket (rfc 6455) routines.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_REST_HTTP_WEBSOCKET_H
+#define PG_REST_HTTP_WEBSOCKET_H
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#define PGREST_HTTP_WEBSOCKET_CONTINUATION    0x0
+#define PGREST_HTTP_WEBSOCKET_TEXT            0x1
+#define PGREST_HTTP_WEBSOCKET_BINARY          0x2
+#define PGREST_HTTP_WEBSOCKET_CLOSE           0x8
+#define PGREST_HTTP_WEBSOCKET_PING            0x9
+#define PGREST_HTTP_WEBSOCKET_PONG            0xa
+
+#define PGREST_HTTP_WEBSOCKET_NORMAL_CLOSURE  1000
+#define PGREST_HTTP_WEBSOCKET_GOING_AWAY      1001
+#define PGREST_HTTP_WEBSOCKET_PROTOCOL_ERROR  1002
+#define PGREST_HTTP_WEBSOCKET_MESSAGE_TOO_BIG 1009
+
+/* a Sec-WebSocket-Key and the base64 sha1 digest answering it */
+#define PGREST_HTTP_WEBSOCKET_KEY_LEN         24
+#define PGREST_HTTP_WEBSOCKET_ACCEPT_LEN      28
+
+/* largest header of a frame sent by the server, which does not mask */
+#define PGREST_HTTP_WEBSOCKET_HEADER_MAX      10
+/* largest message taken from a client */
+#define PGREST_HTTP_WEBSOCKET_MESSAGE_MAX     65536
+
+typedef void (*pgrest_http_websocket_message_pt) (pgrest_http_websocket_t *ws,
+                                                  int            opcode,
+                                                  unsigned char *data,
+                                                  size_t         len);
+typedef void (*pgrest_http_websocket_drain_pt) (pgrest_http_websocket_t *ws);
+
+/*
+ * A frame ready to go on the wire. It is built once and referenced by
+ * the queue of every connection that could not take it at once.
+ */
+typedef struct {
+    pgrest_uint_t                     refs;
+    size_t                            len;
+    unsigned char                     data[FLEXIBLE_ARRAY_MEMBER];
+} pgrest_http_websocket_frame_t;
+
+/* a decoded client frame header */
+typedef struct {
+    int                               opcode;
+    bool                              fin;
+    uint64                            len;
+    /* the mask included */
+    size_t                            hlen;
+} pgrest_http_websocket_header_t;
+
+struct pgrest_http_websocket_s {
+    pgrest_http_request_t            *req;
+    void                             *data;
+    pgrest_http_websocket_message_pt  handler;
+    /* called once the queued frames are out */
+    pgrest_http_websocket_drain_pt    drain_handler;
+
+    /* received and not parsed yet */
+    pgrest_buffer_t                  *in;
+    /* fragments of the message being received */
+    pgrest_buffer_t                  *message;
+    int                               opcode;
+
+    /* of pgrest_http_websocket_link_t, frames the socket did not take */
+    dlist_head                        out;
+    /* bytes of the first one already sent */
+    size_t                            sent;
+    size_t                            out_bytes;
+    pgrest_uint_t                     out_frames;
+
+    unsigned                          close_sent:1;
+};
+
+bool pgrest_http_websocket_is_upgrade(pgrest_http_request_t *req);
+int  pgrest_http_websocket_accept(pgrest_http_request_t            *req,
+                                  pgrest_http_websocket_message_pt  handler,
+                                  void                             *data);
+pgrest_http_websocket_frame_t *
+pgrest_http_websocket_frame_create(int                  opcode,
+                                   const unsigned char *data,
+                                   size_t               len);
+void pgrest_http_websocket_frame_release(pgrest_http_websocket_frame_t *frame);
+int  pgrest_http_websocket_send(pgrest_http_websocket_t       *ws,
+                                pgrest_http_websocket_frame_t *frame);
+bool pgrest_http_websocket_close(pgrest_http_websocket_t *ws, int status);
+void pgrest_http_websocket_accept_key(const unsigned char *key, char *accept);
+void pgrest_http_websocket_unmask(unsigned char       *p,
+                                  size_t               len,
+                                  const unsigned char *mask);
+int  pgrest_http_websocket_parse_header(const unsigned char            *p,
+                                        size_t                          size,
+                                        pgrest_http_websocket_header_t *h);
+
+#endif /* PG_REST_HTTP_WEBSOCKET_H */
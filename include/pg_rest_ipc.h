@@ -13,22 +13,54 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
-typedef void (*pgrest_ipc_msg_handler_pt) (void);
+/* bytes of ring buffer per pair of workers, a power of 2 */
+#define PGREST_IPC_RING_SIZE          (16 * 1024)
+#define PGREST_IPC_MSG_MAX            (PGREST_IPC_RING_SIZE / 4)
 
+/* data points into the ring and is valid during the call only */
+typedef void (*pgrest_ipc_msg_handler_pt) (int src_worker, void *data,
+                                           size_t len);
+
+/* at most 32 commands, pending notifies are kept in a bitmap */
 typedef enum {
     PGREST_IPC_CMD_HTTP_PUSH_CHECK = 0,
     PGREST_IPC_CMD_HTTP_PUSH_DELETE,
     PGREST_IPC_CMD_DB_PUSH_CHECK,
+    PGREST_IPC_CMD_SLAB_RECLAIM,
     PGREST_IPC_CMD_MAX
 } pgrest_ipc_cmd_e;
 
+/*
+ * Processes besides the workers that send to them. Each has a ring to
+ * every worker, after those of the workers, and receives nothing.
+ */
+typedef enum {
+    PGREST_IPC_AUX_CHANGE_FEED = 0,
+    PGREST_IPC_AUX_MAX
+} pgrest_ipc_aux_e;
+
+/* per worker counters, in shared memory */
+typedef struct {
+    uint64                        sent;
+    uint64                        coalesced;
+    uint64                        dropped;
+    uint64                        received;
+} pgrest_ipc_stat_t;
+
 void pgrest_ipc_init(int worker_processes);
 void pgrest_ipc_fini(int worker_processes);
 
+void pgrest_ipc_aux_init(pgrest_ipc_aux_e aux);
+
 void pgrest_ipc_close_channel(evutil_socket_t *sockets);
 void pgrest_ipc_setup_msg_handler(pgrest_ipc_cmd_e command, 
                                   pgrest_ipc_msg_handler_pt handler);
-bool pgrest_ipc_send_notify(int dest_worker, ev_uint8_t command);
+bool pgrest_ipc_send(int dest_worker, pgrest_ipc_cmd_e command,
+                     const void *data, size_t len);
+bool pgrest_ipc_send_notify(int dest_worker, pgrest_ipc_cmd_e command);
+void pgrest_ipc_broadcast_notify(pgrest_ipc_cmd_e command);
+void pgrest_ipc_flush(void);
+void pgrest_ipc_stat_get(int worker, pgrest_ipc_stat_t *stat);
 
 
 #endif /* PG_REST_IPC_H */
@@ -23,8 +23,24 @@
                 DEFAULT_PGSOCKET_DIR,                                       \
                 (port))
 
+/* listeners a worker keeps accept counters for */
+#define PGREST_LISTENER_STAT_MAX               16
+
 typedef struct pgrest_listener_s  pgrest_listener_t;
 
+/*
+ * Accept path counters of one listener in one worker, in shared memory.
+ * The slot is keyed by the listener address, so it is found again after
+ * a reload or a restart of the worker.
+ */
+typedef struct {
+    char                     addr[PGREST_SOCKADDR_STRLEN];
+    uint64                   wakeups;
+    uint64                   accepted;
+    uint64                   eagain;
+    uint64                   errors;
+} pgrest_listener_stat_t;
+
 struct pgrest_listener_s {
     evutil_socket_t          fd;
 
@@ -49,8 +65,15 @@ struct pgrest_listener_s {
 
     pgrest_connection_t     *connection;
 
+    /* owner worker of a cloned reuseport socket, -1 if shared */
+    int                      worker;
+
     int                      post_accept_timeout;
 
+    /* adaptive multi_accept batch and accept counters of this worker */
+    int                      accept_batch;
+    pgrest_listener_stat_t  *stat;
+
     unsigned                 open:1;
     unsigned                 bound:1;
     unsigned                 nonblocking_accept:1;
@@ -62,6 +85,8 @@ struct pgrest_listener_s {
 #endif
 #ifdef HAVE_REUSEPORT
     unsigned                 reuseport:1;
+    /* socket index within the reuseport group equals the worker index */
+    unsigned                 steer:1;
 #endif
     unsigned                 keepalive:2;
 
@@ -86,6 +111,10 @@ bool  pgrest_listener_resume(void);
 bool  pgrest_listener_pause(bool all);
 void  pgrest_listener_info_print(void);
 void  pgrest_listener_fini(void);
+bool  pgrest_listener_reuseport(void);
+bool  pgrest_listener_steer(int *workers, int nworkers);
+List *pgrest_listener_swap(List *listeners);
+void  pgrest_listener_reload(List *listeners, void *base);
 pgrest_listener_t* pgrest_listener_create(void *sockaddr, 
                                           socklen_t socklen);
 
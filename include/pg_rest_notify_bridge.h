@@ -0,0 +1,18 @@
+/*-------------------------------------------------------------------------
+ *
+ * include/pg_rest_notify_bridge.h
+ *
+ * LISTEN/NOTIFY bridge routines.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_REST_NOTIFY_BRIDGE_H
+#define PG_REST_NOTIFY_BRIDGE_H
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+void pgrest_notify_bridge_init(void);
+
+#endif /* PG_REST_NOTIFY_BRIDGE_H */
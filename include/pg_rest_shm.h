@@ -17,6 +17,20 @@ typedef struct pgrest_shm_seg_s  pgrest_shm_seg_t;
 
 typedef bool (*pgrest_shm_seg_init_pt) (pgrest_shm_seg_t *seg);
 
+/* shared state of a dynamic segment, kept in the main segment */
+typedef struct {
+#if PGSQL_VERSION >= 96
+    LWLock                   *lock;
+    LWLock                   *pool_lock;
+#else
+    LWLockId                  lock;
+    LWLockId                  pool_lock;
+#endif
+    int                       id;
+    uint32                    generation;
+    size_t                    size;
+} pgrest_shm_dyn_t;
+
 struct pgrest_shm_seg_s {
     char                     *addr;
     char                     *name;
@@ -24,13 +38,25 @@ struct pgrest_shm_seg_s {
     pgrest_shm_seg_init_pt    init;
     unsigned                  lock:1;
     unsigned                  pool:1;
+    unsigned                  dynamic:1;
+    /* dynamic segments only */
+    size_t                    max;
+    pgrest_shm_dyn_t         *dyn;
+    uint32                    generation;
 };
 
 pgrest_shm_seg_t *
 pgrest_shm_seg_add(char *name, size_t size, bool lock, bool pool);
+pgrest_shm_seg_t *
+pgrest_shm_seg_add_dynamic(char *name, size_t size, size_t max, bool pool);
+bool pgrest_shm_seg_attach(pgrest_shm_seg_t *seg);
+bool pgrest_shm_seg_resize(pgrest_shm_seg_t *seg, size_t size);
 void pgrest_shm_init(void);
 void pgrest_shm_fini(void);
 void pgrest_shm_info_print(void);
+Tuplestorestate *pgrest_shm_tuplestore(FunctionCallInfo fcinfo,
+                                       TupleDesc *tupdesc);
+void pgrest_shm_slab_stat_json(StringInfo buf);
 #if PGSQL_VERSION >= 96
 LWLock *pgrest_shm_get_lock(void);
 #else
@@ -21,6 +21,27 @@ struct pgrest_slab_page_s {
     uintptr_t            prev;
 };
 
+/*
+ * Per slot counters, and for whole page allocations in pages. used takes
+ * in the chunks cached by the processes, cached is how many of them are
+ * as of their last refill or flush. reqs and frees count the calls.
+ */
+typedef struct {
+    pgrest_uint_t        total;
+    pgrest_uint_t        used;
+    pgrest_uint_t        cached;
+    pgrest_uint_t        reqs;
+    pgrest_uint_t        frees;
+    pgrest_uint_t        fails;
+} pgrest_slab_stat_t;
+
+typedef struct {
+    pgrest_uint_t        pages;
+    pgrest_uint_t        free;
+    pgrest_uint_t        runs;
+    pgrest_uint_t        largest;
+} pgrest_slab_info_t;
+
 typedef struct {
 #if PGSQL_VERSION >= 96
     LWLock              *lock;
@@ -34,6 +55,13 @@ typedef struct {
     pgrest_slab_page_t  *last;
     pgrest_slab_page_t   free;
 
+    pgrest_slab_stat_t  *stats;
+    pgrest_slab_stat_t   page_stat;
+    pgrest_uint_t        pfree;
+
+    /* bumped when an allocation failed, the processes flush their caches */
+    pgrest_uint_t        reclaim;
+
     char                *start;
     char                *end;
 
@@ -48,5 +76,12 @@ void  pgrest_slab_init(pgrest_slab_pool_t *pool);
 void *pgrest_slab_alloc(pgrest_slab_pool_t *pool, size_t size);
 void *pgrest_slab_calloc(pgrest_slab_pool_t *pool, size_t size);
 void  pgrest_slab_free(pgrest_slab_pool_t *pool, void *p);
+void  pgrest_slab_cache_discard(pgrest_slab_pool_t *pool);
+void  pgrest_slab_cache_reclaim(void);
+pgrest_uint_t pgrest_slab_nslots(pgrest_slab_pool_t *pool);
+size_t pgrest_slab_slot_size(pgrest_slab_pool_t *pool, pgrest_uint_t slot);
+void  pgrest_slab_stat_get(pgrest_slab_pool_t *pool, pgrest_slab_stat_t *stats,
+                           pgrest_slab_stat_t *page_stat,
+                           pgrest_slab_info_t *info);
 
 #endif /* PG_REST_SLAB_H */
@@ -59,5 +59,7 @@ char *pgrest_strlchr(char *p, char *last, char c);
 int   pgrest_count_params(pgrest_string_t path);
 off_t pgrest_atoof(unsigned char *line, size_t n);
 time_t pgrest_atotm(unsigned char *line, size_t n);
+size_t pgrest_encode_base64(unsigned char *dst, const unsigned char *src,
+                            size_t len);
 
 #endif /* PG_REST_STRING_H */
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * include/pg_rest_timer.h
+ *
+ * coarse-grained timer wheel for connection timeouts
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PG_REST_TIMER_H
+#define PG_REST_TIMER_H
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+/* number of slots, must be a power of two */
+#define PGREST_TIMER_WHEEL_SIZE       4096
+
+typedef struct pgrest_timer_s  pgrest_timer_t;
+typedef void (*pgrest_timer_handler_pt) (pgrest_timer_t *timer);
+
+struct pgrest_timer_s {
+    dlist_node               node;
+    uint64                   expire;
+    pgrest_timer_handler_pt  handler;
+    void                    *data;
+    unsigned                 set:1;
+};
+
+void pgrest_timer_init(int resolution);
+void pgrest_timer_wheel_init(int resolution, uint64 now);
+void pgrest_timer_add(pgrest_timer_t *timer, int timeout);
+void pgrest_timer_add_at(pgrest_timer_t *timer, int timeout, uint64 now);
+void pgrest_timer_del(pgrest_timer_t *timer);
+void pgrest_timer_expire(uint64 now);
+
+#endif /* PG_REST_TIMER_H */
@@ -18,6 +18,7 @@ typedef bool (*pgrest_worker_hook_pt) (void *, void *);
 
 extern sig_atomic_t        pgrest_worker_terminate;
 extern int                 pgrest_worker_index;
+extern int                 pgrest_worker_cpu;
 extern bool                pgrest_worker_event_error;
 
 void pgrest_worker_init(int worker_processes);
@@ -26,6 +27,13 @@ void pgrest_worker_hook_add(pgrest_worker_hook_pt  startup,
                             const char            *name,
                             void                  *data,
                             bool                   head);
+void pgrest_worker_reload_hook_add(pgrest_worker_hook_pt  reload,
+                                   const char            *name,
+                                   void                  *data);
 void pgrest_worker_info_print(void);
+void pgrest_worker_stat_add(int32 n);
+uint32 pgrest_worker_stat_get(int worker);
+bool pgrest_worker_active(int worker);
+bool pgrest_worker_overloaded(int worker);
 
 #endif /* PG_REST_WORKER_H */
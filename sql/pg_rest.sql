@@ -2,3 +2,60 @@
 
 -- complain if script is sourced in psql, rather than via CREATE EXTENSION
 \echo Use "CREATE EXTENSION pg_rest" to load this file. \quit
+
+-- slab pool counters, one row per slot of every slab pool segment
+CREATE FUNCTION pgrest_slab_stats(
+    OUT segment text,
+    OUT slot_size bigint,
+    OUT total bigint,
+    OUT used bigint,
+    OUT cached bigint,
+    OUT reqs bigint,
+    OUT frees bigint,
+    OUT fails bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- slab pool page usage and free runs, one row per slab pool segment
+CREATE FUNCTION pgrest_slab_pages(
+    OUT segment text,
+    OUT pages bigint,
+    OUT free_pages bigint,
+    OUT free_runs bigint,
+    OUT largest_free_run bigint,
+    OUT large_pages bigint,
+    OUT large_used bigint,
+    OUT large_reqs bigint,
+    OUT large_frees bigint,
+    OUT large_fails bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- worker state, one row per worker slot
+CREATE FUNCTION pgrest_worker_stats(
+    OUT worker integer,
+    OUT pid integer,
+    OUT active boolean,
+    OUT connections bigint,
+    OUT restarts bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
+
+-- accept path counters, one row per listener of every worker
+CREATE FUNCTION pgrest_listener_stats(
+    OUT worker integer,
+    OUT listener text,
+    OUT accept_wakeups bigint,
+    OUT accepted bigint,
+    OUT accept_eagain bigint,
+    OUT accept_errors bigint
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE;
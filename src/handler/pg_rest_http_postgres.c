@@ -22,6 +22,10 @@ typedef struct {
     pgrest_string_t                  pg_pass;
     pgrest_string_t                  dbname;
     pgrest_string_t                  encode;
+    /* route every method as a read, not only GET and HEAD */
+    bool                             read_only;
+    /* name the server a request was routed to in a response header */
+    bool                             upstream_header;
     pgrest_http_upstream_conf_t      upstream;
 } pgrest_http_postgres_conf_t;
 
@@ -103,6 +107,28 @@ pgrest_http_postgres_dbname(pgrest_conf_command_t *cmd,
     pgrest_string_init(&conf->dbname, value, strlen(value));
 }
 
+static void  
+pgrest_http_postgres_read_only(pgrest_conf_command_t *cmd, 
+                               void                  *val, 
+                               void                  *parent)
+{
+    pgrest_http_postgres_conf_t   *conf = parent;
+    bool                          *newval = val;
+
+    conf->read_only = *newval;
+}
+
+static void  
+pgrest_http_postgres_upstream_header(pgrest_conf_command_t *cmd, 
+                                     void                  *val, 
+                                     void                  *parent)
+{
+    pgrest_http_postgres_conf_t   *conf = parent;
+    bool                          *newval = val;
+
+    conf->upstream_header = *newval;
+}
+
 static bool 
 pgrest_http_postgres_init(pgrest_http_handler_t *self)
 {
@@ -120,8 +146,39 @@ static int
 pgrest_http_postgres_handler(pgrest_http_handler_t *self,
                              pgrest_http_request_t *req)
 {
+    bool                            read_only;
+    char                           *name;
+    pgrest_http_upstream_server_t  *server = NULL;
+    pgrest_http_postgres_conf_t    *conf;
+
+    conf = ((pgrest_http_postgres_handler_t *) self)->conf;
+
+    if (conf->upstream.upstream) {
+        read_only = conf->read_only || req->method == PGREST_HTTP_GET
+                    || req->method == PGREST_HTTP_HEAD;
+
+        server = pgrest_http_upstream_route(req, conf->upstream.upstream,
+                                            read_only);
+        if (server == NULL) {
+            return PGREST_HTTP_SERVICE_UNAVAILABLE;
+        }
+    }
+
+    /* the server the query would run on, for the client to see */
+    if (server && conf->upstream_header) {
+        name = MemoryContextAlloc(req->pool->mctx, server->name.len + 1);
+        memcpy(name, server->name.base, server->name.len);
+        name[server->name.len] = '\0';
+
+        if (!pgrest_http_set_header(req, PGREST_HTTP_UPSTREAM_SERVER_HEADER,
+                                    name))
+        {
+            return PGREST_HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
 
-    return 0;
+    /* queries are not run, only the route is decided */
+    return PGREST_HTTP_NOT_IMPLEMENTED;
 }
 
 void
@@ -132,4 +189,7 @@ pgrest_http_postgres_conf_register(void)
     pgrest_conf_def_cmd("pg_pass", 0, 0, 0, pgrest_http_postgres_pgpass);
     pgrest_conf_def_cmd("dbname", 0, 0, 0, pgrest_http_postgres_dbname);
     pgrest_conf_def_cmd("encode", 0, 0, 0, pgrest_http_postgres_encode);
+    pgrest_conf_def_cmd("read_only", 0, 0, 0, pgrest_http_postgres_read_only);
+    pgrest_conf_def_cmd("upstream_header", 0, 0, 0,
+                        pgrest_http_postgres_upstream_header);
 }
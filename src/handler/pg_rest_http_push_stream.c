@@ -18,6 +18,19 @@
 
 #include "pg_rest_http_push_stream.h"
 
+#define PGREST_HTTP_PUSH_STREAM_BUCKETS       1024
+#define PGREST_HTTP_PUSH_STREAM_BATCH         64
+#define PGREST_HTTP_PUSH_STREAM_LOCALS        64
+#define PGREST_HTTP_PUSH_STREAM_SINCE         "since"
+#define PGREST_HTTP_PUSH_STREAM_TTL           "message_ttl"
+#define PGREST_HTTP_PUSH_STREAM_MAX           "max_messages"
+#define PGREST_HTTP_PUSH_STREAM_MAX_MESSAGES  65535
+#define PGREST_HTTP_PUSH_STREAM_KEY           "key"
+/* milliseconds between expiry steps, and the work done in one */
+#define PGREST_HTTP_PUSH_STREAM_EXPIRE_INTERVAL 100
+#define PGREST_HTTP_PUSH_STREAM_EXPIRE_BUCKETS  16
+#define PGREST_HTTP_PUSH_STREAM_EXPIRE_MSGS     1024
+
 typedef enum {
     PGREST_HTTP_PUSH_STREAM_PUB = 0,
     PGREST_HTTP_PUSH_STREAM_SUB,
@@ -29,15 +42,31 @@ typedef enum {
     PGREST_HTTP_PUSH_STREAM_WEBSOCKET = 0,
     PGREST_HTTP_PUSH_STREAM_LONGPOLLING,
     PGREST_HTTP_PUSH_STREAM_POLLING,
+    PGREST_HTTP_PUSH_STREAM_EVENTSOURCE,
+    PGREST_HTTP_PUSH_STREAM_STREAMING
 } pgrest_http_push_stream_tunnel_e;
 
+/* what a subscriber whose queue is full gets */
+typedef enum {
+    PGREST_HTTP_PUSH_STREAM_DROP_OLDEST = 0,
+    PGREST_HTTP_PUSH_STREAM_DROP_NEWEST,
+    PGREST_HTTP_PUSH_STREAM_COALESCE,
+    PGREST_HTTP_PUSH_STREAM_DISCONNECT
+} pgrest_http_push_stream_policy_e;
+
 typedef struct {
-    pgrest_string_t                    param_name;
     bool                               store_message;
+    int                                max_messages;
 } pgrest_http_push_stream_pub_t;
 
 typedef struct {
     pgrest_http_push_stream_tunnel_e   tunnel;
+    /* milliseconds a long-polling request waits for a message */
+    int                                longpolling_timeout;
+    /* messages held back for a subscriber the connection is busy with */
+    int                                max_queue_bytes;
+    int                                max_queue_messages;
+    pgrest_http_push_stream_policy_e   slow_policy;
 } pgrest_http_push_stream_sub_t;
 
 typedef struct {
@@ -45,18 +74,166 @@ typedef struct {
 
 typedef struct {
     pgrest_http_push_stream_mode_e      mode;
-    union {
+    /* path parameter or query argument naming the channel */
+    pgrest_string_t                     param_name;
+    /* apart, the defaults of one mode must not overwrite the other's */
+    struct {
         pgrest_http_push_stream_pub_t   pub_conf;
         pgrest_http_push_stream_sub_t   sub_conf;
         pgrest_http_push_stream_admin_t admin_conf;
     } value;
 } pgrest_http_push_stream_conf_t;
 
+typedef struct pgrest_http_push_stream_msg_s
+                                      pgrest_http_push_stream_msg_t;
+typedef struct pgrest_http_push_stream_channel_s
+                                      pgrest_http_push_stream_channel_t;
+
+/* a published message, kept once in the shared segment */
+struct pgrest_http_push_stream_msg_s {
+    pgrest_http_push_stream_msg_t      *next;
+    uint64                              id;
+    time_t                              time;
+    size_t                              len;
+    /* the key follows the data */
+    size_t                              key_len;
+    bool                                stored;
+    unsigned char                       data[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/*
+ * Where a worker with local subscribers is in a channel. next is the
+ * first message after the cursor, so that it does not have to be looked
+ * for from the head, NULL until one is published. A publish puts the
+ * channel on the dirty list of the worker unless it is already queued.
+ */
+typedef struct {
+    uint64                              id;
+    pgrest_http_push_stream_msg_t      *next;
+    pgrest_http_push_stream_channel_t  *dirty;
+    bool                                queued;
+} pgrest_http_push_stream_cursor_t;
+
+/*
+ * A channel lives as long as a worker subscribes to it, it has messages,
+ * it is on a dirty list or the admin gave it a ttl or max_messages.
+ * workers has a bit for every worker with local subscribers, cursors
+ * holds the id of the last message each of them has sent out. A message
+ * is freed once no longer stored and all those workers are past it.
+ */
+struct pgrest_http_push_stream_channel_s {
+    pgrest_http_push_stream_channel_t  *next;
+    uint32                              hash;
+    uint32                              nstored;
+    uint64                              last_id;
+    uint64                              subscribers;
+    uint64                              bytes_out;
+    uint64                              dropped;
+    time_t                              created;
+    /* messages per second, updated once a second */
+    time_t                              rate_time;
+    uint32                              rate_count;
+    double                              rate;
+    /* set by the admin, 0 for none */
+    int                                 ttl;
+    uint32                              max_messages;
+    /* unlinked by the admin, freed once the workers have left */
+    bool                                deleted;
+    pgrest_http_push_stream_msg_t      *head;
+    pgrest_http_push_stream_msg_t      *tail;
+    uint64                              workers[PGREST_MAX_WORKERS / 64];
+    /* the dirty lists it is on */
+    uint32                              nqueued;
+    pgrest_http_push_stream_cursor_t   *cursors;
+    size_t                              len;
+    char                                id[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/* root of the segment, pool->data */
+typedef struct {
+    slock_t                             mutex;
+    uint32                              nbuckets;
+    int                                 nworkers;
+    uint64                              channels;
+    uint64                              messages;
+    uint64                              published;
+    uint64                              dropped;
+    /* channels with a ttl or max_messages, and where expiry goes next */
+    uint64                              expiring;
+    uint32                              expire_next;
+    /* per worker, the channels published to since it last looked */
+    pgrest_http_push_stream_channel_t **dirty;
+    pgrest_http_push_stream_channel_t  *buckets[FLEXIBLE_ARRAY_MEMBER];
+} pgrest_http_push_stream_shm_t;
+
+/* the subscribers of a channel in this worker */
+typedef struct {
+    pgrest_http_push_stream_channel_t  *channel;   /* hash key */
+    dlist_head                          subscribers;
+    /* sent and dropped since last added to the channel */
+    uint64                              bytes_out;
+    uint64                              dropped;
+    bool                                busy;
+} pgrest_http_push_stream_local_t;
+
+typedef struct {
+    dlist_node                          node;
+    pgrest_http_request_t              *req;
+    pgrest_http_push_stream_local_t    *local;
+    /* set for a websocket subscriber */
+    pgrest_http_websocket_t            *ws;
+    /* id of the last message it got, or was published before it came */
+    uint64                              last;
+    pgrest_http_push_stream_tunnel_e    tunnel;
+    pgrest_http_push_stream_sub_t      *conf;
+    /* of pgrest_http_push_stream_pending_t, while the connection is busy */
+    dlist_head                          pending;
+    size_t                              pending_bytes;
+    int                                 npending;
+    bool                                chunked;
+    /* a polling request got its message */
+    bool                                answered;
+} pgrest_http_push_stream_subscriber_t;
+
+/*
+ * A message held back for a slow subscriber, a copy of its own. It
+ * lives outside the request pool so that dropping it gives the memory
+ * back.
+ */
+typedef struct {
+    dlist_node                          node;
+    uint64                              id;
+    size_t                              len;
+    size_t                              key_len;
+    unsigned char                       data[FLEXIBLE_ARRAY_MEMBER];
+} pgrest_http_push_stream_pending_t;
+
+/* a copy of a channel taken by the admin */
+typedef struct {
+    char                               *id;
+    uint64                              published;
+    uint64                              subscribers;
+    uint64                              bytes_out;
+    uint64                              dropped;
+    uint32                              stored;
+    uint32                              max_messages;
+    int                                 ttl;
+    double                              rate;
+} pgrest_http_push_stream_stat_t;
+
+static pgrest_shm_seg_t  *pgrest_http_push_stream_seg = NULL;
+static HTAB              *pgrest_http_push_stream_locals = NULL;
+static struct event      *pgrest_http_push_stream_timer = NULL;
+static MemoryContext      pgrest_http_push_stream_mctx = NULL;
+
 static int
 pgrest_http_push_stream_handler(pgrest_http_handler_t  *self,
                                 pgrest_http_request_t  *req);
 static bool pgrest_http_push_stream_init(pgrest_http_handler_t *self);
 static void pgrest_http_push_stream_fini(pgrest_http_handler_t *self);
+static void
+pgrest_http_push_stream_flush(pgrest_http_push_stream_subscriber_t *sub);
+static void pgrest_http_push_stream_drained(pgrest_http_websocket_t *ws);
 
 
 static void *
@@ -69,6 +246,12 @@ pgrest_http_push_stream_conf(void *parent)
     /* set default value */
     conf = palloc0(sizeof(pgrest_http_push_stream_conf_t));
     conf->mode = PGREST_HTTP_PUSH_STREAM_UNKNOW;
+    conf->value.pub_conf.max_messages = 10;
+    conf->value.sub_conf.tunnel = PGREST_HTTP_PUSH_STREAM_STREAMING;
+    conf->value.sub_conf.longpolling_timeout = 30000;
+    conf->value.sub_conf.max_queue_bytes = 1024 * 1024;
+    conf->value.sub_conf.max_queue_messages = 1024;
+    conf->value.sub_conf.slow_policy = PGREST_HTTP_PUSH_STREAM_DROP_OLDEST;
 
     handler = (void*)pgrest_http_handler_create(path, sizeof(*handler));
     if (handler == NULL) {
@@ -114,8 +297,8 @@ pgrest_http_push_stream_name(pgrest_conf_command_t *cmd,
     pgrest_http_push_stream_conf_t *conf  = parent;
     char                           *value = val;
 
-    conf->value.pub_conf.param_name.base = (unsigned char *)pstrdup(value);
-    conf->value.pub_conf.param_name.len = strlen(value);
+    conf->param_name.base = (unsigned char *)pstrdup(value);
+    conf->param_name.len = strlen(value);
 }
 
 static void  
@@ -130,6 +313,24 @@ pgrest_http_push_stream_stor(pgrest_conf_command_t *cmd,
 }
 
 static void  
+pgrest_http_push_stream_max(pgrest_conf_command_t *cmd,
+                            void                  *val,
+                            void                  *parent)
+{
+    pgrest_http_push_stream_conf_t *conf = parent;
+    int                            *newval = val;
+
+    if (*newval < cmd->min_val || *newval > cmd->max_val) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%d\" must be in the range from %d to %d",
+                         cmd->name, *newval, cmd->min_val, cmd->max_val)));
+    }
+
+    conf->value.pub_conf.max_messages = *newval;
+}
+
+static void 
 pgrest_http_push_stream_tunnel(pgrest_conf_command_t *cmd, 
                                void                  *val, 
                                void                  *parent)
@@ -138,94 +339,2348 @@ pgrest_http_push_stream_tunnel(pgrest_conf_command_t *cmd,
     char                           *value = val;
 
     if (strcmp(value, "websocket") == 0) {
-        conf->mode = PGREST_HTTP_PUSH_STREAM_WEBSOCKET;
+        conf->value.sub_conf.tunnel = PGREST_HTTP_PUSH_STREAM_WEBSOCKET;
     } else if (strcmp(value, "long-polling") == 0) {
-        conf->mode = PGREST_HTTP_PUSH_STREAM_LONGPOLLING;
+        conf->value.sub_conf.tunnel = PGREST_HTTP_PUSH_STREAM_LONGPOLLING;
     } else if (strcmp(value, "polling") == 0) {
-        conf->mode = PGREST_HTTP_PUSH_STREAM_POLLING;
+        conf->value.sub_conf.tunnel = PGREST_HTTP_PUSH_STREAM_POLLING;
+    } else if (strcmp(value, "eventsource") == 0) {
+        conf->value.sub_conf.tunnel = PGREST_HTTP_PUSH_STREAM_EVENTSOURCE;
+    } else if (strcmp(value, "streaming") == 0) {
+        conf->value.sub_conf.tunnel = PGREST_HTTP_PUSH_STREAM_STREAMING;
     } else {
-        ereport(ERROR, 
+        ereport(ERROR,
                 (errmsg(PGREST_PACKAGE " " "invalid value for directive"
                         " \"%s\": \"%s\" only accept \"websocket\" or "
-                        "\"long-polling\" or \"polling\"", cmd->name, value)));
+                        "\"long-polling\" or \"polling\" or "
+                        "\"eventsource\" or \"streaming\"",
+                        cmd->name, value)));
+    }
+}
+
+static void  
+pgrest_http_push_stream_timeout(pgrest_conf_command_t *cmd,
+                                void                  *val,
+                                void                  *parent)
+{
+    pgrest_http_push_stream_conf_t *conf = parent;
+    int                            *newval = val;
+
+    if (*newval < cmd->min_val || *newval > cmd->max_val) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%d\" must be in the range from %d to %d",
+                         cmd->name, *newval, cmd->min_val, cmd->max_val)));
+    }
+
+    conf->value.sub_conf.longpolling_timeout = *newval;
+}
+
+static void  
+pgrest_http_push_stream_queue_bytes(pgrest_conf_command_t *cmd,
+                                    void                  *val,
+                                    void                  *parent)
+{
+    pgrest_http_push_stream_conf_t *conf = parent;
+    int                            *newval = val;
+
+    if (*newval < cmd->min_val || *newval > cmd->max_val) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%d\" must be in the range from %d to %d",
+                         cmd->name, *newval, cmd->min_val, cmd->max_val)));
+    }
+
+    conf->value.sub_conf.max_queue_bytes = *newval;
+}
+
+static void  
+pgrest_http_push_stream_queue_messages(pgrest_conf_command_t *cmd,
+                                       void                  *val,
+                                       void                  *parent)
+{
+    pgrest_http_push_stream_conf_t *conf = parent;
+    int                            *newval = val;
+
+    if (*newval < cmd->min_val || *newval > cmd->max_val) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%d\" must be in the range from %d to %d",
+                         cmd->name, *newval, cmd->min_val, cmd->max_val)));
+    }
+
+    conf->value.sub_conf.max_queue_messages = *newval;
+}
+
+static void 
+pgrest_http_push_stream_policy(pgrest_conf_command_t *cmd, 
+                               void                  *val, 
+                               void                  *parent)
+{
+    pgrest_http_push_stream_conf_t *conf  = parent;
+    char                           *value = val;
+
+    if (strcmp(value, "drop-oldest") == 0) {
+        conf->value.sub_conf.slow_policy = PGREST_HTTP_PUSH_STREAM_DROP_OLDEST;
+    } else if (strcmp(value, "drop-newest") == 0) {
+        conf->value.sub_conf.slow_policy = PGREST_HTTP_PUSH_STREAM_DROP_NEWEST;
+    } else if (strcmp(value, "coalesce") == 0) {
+        conf->value.sub_conf.slow_policy = PGREST_HTTP_PUSH_STREAM_COALESCE;
+    } else if (strcmp(value, "disconnect") == 0) {
+        conf->value.sub_conf.slow_policy = PGREST_HTTP_PUSH_STREAM_DISCONNECT;
+    } else {
+        ereport(ERROR,
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive"
+                        " \"%s\": \"%s\" only accept \"drop-oldest\" or "
+                        "\"drop-newest\" or \"coalesce\" or "
+                        "\"disconnect\"", cmd->name, value)));
+    }
+}
+
+static pgrest_http_push_stream_shm_t *
+pgrest_http_push_stream_shm(void)
+{
+    pgrest_shm_seg_t  *seg = pgrest_http_push_stream_seg;
+
+    if (seg == NULL || seg->generation == 0) {
+        return NULL;
     }
+
+    return ((pgrest_slab_pool_t *) seg->addr)->data;
+}
+
+static pgrest_slab_pool_t *
+pgrest_http_push_stream_pool(void)
+{
+    return (pgrest_slab_pool_t *) pgrest_http_push_stream_seg->addr;
 }
 
 static bool 
-pgrest_http_push_stream_init(pgrest_http_handler_t *self)
+pgrest_http_push_stream_shm_init(pgrest_shm_seg_t *seg)
 {
-    pgrest_http_push_stream_handler_t *handler = (void *)self;
-    pgrest_http_push_stream_conf_t    *conf = handler->conf;
+    pgrest_slab_pool_t             *pool = (pgrest_slab_pool_t *) seg->addr;
+    pgrest_http_push_stream_shm_t  *shm;
+    int                             nworkers;
 
-    switch (conf->mode) {
-    case PGREST_HTTP_PUSH_STREAM_PUB:
-        if (!conf->value.pub_conf.param_name.base) {
-            pgrest_string_set(&conf->value.pub_conf.param_name, "id");
-        }
-        break;
-    case PGREST_HTTP_PUSH_STREAM_SUB:
-    case PGREST_HTTP_PUSH_STREAM_ADMIN:
-        break;
-    default:
-         ereport(LOG, 
-                (errmsg(PGREST_PACKAGE " " "you must specify a valid value"
-                        " for \"push_stream->mode\" directive, only accept"
-                        " \"pub\" or \"sub\" or \"admin\"")));
+    nworkers = pgrest_setting.worker_processes_max;
+
+    shm = pgrest_slab_calloc(pool, offsetof(pgrest_http_push_stream_shm_t,
+                                            buckets)
+                       + PGREST_HTTP_PUSH_STREAM_BUCKETS * sizeof(void *)
+                       + nworkers * sizeof(void *));
+    if (shm == NULL) {
         return false;
     }
 
+    SpinLockInit(&shm->mutex);
+    shm->nbuckets = PGREST_HTTP_PUSH_STREAM_BUCKETS;
+    shm->nworkers = nworkers;
+    shm->dirty = (pgrest_http_push_stream_channel_t **)
+                 &shm->buckets[PGREST_HTTP_PUSH_STREAM_BUCKETS];
+
+    pool->data = shm;
+
     return true;
 }
 
-static int
-pgrest_http_push_stream_pub(pgrest_http_push_stream_handler_t *handler,
-                            pgrest_http_request_t *req)
+static inline bool
+pgrest_http_push_stream_worker_isset(pgrest_http_push_stream_channel_t *ch,
+                                     int                                w)
 {
-    return 0;
+    return (ch->workers[w / 64] & ((uint64) 1 << (w % 64))) != 0;
 }
 
-static int
-pgrest_http_push_stream_sub(pgrest_http_push_stream_handler_t *handler,
-                            pgrest_http_request_t *req)
+static inline bool
+pgrest_http_push_stream_has_workers(pgrest_http_push_stream_channel_t *ch)
 {
-    return 0;
+    int  i;
+
+    for (i = 0; i < PGREST_MAX_WORKERS / 64; i++) {
+        if (ch->workers[i]) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-static int
-pgrest_http_push_stream_admin(pgrest_http_push_stream_handler_t *handler,
-                            pgrest_http_request_t *req)
+/* have worker w look at the channel, called with the mutex */
+static void
+pgrest_http_push_stream_queue(pgrest_http_push_stream_shm_t     *shm,
+                              pgrest_http_push_stream_channel_t *ch,
+                              int                                w)
 {
-    return 0;
+    pgrest_http_push_stream_cursor_t  *cur = &ch->cursors[w];
+
+    if (cur->queued) {
+        return;
+    }
+
+    cur->queued = true;
+    cur->dirty = shm->dirty[w];
+    shm->dirty[w] = ch;
+    ch->nqueued++;
 }
 
-static void 
-pgrest_http_push_stream_fini(pgrest_http_handler_t *self)
+/* the cursor of worker w moved to id, called with the mutex */
+static void
+pgrest_http_push_stream_seek(pgrest_http_push_stream_channel_t *ch,
+                             int                                w,
+                             uint64                             id)
+{
+    pgrest_http_push_stream_msg_t  *msg;
+
+    for (msg = ch->head; msg && msg->id <= id; msg = msg->next) {
+        /* void */
+    }
+
+    ch->cursors[w].id = id;
+    ch->cursors[w].next = msg;
+}
+
+/* called with the mutex */
+static pgrest_http_push_stream_channel_t *
+pgrest_http_push_stream_find(pgrest_http_push_stream_shm_t *shm,
+                             pgrest_string_t               *id,
+                             uint32                         hash)
+{
+    pgrest_http_push_stream_channel_t  *ch;
+
+    ch = shm->buckets[hash & (shm->nbuckets - 1)];
+
+    for ( ; ch; ch = ch->next) {
+        if (ch->hash == hash && ch->len == id->len
+            && memcmp(ch->id, id->base, id->len) == 0)
+        {
+            return ch;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Look the channel up and create it if asked to. Returns with the mutex
+ * held, or NULL without it when the channel does not exist or could not
+ * be allocated.
+ */
+static pgrest_http_push_stream_channel_t *
+pgrest_http_push_stream_acquire(pgrest_http_push_stream_shm_t *shm,
+                                pgrest_string_t               *id,
+                                bool                           create)
+{
+    uint32                              hash;
+    size_t                              size;
+    pgrest_http_push_stream_channel_t  *ch;
+    pgrest_http_push_stream_channel_t  *new = NULL;
+    pgrest_http_push_stream_channel_t **bucket;
+    pgrest_slab_pool_t                 *pool;
+
+    hash = DatumGetUInt32(hash_any(id->base, id->len));
+    pool = pgrest_http_push_stream_pool();
+
+    for ( ;; ) {
+        SpinLockAcquire(&shm->mutex);
+
+        ch = pgrest_http_push_stream_find(shm, id, hash);
+        if (ch && new == NULL) {
+            return ch;
+        }
+
+        if (ch == NULL && new) {
+            bucket = &shm->buckets[hash & (shm->nbuckets - 1)];
+            new->next = *bucket;
+            *bucket = new;
+            shm->channels++;
+
+            return new;
+        }
+
+        SpinLockRelease(&shm->mutex);
+
+        if (!create) {
+            return NULL;
+        }
+
+        /* another worker was faster, no slab call with the spinlock */
+        if (new) {
+            pgrest_slab_free(pool, new);
+            new = NULL;
+            continue;
+        }
+
+        size = MAXALIGN(offsetof(pgrest_http_push_stream_channel_t, id)
+                        + id->len + 1);
+
+        new = pgrest_slab_calloc(pool, size + shm->nworkers
+                                 * sizeof(pgrest_http_push_stream_cursor_t));
+        if (new == NULL) {
+            ereport(LOG, (errmsg(PGREST_PACKAGE " " "push stream shared "
+                                 "memory exhausted, create channel \"%.*s\" "
+                                 "failed", (int) id->len, id->base)));
+            return NULL;
+        }
+
+        new->hash = hash;
+        new->created = time(NULL);
+        new->cursors = (pgrest_http_push_stream_cursor_t *)
+                       ((char *) new + size);
+        new->len = id->len;
+        memcpy(new->id, id->base, id->len);
+    }
+}
+
+/*
+ * Unlink the messages nobody needs anymore and the channel itself once
+ * it is empty, the caller frees them after releasing the mutex. Called
+ * with the mutex, returns the channel when it was unlinked.
+ */
+static pgrest_http_push_stream_channel_t *
+pgrest_http_push_stream_gc(pgrest_http_push_stream_shm_t      *shm,
+                           pgrest_http_push_stream_channel_t  *ch,
+                           pgrest_http_push_stream_msg_t     **garbage)
+{
+    int                                  w;
+    pgrest_http_push_stream_msg_t       *msg;
+    pgrest_http_push_stream_channel_t  **prev;
+
+    while ((msg = ch->head) != NULL && (!msg->stored || ch->deleted)) {
+        for (w = 0; w < shm->nworkers; w++) {
+            if (pgrest_http_push_stream_worker_isset(ch, w)
+                && ch->cursors[w].id < msg->id)
+            {
+                break;
+            }
+        }
+
+        if (w < shm->nworkers) {
+            break;
+        }
+
+        ch->head = msg->next;
+        if (ch->head == NULL) {
+            ch->tail = NULL;
+        }
+
+        msg->next = *garbage;
+        *garbage = msg;
+        shm->messages--;
+    }
+
+    if (ch->head || pgrest_http_push_stream_has_workers(ch)
+        || ch->nqueued || ch->ttl || ch->max_messages)
+    {
+        return NULL;
+    }
+
+    /* a deleted channel is no longer in the bucket */
+    if (!ch->deleted) {
+        prev = &shm->buckets[ch->hash & (shm->nbuckets - 1)];
+        while (*prev != ch) {
+            prev = &(*prev)->next;
+        }
+
+        *prev = ch->next;
+        shm->channels--;
+    }
+
+    return ch;
+}
+
+static void
+pgrest_http_push_stream_free(pgrest_http_push_stream_channel_t *ch,
+                             pgrest_http_push_stream_msg_t     *garbage)
+{
+    pgrest_http_push_stream_msg_t  *next;
+    pgrest_slab_pool_t             *pool = pgrest_http_push_stream_pool();
+
+    for ( ; garbage; garbage = next) {
+        next = garbage->next;
+        pgrest_slab_free(pool, garbage);
+    }
+
+    if (ch) {
+        pgrest_slab_free(pool, ch);
+    }
+}
+
+static bool
+pgrest_http_push_stream_arg(pgrest_http_request_t *req,
+                            const char            *name,
+                            size_t                 len,
+                            pgrest_string_t       *value)
+{
+    unsigned char   *p, *end, *last;
+
+    p = req->args.base;
+    last = p + req->args.len;
+
+    for ( ; p && p < last; p = end + 1) {
+        end = memchr(p, '&', last - p);
+        if (end == NULL) {
+            end = last;
+        }
+
+        if ((size_t) (end - p) > len && p[len] == '='
+            && memcmp(p, name, len) == 0)
+        {
+            value->base = p + len + 1;
+            value->len = end - value->base;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Channel ids are in the form a client sends in a url and are kept out
+ * of json escaping and header splitting: the bytes of [A-Za-z0-9-_.:,@]
+ * as they are, any other byte percent-encoded with upper case digits.
+ * A publisher composing an id from parts, like the change feed, encodes
+ * each part with pgrest_http_push_stream_id_append() and separates them
+ * with '.', ':' or ','.
+ */
+void
+pgrest_http_push_stream_id_append(StringInfo id, const char *part)
 {
+    unsigned char  c;
+
+    for ( ; part && *part; part++) {
+        c = (unsigned char) *part;
 
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '@')
+        {
+            appendStringInfoChar(id, (char) c);
+            continue;
+        }
+
+        appendStringInfo(id, "%%%02X", c);
+    }
 }
 
+/* a hex digit in upper case, -1 for anything else */
 static int
-pgrest_http_push_stream_handler(pgrest_http_handler_t *self,
-                                pgrest_http_request_t *req)
+pgrest_http_push_stream_hex(unsigned char c)
 {
-    pgrest_http_push_stream_handler_t *handler = (void *)self;
-    pgrest_http_push_stream_conf_t    *conf = handler->conf;
+    if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F')) {
+        return c;
+    }
 
-    switch (conf->mode) {
-    case PGREST_HTTP_PUSH_STREAM_PUB:
-        pgrest_http_push_stream_pub(handler, req);
-        break;
-    case PGREST_HTTP_PUSH_STREAM_SUB:
-        pgrest_http_push_stream_sub(handler, req);
-        break;
-    case PGREST_HTTP_PUSH_STREAM_ADMIN:
-        pgrest_http_push_stream_admin(handler, req);
-        break;
+    if (c >= 'a' && c <= 'f') {
+        return c - 0x20;
+    }
+
+    return -1;
+}
+
+/*
+ * Check an id sent by a client and bring its percent escapes to upper
+ * case, in place, so that it names the channel a publisher encoded.
+ */
+bool
+pgrest_http_push_stream_id_valid(pgrest_string_t *id)
+{
+    size_t          i;
+    int             hi, lo;
+    unsigned char   c;
+
+    if (id->len == 0 || id->len > PGREST_HTTP_PUSH_STREAM_ID_MAX) {
+        return false;
+    }
+
+    for (i = 0; i < id->len; i++) {
+        c = id->base[i];
+
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.'
+            || c == ':' || c == ',' || c == '@')
+        {
+            continue;
+        }
+
+        if (c != '%' || id->len - i < 3
+            || (hi = pgrest_http_push_stream_hex(id->base[i + 1])) < 0
+            || (lo = pgrest_http_push_stream_hex(id->base[i + 2])) < 0)
+        {
+            return false;
+        }
+
+        id->base[i + 1] = (unsigned char) hi;
+        id->base[i + 2] = (unsigned char) lo;
+        i += 2;
+    }
+
+    return true;
+}
+
+/* the channel name, from the path parameter or else the query argument */
+static bool
+pgrest_http_push_stream_id(pgrest_http_push_stream_conf_t *conf,
+                           pgrest_http_request_t          *req,
+                           pgrest_string_t                *id)
+{
+    size_t           i;
+    pgrest_string_t *name = &conf->param_name;
+
+    id->base = NULL;
+    id->len = 0;
+
+    for (i = 0; i < req->num_params; i++) {
+        if (req->params[i].key.len == name->len
+            && memcmp(req->params[i].key.base, name->base, name->len) == 0)
+        {
+            *id = req->params[i].value;
+            break;
+        }
+    }
+
+    if (id->base == NULL) {
+        (void) pgrest_http_push_stream_arg(req, (char *) name->base,
+                                           name->len, id);
+    }
+
+    return pgrest_http_push_stream_id_valid(id);
+}
+
+/*
+ * The id of the last message a reconnecting client got, from the
+ * "Last-Event-ID" header an EventSource sends or the "since" argument.
+ */
+static bool
+pgrest_http_push_stream_since(pgrest_http_request_t *req,
+                              bool                  *resume,
+                              uint64                *since)
+{
+    off_t            n;
+    pgrest_param_t  *header;
+    pgrest_string_t  value;
+
+    *resume = false;
+
+    header = pgrest_http_header_find(&req->headers_in.headers,
+                                     "last-event-id",
+                                     sizeof("last-event-id") - 1);
+    if (header) {
+        value = header->value;
+
+    } else if (!pgrest_http_push_stream_arg(req,
+                                     PGREST_HTTP_PUSH_STREAM_SINCE,
+                                     sizeof(PGREST_HTTP_PUSH_STREAM_SINCE) - 1,
+                                     &value))
+    {
+        return true;
+    }
+
+    n = pgrest_atoof(value.base, value.len);
+    if (n == PGREST_ERROR) {
+        return false;
+    }
+
+    *resume = true;
+    *since = (uint64) n;
+
+    return true;
+}
+
+static void
+pgrest_http_push_stream_json(pgrest_http_request_t *req,
+                             pgrest_uint_t          status,
+                             StringInfo             buf)
+{
+    pgrest_string_t  body;
+
+    appendStringInfoString(buf, CRLF);
+
+    body.base = (unsigned char *) buf->data;
+    body.len = buf->len;
+
+    pgrest_http_send_response(req, status, "application/json", &body);
+}
+
+static void
+pgrest_http_push_stream_channel_info(pgrest_http_request_t          *req,
+                                     pgrest_uint_t                   status,
+                                     pgrest_string_t                *id,
+                                     pgrest_http_push_stream_info_t *info)
+{
+    StringInfoData  buf;
+    MemoryContext   oldctx;
+
+    oldctx = MemoryContextSwitchTo(req->pool->mctx);
+
+    initStringInfo(&buf);
+    appendStringInfo(&buf, "{\"channel\": \"%.*s\", \"published_messages\": "
+                     UINT64_FORMAT ", \"stored_messages\": %u, "
+                     "\"subscribers\": " UINT64_FORMAT "}",
+                     (int) id->len, id->base, info->published,
+                     info->stored, info->subscribers);
+
+    MemoryContextSwitchTo(oldctx);
+
+    pgrest_http_push_stream_json(req, status, &buf);
+}
+
+/* called with the mutex, an average over about the last 8 seconds */
+static void
+pgrest_http_push_stream_rate(pgrest_http_push_stream_channel_t *ch,
+                             time_t                             now)
+{
+    time_t  elapsed = now - ch->rate_time;
+
+    if (elapsed <= 0) {
+        return;
+    }
+
+    if (elapsed > 64) {
+        ch->rate = 0;
+
+    } else {
+        ch->rate += (ch->rate_count - ch->rate) / 8;
+
+        /* the seconds without a message */
+        while (--elapsed) {
+            ch->rate -= ch->rate / 8;
+        }
+    }
+
+    ch->rate_time = now;
+    ch->rate_count = 0;
+}
+
+/*
+ * Append a message to the channel, creating it if needed, and add the
+ * workers with subscribers on it to workers. The message is copied once
+ * into the segment, all workers send it from there. max_messages of 0
+ * does not store it, otherwise the max_messages of the channel applies
+ * if the admin set one. The key, which may be NULL, tells the messages
+ * a coalescing subscriber keeps only the latest of. Returns
+ * PGREST_DECLINED when the segment is not mapped and PGREST_ERROR when
+ * it is exhausted.
+ */
+int
+pgrest_http_push_stream_publish(pgrest_string_t                *id,
+                                const unsigned char            *data,
+                                size_t                          len,
+                                pgrest_string_t                *key,
+                                int                             max_messages,
+                                uint64                         *workers,
+                                pgrest_http_push_stream_info_t *info)
+{
+    int                                 i, w;
+    pgrest_http_push_stream_shm_t      *shm;
+    pgrest_http_push_stream_channel_t  *ch;
+    pgrest_http_push_stream_channel_t  *unlinked;
+    pgrest_http_push_stream_msg_t      *msg;
+    pgrest_http_push_stream_msg_t      *garbage = NULL;
+
+    if ((shm = pgrest_http_push_stream_shm()) == NULL) {
+        return PGREST_DECLINED;
+    }
+
+    msg = pgrest_slab_alloc(pgrest_http_push_stream_pool(),
+                            offsetof(pgrest_http_push_stream_msg_t, data)
+                            + len + (key ? key->len : 0));
+    if (msg == NULL) {
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "push stream shared memory "
+                             "exhausted, drop message to channel \"%.*s\"",
+                             (int) id->len, id->base)));
+        return PGREST_ERROR;
+    }
+
+    msg->next = NULL;
+    msg->time = time(NULL);
+    msg->len = len;
+    msg->key_len = key ? key->len : 0;
+    msg->stored = (max_messages > 0);
+    memcpy(msg->data, data, len);
+
+    if (msg->key_len) {
+        memcpy(msg->data + len, key->base, key->len);
+    }
+
+    ch = pgrest_http_push_stream_acquire(shm, id, true);
+    if (ch == NULL) {
+        pgrest_http_push_stream_free(NULL, msg);
+        return PGREST_ERROR;
+    }
+
+    /* what the admin set for the channel wins */
+    if (msg->stored && ch->max_messages) {
+        max_messages = ch->max_messages;
+    }
+
+    msg->id = ++ch->last_id;
+
+    pgrest_http_push_stream_rate(ch, msg->time);
+    ch->rate_count++;
+
+    if (ch->tail) {
+        ch->tail->next = msg;
+    } else {
+        ch->head = msg;
+    }
+
+    ch->tail = msg;
+    shm->messages++;
+    shm->published++;
+
+    for (w = 0; w < shm->nworkers; w++) {
+        if (!pgrest_http_push_stream_worker_isset(ch, w)) {
+            continue;
+        }
+
+        if (ch->cursors[w].next == NULL) {
+            ch->cursors[w].next = msg;
+        }
+
+        pgrest_http_push_stream_queue(shm, ch, w);
+    }
+
+    if (msg->stored && ++ch->nstored > (uint32) max_messages) {
+        /* the oldest stored message goes with its last reader */
+        for (msg = ch->head; !msg->stored; msg = msg->next) {
+            /* void */
+        }
+
+        msg->stored = false;
+        ch->nstored--;
+    }
+
+    for (i = 0; i < PGREST_HTTP_PUSH_STREAM_WORDS; i++) {
+        workers[i] |= ch->workers[i];
+    }
+
+    if (info) {
+        info->published = ch->last_id;
+        info->stored = ch->nstored;
+        info->subscribers = ch->subscribers;
+    }
+
+    unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+
+    SpinLockRelease(&shm->mutex);
+
+    pgrest_http_push_stream_free(unlinked, garbage);
+
+    return PGREST_OK;
+}
+
+/* wake the workers collected by pgrest_http_push_stream_publish() */
+void
+pgrest_http_push_stream_notify(uint64 *workers, pgrest_ipc_cmd_e command)
+{
+    int  w;
+
+    for (w = 0; w < PGREST_MAX_WORKERS; w++) {
+        if (workers[w / 64] & ((uint64) 1 << (w % 64))) {
+            (void) pgrest_ipc_send_notify(w, command);
+        }
+    }
+}
+
+/*
+ * Map the current segment in a process other than a worker, which has
+ * no reload hook following a resize. Cheap when it did not change.
+ */
+bool
+pgrest_http_push_stream_attach(void)
+{
+    pgrest_shm_seg_t  *seg = pgrest_http_push_stream_seg;
+
+    if (seg == NULL) {
+        return false;
+    }
+
+    if (seg->generation == seg->dyn->generation && seg->generation) {
+        return true;
+    }
+
+    return pgrest_shm_seg_attach(seg) && seg->generation != 0;
+}
+
+/* append the request body to the channel */
+static int
+pgrest_http_push_stream_pub(pgrest_http_push_stream_handler_t *handler,
+                            pgrest_http_request_t *req)
+{
+    int                                 rc;
+    uint64                              workers[PGREST_HTTP_PUSH_STREAM_WORDS];
+    pgrest_string_t                     id, key;
+    pgrest_iovec_t                     *entity;
+    pgrest_http_push_stream_info_t      info;
+    pgrest_http_push_stream_conf_t     *conf = handler->conf;
+    pgrest_http_push_stream_pub_t      *pub = &conf->value.pub_conf;
+    pgrest_http_push_stream_shm_t      *shm;
+    pgrest_http_push_stream_channel_t  *ch;
+
+    if (!pgrest_http_push_stream_id(conf, req, &id)) {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    if ((shm = pgrest_http_push_stream_shm()) == NULL) {
+        return PGREST_HTTP_SERVICE_UNAVAILABLE;
+    }
+
+    if (req->method == PGREST_HTTP_GET || req->method == PGREST_HTTP_HEAD) {
+        ch = pgrest_http_push_stream_acquire(shm, &id, false);
+        if (ch == NULL) {
+            return PGREST_HTTP_NOT_FOUND;
+        }
+
+        info.published = ch->last_id;
+        info.stored = ch->nstored;
+        info.subscribers = ch->subscribers;
+
+        SpinLockRelease(&shm->mutex);
+
+        pgrest_http_push_stream_channel_info(req, PGREST_HTTP_OK, &id, &info);
+        return PGREST_OK;
+    }
+
+    if (req->method != PGREST_HTTP_POST && req->method != PGREST_HTTP_PUT) {
+        return PGREST_HTTP_NOT_ALLOWED;
+    }
+
+    if (req->request_body == NULL || req->request_body->entity.len == 0) {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    entity = &req->request_body->entity;
+    MemSet(workers, 0, sizeof(workers));
+
+    /* for the subscribers coalescing messages */
+    if (!pgrest_http_push_stream_arg(req, PGREST_HTTP_PUSH_STREAM_KEY,
+                                     sizeof(PGREST_HTTP_PUSH_STREAM_KEY) - 1,
+                                     &key))
+    {
+        key.len = 0;
+    }
+
+    rc = pgrest_http_push_stream_publish(&id, entity->base, entity->len,
+                                         key.len ? &key : NULL,
+                                         pub->store_message
+                                             ? pub->max_messages : 0,
+                                         workers, &info);
+    if (rc == PGREST_DECLINED) {
+        return PGREST_HTTP_SERVICE_UNAVAILABLE;
+    }
+
+    if (rc != PGREST_OK) {
+        return PGREST_HTTP_INSUFFICIENT_STORAGE;
+    }
+
+    pgrest_http_push_stream_notify(workers, PGREST_IPC_CMD_HTTP_PUSH_CHECK);
+    pgrest_http_push_stream_channel_info(req, PGREST_HTTP_OK, &id, &info);
+
+    return PGREST_OK;
+}
+
+/* the last local subscriber of the channel has gone */
+static void
+pgrest_http_push_stream_leave(pgrest_http_push_stream_local_t *local)
+{
+    pgrest_http_push_stream_channel_t  *ch = local->channel;
+    pgrest_http_push_stream_channel_t  *unlinked;
+    pgrest_http_push_stream_msg_t      *garbage = NULL;
+    pgrest_http_push_stream_shm_t      *shm = pgrest_http_push_stream_shm();
+    int                                 w = pgrest_worker_index;
+
+    SpinLockAcquire(&shm->mutex);
+
+    ch->workers[w / 64] &= ~((uint64) 1 << (w % 64));
+    ch->cursors[w].id = 0;
+    ch->cursors[w].next = NULL;
+
+    unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+
+    SpinLockRelease(&shm->mutex);
+
+    pgrest_http_push_stream_free(unlinked, garbage);
+
+    (void) hash_search(pgrest_http_push_stream_locals, &local->channel,
+                       HASH_REMOVE, NULL);
+}
+
+static void
+pgrest_http_push_stream_drop(pgrest_http_push_stream_subscriber_t *sub,
+                             pgrest_http_push_stream_pending_t    *pending)
+{
+    dlist_delete(&pending->node);
+
+    sub->pending_bytes -= pending->len + pending->key_len;
+    sub->npending--;
+
+    pgrest_util_free(pending);
+}
+
+/* request cleanup of a subscriber */
+static void
+pgrest_http_push_stream_unsubscribe(void *data)
+{
+    dlist_mutable_iter                    iter;
+    pgrest_http_push_stream_subscriber_t *sub = data;
+    pgrest_http_push_stream_local_t      *local = sub->local;
+    pgrest_http_push_stream_shm_t        *shm = pgrest_http_push_stream_shm();
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "push stream unsubscribe "
+                              "channel \"%.*s\"", (int) local->channel->len,
+                               local->channel->id)));
+
+    dlist_delete(&sub->node);
+
+    dlist_foreach_modify(iter, &sub->pending) {
+        pgrest_http_push_stream_drop(sub, dlist_container(
+                                        pgrest_http_push_stream_pending_t,
+                                        node, iter.cur));
+    }
+
+    SpinLockAcquire(&shm->mutex);
+    local->channel->subscribers--;
+    SpinLockRelease(&shm->mutex);
+
+    if (dlist_is_empty(&local->subscribers) && !local->busy) {
+        pgrest_http_push_stream_leave(local);
+    }
+}
+
+/* the subscriber of a request, found through its cleanup */
+static pgrest_http_push_stream_subscriber_t *
+pgrest_http_push_stream_subscriber(pgrest_http_request_t *req)
+{
+    pgrest_http_cleanup_t  *cln;
+
+    for (cln = req->cleanup; cln; cln = cln->next) {
+        if (cln->handler == pgrest_http_push_stream_unsubscribe) {
+            return cln->data;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Nothing is expected from a subscriber but to notice when it is gone,
+ * or that a long-polling request waited long enough.
+ */
+static void
+pgrest_http_push_stream_sub_reading(pgrest_http_request_t *req)
+{
+    ssize_t               n;
+    unsigned char         buf[64];
+    pgrest_connection_t  *conn = req->conn;
+
+    if (conn->timedout) {
+        conn->timedout = 0;
+        pgrest_http_send_response(req, PGREST_HTTP_NOT_MODIFIED, NULL, NULL);
+        return;
+    }
+
+    for ( ;; ) {
+        n = pgrest_conn_recv(conn, buf, sizeof(buf));
+
+        if (n == PGREST_AGAIN) {
+            if (!pgrest_conn_add_read(conn, 0)) {
+                pgrest_http_close_request(req, 0);
+            }
+
+            return;
+        }
+
+        if (n == 0 || n == PGREST_ERROR) {
+            debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "push stream "
+                                      "subscriber closed connection")));
+            conn->error = 1;
+            pgrest_http_close_request(req, PGREST_HTTP_CLIENT_CLOSED_REQUEST);
+            return;
+        }
+    }
+}
+
+static void
+pgrest_http_push_stream_sub_writing(pgrest_http_request_t *req)
+{
+    pgrest_http_push_stream_subscriber_t *sub;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "push stream subscriber "
+                              "drained")));
+
+    sub = pgrest_http_push_stream_subscriber(req);
+    if (sub) {
+        pgrest_http_push_stream_flush(sub);
+    }
+}
+
+/*
+ * Keep the request until a message comes. A client resuming with
+ * "Last-Event-ID" or "since" gets what it missed and is still there
+ * first, the rest start with what is published from now on. Streaming
+ * responses carry each message as a chunk, an event-stream as an event
+ * and a websocket as a text frame; a polling request is answered with
+ * a single message.
+ */
+static int
+pgrest_http_push_stream_sub(pgrest_http_push_stream_handler_t *handler,
+                            pgrest_http_request_t *req)
+{
+    int                                   w = pgrest_worker_index;
+    int                                   rc;
+    bool                                  found, resume, backlog;
+    uint64                                since = 0;
+    const char                           *type;
+    pgrest_string_t                       id;
+    pgrest_http_cleanup_t                *cln;
+    pgrest_http_push_stream_conf_t       *conf = handler->conf;
+    pgrest_http_push_stream_sub_t        *sub_conf = &conf->value.sub_conf;
+    pgrest_http_push_stream_shm_t        *shm;
+    pgrest_http_push_stream_channel_t    *ch;
+    pgrest_http_push_stream_local_t      *local;
+    pgrest_http_push_stream_subscriber_t *sub;
+
+    if (req->method != PGREST_HTTP_GET) {
+        return PGREST_HTTP_NOT_ALLOWED;
+    }
+
+    if (!pgrest_http_push_stream_id(conf, req, &id)
+        || !pgrest_http_push_stream_since(req, &resume, &since))
+    {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    if (sub_conf->tunnel == PGREST_HTTP_PUSH_STREAM_WEBSOCKET
+        && !pgrest_http_websocket_is_upgrade(req))
+    {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    if ((shm = pgrest_http_push_stream_shm()) == NULL) {
+        return PGREST_HTTP_SERVICE_UNAVAILABLE;
+    }
+
+    sub = pgrest_mpool_calloc(req->pool, 1, sizeof(*sub));
+    cln = pgrest_http_cleanup_add(req);
+    if (sub == NULL || cln == NULL) {
+        return PGREST_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ch = pgrest_http_push_stream_acquire(shm, &id, true);
+    if (ch == NULL) {
+        return PGREST_HTTP_INSUFFICIENT_STORAGE;
+    }
+
+    if (!pgrest_http_push_stream_worker_isset(ch, w)) {
+        ch->workers[w / 64] |= (uint64) 1 << (w % 64);
+        ch->cursors[w].id = ch->last_id;
+        ch->cursors[w].next = NULL;
+    }
+
+    /* ids start over with the segment, a larger one resumes from now */
+    sub->last = resume ? Min(since, ch->last_id) : ch->last_id;
+
+    /* the messages it missed stay until this worker has sent them */
+    if (ch->cursors[w].id > sub->last) {
+        pgrest_http_push_stream_seek(ch, w, sub->last);
+    }
+
+    backlog = (ch->tail && ch->tail->id > sub->last);
+    if (backlog) {
+        pgrest_http_push_stream_queue(shm, ch, w);
+    }
+
+    ch->subscribers++;
+
+    SpinLockRelease(&shm->mutex);
+
+    local = hash_search(pgrest_http_push_stream_locals, &ch, HASH_ENTER,
+                        &found);
+    if (!found) {
+        dlist_init(&local->subscribers);
+        local->bytes_out = 0;
+        local->dropped = 0;
+        local->busy = false;
+    }
+
+    sub->req = req;
+    sub->local = local;
+    sub->tunnel = sub_conf->tunnel;
+    sub->conf = sub_conf;
+    dlist_init(&sub->pending);
+    dlist_push_tail(&local->subscribers, &sub->node);
+
+    cln->handler = pgrest_http_push_stream_unsubscribe;
+    cln->data = sub;
+
+    switch (sub->tunnel) {
+    case PGREST_HTTP_PUSH_STREAM_WEBSOCKET:
+        /* a failed handshake is answered as usual, the cleanup unsubscribes */
+        rc = pgrest_http_websocket_accept(req, NULL, sub);
+        if (rc != PGREST_OK) {
+            return rc;
+        }
+
+        sub->ws = req->websocket;
+        sub->ws->drain_handler = pgrest_http_push_stream_drained;
+        break;
+
+    case PGREST_HTTP_PUSH_STREAM_POLLING:
+    case PGREST_HTTP_PUSH_STREAM_LONGPOLLING:
+        if (!backlog && sub->tunnel == PGREST_HTTP_PUSH_STREAM_POLLING) {
+            pgrest_http_send_response(req, PGREST_HTTP_NOT_MODIFIED, NULL,
+                                      NULL);
+            return PGREST_OK;
+        }
+
+        req->read_event_handler = pgrest_http_push_stream_sub_reading;
+
+        if (!pgrest_conn_add_read(req->conn, sub_conf->longpolling_timeout)) {
+            pgrest_http_close_request(req, 0);
+            return PGREST_OK;
+        }
+
+        break;
+
+    default:
+        type = (sub->tunnel == PGREST_HTTP_PUSH_STREAM_EVENTSOURCE)
+               ? "text/event-stream" : "text/plain";
+
+        req->chunked = 1;
+        req->headers_out.status = PGREST_HTTP_OK;
+        req->headers_out.content_length_n = -1;
+
+        if (!pgrest_http_set_header(req, "Content-Type", type)
+            || !pgrest_http_set_header(req, "Cache-Control", "no-cache")
+            || pgrest_http_send_header(req) == PGREST_ERROR)
+        {
+            pgrest_http_close_request(req, 0);
+            return PGREST_OK;
+        }
+
+        /* cleared for http/1.0, which gets the messages as they are */
+        sub->chunked = req->chunked;
+
+        req->read_event_handler = pgrest_http_push_stream_sub_reading;
+        req->write_event_handler = pgrest_http_push_stream_sub_writing;
+
+        if (!pgrest_conn_add_read(req->conn, 0)) {
+            pgrest_http_close_request(req, 0);
+            return PGREST_OK;
+        }
+
+        break;
+    }
+
+    /* sent from the event loop, like what is published later */
+    if (backlog) {
+        (void) pgrest_ipc_send_notify(w, PGREST_IPC_CMD_HTTP_PUSH_CHECK);
+    }
+
+    return PGREST_OK;
+}
+
+/* a polling request is done with its first message */
+static void
+pgrest_http_push_stream_answer(pgrest_http_push_stream_subscriber_t *sub,
+                               pgrest_http_push_stream_msg_t        *msg)
+{
+    char                    last[sizeof("18446744073709551615")];
+    pgrest_string_t         body;
+    pgrest_http_request_t  *req = sub->req;
+
+    sub->answered = true;
+    pgrest_conn_del_timer(req->conn);
+
+    snprintf(last, sizeof(last), UINT64_FORMAT, msg->id);
+
+    if (!pgrest_http_set_header(req, "Last-Event-ID", last)
+        || !pgrest_http_set_header(req, "Cache-Control", "no-cache"))
+    {
+        pgrest_http_close_request(req, 0);
+        return;
+    }
+
+    body.base = msg->data;
+    body.len = msg->len;
+
+    pgrest_http_send_response(req, PGREST_HTTP_OK, "text/plain", &body);
+}
+
+/* a server-sent event, every line of the message a "data" field */
+static StringInfo
+pgrest_http_push_stream_event(uint64               id,
+                              const unsigned char *data,
+                              size_t               len)
+{
+    const unsigned char  *p, *end, *last;
+    MemoryContext         oldctx;
+    static StringInfo     buf = NULL;
+
+    if (buf == NULL) {
+        oldctx = MemoryContextSwitchTo(TopMemoryContext);
+        buf = makeStringInfo();
+        MemoryContextSwitchTo(oldctx);
+    } else {
+        resetStringInfo(buf);
+    }
+
+    appendStringInfo(buf, "id: " UINT64_FORMAT "\n", id);
+
+    p = data;
+    last = p + len;
+
+    do {
+        end = memchr(p, '\n', last - p);
+        if (end == NULL) {
+            end = last;
+        }
+
+        appendStringInfoString(buf, "data: ");
+        appendBinaryStringInfo(buf, (char *) p, end - p);
+        appendStringInfoChar(buf, '\n');
+
+        p = end + 1;
+    } while (p < last);
+
+    appendStringInfoChar(buf, '\n');
+
+    return buf;
+}
+
+/* a piece of the response, as a chunk unless for http/1.0 */
+static int
+pgrest_http_push_stream_write(pgrest_http_push_stream_subscriber_t *sub,
+                              void                                 *data,
+                              size_t                                len)
+{
+    char          size[sizeof("ffffffffffffffff" CRLF)];
+    struct iovec  iov[3];
+
+    if (!sub->chunked) {
+        iov[0].iov_base = data;
+        iov[0].iov_len = len;
+
+        return pgrest_http_write(sub->req, iov, 1);
+    }
+
+    iov[0].iov_base = size;
+    iov[0].iov_len = snprintf(size, sizeof(size), "%zx" CRLF, len);
+    iov[1].iov_base = data;
+    iov[1].iov_len = len;
+    iov[2].iov_base = CRLF;
+    iov[2].iov_len = sizeof(CRLF) - 1;
+
+    return pgrest_http_write(sub->req, iov, 3);
+}
+
+/*
+ * Hand a message to the connection. frame and event are built on the
+ * first call and reused by the callers for the other subscribers, the
+ * websocket ones that can not take the frame at once queue a reference
+ * to it instead of a copy.
+ */
+static int
+pgrest_http_push_stream_deliver(pgrest_http_push_stream_subscriber_t *sub,
+                                uint64                                id,
+                                const unsigned char                  *data,
+                                size_t                                len,
+                                pgrest_http_websocket_frame_t       **frame,
+                                StringInfo                           *event)
+{
+    int  rc;
+
+    switch (sub->tunnel) {
+    case PGREST_HTTP_PUSH_STREAM_WEBSOCKET:
+        if (*frame == NULL) {
+            *frame = pgrest_http_websocket_frame_create(
+                                             PGREST_HTTP_WEBSOCKET_TEXT,
+                                             data, len);
+            if (*frame == NULL) {
+                return PGREST_ERROR;
+            }
+        }
+
+        rc = pgrest_http_websocket_send(sub->ws, *frame);
+        sub->local->bytes_out += (*frame)->len;
+        break;
+
+    case PGREST_HTTP_PUSH_STREAM_EVENTSOURCE:
+        if (*event == NULL) {
+            *event = pgrest_http_push_stream_event(id, data, len);
+        }
+
+        rc = pgrest_http_push_stream_write(sub, (*event)->data,
+                                           (*event)->len);
+        sub->local->bytes_out += (*event)->len;
+        break;
+
+    default:
+        /* shared memory goes straight to the socket, copied if slow */
+        rc = pgrest_http_push_stream_write(sub, (void *) data, len);
+        sub->local->bytes_out += len;
+        break;
+    }
+
+    return rc;
+}
+
+/* the connection still has something of an earlier message to send */
+static bool
+pgrest_http_push_stream_busy(pgrest_http_push_stream_subscriber_t *sub)
+{
+    if (pgrest_http_output_pending(sub->req)) {
+        return true;
+    }
+
+    return sub->ws && !dlist_is_empty(&sub->ws->out);
+}
+
+/*
+ * Queue a message for a subscriber the connection is busy with, within
+ * the limits of its location. Once they are reached the policy drops
+ * the oldest or the newest message, or the subscriber. Coalescing
+ * first drops the queued message with the same key, messages published
+ * without one share the empty key. Returns PGREST_ERROR when the
+ * subscriber has to go.
+ */
+static int
+pgrest_http_push_stream_hold(pgrest_http_push_stream_subscriber_t *sub,
+                             pgrest_http_push_stream_msg_t        *msg)
+{
+    size_t                              size = msg->len + msg->key_len;
+    dlist_mutable_iter                  iter;
+    pgrest_http_push_stream_sub_t      *conf = sub->conf;
+    pgrest_http_push_stream_pending_t  *pending;
+
+    if (conf->slow_policy == PGREST_HTTP_PUSH_STREAM_COALESCE) {
+        dlist_foreach_modify(iter, &sub->pending) {
+            pending = dlist_container(pgrest_http_push_stream_pending_t,
+                                      node, iter.cur);
+
+            if (pending->key_len == msg->key_len
+                && memcmp(pending->data + pending->len,
+                          msg->data + msg->len, msg->key_len) == 0)
+            {
+                pgrest_http_push_stream_drop(sub, pending);
+                sub->local->dropped++;
+            }
+        }
+    }
+
+    while (sub->npending >= conf->max_queue_messages
+           || sub->pending_bytes + size > (size_t) conf->max_queue_bytes)
+    {
+        switch (conf->slow_policy) {
+        case PGREST_HTTP_PUSH_STREAM_DISCONNECT:
+            ereport(LOG, (errmsg(PGREST_PACKAGE " " "push stream subscriber "
+                                 "too slow on channel \"%.*s\", %d messages "
+                                 "%zu bytes queued, closing",
+                                 (int) sub->local->channel->len,
+                                 sub->local->channel->id, sub->npending,
+                                 sub->pending_bytes)));
+            return PGREST_ERROR;
+
+        case PGREST_HTTP_PUSH_STREAM_DROP_NEWEST:
+            sub->local->dropped++;
+            return PGREST_OK;
+
+        default:
+            /* a message larger than the queue goes too */
+            if (dlist_is_empty(&sub->pending)) {
+                sub->local->dropped++;
+                return PGREST_OK;
+            }
+
+            pending = dlist_container(pgrest_http_push_stream_pending_t,
+                                      node,
+                                      dlist_head_node(&sub->pending));
+            pgrest_http_push_stream_drop(sub, pending);
+            sub->local->dropped++;
+            break;
+        }
+    }
+
+    if (pgrest_http_push_stream_mctx == NULL) {
+        pgrest_http_push_stream_mctx = pgrest_util_mctx_create(
+                                     TopMemoryContext,
+                                     PGREST_PACKAGE " " "push stream queues",
+                                     ALLOCSET_DEFAULT_MINSIZE,
+                                     ALLOCSET_DEFAULT_INITSIZE,
+                                     ALLOCSET_DEFAULT_MAXSIZE);
+        if (pgrest_http_push_stream_mctx == NULL) {
+            return PGREST_ERROR;
+        }
+    }
+
+    pending = pgrest_util_alloc(pgrest_http_push_stream_mctx,
+                                offsetof(pgrest_http_push_stream_pending_t,
+                                         data) + size);
+    if (pending == NULL) {
+        return PGREST_ERROR;
+    }
+
+    pending->id = msg->id;
+    pending->len = msg->len;
+    pending->key_len = msg->key_len;
+    memcpy(pending->data, msg->data, size);
+
+    dlist_push_tail(&sub->pending, &pending->node);
+    sub->pending_bytes += size;
+    sub->npending++;
+
+    return PGREST_OK;
+}
+
+/* the connection took what it had, give it the queued messages */
+static void
+pgrest_http_push_stream_flush(pgrest_http_push_stream_subscriber_t *sub)
+{
+    int                                 rc;
+    StringInfo                          event;
+    pgrest_http_websocket_frame_t      *frame;
+    pgrest_http_push_stream_pending_t  *pending;
+
+    while (!dlist_is_empty(&sub->pending)
+           && !pgrest_http_push_stream_busy(sub))
+    {
+        pending = dlist_container(pgrest_http_push_stream_pending_t, node,
+                                  dlist_head_node(&sub->pending));
+
+        frame = NULL;
+        event = NULL;
+
+        rc = pgrest_http_push_stream_deliver(sub, pending->id, pending->data,
+                                             pending->len, &frame, &event);
+        if (frame) {
+            pgrest_http_websocket_frame_release(frame);
+        }
+
+        pgrest_http_push_stream_drop(sub, pending);
+
+        if (rc == PGREST_ERROR) {
+            pgrest_http_close_request(sub->req, 0);
+            return;
+        }
+    }
+}
+
+static void
+pgrest_http_push_stream_drained(pgrest_http_websocket_t *ws)
+{
+    pgrest_http_push_stream_flush(ws->data);
+}
+
+/*
+ * Write a message to the local subscribers of its channel, or queue it
+ * for those whose connection has not sent the last ones yet.
+ */
+static void
+pgrest_http_push_stream_fanout(pgrest_http_push_stream_local_t *local,
+                               pgrest_http_push_stream_msg_t   *msg)
+{
+    int                                    rc;
+    dlist_mutable_iter                     iter;
+    StringInfo                             event = NULL;
+    pgrest_http_websocket_frame_t         *frame = NULL;
+    pgrest_http_push_stream_subscriber_t  *sub;
+
+    dlist_foreach_modify(iter, &local->subscribers) {
+        sub = dlist_container(pgrest_http_push_stream_subscriber_t, node,
+                              iter.cur);
+
+        if (msg->id <= sub->last || sub->answered) {
+            continue;
+        }
+
+        sub->last = msg->id;
+
+        switch (sub->tunnel) {
+        case PGREST_HTTP_PUSH_STREAM_POLLING:
+        case PGREST_HTTP_PUSH_STREAM_LONGPOLLING:
+            pgrest_http_push_stream_answer(sub, msg);
+            local->bytes_out += msg->len;
+            continue;
+
+        default:
+            break;
+        }
+
+        if (!dlist_is_empty(&sub->pending)
+            || pgrest_http_push_stream_busy(sub))
+        {
+            rc = pgrest_http_push_stream_hold(sub, msg);
+        } else {
+            rc = pgrest_http_push_stream_deliver(sub, msg->id, msg->data,
+                                                 msg->len, &frame, &event);
+        }
+
+        if (rc == PGREST_ERROR) {
+            pgrest_http_close_request(sub->req, 0);
+        }
+    }
+
+    if (frame) {
+        pgrest_http_websocket_frame_release(frame);
+    }
+}
+
+/* send what was published since the last time on one channel */
+static void
+pgrest_http_push_stream_check_channel(pgrest_http_push_stream_shm_t   *shm,
+                                      pgrest_http_push_stream_local_t *local)
+{
+    int                                 i, n;
+    pgrest_http_push_stream_channel_t  *ch = local->channel;
+    pgrest_http_push_stream_channel_t  *unlinked;
+    pgrest_http_push_stream_cursor_t   *cur;
+    pgrest_http_push_stream_msg_t      *msg;
+    pgrest_http_push_stream_msg_t      *msgs[PGREST_HTTP_PUSH_STREAM_BATCH];
+    pgrest_http_push_stream_msg_t      *garbage;
+
+    cur = &ch->cursors[pgrest_worker_index];
+    local->busy = true;
+
+    do {
+        SpinLockAcquire(&shm->mutex);
+
+        n = 0;
+
+        for (msg = cur->next; msg && n < PGREST_HTTP_PUSH_STREAM_BATCH;
+             msg = msg->next)
+        {
+            msgs[n++] = msg;
+        }
+
+        SpinLockRelease(&shm->mutex);
+
+        /* they stay until the cursor passes them */
+        for (i = 0; i < n && !dlist_is_empty(&local->subscribers); i++) {
+            pgrest_http_push_stream_fanout(local, msgs[i]);
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        garbage = NULL;
+
+        SpinLockAcquire(&shm->mutex);
+        cur->id = msgs[n - 1]->id;
+        cur->next = msgs[n - 1]->next;
+        ch->bytes_out += local->bytes_out;
+        ch->dropped += local->dropped;
+        shm->dropped += local->dropped;
+        local->bytes_out = 0;
+        local->dropped = 0;
+        unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+        SpinLockRelease(&shm->mutex);
+
+        Assert(unlinked == NULL);
+        pgrest_http_push_stream_free(unlinked, garbage);
+
+    } while (n == PGREST_HTTP_PUSH_STREAM_BATCH);
+
+    local->busy = false;
+
+    if (dlist_is_empty(&local->subscribers)) {
+        pgrest_http_push_stream_leave(local);
+    }
+}
+
+/*
+ * Go through the dirty list of this worker. The list is taken whole, its
+ * channels stay queued, and so linked and allocated, until each is
+ * looked at; a publish meanwhile puts it on the list again.
+ */
+static void
+pgrest_http_push_stream_check(int src_worker, void *data, size_t len)
+{
+    int                                 w = pgrest_worker_index;
+    bool                                subscribed;
+    pgrest_http_push_stream_channel_t  *ch, *next, *unlinked;
+    pgrest_http_push_stream_msg_t      *garbage;
+    pgrest_http_push_stream_local_t    *local;
+    pgrest_http_push_stream_shm_t      *shm = pgrest_http_push_stream_shm();
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d push stream "
+                              "check from worker %d", pgrest_worker_index,
+                               src_worker)));
+
+    if (shm == NULL || pgrest_http_push_stream_locals == NULL) {
+        return;
+    }
+
+    SpinLockAcquire(&shm->mutex);
+    ch = shm->dirty[w];
+    shm->dirty[w] = NULL;
+    SpinLockRelease(&shm->mutex);
+
+    for ( ; ch; ch = next) {
+        garbage = NULL;
+        unlinked = NULL;
+
+        SpinLockAcquire(&shm->mutex);
+
+        next = ch->cursors[w].dirty;
+        ch->cursors[w].dirty = NULL;
+        ch->cursors[w].queued = false;
+        ch->nqueued--;
+
+        /* the subscribers left after the publish */
+        subscribed = pgrest_http_push_stream_worker_isset(ch, w);
+        if (!subscribed) {
+            unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+        }
+
+        SpinLockRelease(&shm->mutex);
+
+        if (!subscribed) {
+            pgrest_http_push_stream_free(unlinked, garbage);
+            continue;
+        }
+
+        local = hash_search(pgrest_http_push_stream_locals, &ch, HASH_FIND,
+                            NULL);
+        if (local) {
+            pgrest_http_push_stream_check_channel(shm, local);
+        }
+    }
+}
+
+/* called with the mutex, the id is left to the caller */
+static void
+pgrest_http_push_stream_stat(pgrest_http_push_stream_channel_t *ch,
+                             pgrest_http_push_stream_stat_t    *stat,
+                             time_t                             now)
+{
+    pgrest_http_push_stream_rate(ch, now);
+
+    stat->published = ch->last_id;
+    stat->subscribers = ch->subscribers;
+    stat->bytes_out = ch->bytes_out;
+    stat->dropped = ch->dropped;
+    stat->stored = ch->nstored;
+    stat->max_messages = ch->max_messages;
+    stat->ttl = ch->ttl;
+    stat->rate = ch->rate;
+}
+
+static void
+pgrest_http_push_stream_stat_json(StringInfo                      buf,
+                                  pgrest_http_push_stream_stat_t *stat)
+{
+    /* published by the change feed or the notify bridge, any name goes */
+    appendStringInfoString(buf, "{\"channel\": ");
+    escape_json(buf, stat->id);
+    appendStringInfo(buf, ", \"published_messages\": " UINT64_FORMAT ", "
+                     "\"stored_messages\": %u, "
+                     "\"subscribers\": " UINT64_FORMAT ", "
+                     "\"publish_rate\": %.2f, "
+                     "\"bytes_out\": " UINT64_FORMAT ", "
+                     "\"dropped_messages\": " UINT64_FORMAT ", "
+                     "\"message_ttl\": %d, \"max_messages\": %u}",
+                     stat->published, stat->stored, stat->subscribers,
+                     stat->rate, stat->bytes_out, stat->dropped, stat->ttl,
+                     stat->max_messages);
+}
+
+static void
+pgrest_http_push_stream_stat_send(pgrest_http_request_t          *req,
+                                  pgrest_string_t                *id,
+                                  pgrest_http_push_stream_stat_t *stat)
+{
+    StringInfoData  buf;
+    MemoryContext   oldctx;
+
+    oldctx = MemoryContextSwitchTo(req->pool->mctx);
+
+    stat->id = pnstrdup((char *) id->base, id->len);
+
+    initStringInfo(&buf);
+    pgrest_http_push_stream_stat_json(&buf, stat);
+
+    MemoryContextSwitchTo(oldctx);
+
+    pgrest_http_push_stream_json(req, PGREST_HTTP_OK, &buf);
+}
+
+/*
+ * All channels, a bucket at a time. The copies are made with the
+ * mutex held and formatted without it, the arrays grow and the bucket
+ * is taken again when they are too small.
+ */
+static void
+pgrest_http_push_stream_list(pgrest_http_request_t         *req,
+                             pgrest_http_push_stream_shm_t *shm)
+{
+    int                                 i, n, max = 16;
+    uint32                              b;
+    size_t                              size, names_size = 1024;
+    char                               *names, *p;
+    time_t                              now = time(NULL);
+    bool                                first = true;
+    uint64                              channels, messages;
+    uint64                              published, dropped;
+    StringInfoData                      buf;
+    MemoryContext                       oldctx;
+    pgrest_http_push_stream_stat_t     *stats;
+    pgrest_http_push_stream_channel_t  *ch;
+
+    oldctx = MemoryContextSwitchTo(req->pool->mctx);
+
+    stats = palloc(max * sizeof(pgrest_http_push_stream_stat_t));
+    names = palloc(names_size);
+
+    initStringInfo(&buf);
+
+    /* no allocation under the spinlock, it could raise an error */
+    SpinLockAcquire(&shm->mutex);
+    channels = shm->channels;
+    messages = shm->messages;
+    published = shm->published;
+    dropped = shm->dropped;
+    SpinLockRelease(&shm->mutex);
+
+    appendStringInfo(&buf, "{\"channels\": " UINT64_FORMAT ", "
+                     "\"messages\": " UINT64_FORMAT ", "
+                     "\"published_messages\": " UINT64_FORMAT ", "
+                     "\"dropped_messages\": " UINT64_FORMAT ", ",
+                     channels, messages, published, dropped);
+
+    appendStringInfo(&buf, "\"generation\": %u, \"size\": %zu, "
+                     "\"list\": [",
+                     pgrest_http_push_stream_seg->generation,
+                     pgrest_http_push_stream_seg->size);
+
+    for (b = 0; b < shm->nbuckets; b++) {
+        for ( ;; ) {
+            SpinLockAcquire(&shm->mutex);
+
+            n = 0;
+            size = 0;
+
+            for (ch = shm->buckets[b]; ch; ch = ch->next) {
+                n++;
+                size += ch->len + 1;
+            }
+
+            if (n <= max && size <= names_size) {
+                break;
+            }
+
+            SpinLockRelease(&shm->mutex);
+
+            max = Max(n, max * 2);
+            names_size = Max(size, names_size * 2);
+            stats = repalloc(stats, max * sizeof(*stats));
+            names = repalloc(names, names_size);
+        }
+
+        p = names;
+
+        for (ch = shm->buckets[b], i = 0; ch; ch = ch->next, i++) {
+            pgrest_http_push_stream_stat(ch, &stats[i], now);
+
+            memcpy(p, ch->id, ch->len + 1);
+            stats[i].id = p;
+            p += ch->len + 1;
+        }
+
+        SpinLockRelease(&shm->mutex);
+
+        for (i = 0; i < n; i++) {
+            if (!first) {
+                appendStringInfoString(&buf, ", ");
+            }
+
+            first = false;
+            pgrest_http_push_stream_stat_json(&buf, &stats[i]);
+        }
+    }
+
+    appendStringInfoString(&buf, "]}");
+
+    MemoryContextSwitchTo(oldctx);
+
+    pgrest_http_push_stream_json(req, PGREST_HTTP_OK, &buf);
+}
+
+/* "message_ttl" in seconds and "max_messages", 0 removes them */
+static int
+pgrest_http_push_stream_set(pgrest_http_request_t         *req,
+                            pgrest_http_push_stream_shm_t *shm,
+                            pgrest_string_t               *id)
+{
+    off_t                               ttl = -1, max = -1;
+    bool                                had;
+    pgrest_string_t                     value;
+    pgrest_http_push_stream_stat_t      stat;
+    pgrest_http_push_stream_channel_t  *ch, *unlinked;
+    pgrest_http_push_stream_msg_t      *garbage = NULL;
+
+    if (pgrest_http_push_stream_arg(req, PGREST_HTTP_PUSH_STREAM_TTL,
+                                    sizeof(PGREST_HTTP_PUSH_STREAM_TTL) - 1,
+                                    &value))
+    {
+        ttl = pgrest_atoof(value.base, value.len);
+        if (ttl == PGREST_ERROR || ttl > INT_MAX) {
+            return PGREST_HTTP_BAD_REQUEST;
+        }
+    }
+
+    if (pgrest_http_push_stream_arg(req, PGREST_HTTP_PUSH_STREAM_MAX,
+                                    sizeof(PGREST_HTTP_PUSH_STREAM_MAX) - 1,
+                                    &value))
+    {
+        max = pgrest_atoof(value.base, value.len);
+        if (max == PGREST_ERROR
+            || max > PGREST_HTTP_PUSH_STREAM_MAX_MESSAGES)
+        {
+            return PGREST_HTTP_BAD_REQUEST;
+        }
+    }
+
+    if (ttl < 0 && max < 0) {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    ch = pgrest_http_push_stream_acquire(shm, id, true);
+    if (ch == NULL) {
+        return PGREST_HTTP_INSUFFICIENT_STORAGE;
+    }
+
+    had = (ch->ttl || ch->max_messages);
+
+    if (ttl >= 0) {
+        ch->ttl = (int) ttl;
+    }
+
+    if (max >= 0) {
+        ch->max_messages = (uint32) max;
+    }
+
+    /* the stored messages above the new limits go with the next expiry */
+    if (had != (ch->ttl || ch->max_messages)) {
+        if (had) {
+            shm->expiring--;
+        } else {
+            shm->expiring++;
+        }
+    }
+
+    pgrest_http_push_stream_stat(ch, &stat, time(NULL));
+
+    unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+
+    SpinLockRelease(&shm->mutex);
+
+    pgrest_http_push_stream_free(unlinked, garbage);
+
+    pgrest_http_push_stream_stat_send(req, id, &stat);
+
+    return PGREST_OK;
+}
+
+/*
+ * The channel is unlinked at once, a publisher or subscriber coming
+ * after gets a new one. The workers with subscribers on it are told to
+ * close them, which frees it with the last one.
+ */
+static int
+pgrest_http_push_stream_delete(pgrest_http_request_t         *req,
+                               pgrest_http_push_stream_shm_t *shm,
+                               pgrest_string_t               *id)
+{
+    uint64                               workers[PGREST_HTTP_PUSH_STREAM_WORDS];
+    pgrest_http_push_stream_stat_t       stat;
+    pgrest_http_push_stream_channel_t   *ch, *unlinked;
+    pgrest_http_push_stream_channel_t  **prev;
+    pgrest_http_push_stream_msg_t       *garbage = NULL;
+
+    ch = pgrest_http_push_stream_acquire(shm, id, false);
+    if (ch == NULL) {
+        return PGREST_HTTP_NOT_FOUND;
+    }
+
+    prev = &shm->buckets[ch->hash & (shm->nbuckets - 1)];
+    while (*prev != ch) {
+        prev = &(*prev)->next;
+    }
+
+    *prev = ch->next;
+    shm->channels--;
+
+    if (ch->ttl || ch->max_messages) {
+        shm->expiring--;
+    }
+
+    pgrest_http_push_stream_stat(ch, &stat, time(NULL));
+
+    /* the stored messages are let go by pgrest_http_push_stream_gc() */
+    ch->deleted = true;
+    ch->nstored = 0;
+    ch->ttl = 0;
+    ch->max_messages = 0;
+
+    memcpy(workers, ch->workers, sizeof(workers));
+
+    unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+
+    SpinLockRelease(&shm->mutex);
+
+    pgrest_http_push_stream_free(unlinked, garbage);
+
+    pgrest_http_push_stream_notify(workers, PGREST_IPC_CMD_HTTP_PUSH_DELETE);
+    pgrest_http_push_stream_stat_send(req, id, &stat);
+
+    return PGREST_OK;
+}
+
+/*
+ * GET lists the channels, or shows the one named like a publisher
+ * does. PUT or POST sets its "message_ttl" and "max_messages", DELETE
+ * removes it together with its messages and subscribers.
+ */
+static int
+pgrest_http_push_stream_admin(pgrest_http_push_stream_handler_t *handler,
+                              pgrest_http_request_t *req)
+{
+    pgrest_string_t                     id;
+    pgrest_http_push_stream_stat_t      stat;
+    pgrest_http_push_stream_conf_t     *conf = handler->conf;
+    pgrest_http_push_stream_shm_t      *shm;
+    pgrest_http_push_stream_channel_t  *ch;
+
+    if (!pgrest_http_push_stream_id(conf, req, &id) && id.len) {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    if ((shm = pgrest_http_push_stream_shm()) == NULL) {
+        return PGREST_HTTP_SERVICE_UNAVAILABLE;
+    }
+
+    switch (req->method) {
+    case PGREST_HTTP_GET:
+    case PGREST_HTTP_HEAD:
+        if (id.len == 0) {
+            pgrest_http_push_stream_list(req, shm);
+            return PGREST_OK;
+        }
+
+        ch = pgrest_http_push_stream_acquire(shm, &id, false);
+        if (ch == NULL) {
+            return PGREST_HTTP_NOT_FOUND;
+        }
+
+        pgrest_http_push_stream_stat(ch, &stat, time(NULL));
+
+        SpinLockRelease(&shm->mutex);
+
+        pgrest_http_push_stream_stat_send(req, &id, &stat);
+        return PGREST_OK;
+
+    case PGREST_HTTP_PUT:
+    case PGREST_HTTP_POST:
+        return id.len ? pgrest_http_push_stream_set(req, shm, &id)
+                      : PGREST_HTTP_BAD_REQUEST;
+
+    case PGREST_HTTP_DELETE:
+        return id.len ? pgrest_http_push_stream_delete(req, shm, &id)
+                      : PGREST_HTTP_BAD_REQUEST;
+
+    default:
+        return PGREST_HTTP_NOT_ALLOWED;
+    }
+}
+
+/* called with the mutex, returns the number of messages looked at */
+static int
+pgrest_http_push_stream_trim(pgrest_http_push_stream_channel_t *ch,
+                             time_t                             now,
+                             int                                limit)
+{
+    int                             n = 0;
+    pgrest_http_push_stream_msg_t  *msg;
+
+    /* stored messages are in the order they came */
+    for (msg = ch->head; msg && n < limit; msg = msg->next, n++) {
+        if (!msg->stored) {
+            continue;
+        }
+
+        if (!(ch->ttl && msg->time + ch->ttl <= now)
+            && !(ch->max_messages && ch->nstored > ch->max_messages))
+        {
+            break;
+        }
+
+        msg->stored = false;
+        ch->nstored--;
+    }
+
+    return n;
+}
+
+/*
+ * Let go the stored messages past the ttl or the max_messages of their
+ * channel. A step takes a few buckets and a bounded number of messages,
+ * neither the mutex nor the worker is held for long. The workers share
+ * the buckets through expire_next, so together they go round the table
+ * faster than a single one.
+ */
+static void
+pgrest_http_push_stream_expire(evutil_socket_t fd, short events, void *arg)
+{
+    int                                 n, visited = 0;
+    time_t                              now;
+    pgrest_http_push_stream_shm_t      *shm = pgrest_http_push_stream_shm();
+    pgrest_http_push_stream_channel_t  *ch;
+    pgrest_http_push_stream_channel_t  *unlinked PG_USED_FOR_ASSERTS_ONLY;
+    pgrest_http_push_stream_msg_t      *garbage;
+
+    /* read without the mutex, a stale value delays the step only */
+    if (shm == NULL || shm->expiring == 0) {
+        return;
+    }
+
+    now = time(NULL);
+
+    for (n = 0; n < PGREST_HTTP_PUSH_STREAM_EXPIRE_BUCKETS
+                && visited < PGREST_HTTP_PUSH_STREAM_EXPIRE_MSGS; n++)
+    {
+        garbage = NULL;
+
+        SpinLockAcquire(&shm->mutex);
+
+        ch = shm->buckets[shm->expire_next++ & (shm->nbuckets - 1)];
+
+        for ( ; ch; ch = ch->next) {
+            if (ch->ttl == 0 && ch->max_messages == 0) {
+                continue;
+            }
+
+            visited += pgrest_http_push_stream_trim(ch, now,
+                                   PGREST_HTTP_PUSH_STREAM_EXPIRE_MSGS
+                                   - visited);
+
+            /* kept for its settings */
+            unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+            Assert(unlinked == NULL);
+        }
+
+        SpinLockRelease(&shm->mutex);
+
+        pgrest_http_push_stream_free(NULL, garbage);
+    }
+}
+
+/* close the local subscribers of the channels the admin deleted */
+static void
+pgrest_http_push_stream_deleted(int src_worker, void *data, size_t len)
+{
+    HASH_SEQ_STATUS                       status;
+    dlist_mutable_iter                    iter;
+    pgrest_http_push_stream_local_t      *local;
+    pgrest_http_push_stream_subscriber_t *sub;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d push stream "
+                              "delete from worker %d", pgrest_worker_index,
+                               src_worker)));
+
+    if (pgrest_http_push_stream_shm() == NULL
+        || pgrest_http_push_stream_locals == NULL)
+    {
+        return;
+    }
+
+    hash_seq_init(&status, pgrest_http_push_stream_locals);
+
+    while ((local = hash_seq_search(&status)) != NULL) {
+        /* set before the command was sent */
+        if (!local->channel->deleted) {
+            continue;
+        }
+
+        local->busy = true;
+
+        dlist_foreach_modify(iter, &local->subscribers) {
+            sub = dlist_container(pgrest_http_push_stream_subscriber_t,
+                                  node, iter.cur);
+
+            switch (sub->tunnel) {
+            case PGREST_HTTP_PUSH_STREAM_WEBSOCKET:
+                if (sub->ws == NULL) {
+                    pgrest_http_close_request(sub->req, 0);
+                    break;
+                }
+
+                (void) pgrest_http_websocket_close(sub->ws,
+                                        PGREST_HTTP_WEBSOCKET_GOING_AWAY);
+                break;
+
+            case PGREST_HTTP_PUSH_STREAM_POLLING:
+            case PGREST_HTTP_PUSH_STREAM_LONGPOLLING:
+                if (!sub->answered) {
+                    sub->answered = true;
+                    pgrest_conn_del_timer(sub->req->conn);
+                    pgrest_http_send_response(sub->req,
+                                              PGREST_HTTP_NOT_FOUND,
+                                              NULL, NULL);
+                }
+                break;
+
+            default:
+                pgrest_http_close_request(sub->req, 0);
+                break;
+            }
+        }
+
+        local->busy = false;
+
+        if (dlist_is_empty(&local->subscribers)) {
+            pgrest_http_push_stream_leave(local);
+        }
+    }
+}
+
+/* close the local subscribers, they can not follow into a new segment */
+static void
+pgrest_http_push_stream_reset(void)
+{
+    HASH_SEQ_STATUS                       status;
+    dlist_mutable_iter                    iter;
+    pgrest_http_push_stream_local_t      *local;
+    pgrest_http_push_stream_subscriber_t *sub;
+
+    hash_seq_init(&status, pgrest_http_push_stream_locals);
+
+    while ((local = hash_seq_search(&status)) != NULL) {
+        local->busy = true;
+
+        dlist_foreach_modify(iter, &local->subscribers) {
+            sub = dlist_container(pgrest_http_push_stream_subscriber_t,
+                                  node, iter.cur);
+            pgrest_http_close_request(sub->req, 0);
+        }
+
+        local->busy = false;
+        pgrest_http_push_stream_leave(local);
+    }
+}
+
+/*
+ * A worker restarting after a crash drops what its predecessor left in
+ * the channels and on its dirty list, otherwise their messages would
+ * never be freed.
+ */
+static bool
+pgrest_http_push_stream_worker_init(void *data, void *base)
+{
+    uint32                              i;
+    int                                 w = pgrest_worker_index;
+    bool                                queued;
+    HASHCTL                             ctl;
+    pgrest_http_push_stream_shm_t      *shm;
+    pgrest_http_push_stream_channel_t  *ch, *next, *unlinked;
+    pgrest_http_push_stream_channel_t  *channels = NULL;
+    pgrest_http_push_stream_msg_t      *garbage = NULL;
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = sizeof(pgrest_http_push_stream_channel_t *);
+    ctl.entrysize = sizeof(pgrest_http_push_stream_local_t);
+    ctl.hash = tag_hash;
+
+    pgrest_http_push_stream_locals = hash_create(PGREST_PACKAGE " " "push "
+                                                 "stream subscribers",
+                                                 PGREST_HTTP_PUSH_STREAM_LOCALS,
+                                                 &ctl,
+                                                 HASH_ELEM | HASH_FUNCTION);
+
+    pgrest_ipc_setup_msg_handler(PGREST_IPC_CMD_HTTP_PUSH_CHECK,
+                                 pgrest_http_push_stream_check);
+    pgrest_ipc_setup_msg_handler(PGREST_IPC_CMD_DB_PUSH_CHECK,
+                                 pgrest_http_push_stream_check);
+    pgrest_ipc_setup_msg_handler(PGREST_IPC_CMD_HTTP_PUSH_DELETE,
+                                 pgrest_http_push_stream_deleted);
+
+    pgrest_http_push_stream_timer = pgrest_event_new(base, -1, EV_PERSIST,
+                                            pgrest_http_push_stream_expire,
+                                            NULL);
+    if (pgrest_http_push_stream_timer == NULL
+        || !pgrest_event_add(pgrest_http_push_stream_timer, EV_TIMEOUT,
+                             PGREST_HTTP_PUSH_STREAM_EXPIRE_INTERVAL))
+    {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "worker %d create "
+                                 "push stream expiry timer failed",
+                                  pgrest_worker_index)));
+        return false;
+    }
+
+    if ((shm = pgrest_http_push_stream_shm()) == NULL) {
+        return true;
+    }
+
+    SpinLockAcquire(&shm->mutex);
+
+    shm->dirty[w] = NULL;
+
+    for (i = 0; i < shm->nbuckets; i++) {
+        for (ch = shm->buckets[i]; ch; ch = next) {
+            next = ch->next;
+
+            queued = ch->cursors[w].queued;
+
+            if (queued) {
+                ch->cursors[w].queued = false;
+                ch->cursors[w].dirty = NULL;
+                ch->nqueued--;
+            }
+
+            if (!queued && !pgrest_http_push_stream_worker_isset(ch, w)) {
+                continue;
+            }
+
+            ch->workers[w / 64] &= ~((uint64) 1 << (w % 64));
+            ch->cursors[w].id = 0;
+            ch->cursors[w].next = NULL;
+
+            unlinked = pgrest_http_push_stream_gc(shm, ch, &garbage);
+            if (unlinked) {
+                unlinked->next = channels;
+                channels = unlinked;
+            }
+        }
+    }
+
+    SpinLockRelease(&shm->mutex);
+
+    pgrest_http_push_stream_free(NULL, garbage);
+
+    for (ch = channels; ch; ch = next) {
+        next = ch->next;
+        pgrest_http_push_stream_free(ch, NULL);
+    }
+
+    return true;
+}
+
+/* apply a changed "push_stream_shm_size" */
+static bool
+pgrest_http_push_stream_reload(void *data, void *base)
+{
+    size_t             size;
+    pgrest_shm_seg_t  *seg = pgrest_http_push_stream_seg;
+
+    size = TYPEALIGN(pgrest_pagesize,
+                     (size_t) pgrest_setting.push_stream_shm_size
+                     * 1024 * 1024);
+
+    if (seg->generation
+        && (seg->size != size || seg->generation != seg->dyn->generation))
+    {
+        pgrest_http_push_stream_reset();
+    }
+
+    return pgrest_shm_seg_resize(seg, size);
+}
+
+/*
+ * The segment can only be added by the postmaster, a location added by
+ * a later reload finds it there if another location had it configured
+ * from the start.
+ */
+static bool
+pgrest_http_push_stream_shm_add(void)
+{
+    size_t             size;
+    size_t             max;
+    pgrest_shm_seg_t  *seg;
+
+    if (pgrest_http_push_stream_seg) {
+        return true;
+    }
+
+    if (IsUnderPostmaster) {
+        ereport(LOG,
+                (errmsg(PGREST_PACKAGE " " "push stream was not configured "
+                        "at server start, a restart is required")));
+        return true;
+    }
+
+    size = (size_t) pgrest_setting.push_stream_shm_size * 1024 * 1024;
+    max = (size_t) pgrest_setting.push_stream_shm_size_max * 1024 * 1024;
+
+    seg = pgrest_shm_seg_add_dynamic(PGREST_PACKAGE " " "push stream",
+                                     size, max, true);
+    if (seg == NULL) {
+        return false;
+    }
+
+    seg->init = pgrest_http_push_stream_shm_init;
+    pgrest_http_push_stream_seg = seg;
+
+    pgrest_worker_hook_add(pgrest_http_push_stream_worker_init,
+                           NULL,
+                           "push stream",
+                           NULL,
+                           false);
+    pgrest_worker_reload_hook_add(pgrest_http_push_stream_reload,
+                                  "push stream",
+                                  NULL);
+
+    return true;
+}
+
+static bool
+pgrest_http_push_stream_init(pgrest_http_handler_t *self)
+{
+    pgrest_http_push_stream_handler_t *handler = (void *)self;
+    pgrest_http_push_stream_conf_t    *conf = handler->conf;
+
+    switch (conf->mode) {
+    case PGREST_HTTP_PUSH_STREAM_PUB:
+    case PGREST_HTTP_PUSH_STREAM_SUB:
+    case PGREST_HTTP_PUSH_STREAM_ADMIN:
+        break;
+    default:
+         ereport(LOG, 
+                (errmsg(PGREST_PACKAGE " " "you must specify a valid value"
+                        " for \"push_stream->mode\" directive, only accept"
+                        " \"pub\" or \"sub\" or \"admin\"")));
+        return false;
+    }
+
+    if (!conf->param_name.base) {
+        pgrest_string_set(&conf->param_name, "id");
+    }
+
+    return pgrest_http_push_stream_shm_add();
+}
+
+static void
+pgrest_http_push_stream_fini(pgrest_http_handler_t *self)
+{
+
+}
+
+static int
+pgrest_http_push_stream_handler(pgrest_http_handler_t *self,
+                                pgrest_http_request_t *req)
+{
+    pgrest_http_push_stream_handler_t *handler = (void *)self;
+    pgrest_http_push_stream_conf_t    *conf = handler->conf;
+
+    switch (conf->mode) {
+    case PGREST_HTTP_PUSH_STREAM_PUB:
+        return pgrest_http_push_stream_pub(handler, req);
+    case PGREST_HTTP_PUSH_STREAM_SUB:
+        return pgrest_http_push_stream_sub(handler, req);
+    case PGREST_HTTP_PUSH_STREAM_ADMIN:
+        return pgrest_http_push_stream_admin(handler, req);
     default:
         Assert(false);
     }
 
-    return 0;
+    return PGREST_HTTP_INTERNAL_SERVER_ERROR;
 }
 
 void
@@ -236,5 +2691,15 @@ pgrest_http_push_stream_conf_register(void)
     pgrest_conf_def_cmd("mode", 0, 0, 0, pgrest_http_push_stream_mode);
     pgrest_conf_def_cmd("param_name", 0, 0, 0, pgrest_http_push_stream_name);
     pgrest_conf_def_cmd("store_message", 0, 0, 0, pgrest_http_push_stream_stor);
+    pgrest_conf_def_cmd("max_messages", 0, 1, 65535,
+                        pgrest_http_push_stream_max);
     pgrest_conf_def_cmd("subscriber", 0, 0, 0, pgrest_http_push_stream_tunnel);
+    pgrest_conf_def_cmd("longpolling_timeout", 0, 1000, 86400000,
+                        pgrest_http_push_stream_timeout);
+    pgrest_conf_def_cmd("max_queue_bytes", 0, 1024, INT_MAX,
+                        pgrest_http_push_stream_queue_bytes);
+    pgrest_conf_def_cmd("max_queue_messages", 0, 1, 1000000,
+                        pgrest_http_push_stream_queue_messages);
+    pgrest_conf_def_cmd("slow_policy", 0, 0, 0,
+                        pgrest_http_push_stream_policy);
 }
@@ -0,0 +1,96 @@
+/* -------------------------------------------------------------------------
+ *
+ * pq_rest_http_slab_stats.c
+ *   http slab stats module
+ *
+ *
+ *
+ * Copyright (C) 2014-2015, Robert Mu <dbx_c@hotmail.com>
+ *
+ *  src/pg_rest_http_slab_stats.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#include "pg_rest_http_slab_stats.h"
+
+static int
+pgrest_http_slab_stats_handler(pgrest_http_handler_t  *self,
+                               pgrest_http_request_t  *req);
+static bool pgrest_http_slab_stats_init(pgrest_http_handler_t *self);
+static void pgrest_http_slab_stats_fini(pgrest_http_handler_t *self);
+
+/* the location takes no settings, "slab_stats": {} turns it on */
+static void *
+pgrest_http_slab_stats_conf(void *parent)
+{
+    pgrest_http_slab_stats_handler_t *handler;
+    pgrest_conf_http_path_t          *path = parent;
+
+    handler = (void*)pgrest_http_handler_create(path, sizeof(*handler));
+    if (handler == NULL) {
+        return NULL;
+    }
+
+    handler->super.name = "slab_stats";
+    handler->super.init = pgrest_http_slab_stats_init;
+    handler->super.fini = pgrest_http_slab_stats_fini;
+    handler->super.handler = pgrest_http_slab_stats_handler;
+
+    return handler;
+}
+
+static bool
+pgrest_http_slab_stats_init(pgrest_http_handler_t *self)
+{
+
+    return true;
+}
+
+static void
+pgrest_http_slab_stats_fini(pgrest_http_handler_t *self)
+{
+
+}
+
+/*
+ * The counters of every slab pool segment as pgrest_slab_pages() and
+ * pgrest_slab_stats() return them, without a database connection.
+ */
+static int
+pgrest_http_slab_stats_handler(pgrest_http_handler_t *self,
+                               pgrest_http_request_t *req)
+{
+    StringInfoData    buf;
+    MemoryContext     oldctx;
+    pgrest_string_t   body;
+
+    if (req->method != PGREST_HTTP_GET && req->method != PGREST_HTTP_HEAD) {
+        return PGREST_HTTP_NOT_ALLOWED;
+    }
+
+    oldctx = MemoryContextSwitchTo(req->pool->mctx);
+
+    initStringInfo(&buf);
+    pgrest_shm_slab_stat_json(&buf);
+    appendStringInfoString(&buf, CRLF);
+
+    MemoryContextSwitchTo(oldctx);
+
+    body.base = (unsigned char *) buf.data;
+    body.len = buf.len;
+
+    pgrest_http_send_response(req, PGREST_HTTP_OK, "application/json", &body);
+
+    return PGREST_OK;
+}
+
+void
+pgrest_http_slab_stats_conf_register(void)
+{
+    pgrest_conf_def_obj("slab_stats", pgrest_http_slab_stats_conf);
+}
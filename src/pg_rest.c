@@ -51,6 +51,9 @@ _PG_init(void)
     /* initialize guc variables */
     pgrest_guc_init((char *) &pgrest_setting);
 
+    /* initialize timer wheel */
+    pgrest_timer_init(pgrest_setting.worker_timer_resolution);
+
     /* initialize connection */
     pgrest_conn_init(pgrest_setting.worker_noconn);
 
@@ -60,17 +63,23 @@ _PG_init(void)
     /* initialize listener */
     pgrest_listener_init();
 
+    /* initialize workers, settles worker_processes_max */
+    pgrest_worker_init(pgrest_setting.worker_processes);
+
     /* initialize acceptor */
-    pgrest_acceptor_init(pgrest_setting.worker_processes);
+    pgrest_acceptor_init(pgrest_setting.worker_processes_max);
 
-    /* initialize shared memory */
-    pgrest_shm_init();
+    /* initialize ipc, adds the ring segment */
+    pgrest_ipc_init(pgrest_setting.worker_processes_max);
 
-    /* initialize ipc */
-    pgrest_ipc_init(pgrest_setting.worker_processes);
+    /* initialize change feed, sends through ipc */
+    pgrest_change_feed_init();
 
-    /* initialize workers */
-    pgrest_worker_init(pgrest_setting.worker_processes);
+    /* initialize notify bridge, runs in worker 0 */
+    pgrest_notify_bridge_init();
+
+    /* initialize shared memory */
+    pgrest_shm_init();
 
     pgrest_master_context = MemoryContextSwitchTo(old_context);
 }
@@ -85,7 +94,7 @@ _PG_fini(void)
 
     pgrest_listener_fini();
     pgrest_shm_fini();
-    pgrest_ipc_fini(pgrest_setting.worker_processes);
+    pgrest_ipc_fini(pgrest_setting.worker_processes_max);
 
     MemoryContextDelete(pgrest_master_context);
 }
@@ -15,12 +15,18 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
+#define PGREST_ACCEPTOR_BALANCE_INTERVAL    1000
+
 typedef struct {
     slock_t     acceptor_mutex;
 } pgrest_acceptor_data_t;
 
 static pgrest_acceptor_data_t *pgrest_acceptor_data = NULL;
 static struct event           *pgrest_acceptor_event_timer = NULL;
+static struct event           *pgrest_acceptor_balance_timer = NULL;
+static int                     pgrest_acceptor_steer_nworkers = 0;
+static int                     pgrest_acceptor_steer_workers[
+                                                    PGREST_MAX_WORKERS];
 
 bool                           pgrest_acceptor_use_mutex = false;
 bool                           pgrest_acceptor_mutex_held = false;
@@ -71,6 +77,45 @@ pgrest_acceptor_timer_handler(evutil_socket_t fd, short events, void *arg)
     }
 }
 
+/*
+ * Periodically re-steer reuseport groups away from overloaded workers.
+ * Runs in worker 0 only, the program is shared by the whole group.
+ */
+static void
+pgrest_acceptor_balance_handler(evutil_socket_t fd, short events, void *arg)
+{
+    int   i;
+    int   n;
+    int   workers[PGREST_MAX_WORKERS];
+
+    n = 0;
+    for (i = 0; i < pgrest_setting.worker_processes; i++) {
+        if (!pgrest_worker_overloaded(i)) {
+            workers[n++] = i;
+        }
+    }
+
+    if (n == pgrest_acceptor_steer_nworkers
+        && memcmp(workers, pgrest_acceptor_steer_workers,
+                  n * sizeof(int)) == 0)
+    {
+        return;
+    }
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d steer reuseport"
+                              " connections to %d workers",
+                               pgrest_worker_index, n)));
+
+    if (!pgrest_listener_steer(workers, n)) {
+        /* not supported, stop trying */
+        (void) pgrest_event_del(pgrest_acceptor_balance_timer, EV_TIMEOUT);
+        return;
+    }
+
+    memcpy(pgrest_acceptor_steer_workers, workers, n * sizeof(int));
+    pgrest_acceptor_steer_nworkers = n;
+}
+
 static bool
 pgrest_acceptor_worker_init(void *data, void *base)
 {
@@ -87,6 +132,32 @@ pgrest_acceptor_worker_init(void *data, void *base)
 
     pgrest_event_priority_set(pgrest_acceptor_event_timer, 0);
 
+    if (pgrest_worker_index == 0
+        && pgrest_setting.acceptor_balance_threshold
+        && pgrest_setting.worker_processes > 1
+        && pgrest_listener_reuseport())
+    {
+        /*
+         * The program outlives the worker, attach one for the current
+         * load at the first tick rather than trust what a previous
+         * worker 0 left behind.
+         */
+        pgrest_acceptor_steer_nworkers = 0;
+
+        pgrest_acceptor_balance_timer = pgrest_event_new(base, -1, EV_PERSIST,
+                                            pgrest_acceptor_balance_handler,
+                                            NULL);
+        if (pgrest_acceptor_balance_timer == NULL
+            || !pgrest_event_add(pgrest_acceptor_balance_timer, EV_TIMEOUT,
+                                 PGREST_ACCEPTOR_BALANCE_INTERVAL))
+        {
+            ereport(WARNING, (errmsg(PGREST_PACKAGE " " "worker %d create "
+                                     "balance timer failed",
+                                      pgrest_worker_index)));
+            return false;
+        }
+    }
+
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d initialize "
                                "acceptor successfull", pgrest_worker_index)));
 
@@ -97,6 +168,13 @@ static bool
 pgrest_acceptor_worker_exit(void *data, void *base)
 {
     pgrest_event_free(pgrest_acceptor_event_timer);
+
+    if (pgrest_acceptor_balance_timer) {
+        (void) pgrest_event_del(pgrest_acceptor_balance_timer, EV_TIMEOUT);
+        pgrest_event_free(pgrest_acceptor_balance_timer);
+        pgrest_acceptor_balance_timer = NULL;
+    }
+
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d acceptor_exit ",
                                pgrest_worker_index)));
 
@@ -123,6 +201,59 @@ pgrest_acceptor_close_conn(pgrest_connection_t *conn)
     }
 }
 
+/*
+ * Estimate the accept queue depth of a listening socket, -1 if unknown.
+ * For a listening TCP socket Linux reports the current accept queue
+ * length in tcpi_unacked.
+ */
+static int
+pgrest_acceptor_backlog(evutil_socket_t fd)
+{
+#if defined(__linux__) && defined(TCP_INFO)
+    struct tcp_info  ti;
+    socklen_t        len;
+
+    len = sizeof(struct tcp_info);
+
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) == -1) {
+        return -1;
+    }
+
+    return (int) ti.tcpi_unacked;
+#else
+    return -1;
+#endif
+}
+
+/*
+ * Adapt the number of connections accepted per wakeup. The batch shrinks
+ * when the queue drains early, and grows towards the queued backlog
+ * (or doubles when it is unknown) when it is used up, never going above
+ * multi_accept_max so established connections are not starved.
+ */
+static void
+pgrest_acceptor_batch_update(pgrest_listener_t *listener,
+                             int accepted,
+                             bool drained)
+{
+    int   batch;
+    int   backlog;
+
+    batch = listener->accept_batch;
+
+    if (drained) {
+        if (accepted < batch / 2) {
+            batch = Max(batch / 2, 1);
+        }
+    } else {
+        backlog = pgrest_acceptor_backlog(listener->fd);
+        batch = (backlog < 0) ? batch * 2 : batch + backlog;
+    }
+
+    listener->accept_batch = Min(batch,
+                                 pgrest_setting.acceptor_multi_accept_max);
+}
+
 void
 pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
 {
@@ -131,21 +262,27 @@ pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
     pgrest_listener_t   *listener;
     pgrest_connection_t *conn;
     pgrest_connection_t *lconn;
+    pgrest_conn_cold_t  *cold;
     SockAddr             sockaddr;
-    int                  available;
+    bool                 available;
+    int                  limit;
+    int                  n;
 #ifdef HAVE_ACCEPT4
     static int           use_accept4 = 1;
 #endif
 
     lconn = (pgrest_connection_t *) arg;
-    listener = lconn->listener;
+    listener = pgrest_conn_cold(lconn)->listener;
     available = pgrest_setting.acceptor_multi_accept;
+    limit = available ? listener->accept_batch : 1;
+
+    listener->stat->wakeups++;
 
     ereport(DEBUG2, (errmsg(PGREST_PACKAGE " " "accept on %s multi_accept: %d"
-                             ,listener->addr_text, 
-                             pgrest_setting.acceptor_multi_accept)));
+                            " batch: %d", listener->addr_text, available,
+                             limit)));
 
-    do {
+    for (n = 0; n < limit; /* void */ ) {
         sockaddr.salen = sizeof(sockaddr.addr);
 
 #ifdef HAVE_ACCEPT4
@@ -166,9 +303,17 @@ pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
             if (PGREST_UTIL_ERR_RW_RETRIABLE(err)) {
                 debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "accept()"
                                            " not ready")));
+                listener->stat->eagain++;
+
+                if (available) {
+                    pgrest_acceptor_batch_update(listener, n, true);
+                }
+
                 return;
             }
 
+            listener->stat->errors++;
+
 #ifdef HAVE_ACCEPT4
             ereport(COMMERROR,
                     (errcode_for_socket_access(),
@@ -187,6 +332,7 @@ pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
 
             if (err == ECONNABORTED) {
                 if (available) {
+                    n++;
                     continue;
                 }
             }
@@ -219,6 +365,9 @@ pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
             return;
         }
 
+        n++;
+        listener->stat->accepted++;
+
         pgrest_acceptor_disabled = pgrest_setting.worker_noconn / 8
                                    - pgrest_conn_free_noconn;
 
@@ -229,20 +378,21 @@ pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
             return;
         }
 
-        conn->type = SOCK_STREAM;
+        cold = pgrest_conn_cold(conn);
+        cold->type = SOCK_STREAM;
 
         if ((conn->pool = pgrest_mpool_create(NULL)) == NULL) {
             pgrest_acceptor_close_conn(conn);
             return;
         }
 
-        if((conn->sockaddr = pgrest_mpool_alloc(conn->pool, 
+        if((cold->sockaddr = pgrest_mpool_alloc(conn->pool, 
                                                 sockaddr.salen)) == NULL)
         {
             pgrest_acceptor_close_conn(conn);
             return;
         }
-        memcpy(conn->sockaddr, &sockaddr.addr, sockaddr.salen);
+        memcpy(cold->sockaddr, &sockaddr.addr, sockaddr.salen);
 
         if (evutil_make_socket_nonblocking(fd) == -1) {
             ereport(WARNING,
@@ -253,34 +403,38 @@ pgrest_acceptor_accept_handler(evutil_socket_t afd, short events, void *arg)
             return;
         }
 
-        conn->socklen = sockaddr.salen;
-        conn->listener = listener;
-        conn->local_sockaddr = listener->sockaddr;
-        conn->local_socklen = listener->socklen;
+        cold->socklen = sockaddr.salen;
+        cold->listener = listener;
+        cold->local_sockaddr = listener->sockaddr;
+        cold->local_socklen = listener->socklen;
 #ifdef HAVE_UNIX_SOCKETS
-        if (conn->sockaddr->sa_family == AF_UNIX) {
+        if (cold->sockaddr->sa_family == AF_UNIX) {
             conn->tcp_nopush = PGREST_TCP_NOPUSH_DISABLED;
             conn->tcp_nodelay = PGREST_TCP_NODELAY_DISABLED;
         }
 #endif
         if (listener->addr_ntop) {
-            conn->addr_text = pgrest_mpool_alloc(conn->pool, 
+            cold->addr_text = pgrest_mpool_alloc(conn->pool, 
                                                  listener->addr_text_max_len);
-            if (conn->addr_text == NULL) {
+            if (cold->addr_text == NULL) {
                 pgrest_acceptor_close_conn(conn);
                 return;
             }
 
-            (void) pgrest_inet_ntop(conn->sockaddr, 
-                                    conn->socklen, 
-                                    conn->addr_text, 
+            (void) pgrest_inet_ntop(cold->sockaddr, 
+                                    cold->socklen, 
+                                    cold->addr_text, 
                                     listener->addr_text_max_len,
                                     false);
         }
 
         listener->handler(conn);
+    }
 
-    } while (available);
+    /* batch used up, more connections may still be queued */
+    if (available) {
+        pgrest_acceptor_batch_update(listener, n, false);
+    }
 }
 
 bool
@@ -335,7 +489,10 @@ pgrest_acceptor_unlock_mutex(void)
 void
 pgrest_acceptor_init(int worker_processes)
 {
-    if (worker_processes > 1 && pgrest_setting.acceptor_mutex) {
+    if (worker_processes > 1
+        && pgrest_setting.acceptor_mode == PGREST_ACCEPT_MODE_MUTEX
+        && pgrest_setting.acceptor_mutex)
+    {
         pgrest_acceptor_use_mutex = true;
     } else {
         pgrest_acceptor_use_mutex = false;
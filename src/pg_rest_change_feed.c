@@ -0,0 +1,938 @@
+/* -------------------------------------------------------------------------
+ *
+ * pq_rest_change_feed.c
+ *   logical decoding change feed
+ *
+ *
+ *
+ * Copyright (C) 2014-2015, Robert Mu <dbx_c@hotmail.com>
+ *
+ *  src/pg_rest_change_feed.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#include "pg_rest_http_push_stream.h"
+
+#if PGSQL_VERSION >= 94
+
+/* "schema.table", the key of the primary key cache */
+#define PGREST_CHANGE_FEED_TABLE_MAX      (NAMEDATALEN * 2)
+#define PGREST_CHANGE_FEED_TABLES         64
+
+typedef struct {
+    char                         *name;
+    /* as text, NULL for a null */
+    char                         *value;
+    /* a string in json, numbers and booleans are not */
+    bool                          quote;
+} pgrest_change_feed_column_t;
+
+/* a row change of the transaction being read */
+typedef struct {
+    const char                   *op;
+    char                         *schema;
+    char                         *table;
+    /* of pgrest_change_feed_column_t */
+    List                         *columns;
+    /* the old key printed by update and delete */
+    List                         *keys;
+    StringInfoData                json;
+    bool                          done;
+} pgrest_change_feed_change_t;
+
+/* the primary key columns of a table, NIL without a primary key */
+typedef struct {
+    char                          table[PGREST_CHANGE_FEED_TABLE_MAX];
+    List                         *columns;
+} pgrest_change_feed_pkey_t;
+
+static volatile sig_atomic_t      pgrest_change_feed_terminate = false;
+static volatile sig_atomic_t      pgrest_change_feed_reconfigure = false;
+static MemoryContext              pgrest_change_feed_mctx = NULL;
+static HTAB                      *pgrest_change_feed_pkeys = NULL;
+/* workers with subscribers on what this poll published */
+static uint64                     pgrest_change_feed_workers[
+                                      PGREST_HTTP_PUSH_STREAM_WORDS];
+
+static const char *pgrest_change_feed_plugins[] = {
+    "test_decoding",
+    "wal2json"
+};
+
+/* the slot is only read here, it moves on past what was published */
+static const char *pgrest_change_feed_queries[] = {
+    "SELECT * FROM pg_catalog.pg_logical_slot_peek_changes($1, NULL, $2, "
+    "'include-xids', '1', 'skip-empty-xacts', '1')",
+    "SELECT * FROM pg_catalog.pg_logical_slot_peek_changes($1, NULL, $2)"
+};
+
+static const char *pgrest_change_feed_advance_queries[] = {
+    "SELECT count(*) FROM pg_catalog.pg_logical_slot_get_changes($1, "
+    "$2::pg_catalog.pg_lsn, NULL, 'include-xids', '1', "
+    "'skip-empty-xacts', '1')",
+    "SELECT count(*) FROM pg_catalog.pg_logical_slot_get_changes($1, "
+    "$2::pg_catalog.pg_lsn, NULL)"
+};
+
+static const char *pgrest_change_feed_pkey_query =
+    "SELECT a.attname FROM pg_catalog.pg_index i "
+    "JOIN pg_catalog.pg_class c ON c.oid = i.indrelid "
+    "JOIN pg_catalog.pg_namespace n ON n.oid = c.relnamespace "
+    "CROSS JOIN pg_catalog.generate_subscripts(i.indkey, 1) k "
+    "JOIN pg_catalog.pg_attribute a ON a.attrelid = i.indrelid "
+    "AND a.attnum = i.indkey[k] "
+    "WHERE n.nspname = $1 AND c.relname = $2 AND i.indisprimary "
+    "ORDER BY k";
+
+#if PGSQL_VERSION >= 95
+static void pgrest_change_feed_main(Datum) pg_attribute_noreturn();
+#else
+static void pgrest_change_feed_main(Datum);
+#endif
+
+static void
+pgrest_change_feed_sigterm(SIGNAL_ARGS)
+{
+    int  save_errno = errno;
+
+    pgrest_change_feed_terminate = true;
+    SetLatch(&MyProc->procLatch);
+
+    errno = save_errno;
+}
+
+static void
+pgrest_change_feed_sighup(SIGNAL_ARGS)
+{
+    int  save_errno = errno;
+
+    pgrest_change_feed_reconfigure = true;
+    SetLatch(&MyProc->procLatch);
+
+    errno = save_errno;
+}
+
+/* forget the primary keys, a table may have been altered meanwhile */
+static void
+pgrest_change_feed_pkeys_init(void)
+{
+    HASHCTL  ctl;
+
+    if (pgrest_change_feed_pkeys) {
+        hash_destroy(pgrest_change_feed_pkeys);
+        MemoryContextReset(pgrest_change_feed_mctx);
+    }
+
+    MemSet(&ctl, 0, sizeof(ctl));
+    ctl.keysize = PGREST_CHANGE_FEED_TABLE_MAX;
+    ctl.entrysize = sizeof(pgrest_change_feed_pkey_t);
+
+    pgrest_change_feed_pkeys = hash_create(PGREST_PACKAGE " " "change feed "
+                                           "primary keys",
+                                           PGREST_CHANGE_FEED_TABLES,
+                                           &ctl,
+                                           HASH_ELEM);
+}
+
+/* called within the transaction of the poll */
+static List *
+pgrest_change_feed_pkey(pgrest_change_feed_change_t *change)
+{
+    int                         ret;
+    uint64                      i;
+    bool                        found;
+    char                        table[PGREST_CHANGE_FEED_TABLE_MAX];
+    Oid                         argtypes[2] = { TEXTOID, TEXTOID };
+    Datum                       values[2];
+    MemoryContext               oldctx;
+    pgrest_change_feed_pkey_t  *entry;
+
+    snprintf(table, sizeof(table), "%s.%s", change->schema, change->table);
+
+    entry = hash_search(pgrest_change_feed_pkeys, table, HASH_ENTER, &found);
+    if (found) {
+        return entry->columns;
+    }
+
+    entry->columns = NIL;
+
+    values[0] = CStringGetTextDatum(change->schema);
+    values[1] = CStringGetTextDatum(change->table);
+
+    ret = SPI_execute_with_args(pgrest_change_feed_pkey_query, 2, argtypes,
+                                values, NULL, true, 0);
+    if (ret != SPI_OK_SELECT) {
+        return NIL;
+    }
+
+    oldctx = MemoryContextSwitchTo(pgrest_change_feed_mctx);
+
+    for (i = 0; i < SPI_processed; i++) {
+        entry->columns = lappend(entry->columns,
+                                 SPI_getvalue(SPI_tuptable->vals[i],
+                                              SPI_tuptable->tupdesc, 1));
+    }
+
+    MemoryContextSwitchTo(oldctx);
+
+    return entry->columns;
+}
+
+/* numbers and booleans test_decoding prints unquoted, which are json too */
+static bool
+pgrest_change_feed_literal(const char *value)
+{
+    const char  *p = value;
+
+    if (strcmp(p, "true") == 0 || strcmp(p, "false") == 0) {
+        return true;
+    }
+
+    if (*p == '-') {
+        p++;
+    }
+
+    /* NaN and Infinity are not */
+    if (*p < '0' || *p > '9') {
+        return false;
+    }
+
+    return strspn(p, "0123456789.eE+-") == strlen(p);
+}
+
+/* an identifier as quote_identifier() printed it */
+static char *
+pgrest_change_feed_ident(char **pos, const char *stop)
+{
+    char    *p = *pos;
+    char    *result;
+    char    *r;
+    size_t   n;
+
+    if (*p != '"') {
+        n = strcspn(p, stop);
+        *pos = p + n;
+        return pnstrdup(p, n);
+    }
+
+    result = r = palloc(strlen(p));
+
+    for (p++; *p; p++) {
+        if (*p == '"' && *++p != '"') {
+            break;
+        }
+
+        *r++ = *p;
+    }
+
+    *r = '\0';
+    *pos = p;
+
+    return result;
+}
+
+/* a value as test_decoding printed it, a literal within quotes */
+static char *
+pgrest_change_feed_quoted(char **pos)
+{
+    char    *p = *pos;
+    char    *result;
+    char    *r;
+
+    result = r = palloc(strlen(p));
+
+    for (p++; *p; p++) {
+        if (*p == '\'' && *++p != '\'') {
+            break;
+        }
+
+        *r++ = *p;
+    }
+
+    *r = '\0';
+    *pos = p;
+
+    return result;
+}
+
+/*
+ * "table public.t: UPDATE: old-key: id[integer]:1 new-tuple: id[integer]:2
+ * name[text]:'x'", returns NULL for anything else.
+ */
+static pgrest_change_feed_change_t *
+pgrest_change_feed_test_decoding(char *data)
+{
+    char                         *p = data;
+    size_t                        n;
+    List                        **target;
+    pgrest_change_feed_change_t  *change;
+    pgrest_change_feed_column_t  *col;
+
+    if (strncmp(p, "table ", 6) != 0) {
+        return NULL;
+    }
+
+    change = palloc0(sizeof(pgrest_change_feed_change_t));
+
+    p += 6;
+    change->schema = pgrest_change_feed_ident(&p, ".");
+    if (*p++ != '.') {
+        return NULL;
+    }
+
+    change->table = pgrest_change_feed_ident(&p, ":");
+    if (strncmp(p, ": ", 2) != 0) {
+        return NULL;
+    }
+
+    p += 2;
+
+    if (strncmp(p, "INSERT: ", 8) == 0) {
+        change->op = "insert";
+    } else if (strncmp(p, "UPDATE: ", 8) == 0) {
+        change->op = "update";
+    } else if (strncmp(p, "DELETE: ", 8) == 0) {
+        change->op = "delete";
+    } else {
+        return NULL;
+    }
+
+    p += 8;
+    target = &change->columns;
+
+    while (*p) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+
+        if (strncmp(p, "old-key: ", 9) == 0) {
+            target = &change->keys;
+            p += 9;
+            continue;
+        }
+
+        if (strncmp(p, "new-tuple: ", 11) == 0) {
+            target = &change->columns;
+            p += 11;
+            continue;
+        }
+
+        if (strncmp(p, "(no-tuple-data)", 15) == 0) {
+            break;
+        }
+
+        col = palloc0(sizeof(pgrest_change_feed_column_t));
+        col->name = pgrest_change_feed_ident(&p, "[");
+
+        /* the type may hold spaces and brackets */
+        if (*p != '[' || (p = strstr(p, "]:")) == NULL) {
+            return NULL;
+        }
+
+        p += 2;
+
+        if (*p == '\'') {
+            col->value = pgrest_change_feed_quoted(&p);
+            col->quote = true;
+
+        } else {
+            n = strcspn(p, " ");
+            col->value = pnstrdup(p, n);
+            p += n;
+
+            if (strcmp(col->value, "unchanged-toast-datum") == 0) {
+                continue;
+            }
+
+            if (strcmp(col->value, "null") == 0) {
+                col->value = NULL;
+            } else {
+                col->quote = !pgrest_change_feed_literal(col->value);
+            }
+        }
+
+        *target = lappend(*target, col);
+    }
+
+    return change;
+}
+
+static List *
+pgrest_change_feed_wal2json_columns(json_t *names, json_t *values)
+{
+    size_t                        i;
+    char                         *text;
+    json_t                       *value;
+    const char                   *name;
+    List                         *result = NIL;
+    pgrest_change_feed_column_t  *col;
+
+    for (i = 0; i < json_array_size(names) && i < json_array_size(values);
+         i++)
+    {
+        if ((name = json_string_value(json_array_get(names, i))) == NULL) {
+            continue;
+        }
+
+        value = json_array_get(values, i);
+
+        col = palloc0(sizeof(pgrest_change_feed_column_t));
+        col->name = pstrdup(name);
+
+        if (json_is_string(value)) {
+            col->value = pstrdup(json_string_value(value));
+            col->quote = true;
+
+        } else if (!json_is_null(value)
+                   && (text = json_dumps(value, JSON_ENCODE_ANY)) != NULL)
+        {
+            col->value = pstrdup(text);
+            free(text);
+        }
+
+        result = lappend(result, col);
+    }
+
+    return result;
+}
+
+/* wal2json writes a whole transaction as one document */
+static List *
+pgrest_change_feed_wal2json(char *data)
+{
+    size_t                        i;
+    json_t                       *root;
+    json_t                       *jchange;
+    json_t                       *oldkeys;
+    json_error_t                  error;
+    const char                   *kind;
+    const char                   *schema;
+    const char                   *table;
+    List                         *result = NIL;
+    pgrest_change_feed_change_t  *change;
+
+    if ((root = json_loads(data, 0, &error)) == NULL) {
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "change feed got invalid "
+                             "wal2json output, line %d: %s",
+                              error.line, error.text)));
+        return NIL;
+    }
+
+    for (i = 0; i < json_array_size(json_object_get(root, "change")); i++) {
+        jchange = json_array_get(json_object_get(root, "change"), i);
+
+        kind = json_string_value(json_object_get(jchange, "kind"));
+        schema = json_string_value(json_object_get(jchange, "schema"));
+        table = json_string_value(json_object_get(jchange, "table"));
+
+        if (kind == NULL || schema == NULL || table == NULL) {
+            continue;
+        }
+
+        change = palloc0(sizeof(pgrest_change_feed_change_t));
+        change->op = pstrdup(kind);
+        change->schema = pstrdup(schema);
+        change->table = pstrdup(table);
+        change->columns = pgrest_change_feed_wal2json_columns(
+                              json_object_get(jchange, "columnnames"),
+                              json_object_get(jchange, "columnvalues"));
+
+        if ((oldkeys = json_object_get(jchange, "oldkeys")) != NULL) {
+            change->keys = pgrest_change_feed_wal2json_columns(
+                               json_object_get(oldkeys, "keynames"),
+                               json_object_get(oldkeys, "keyvalues"));
+        }
+
+        result = lappend(result, change);
+    }
+
+    json_decref(root);
+
+    return result;
+}
+
+/* the old key, or the primary key taken from the new row */
+static List *
+pgrest_change_feed_key(pgrest_change_feed_change_t *change)
+{
+    ListCell                     *name;
+    ListCell                     *cell;
+    List                         *result = NIL;
+    pgrest_change_feed_column_t  *col;
+
+    if (change->keys != NIL) {
+        return change->keys;
+    }
+
+    foreach(name, pgrest_change_feed_pkey(change)) {
+        col = NULL;
+
+        foreach(cell, change->columns) {
+            col = lfirst(cell);
+
+            if (strcmp(col->name, lfirst(name)) == 0) {
+                break;
+            }
+
+            col = NULL;
+        }
+
+        if (col == NULL || col->value == NULL) {
+            return NIL;
+        }
+
+        result = lappend(result, col);
+    }
+
+    return result;
+}
+
+static void
+pgrest_change_feed_json_columns(StringInfo buf, const char *name,
+                                List *columns)
+{
+    ListCell                     *cell;
+    pgrest_change_feed_column_t  *col;
+
+    appendStringInfo(buf, ", \"%s\": {", name);
+
+    foreach(cell, columns) {
+        col = lfirst(cell);
+
+        if (cell != list_head(columns)) {
+            appendStringInfoString(buf, ", ");
+        }
+
+        escape_json(buf, col->name);
+        appendStringInfoString(buf, ": ");
+
+        if (col->value == NULL) {
+            appendStringInfoString(buf, "null");
+        } else if (col->quote) {
+            escape_json(buf, col->value);
+        } else {
+            appendStringInfoString(buf, col->value);
+        }
+    }
+
+    appendStringInfoChar(buf, '}');
+}
+
+/* false when the message could not be published */
+static bool
+pgrest_change_feed_send(StringInfo id, StringInfo buf)
+{
+    pgrest_string_t  channel;
+    int              max = pgrest_setting.change_feed_max_messages;
+
+    /* no client could name it */
+    if (id->len > PGREST_HTTP_PUSH_STREAM_ID_MAX) {
+        debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "change feed skip "
+                                  "channel \"%.*s...\", longer than %d "
+                                  "bytes", 64, id->data,
+                                   PGREST_HTTP_PUSH_STREAM_ID_MAX)));
+        return true;
+    }
+
+    channel.base = (unsigned char *) id->data;
+    channel.len = id->len;
+
+    return pgrest_http_push_stream_publish(&channel,
+                                           (unsigned char *) buf->data,
+                                           buf->len, NULL, max,
+                                           pgrest_change_feed_workers,
+                                           NULL) == PGREST_OK;
+}
+
+/*
+ * The channel of a table, "schema.table", or of a row of it with the
+ * values of its key, "schema.table:value,value". Every part is
+ * percent-encoded, a '.', ':' or ',' in a name or a value does not
+ * read as a separator.
+ */
+void
+pgrest_change_feed_channel(StringInfo id, const char *schema,
+                           const char *table, List *values)
+{
+    ListCell  *cell;
+
+    pgrest_http_push_stream_id_append(id, schema);
+    appendStringInfoChar(id, '.');
+    pgrest_http_push_stream_id_append(id, table);
+
+    foreach(cell, values) {
+        appendStringInfoChar(id, cell == list_head(values) ? ':' : ',');
+        pgrest_http_push_stream_id_append(id, lfirst(cell));
+    }
+}
+
+/*
+ * Publish a committed transaction. Every change goes to the channel of
+ * its row and the changes of each table go together to the channel of
+ * the table, see pgrest_change_feed_channel(). False when a message
+ * could not be published, the transaction is read again then.
+ */
+static bool
+pgrest_change_feed_publish(const char *xid, const char *lsn, List *changes)
+{
+    ListCell                     *cell;
+    ListCell                     *next;
+    ListCell                     *k;
+    List                         *key;
+    List                         *values;
+    StringInfoData                id;
+    StringInfoData                buf;
+    pgrest_change_feed_change_t  *change;
+    pgrest_change_feed_change_t  *other;
+    pgrest_change_feed_column_t  *col;
+
+    initStringInfo(&id);
+    initStringInfo(&buf);
+
+    foreach(cell, changes) {
+        change = lfirst(cell);
+        key = pgrest_change_feed_key(change);
+
+        initStringInfo(&change->json);
+        appendStringInfo(&change->json, "{\"xid\": %s, \"lsn\": \"%s\", "
+                         "\"op\": \"%s\", \"schema\": ", xid, lsn,
+                         change->op);
+        escape_json(&change->json, change->schema);
+        appendStringInfoString(&change->json, ", \"table\": ");
+        escape_json(&change->json, change->table);
+        pgrest_change_feed_json_columns(&change->json, "key", key);
+        pgrest_change_feed_json_columns(&change->json, "row",
+                                        change->columns);
+        appendStringInfoChar(&change->json, '}');
+
+        if (key == NIL) {
+            continue;
+        }
+
+        values = NIL;
+
+        foreach(k, key) {
+            col = lfirst(k);
+            values = lappend(values, col->value);
+        }
+
+        resetStringInfo(&id);
+        pgrest_change_feed_channel(&id, change->schema, change->table,
+                                   values);
+        list_free(values);
+
+        if (!pgrest_change_feed_send(&id, &change->json)) {
+            return false;
+        }
+    }
+
+    foreach(cell, changes) {
+        change = lfirst(cell);
+
+        if (change->done) {
+            continue;
+        }
+
+        resetStringInfo(&buf);
+        appendStringInfo(&buf, "{\"xid\": %s, \"lsn\": \"%s\", "
+                         "\"changes\": [", xid, lsn);
+
+        for (next = cell; next; next = lnext(next)) {
+            other = lfirst(next);
+
+            if (other->done || strcmp(other->schema, change->schema) != 0
+                || strcmp(other->table, change->table) != 0)
+            {
+                continue;
+            }
+
+            if (next != cell) {
+                appendStringInfoString(&buf, ", ");
+            }
+
+            appendBinaryStringInfo(&buf, other->json.data, other->json.len);
+            other->done = true;
+        }
+
+        appendStringInfoString(&buf, "]}");
+
+        resetStringInfo(&id);
+        pgrest_change_feed_channel(&id, change->schema, change->table, NIL);
+
+        if (!pgrest_change_feed_send(&id, &buf)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Publish what the slot decoded since the last call, whole transactions
+ * only. The slot is peeked at and then moved on past the last
+ * transaction published in full, one that could not be published is
+ * read again by the next call. Returns the rows read, 0 after a failure.
+ */
+static uint64
+pgrest_change_feed_poll(void)
+{
+    int             ret;
+    int             plugin = pgrest_setting.change_feed_plugin;
+    uint64          i;
+    uint64          n;
+    char           *lsn;
+    char           *xid;
+    char           *data;
+    char           *done = NULL;
+    const char     *query;
+    bool            failed = false;
+    List           *changes = NIL;
+    Oid             argtypes[2] = { TEXTOID, INT4OID };
+    Oid             advtypes[2] = { TEXTOID, TEXTOID };
+    Datum           values[2];
+    HeapTuple       tuple;
+    TupleDesc       tupdesc;
+    SPITupleTable  *tuptable;
+    pgrest_change_feed_change_t *change;
+
+    SetCurrentStatementStartTimestamp();
+    StartTransactionCommand();
+    SPI_connect();
+    PushActiveSnapshot(GetTransactionSnapshot());
+    pgstat_report_activity(STATE_RUNNING,
+                           pgrest_change_feed_queries[plugin]);
+
+    values[0] = CStringGetTextDatum(pgrest_setting.change_feed_slot);
+    values[1] = Int32GetDatum(pgrest_setting.change_feed_batch);
+
+    ret = SPI_execute_with_args(pgrest_change_feed_queries[plugin], 2,
+                                argtypes, values, NULL, false, 0);
+    if (ret != SPI_OK_SELECT) {
+        ereport(ERROR, (errmsg(PGREST_PACKAGE " " "change feed read slot "
+                               "\"%s\" failed: %d",
+                                pgrest_setting.change_feed_slot, ret)));
+    }
+
+    /* looking primary keys up runs other queries */
+    tuptable = SPI_tuptable;
+    tupdesc = tuptable->tupdesc;
+    n = SPI_processed;
+
+    for (i = 0; i < n && !failed; i++) {
+        tuple = tuptable->vals[i];
+        lsn = SPI_getvalue(tuple, tupdesc, 1);
+        xid = SPI_getvalue(tuple, tupdesc, 2);
+        data = SPI_getvalue(tuple, tupdesc, 3);
+
+        if (xid == NULL || data == NULL) {
+            continue;
+        }
+
+        if (plugin == PGREST_CHANGE_FEED_WAL2JSON) {
+            if (pgrest_change_feed_publish(xid, lsn,
+                                        pgrest_change_feed_wal2json(data)))
+            {
+                done = lsn;
+            } else {
+                failed = true;
+            }
+
+            continue;
+        }
+
+        if (strncmp(data, "BEGIN", 5) == 0) {
+            changes = NIL;
+        } else if (strncmp(data, "COMMIT", 6) == 0) {
+            if (pgrest_change_feed_publish(xid, lsn, changes)) {
+                done = lsn;
+            } else {
+                failed = true;
+            }
+
+            changes = NIL;
+        } else if ((change = pgrest_change_feed_test_decoding(data))) {
+            changes = lappend(changes, change);
+        } else {
+            debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "change feed skip "
+                                      "\"%s\"", data)));
+        }
+    }
+
+    if (failed) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "change feed could not "
+                                 "publish transaction %s, read it again "
+                                 "later", xid)));
+        n = 0;
+    }
+
+    if (done) {
+        query = pgrest_change_feed_advance_queries[plugin];
+        values[1] = CStringGetTextDatum(done);
+
+        ret = SPI_execute_with_args(query, 2, advtypes, values, NULL,
+                                    false, 0);
+        if (ret != SPI_OK_SELECT) {
+            ereport(ERROR, (errmsg(PGREST_PACKAGE " " "change feed advance "
+                                   "slot \"%s\" to %s failed: %d",
+                                    pgrest_setting.change_feed_slot, done,
+                                    ret)));
+        }
+    }
+
+    SPI_finish();
+    PopActiveSnapshot();
+    CommitTransactionCommand();
+    pgstat_report_activity(STATE_IDLE, NULL);
+
+    /* a single wakeup per worker for the whole poll */
+    pgrest_http_push_stream_notify(pgrest_change_feed_workers,
+                                   PGREST_IPC_CMD_DB_PUSH_CHECK);
+    pgrest_ipc_flush();
+    MemSet(pgrest_change_feed_workers, 0, sizeof(pgrest_change_feed_workers));
+
+    return n;
+}
+
+/* create the slot with the configured plugin unless it is there */
+static void
+pgrest_change_feed_slot(void)
+{
+    int          ret;
+    Oid          argtypes[2] = { TEXTOID, TEXTOID };
+    Datum        values[2];
+    const char  *plugin;
+
+    plugin = pgrest_change_feed_plugins[pgrest_setting.change_feed_plugin];
+
+    values[0] = CStringGetTextDatum(pgrest_setting.change_feed_slot);
+    values[1] = CStringGetTextDatum(plugin);
+
+    SetCurrentStatementStartTimestamp();
+    StartTransactionCommand();
+    SPI_connect();
+    PushActiveSnapshot(GetTransactionSnapshot());
+
+    ret = SPI_execute_with_args("SELECT 1 FROM pg_catalog."
+                                "pg_replication_slots WHERE slot_name = $1",
+                                1, argtypes, values, NULL, true, 0);
+
+    if (ret == SPI_OK_SELECT && SPI_processed == 0) {
+        (void) SPI_execute_with_args("SELECT pg_catalog."
+                                     "pg_create_logical_replication_slot("
+                                     "$1, $2)", 2, argtypes, values, NULL,
+                                     false, 0);
+
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "change feed created slot "
+                             "\"%s\" with plugin %s",
+                              pgrest_setting.change_feed_slot, plugin)));
+    }
+
+    SPI_finish();
+    PopActiveSnapshot();
+    CommitTransactionCommand();
+}
+
+static void
+pgrest_change_feed_main(Datum arg)
+{
+    int     rc;
+    uint64  n;
+    bool    paused = false;
+
+    pqsignal(SIGHUP, pgrest_change_feed_sighup);
+    pqsignal(SIGTERM, pgrest_change_feed_sigterm);
+    BackgroundWorkerUnblockSignals();
+
+    pgrest_ipc_aux_init(PGREST_IPC_AUX_CHANGE_FEED);
+
+    BackgroundWorkerInitializeConnection(pgrest_setting.change_feed_database,
+                                         NULL);
+
+    pgrest_change_feed_mctx = AllocSetContextCreate(TopMemoryContext,
+                                                    PGREST_PACKAGE " "
+                                                    "change feed",
+                                                    ALLOCSET_SMALL_SIZES);
+    pgrest_change_feed_pkeys_init();
+    pgrest_change_feed_slot();
+
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "change feed started on slot "
+                         "\"%s\"", pgrest_setting.change_feed_slot)));
+
+    while (!pgrest_change_feed_terminate) {
+        n = 0;
+
+        if (pgrest_change_feed_reconfigure) {
+            pgrest_change_feed_reconfigure = false;
+            pgrest_change_feed_pkeys_init();
+        }
+
+        /* leave the changes in the slot while there is nowhere to go */
+        if (pgrest_http_push_stream_attach()) {
+            paused = false;
+            n = pgrest_change_feed_poll();
+
+        } else if (!paused) {
+            paused = true;
+            ereport(LOG, (errmsg(PGREST_PACKAGE " " "change feed paused, no "
+                                 "push stream segment is available")));
+        }
+
+        /* more may be waiting as long as a poll comes back full */
+        if (n >= (uint64) pgrest_setting.change_feed_batch) {
+            CHECK_FOR_INTERRUPTS();
+            continue;
+        }
+
+        rc = WaitLatch(&MyProc->procLatch,
+                       WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+                       pgrest_setting.change_feed_naptime);
+        ResetLatch(&MyProc->procLatch);
+
+        if (rc & WL_POSTMASTER_DEATH) {
+            proc_exit(1);
+        }
+    }
+
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "change feed got SIGTERM")));
+
+    proc_exit(0);
+}
+
+#endif
+
+void
+pgrest_change_feed_init(void)
+{
+#if PGSQL_VERSION >= 94
+    BackgroundWorker  worker;
+#endif
+
+    if (pgrest_setting.change_feed_slot[0] == '\0') {
+        return;
+    }
+
+#if PGSQL_VERSION >= 94
+    MemSet(&worker, 0, sizeof(BackgroundWorker));
+
+    snprintf(worker.bgw_name, BGW_MAXLEN, PGREST_PACKAGE " " "change feed");
+    worker.bgw_flags = BGWORKER_SHMEM_ACCESS
+                       | BGWORKER_BACKEND_DATABASE_CONNECTION;
+    worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+    worker.bgw_restart_time = pgrest_setting.worker_restart_delay;
+    worker.bgw_main = pgrest_change_feed_main;
+    worker.bgw_main_arg = (Datum) 0;
+    worker.bgw_notify_pid = 0;
+
+    RegisterBackgroundWorker(&worker);
+#else
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "change feed requires logical "
+                         "decoding of PostgreSQL 9.4 or later, "
+                         "\"change_feed_slot\" ignored")));
+#endif
+}
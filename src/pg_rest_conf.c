@@ -28,11 +28,9 @@ static void  pgrest_conf_integer_set(pgrest_conf_command_t *cmd,
 static void  pgrest_conf_bool_set(pgrest_conf_command_t *cmd, 
                                  void *val, 
                                  void *parent);
-#ifdef HAVE_OPENSSL
 static void  pgrest_conf_string_set(pgrest_conf_command_t *cmd, 
                                  void *val, 
                                  void *parent);
-#endif
 static void  pgrest_conf_address_set(pgrest_conf_command_t *cmd, 
                                  void *val, 
                                  void *parent);
@@ -78,6 +76,18 @@ static void  pgrest_conf_http_path_set(pgrest_conf_command_t *cmd,
 static void pgrest_conf_lc_set(pgrest_conf_command_t *cmd, 
                                  void *val, 
                                  void *parent);
+static void  pgrest_conf_amode_set(pgrest_conf_command_t *cmd, 
+                                 void *val, 
+                                 void *parent);
+static void  pgrest_conf_affinity_set(pgrest_conf_command_t *cmd, 
+                                 void *val, 
+                                 void *parent);
+static void  pgrest_conf_name_set(pgrest_conf_command_t *cmd, 
+                                 void *val, 
+                                 void *parent);
+static void  pgrest_conf_plugin_set(pgrest_conf_command_t *cmd, 
+                                 void *val, 
+                                 void *parent);
 
 static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
 
@@ -99,6 +109,55 @@ static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
       offsetof(pgrest_setting_t, worker_processes),
       1,
       PGREST_MAX_WORKERS,
+      PGREST_CONF_SCALAR | PGREST_CONF_AUTO,
+      pgrest_conf_integer_set },
+
+    { "worker_processes_max",
+      offsetof(pgrest_setting_t, worker_processes_max),
+      0,
+      PGREST_MAX_WORKERS,
+      PGREST_CONF_SCALAR | PGREST_CONF_AUTO,
+      pgrest_conf_integer_set },
+
+    { "scale_interval",
+      offsetof(pgrest_setting_t, worker_scale_interval),
+      100,
+      3600000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "scale_up_threshold",
+      offsetof(pgrest_setting_t, worker_scale_up),
+      1,
+      100,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "scale_down_threshold",
+      offsetof(pgrest_setting_t, worker_scale_down),
+      0,
+      100,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "shutdown_timeout",
+      offsetof(pgrest_setting_t, worker_shutdown_timeout),
+      0,
+      3600000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "restart_delay",
+      offsetof(pgrest_setting_t, worker_restart_delay),
+      -1,
+      3600,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "restart_delay_max",
+      offsetof(pgrest_setting_t, worker_restart_delay_max),
+      1,
+      3600,
       PGREST_CONF_SCALAR,
       pgrest_conf_integer_set },
 
@@ -123,6 +182,20 @@ static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
       PGREST_CONF_SCALAR,
       pgrest_conf_integer_set },
 
+    { "timer_resolution",
+      offsetof(pgrest_setting_t, worker_timer_resolution),
+      1,
+      1000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "worker_cpu_affinity",
+      0,
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_affinity_set },
+
     { "accept",
       0,
       0,
@@ -130,6 +203,13 @@ static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
       PGREST_CONF_OBJECT,
       NULL },
 
+    { "accept_mode",
+      offsetof(pgrest_setting_t, acceptor_mode),
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_amode_set },
+
     { "accept_mutex",
       offsetof(pgrest_setting_t, acceptor_mutex),
       0,
@@ -151,6 +231,20 @@ static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
       PGREST_CONF_SCALAR,
       pgrest_conf_bool_set },
 
+    { "multi_accept_max",
+      offsetof(pgrest_setting_t, acceptor_multi_accept_max),
+      1,
+      65535,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "balance_threshold",
+      offsetof(pgrest_setting_t, acceptor_balance_threshold),
+      0,
+      1000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
     { "http",
       0,
       0,
@@ -165,6 +259,104 @@ static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
       PGREST_CONF_SCALAR,
       pgrest_conf_tbpath_set },
 
+    { "push_stream_shm_size",
+      offsetof(pgrest_setting_t, push_stream_shm_size),
+      1,
+      65536,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "push_stream_shm_size_max",
+      offsetof(pgrest_setting_t, push_stream_shm_size_max),
+      1,
+      65536,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "change_feed",
+      0,
+      0,
+      0,
+      PGREST_CONF_OBJECT,
+      NULL },
+
+    { "change_feed_slot",
+      offsetof(pgrest_setting_t, change_feed_slot),
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_name_set },
+
+    { "change_feed_plugin",
+      offsetof(pgrest_setting_t, change_feed_plugin),
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_plugin_set },
+
+    { "change_feed_database",
+      offsetof(pgrest_setting_t, change_feed_database),
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_name_set },
+
+    { "change_feed_naptime",
+      offsetof(pgrest_setting_t, change_feed_naptime),
+      1,
+      60000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "change_feed_batch",
+      offsetof(pgrest_setting_t, change_feed_batch),
+      1,
+      1000000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "change_feed_max_messages",
+      offsetof(pgrest_setting_t, change_feed_max_messages),
+      0,
+      65535,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "notify_bridge",
+      0,
+      0,
+      0,
+      PGREST_CONF_OBJECT,
+      NULL },
+
+    { "notify_conninfo",
+      offsetof(pgrest_setting_t, notify_conninfo),
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_string_set },
+
+    { "notify_channels",
+      offsetof(pgrest_setting_t, notify_channels),
+      0,
+      0,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_string_set },
+
+    { "notify_max_messages",
+      offsetof(pgrest_setting_t, notify_max_messages),
+      0,
+      65535,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
+    { "notify_reconnect_delay",
+      offsetof(pgrest_setting_t, notify_reconnect_delay),
+      100,
+      3600000,
+      PGREST_CONF_SCALAR,
+      pgrest_conf_integer_set },
+
     { "server",
       0,
       0,
@@ -457,6 +649,9 @@ static pgrest_conf_command_t  pgrest_conf_static_cmds[] = {
     { NULL, 0, 0, 0, 0, NULL }
 };
 static List              *pgrest_conf_dynamic_cmds = NIL;
+/* of the configuration in use and of the file last parsed */
+static time_t             pgrest_conf_mtime = 0;
+static time_t             pgrest_conf_parsed_mtime = 0;
 static pgrest_setting_t  *pgrest_setting_private;
 
 static void
@@ -495,7 +690,6 @@ pgrest_conf_bool_set(pgrest_conf_command_t *cmd, void *val, void *parent)
     *save = *newval;
 }
 
-#ifdef HAVE_OPENSSL
 static void
 pgrest_conf_string_set(pgrest_conf_command_t *cmd, void *val, void *parent)
 {
@@ -506,7 +700,6 @@ pgrest_conf_string_set(pgrest_conf_command_t *cmd, void *val, void *parent)
     save = (char **) (object + cmd->offset);
     *save = pstrdup(newval);
 }
-#endif
 
 static void  
 pgrest_conf_address_set(pgrest_conf_command_t *cmd, void *val, void *parent)
@@ -792,19 +985,190 @@ pgrest_conf_lc_set(pgrest_conf_command_t *cmd, void *val, void *parent)
     }
 }
 
+static void  
+pgrest_conf_amode_set(pgrest_conf_command_t *cmd, void *val, void *parent)
+{
+    pgrest_setting_t *setting = parent;
+    char             *value = val;
+
+    if (strcmp(value, "mutex") == 0) {
+        setting->acceptor_mode = PGREST_ACCEPT_MODE_MUTEX;
+    } else if (strcmp(value, "reuseport") == 0) {
+#ifndef HAVE_REUSEPORT
+        ereport(WARNING, 
+                (errmsg(PGREST_PACKAGE " " "directive \"%s\": \"%s\" is not "
+                        "supported on this platform, ignored",
+                         cmd->name, value)));
+        return;
+#endif
+        setting->acceptor_mode = PGREST_ACCEPT_MODE_REUSEPORT;
+    } else if (strcmp(value, "exclusive") == 0) {
+#ifndef HAVE_EPOLLEXCLUSIVE
+        ereport(WARNING, 
+                (errmsg(PGREST_PACKAGE " " "directive \"%s\": \"%s\" is not "
+                        "supported on this platform, ignored",
+                         cmd->name, value)));
+        return;
+#endif
+        setting->acceptor_mode = PGREST_ACCEPT_MODE_EXCLUSIVE;
+    } else {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%s\" only accept \"mutex\" or "
+                        "\"reuseport\" or \"exclusive\"", cmd->name, value)));
+    }
+}
+
+/*
+ * "auto", "off" or one bit mask per worker, e.g. "0001 0010 0100 1000",
+ * the rightmost bit being cpu 0. Workers beyond the last mask reuse it.
+ */
+static void  
+pgrest_conf_affinity_set(pgrest_conf_command_t *cmd, void *val, void *parent)
+{
+    pgrest_setting_t *setting = parent;
+    char             *value = val;
+    char             *p;
+    uint64           *mask;
+    int               n;
+
+    if (strcmp(value, "off") == 0) {
+        return;
+    }
+
+#ifndef HAVE_CPU_AFFINITY
+    ereport(WARNING, 
+            (errmsg(PGREST_PACKAGE " " "directive \"%s\" is not supported "
+                    "on this platform, ignored", cmd->name)));
+    return;
+#endif
+
+    if (strcmp(value, "auto") == 0) {
+        setting->worker_cpu_affinity_auto = true;
+        return;
+    }
+
+    for (p = value; *p; /* void */) {
+
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+
+        mask = pgrest_array_push(&setting->worker_cpu_affinity);
+        if (mask == NULL) {
+            ereport(ERROR, (errmsg(PGREST_PACKAGE " " "out of memory")));
+        }
+
+        *mask = 0;
+
+        for (n = 0; *p && *p != ' '; p++, n++) {
+
+            if (n == 64) {
+                ereport(ERROR, 
+                        (errmsg(PGREST_PACKAGE " " "invalid value for "
+                                "directive \"%s\": \"%s\" mask is longer "
+                                "than 64 cpus", cmd->name, value)));
+            }
+
+            if (*p != '0' && *p != '1') {
+                ereport(ERROR, 
+                        (errmsg(PGREST_PACKAGE " " "invalid value for "
+                                "directive \"%s\": \"%s\" only accept "
+                                "\"auto\", \"off\" or cpu masks",
+                                 cmd->name, value)));
+            }
+
+            *mask = (*mask << 1) | (uint64) (*p - '0');
+        }
+
+        if (*mask == 0) {
+            ereport(ERROR, 
+                    (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                            "\"%s\": \"%s\" contains an empty mask",
+                             cmd->name, value)));
+        }
+    }
+}
+
+static void  
+pgrest_conf_name_set(pgrest_conf_command_t *cmd, void *val, void *parent)
+{
+    char  *object = parent;
+    char  *value = val;
+
+    if (strlen(value) >= NAMEDATALEN) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value \"%s\" for "
+                        "directive \"%s\": name too long", value, cmd->name)));
+    }
+
+    strcpy(object + cmd->offset, value);
+}
+
+static void  
+pgrest_conf_plugin_set(pgrest_conf_command_t *cmd, void *val, void *parent)
+{
+    pgrest_setting_t *setting = parent;
+    char             *value = val;
+
+    if (strcmp(value, "test_decoding") == 0) {
+        setting->change_feed_plugin = PGREST_CHANGE_FEED_TEST_DECODING;
+    } else if (strcmp(value, "wal2json") == 0) {
+        setting->change_feed_plugin = PGREST_CHANGE_FEED_WAL2JSON;
+    } else {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%s\" only accept \"test_decoding\" or "
+                        "\"wal2json\"", cmd->name, value)));
+    }
+}
+
 static void *
 pgrest_conf_setting_create(void *parent)
 {
-    pgrest_setting_private->worker_processes = pgrest_util_ncpu();
+    pgrest_setting_private->worker_processes = Min(pgrest_util_ncpu(),
+                                                   PGREST_MAX_WORKERS);
+    pgrest_setting_private->worker_processes_max = 0;
+    pgrest_setting_private->worker_scale_interval = 5000;
+    pgrest_setting_private->worker_scale_up = 75;
+    pgrest_setting_private->worker_scale_down = 10;
+    pgrest_setting_private->worker_shutdown_timeout = 10000;
+    pgrest_setting_private->worker_restart_delay = 1;
+    pgrest_setting_private->worker_restart_delay_max = 60;
     pgrest_setting_private->worker_priority = 0;
     pgrest_setting_private->worker_nofile = 1024;
     pgrest_setting_private->worker_noconn = 1024;
+    pgrest_setting_private->worker_timer_resolution = 10;
+    pgrest_setting_private->worker_cpu_affinity_auto = false;
+    pgrest_setting_private->acceptor_mode = PGREST_ACCEPT_MODE_MUTEX;
     pgrest_setting_private->acceptor_mutex = true;
     pgrest_setting_private->acceptor_mutex_delay = 500;
     pgrest_setting_private->acceptor_multi_accept = false;
+    pgrest_setting_private->acceptor_multi_accept_max = 64;
+    pgrest_setting_private->acceptor_balance_threshold = 20;
     strcpy(pgrest_setting_private->temp_buffer_path, 
             PGREST_BUFFER_DTEMP_PATH);
-
+    pgrest_setting_private->push_stream_shm_size = 32;
+    pgrest_setting_private->push_stream_shm_size_max = 256;
+    pgrest_setting_private->change_feed_slot[0] = '\0';
+    pgrest_setting_private->change_feed_plugin = 
+                                   PGREST_CHANGE_FEED_TEST_DECODING;
+    strcpy(pgrest_setting_private->change_feed_database, "postgres");
+    pgrest_setting_private->change_feed_naptime = 10;
+    pgrest_setting_private->change_feed_batch = 1000;
+    pgrest_setting_private->change_feed_max_messages = 0;
+    pgrest_setting_private->notify_conninfo = "";
+    pgrest_setting_private->notify_channels = "";
+    pgrest_setting_private->notify_max_messages = 0;
+    pgrest_setting_private->notify_reconnect_delay = 1000;
+
+    if (pgrest_array_init(&pgrest_setting_private->worker_cpu_affinity,
+                          CurrentMemoryContext,
+                          4, 
+                          sizeof(uint64)) == false) {
+        return NULL;
+    }
     if (pgrest_array_init(&pgrest_setting_private->conf_http_servers,
                           CurrentMemoryContext,
                           2, 
@@ -990,7 +1354,26 @@ pgrest_conf_parse_type(const char *name, void *val, void *parent)
 static void 
 pgrest_conf_parse_string(const char *name, json_t *jelem, void *parent)
 {
-    char *val = (char *) json_string_value(jelem);
+    pgrest_conf_command_t *cmd;
+    char                  *val = (char *) json_string_value(jelem);
+    int                    ncpu;
+
+    cmd = pgrest_conf_cmd_find(name);
+
+    /* integer directive, "auto" stands for the number of online cpus */
+    if (cmd->flags & PGREST_CONF_AUTO) {
+        if (strcmp(val, "auto") != 0) {
+            ereport(ERROR, 
+                    (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                            "\"%s\": \"%s\" only accept an integer or "
+                            "\"auto\"", cmd->name, val)));
+        }
+
+        ncpu = Min(pgrest_util_ncpu(), cmd->max_val);
+        pgrest_conf_parse_type(name, &ncpu, parent);
+        return;
+    }
+
     pgrest_conf_parse_type(name, val, parent);
 }
 
@@ -1178,12 +1561,44 @@ pgrest_conf_def_obj(const char *name, pgrest_conf_create_pt handler)
     pgrest_conf_def_cmd_(name, 0, 0, 0, PGREST_CONF_OBJECT, handler);
 }
 
+static time_t
+pgrest_conf_file_mtime(const char *filename)
+{
+    struct stat   st;
+
+    if (stat(filename, &st) == -1) {
+        return 0;
+    }
+
+    return st.st_mtime;
+}
+
+/* whether the file was modified since the configuration in use was read */
+bool
+pgrest_conf_changed(const char *filename)
+{
+    return pgrest_conf_file_mtime(filename) != pgrest_conf_mtime;
+}
+
+/*
+ * Called once the configuration just parsed is in use. A file that
+ * failed to parse or to apply is thus still seen as changed.
+ */
+void
+pgrest_conf_commit(void)
+{
+    pgrest_conf_mtime = pgrest_conf_parsed_mtime;
+}
+
 bool 
 pgrest_conf_parse(pgrest_setting_t *setting, const char *filename)
 {
     json_t                 *jroot;
 
     pgrest_setting_private = setting;
+
+    /* before reading, a write meanwhile is then seen as a change */
+    pgrest_conf_parsed_mtime = pgrest_conf_file_mtime(filename);
     
     if (!pgrest_conf_parse_init(filename, &jroot)) {
         return false;
@@ -15,18 +15,24 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
-static pgrest_connection_t *pgrest_conn_conns;
 static pgrest_connection_t *pgrest_conn_free_conns;
+static char                *pgrest_conn_events;
 static dlist_head           pgrest_conn_reuse_conns = 
                                 DLIST_STATIC_INIT(pgrest_conn_reuse_conns);
 
+pgrest_connection_t        *pgrest_conn_conns;
+pgrest_conn_cold_t         *pgrest_conn_colds;
 int                         pgrest_conn_free_noconn;
 
 static void pgrest_conn_drain(void);
+static void pgrest_conn_timer_handler(pgrest_timer_t *timer);
+static void pgrest_conn_reset(pgrest_connection_t *conn);
 
 pgrest_connection_t *
 pgrest_conn_get(evutil_socket_t fd)
 {
+    struct event         *rev;
+    struct event         *wev;
     pgrest_connection_t  *conn;
 
     conn = pgrest_conn_free_conns;
@@ -46,10 +52,20 @@ pgrest_conn_get(evutil_socket_t fd)
 
     pgrest_conn_free_conns = conn->data;
     pgrest_conn_free_noconn--;
+    pgrest_worker_stat_add(1);
+
+    rev = conn->rev;
+    wev = conn->wev;
 
     MemSet(conn, 0, sizeof(pgrest_connection_t));
+    MemSet(pgrest_conn_cold(conn), 0, sizeof(pgrest_conn_cold_t));
 
+    conn->rev = rev;
+    conn->wev = wev;
     conn->fd = fd;
+
+    conn->timer.handler = pgrest_conn_timer_handler;
+    conn->timer.data = conn;
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d get connection %d "
                               "successful", pgrest_worker_index, conn->fd)));
     return conn;
@@ -60,6 +76,7 @@ pgrest_conn_drain(void)
 {
     int                   i;
     dlist_node           *node;
+    pgrest_conn_cold_t   *cold;
     pgrest_connection_t  *conn;
 
     for (i = 0; i < 32; i++) {
@@ -68,7 +85,8 @@ pgrest_conn_drain(void)
         }
 
         node = dlist_tail_node(&pgrest_conn_reuse_conns);
-        conn = dlist_container(pgrest_connection_t, elem, node);
+        cold = dlist_container(pgrest_conn_cold_t, elem, node);
+        conn = &pgrest_conn_conns[cold - pgrest_conn_colds];
 
         ereport(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d reusing "
                                 "connection", pgrest_worker_index)));
@@ -88,13 +106,14 @@ pgrest_conn_reusable(pgrest_connection_t *conn, int reusable)
                       "%d", pgrest_worker_index, reusable)));
 
     if (conn->reusable) {
-        dlist_delete(&conn->elem);
+        dlist_delete(&pgrest_conn_cold(conn)->elem);
     }
 
     conn->reusable = reusable;
 
     if (reusable) {
-        dlist_push_head(&pgrest_conn_reuse_conns, &conn->elem);
+        dlist_push_head(&pgrest_conn_reuse_conns,
+                        &pgrest_conn_cold(conn)->elem);
     }
 }
 
@@ -108,6 +127,39 @@ pgrest_conn_free(pgrest_connection_t *conn)
     conn->data = pgrest_conn_free_conns;
     pgrest_conn_free_conns = conn;
     pgrest_conn_free_noconn++;
+    pgrest_worker_stat_add(-1);
+}
+
+/*
+ * Abort a connection with a RST instead of an orderly FIN, the peer must
+ * not mistake a cut off response for a complete one.
+ */
+static void
+pgrest_conn_reset(pgrest_connection_t *conn)
+{
+    struct linger        linger;
+    pgrest_conn_cold_t  *cold;
+
+    linger.l_onoff = 1;
+    linger.l_linger = 0;
+
+    if (setsockopt(conn->fd, SOL_SOCKET, SO_LINGER,
+                   (const void *) &linger, sizeof(struct linger)) == -1)
+    {
+        ereport(LOG,
+                (errcode_for_socket_access(),
+                 errmsg(PGREST_PACKAGE " " "setsockopt(SO_LINGER) "
+                        "failed : %m")));
+    }
+
+    /* let the protocol release what it holds on the connection */
+    cold = pgrest_conn_cold(conn);
+    if (cold->abort) {
+        cold->abort(conn);
+        return;
+    }
+
+    pgrest_conn_close(conn);
 }
 
 void
@@ -124,6 +176,9 @@ pgrest_conn_close(pgrest_connection_t *conn)
 
     (void) pgrest_event_del(conn->rev, EV_READ);
     (void) pgrest_event_del(conn->wev, EV_WRITE);
+    pgrest_conn_del_timer(conn);
+    pgrest_event_delete_posted(&conn->posted_rev);
+    pgrest_event_delete_posted(&conn->posted_wev);
 
     pgrest_conn_reusable(conn, 0);
     pgrest_conn_free(conn);
@@ -134,6 +189,88 @@ pgrest_conn_close(pgrest_connection_t *conn)
     closesocket(fd);
 }
 
+/*
+ * Close connections waiting for a (next) request, their read handler sees
+ * conn->close and closes the connection.
+ */
+void
+pgrest_conn_close_idle(void)
+{
+    dlist_mutable_iter    iter;
+    pgrest_conn_cold_t   *cold;
+    pgrest_connection_t  *conn;
+
+    dlist_foreach_modify(iter, &pgrest_conn_reuse_conns) {
+        cold = dlist_container(pgrest_conn_cold_t, elem, iter.cur);
+        conn = &pgrest_conn_conns[cold - pgrest_conn_colds];
+
+        conn->close = 1;
+        conn->rev_handler(conn->fd, EV_READ, conn);
+    }
+}
+
+/*
+ * Number of client connections still open, listening sockets and ipc
+ * channels are not counted.
+ */
+int
+pgrest_conn_active(void)
+{
+    int                   i;
+    int                   n;
+    pgrest_conn_cold_t   *cold;
+    pgrest_connection_t  *conn;
+
+    n = 0;
+    conn = pgrest_conn_conns;
+
+    for (i = 0; i < pgrest_setting.worker_noconn; i++) {
+        cold = &pgrest_conn_colds[i];
+
+        if (conn[i].fd == -1
+            || conn[i].channel
+            || (cold->listener && cold->listener->connection == &conn[i]))
+        {
+            continue;
+        }
+
+        n++;
+    }
+
+    return n;
+}
+
+static void
+pgrest_conn_timer_handler(pgrest_timer_t *timer)
+{
+    pgrest_connection_t  *conn = timer->data;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d connection %d "
+                              "timed out", pgrest_worker_index, conn->fd)));
+
+    pgrest_event_active(conn->rev, EV_TIMEOUT);
+}
+
+/*
+ * Wait for the connection to become readable. A non-zero timeout (re)arms
+ * the read timer in the timer wheel, zero keeps the current one.
+ */
+bool
+pgrest_conn_add_read(pgrest_connection_t *conn, int timeout)
+{
+    if (timeout) {
+        pgrest_timer_add(&conn->timer, timeout);
+    }
+
+    return pgrest_event_add(conn->rev, EV_READ, 0);
+}
+
+void
+pgrest_conn_del_timer(pgrest_connection_t *conn)
+{
+    pgrest_timer_del(&conn->timer);
+}
+
 ssize_t
 pgrest_conn_recv(pgrest_connection_t *conn, unsigned char *buf, size_t size)
 {
@@ -197,12 +334,38 @@ pgrest_conn_send(pgrest_connection_t *conn, unsigned char *buf, size_t size)
     }
 }
 
+ssize_t
+pgrest_conn_sendv(pgrest_connection_t *conn, struct iovec *iov, int niov)
+{
+    ssize_t n;
+    int     err;
+
+    for ( ;; ) {
+        n = writev(conn->fd, iov, niov);
+
+        if (n >= 0) {
+            conn->sent += n;
+            return n;
+        }
+
+        err = EVUTIL_SOCKET_ERROR();
+        if (PGREST_UTIL_ERR_RW_RETRIABLE(err)) {
+            if (err == EAGAIN) {
+                return PGREST_AGAIN;
+            }
+        } else {
+            return PGREST_ERROR;
+        }
+    }
+}
+
 bool
 pgrest_conn_local_sockaddr(pgrest_connection_t *conn, 
                            pgrest_string_t *s,
                            bool port)
 {
     socklen_t             len;
+    pgrest_conn_cold_t   *cold;
     pgrest_uint_t         addr;
     pgrest_sockaddr_t     sa;
     struct sockaddr_in   *sin;
@@ -211,12 +374,14 @@ pgrest_conn_local_sockaddr(pgrest_connection_t *conn,
     struct sockaddr_in6  *sin6;
 #endif
 
+    cold = pgrest_conn_cold(conn);
+
     addr = 0;
-    if (conn->local_socklen) {
-        switch (conn->local_sockaddr->sa_family) {
+    if (cold->local_socklen) {
+        switch (cold->local_sockaddr->sa_family) {
 #ifdef HAVE_IPV6
         case AF_INET6:
-            sin6 = (struct sockaddr_in6 *) conn->local_sockaddr;
+            sin6 = (struct sockaddr_in6 *) cold->local_sockaddr;
 
             for (i = 0; addr == 0 && i < 16; i++) {
                 addr |= sin6->sin6_addr.s6_addr[i];
@@ -229,7 +394,7 @@ pgrest_conn_local_sockaddr(pgrest_connection_t *conn,
             break;
 #endif
         default: /* AF_INET */
-            sin = (struct sockaddr_in *) conn->local_sockaddr;
+            sin = (struct sockaddr_in *) cold->local_sockaddr;
             addr = sin->sin_addr.s_addr;
             break;
         }
@@ -245,21 +410,21 @@ pgrest_conn_local_sockaddr(pgrest_connection_t *conn,
             return false;
         }
 
-        conn->local_sockaddr = pgrest_mpool_alloc(conn->pool, len);
-        if (conn->local_sockaddr == NULL) {
+        cold->local_sockaddr = pgrest_mpool_alloc(conn->pool, len);
+        if (cold->local_sockaddr == NULL) {
             return false;
         }
 
-        memcpy(conn->local_sockaddr, &sa, len);
-        conn->local_socklen = len;
+        memcpy(cold->local_sockaddr, &sa, len);
+        cold->local_socklen = len;
     }
 
     if (s == NULL) {
         return true;
     }
 
-    (void) pgrest_inet_ntop(conn->local_sockaddr, 
-                            conn->local_socklen, 
+    (void) pgrest_inet_ntop(cold->local_sockaddr, 
+                            cold->local_socklen, 
                             (char *)s->base, 
                             s->len,
                             port);
@@ -329,23 +494,45 @@ static bool
 pgrest_conn_worker_init(void *data, void *base)
 {
     int                  i;
+    size_t               size;
+    char                *ev;
     pgrest_connection_t *conn;
     pgrest_connection_t *next;
     int                  worker_noconn = (intptr_t) data;
 
-    pgrest_conn_conns = palloc0(sizeof(pgrest_connection_t) * worker_noconn);
+    /* the hot parts start on a cache line, see PGREST_CONN_ALIGNED */
+    pgrest_conn_conns = (pgrest_connection_t *)
+                        CACHELINEALIGN(palloc0(sizeof(pgrest_connection_t)
+                                               * worker_noconn
+                                               + PG_CACHE_LINE_SIZE));
+    pgrest_conn_colds = palloc0(sizeof(pgrest_conn_cold_t) * worker_noconn);
+
+    /*
+     * read and write events of a connection are embedded side by side in
+     * one contiguous block instead of being allocated one by one.
+     */
+    size = MAXALIGN(pgrest_event_size());
+    pgrest_conn_events = palloc0(size * 2 * worker_noconn);
 
     conn = pgrest_conn_conns;
+    ev = pgrest_conn_events + size * 2 * worker_noconn;
     i = worker_noconn;
     next = NULL;
 
     do {
         i--;
+        ev -= size * 2;
 
         conn[i].data = next;
         conn[i].fd = (evutil_socket_t) -1;
-        conn[i].rev = pgrest_event_new(NULL, -1, 0, NULL, NULL);
-        conn[i].wev = pgrest_event_new(NULL, -1, 0, NULL, NULL);
+        conn[i].rev = (struct event *) ev;
+        conn[i].wev = (struct event *) (ev + size);
+
+        if (pgrest_event_assign(conn[i].rev, base, -1, 0, NULL, NULL) < 0
+            || pgrest_event_assign(conn[i].wev, base, -1, 0, NULL, NULL) < 0)
+        {
+            return false;
+        }
 
         next = &conn[i];
     } while (i);
@@ -364,6 +551,7 @@ static bool
 pgrest_conn_worker_exit(void *data, void *base)
 {
     int                   i;
+    pgrest_conn_cold_t   *cold;
     pgrest_connection_t  *conn;
 
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d conn_exit",
@@ -372,21 +560,33 @@ pgrest_conn_worker_exit(void *data, void *base)
     conn = pgrest_conn_conns;
     
     for (i = 0; i < pgrest_setting.worker_noconn; i++) {
+        cold = &pgrest_conn_colds[i];
+
         if (conn[i].fd != -1
-            && !conn[i].channel) {
+            && !conn[i].channel
+            && !(cold->listener && cold->listener->connection == &conn[i]))
+        {
+            /* not finished within shutdown_timeout, reset the client */
             ereport(WARNING,
                     (errmsg(PGREST_PACKAGE " " "worker %d open socket %d "
                             "left in connection %d", pgrest_worker_index,
                              conn[i].fd, i)));
+
+            pgrest_conn_reset(&conn[i]);
         }
 
-        /* free event */
+        /* events are embedded in pgrest_conn_events, only delete them */
         (void) pgrest_event_del(conn[i].rev, EV_READ);
         (void) pgrest_event_del(conn[i].wev, EV_WRITE);
-        pgrest_event_free(conn[i].rev);
-        pgrest_event_free(conn[i].wev);
     }
 
+    /*
+     * pgrest_conn_events is left to the worker context, like the
+     * connections. The exit hooks of the listeners, ipc and acceptor run
+     * after this one and still delete events embedded in it, and the
+     * event base refers to them until pgrest_worker_event_fini().
+     */
+
     return true;
 }
 
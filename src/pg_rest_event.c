@@ -15,6 +15,10 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
+bool               pgrest_event_posting = false;
+static dlist_head  pgrest_event_posted =
+                               DLIST_STATIC_INIT(pgrest_event_posted);
+
 bool
 pgrest_event_add(struct event *ev, short events, int timeout)
 {
@@ -97,6 +101,56 @@ pgrest_event_base_free(struct event_base *base)
     event_base_free(base);
 }
 
+void
+pgrest_event_post(pgrest_event_posted_t *pev, event_callback_fn handler,
+                  evutil_socket_t fd, short events, void *arg)
+{
+    if (pev->events) {
+        pev->events |= events;
+        return;
+    }
+
+    pev->handler = handler;
+    pev->fd = fd;
+    pev->events = events;
+    pev->arg = arg;
+
+    dlist_push_tail(&pgrest_event_posted, &pev->node);
+}
+
+void
+pgrest_event_delete_posted(pgrest_event_posted_t *pev)
+{
+    if (pev->events) {
+        dlist_delete(&pev->node);
+        pev->events = 0;
+    }
+}
+
+/*
+ * Run the callbacks posted during the locked phase. Entries are unlinked
+ * before running, so a handler may post or cancel others safely.
+ */
+void
+pgrest_event_run_pending(void)
+{
+    dlist_node            *node;
+    pgrest_event_posted_t *pev;
+    short                  events;
+
+    pgrest_event_posting = false;
+
+    while (!dlist_is_empty(&pgrest_event_posted)) {
+        node = dlist_pop_head_node(&pgrest_event_posted);
+        pev = dlist_container(pgrest_event_posted_t, node, node);
+
+        events = pev->events;
+        pev->events = 0;
+
+        pev->handler(pev->fd, events, pev->arg);
+    }
+}
+
 #if 0
 void 
 pgrest_event_global_shutdown(void)
@@ -153,6 +153,8 @@ pgrest_guc_init(char *setting)
                 (errmsg(PGREST_PACKAGE " " "parse configure file failed")));
     }
 
+    pgrest_conf_commit();
+
 #if (PGREST_DEBUG)
     pgrest_guc_info_print(setting);
 #endif
@@ -18,8 +18,12 @@
 
 #include "pg_rest_http_postgres.h"
 #include "pg_rest_http_push_stream.h"
+#include "pg_rest_http_slab_stats.h"
 
-static pgrest_array_t *pgrest_http_ports = NULL;
+static pgrest_array_t     *pgrest_http_ports = NULL;
+static pgrest_http_conf_t  pgrest_http_conf_initial;
+
+pgrest_http_conf_t        *pgrest_http_conf = &pgrest_http_conf_initial;
 
 static pgrest_listener_t *
 pgrest_http_add_listener(pgrest_http_conf_addr_t *addr)
@@ -65,7 +69,8 @@ pgrest_http_add_listener(pgrest_http_conf_addr_t *addr)
     listener->fastopen = addr->opt.fastopen;
 #endif
 #ifdef HAVE_REUSEPORT
-    listener->reuseport = addr->opt.reuseport;
+    listener->reuseport = addr->opt.reuseport
+            || pgrest_setting.acceptor_mode == PGREST_ACCEPT_MODE_REUSEPORT;
 #endif
 #ifdef HAVE_UNIX_SOCKETS
     if (listener->sockaddr->sa_family == AF_UNIX) {
@@ -533,10 +538,11 @@ pgrest_http_setup_configurators(void)
     pgrest_http_upstream_conf_register();
     pgrest_http_postgres_conf_register();
     pgrest_http_push_stream_conf_register();
+    pgrest_http_slab_stats_conf_register();
 }
 
-void 
-pgrest_http_init(pgrest_setting_t *setting)
+static void 
+pgrest_http_configure(pgrest_setting_t *setting)
 {
     pgrest_uint_t              i;
     pgrest_conf_http_server_t *conf_server;
@@ -575,3 +581,117 @@ pgrest_http_init(pgrest_setting_t *setting)
                 (errmsg(PGREST_PACKAGE " " "http optimize servers failed")));
     }
 }
+
+void
+pgrest_http_conf_hold(pgrest_connection_t *conn)
+{
+    pgrest_http_conf->refs++;
+    conn->conf = pgrest_http_conf;
+}
+
+void
+pgrest_http_conf_release(pgrest_connection_t *conn)
+{
+    pgrest_http_conf_t *conf = conn->conf;
+
+    if (conf == NULL) {
+        return;
+    }
+
+    conn->conf = NULL;
+
+    if (--conf->refs == 0 && conf != pgrest_http_conf && conf->mctx) {
+        debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d free http "
+                                  "configuration %u", pgrest_worker_index,
+                                   (unsigned) conf->generation)));
+        MemoryContextDelete(conf->mctx);
+    }
+}
+
+/*
+ * Re-read the configure file into a fresh memory context and switch new
+ * connections over to it. Only the "http" block is applied, worker and
+ * accept settings need a restart. On any error the current
+ * configuration stays in use.
+ */
+static bool
+pgrest_http_reload(void *data, void *base)
+{
+    MemoryContext           mctx;
+    MemoryContext           oldctx;
+    pgrest_setting_t       *setting;
+    pgrest_http_conf_t     *conf;
+    pgrest_http_conf_t     *prev;
+    pgrest_array_t         *upstreams;
+    List                   *listeners;
+    volatile bool           result = false;
+
+    mctx = AllocSetContextCreate(TopMemoryContext,
+                                 PGREST_PACKAGE " " "http configuration",
+                                 ALLOCSET_SMALL_SIZES);
+    oldctx = MemoryContextSwitchTo(mctx);
+
+    upstreams = pgrest_http_upstream_swap(NULL);
+    listeners = pgrest_listener_swap(NIL);
+
+    PG_TRY();
+    {
+        setting = palloc0(sizeof(pgrest_setting_t));
+
+        if (pgrest_conf_parse(setting, pgrest_setting.configure_file)) {
+            pgrest_http_configure(setting);
+            result = true;
+        }
+    }
+    PG_CATCH();
+    {
+        EmitErrorReport();
+        FlushErrorState();
+    }
+    PG_END_TRY();
+
+    MemoryContextSwitchTo(oldctx);
+
+    listeners = pgrest_listener_swap(listeners);
+
+    if (!result) {
+        (void) pgrest_http_upstream_swap(upstreams);
+        MemoryContextDelete(mctx);
+        return false;
+    }
+
+    /* read by the reload hooks of the handlers, which run after this */
+    pgrest_setting.push_stream_shm_size = setting->push_stream_shm_size;
+
+    conf = MemoryContextAllocZero(mctx, sizeof(pgrest_http_conf_t));
+    conf->mctx = mctx;
+    conf->generation = pgrest_http_conf->generation + 1;
+
+    pgrest_listener_reload(listeners, base);
+
+    prev = pgrest_http_conf;
+    pgrest_http_conf = conf;
+    pgrest_conf_commit();
+
+    if (prev->refs == 0 && prev->mctx) {
+        MemoryContextDelete(prev->mctx);
+    }
+
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d http configuration "
+                         "%u loaded", pgrest_worker_index,
+                          (unsigned) conf->generation)));
+
+    return true;
+}
+
+void 
+pgrest_http_init(pgrest_setting_t *setting)
+{
+    /* ahead of the hooks the handlers add while being configured */
+    pgrest_worker_reload_hook_add(pgrest_http_reload, "http", NULL);
+
+    /* follows the reload, which reads the upstreams to check */
+    pgrest_http_upstream_check_init();
+
+    pgrest_http_configure(setting);
+}
@@ -74,9 +74,89 @@ pgrest_http_filter_create(pgrest_conf_http_path_t *path,
     return filter;
 }
 
-void 
+static void
+pgrest_http_request_handler(evutil_socket_t fd, short events, void *arg)
+{
+    pgrest_connection_t    *conn = (pgrest_connection_t *) arg;
+    pgrest_http_request_t  *req = conn->data;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http run request")));
+
+    /* a handler that armed the read timer checks this */
+    if (events & EV_TIMEOUT) {
+        conn->timedout = 1;
+    }
+
+    req->read_event_handler(req);
+}
+
+/*
+ * Find the path configuration for the request and run its handlers in
+ * turn until one does not decline. A handler returns PGREST_OK when it
+ * has taken the request over, an http status or PGREST_ERROR to have
+ * the request finalized with.
+ */
+void
 pgrest_http_process_request(pgrest_http_request_t *req)
 {
+    int                       rc;
+    pgrest_uint_t             i;
+    unsigned char            *p;
+    pgrest_connection_t      *conn;
+    pgrest_conf_http_path_t  *path = NULL;
+    pgrest_http_handler_t   **handler;
+
+    conn = req->conn;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http process request")));
+
+    pgrest_conn_del_timer(conn);
+
+    req->http_state = PGREST_HTTP_PROCESS_REQUEST_STATE;
+    req->read_event_handler = pgrest_http_block_reading;
+    conn->rev_handler = pgrest_http_request_handler;
+
+    p = memchr(req->path.base, '?', req->path.len);
+    if (p) {
+        req->args.base = p + 1;
+        req->args.len = req->path.base + req->path.len - p - 1;
+        req->path.len = p - req->path.base;
+    }
+
+    req->num_params = PGREST_HTTP_MAX_PARAMS;
+
+    if (!pgrest_rtree_find(req->http_conf->paths, req->path,
+                           (void **) &path, req->params, &req->num_params)
+        || path == NULL)
+    {
+        req->num_params = 0;
+        pgrest_http_finalize_request(req, PGREST_HTTP_NOT_FOUND);
+        return;
+    }
+
+    req->path_conf = path;
+
+    rc = PGREST_DECLINED;
+    handler = path->handlers.elts;
+
+    for (i = 0; i < path->handlers.size; i++) {
+        rc = handler[i]->handler(handler[i], req);
+        if (rc != PGREST_DECLINED) {
+            break;
+        }
+    }
+
+    switch (rc) {
+    case PGREST_OK:
+    case PGREST_AGAIN:
+        return;
+    case PGREST_DECLINED:
+        rc = PGREST_HTTP_NOT_FOUND;
+        break;
+    default:
+        break;
+    }
 
+    pgrest_http_finalize_request(req, rc);
 }
 
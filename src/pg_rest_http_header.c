@@ -427,6 +427,25 @@ pgrest_http_header_add(pgrest_array_t *headers, pgrest_param_t **header)
     return true;
 }
 
+/* name in lower case, as the received header names were converted */
+pgrest_param_t *
+pgrest_http_header_find(pgrest_array_t *headers, const char *name, size_t len)
+{
+    pgrest_uint_t   i;
+    pgrest_param_t *elem;
+
+    elem = headers->elts;
+    for (i = 0; i < headers->size; i++) {
+        if (elem[i].key.len == len
+            && memcmp(elem[i].key.base, name, len) == 0)
+        {
+            return &elem[i];
+        }
+    }
+
+    return NULL;
+}
+
 void
 pgrest_http_header_align(pgrest_http_headers_in_t *headers_in, 
                          unsigned char *old,
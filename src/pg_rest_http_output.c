@@ -0,0 +1,462 @@
+/* -------------------------------------------------------------------------
+ *
+ * pq_rest_http_output.c
+ *   http response output routines
+ *
+ *
+ *
+ * Copyright (C) 2014-2015, Robert Mu <dbx_c@hotmail.com>
+ *
+ *  src/pg_rest_http_output.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#define PGREST_HTTP_OUTPUT_BUFFER_SIZE        4096
+
+static const char *
+pgrest_http_status_line(pgrest_uint_t status)
+{
+    switch (status) {
+    case PGREST_HTTP_SWITCHING_PROTOCOLS:
+        return "101 Switching Protocols";
+    case PGREST_HTTP_OK:
+        return "200 OK";
+    case PGREST_HTTP_CREATED:
+        return "201 Created";
+    case PGREST_HTTP_ACCEPTED:
+        return "202 Accepted";
+    case PGREST_HTTP_NO_CONTENT:
+        return "204 No Content";
+    case PGREST_HTTP_NOT_MODIFIED:
+        return "304 Not Modified";
+    case PGREST_HTTP_BAD_REQUEST:
+    case PGREST_HTTP_REQUEST_HEADER_TOO_LARGE:
+        return "400 Bad Request";
+    case PGREST_HTTP_UNAUTHORIZED:
+        return "401 Unauthorized";
+    case PGREST_HTTP_FORBIDDEN:
+        return "403 Forbidden";
+    case PGREST_HTTP_NOT_FOUND:
+        return "404 Not Found";
+    case PGREST_HTTP_NOT_ALLOWED:
+        return "405 Not Allowed";
+    case PGREST_HTTP_REQUEST_TIME_OUT:
+        return "408 Request Time-out";
+    case PGREST_HTTP_CONFLICT:
+        return "409 Conflict";
+    case PGREST_HTTP_LENGTH_REQUIRED:
+        return "411 Length Required";
+    case PGREST_HTTP_REQUEST_ENTITY_TOO_LARGE:
+        return "413 Request Entity Too Large";
+    case PGREST_HTTP_REQUEST_URI_TOO_LARGE:
+        return "414 Request-URI Too Large";
+    case PGREST_HTTP_UNSUPPORTED_MEDIA_TYPE:
+        return "415 Unsupported Media Type";
+    case PGREST_HTTP_UPGRADE_REQUIRED:
+        return "426 Upgrade Required";
+    case PGREST_HTTP_INTERNAL_SERVER_ERROR:
+        return "500 Internal Server Error";
+    case PGREST_HTTP_NOT_IMPLEMENTED:
+        return "501 Not Implemented";
+    case PGREST_HTTP_BAD_GATEWAY:
+        return "502 Bad Gateway";
+    case PGREST_HTTP_SERVICE_UNAVAILABLE:
+        return "503 Service Temporarily Unavailable";
+    case PGREST_HTTP_GATEWAY_TIME_OUT:
+        return "504 Gateway Time-out";
+    case PGREST_HTTP_INSUFFICIENT_STORAGE:
+        return "507 Insufficient Storage";
+    default:
+        return NULL;
+    }
+}
+
+static const char *
+pgrest_http_date(void)
+{
+    static char    date[sizeof("Mon, 28 Sep 1970 06:00:00 GMT")];
+    static time_t  cached = 0;
+    time_t         now;
+    struct tm      tm;
+
+    now = time(NULL);
+
+    if (now != cached) {
+        gmtime_r(&now, &tm);
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        cached = now;
+    }
+
+    return date;
+}
+
+/* the key must outlive the request, the value is copied */
+bool
+pgrest_http_set_header(pgrest_http_request_t *req,
+                       const char            *key,
+                       const char            *value)
+{
+    pgrest_param_t  *header;
+
+    header = pgrest_array_push(&req->headers_out.headers);
+    if (header == NULL) {
+        return false;
+    }
+
+    header->key.base = (unsigned char *) key;
+    header->key.len = strlen(key);
+    header->value.base = (unsigned char *)
+                             MemoryContextStrdup(req->pool->mctx, value);
+    header->value.len = strlen(value);
+
+    return true;
+}
+
+/*
+ * Send the status line and headers. The body is delimited by
+ * headers_out.content_length_n, by chunked encoding when req->chunked is
+ * set or else by closing the connection.
+ */
+int
+pgrest_http_send_header(pgrest_http_request_t *req)
+{
+    StringInfoData     buf;
+    MemoryContext      oldctx;
+    pgrest_param_t    *header;
+    pgrest_uint_t      i;
+    pgrest_uint_t      status;
+    const char        *line;
+    struct iovec       iov;
+
+    if (req->header_sent) {
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "http header already sent")));
+        return PGREST_ERROR;
+    }
+
+    req->header_sent = 1;
+
+    if (req->headers_out.status == 0) {
+        req->headers_out.status = PGREST_HTTP_OK;
+    }
+
+    status = req->headers_out.status;
+
+    if (req->http_version < PGREST_HTTP_VERSION_11) {
+        req->chunked = 0;
+        req->keepalive = (req->headers_in.connection_type
+                              == PGREST_HTTP_CONNECTION_KEEP_ALIVE);
+    } else {
+        req->keepalive = (req->headers_in.connection_type
+                              != PGREST_HTTP_CONNECTION_CLOSE);
+    }
+
+    if (req->headers_out.content_length_n < 0 && !req->chunked) {
+        req->keepalive = 0;
+    }
+
+    oldctx = MemoryContextSwitchTo(req->pool->mctx);
+
+    initStringInfo(&buf);
+
+    line = pgrest_http_status_line(status);
+    if (line) {
+        appendStringInfo(&buf, "HTTP/1.1 %s" CRLF, line);
+    } else {
+        appendStringInfo(&buf, "HTTP/1.1 %u " CRLF, (unsigned) status);
+    }
+
+    appendStringInfo(&buf, "Server: " PGREST_PACKAGE CRLF
+                           "Date: %s" CRLF, pgrest_http_date());
+
+    if (req->headers_out.content_length_n >= 0) {
+        appendStringInfo(&buf, "Content-Length: " INT64_FORMAT CRLF,
+                         (int64) req->headers_out.content_length_n);
+    } else if (req->chunked) {
+        appendStringInfoString(&buf, "Transfer-Encoding: chunked" CRLF);
+    }
+
+    /* an upgraded connection sets its own "Connection" header */
+    if (status != PGREST_HTTP_SWITCHING_PROTOCOLS) {
+        appendStringInfoString(&buf, req->keepalive
+                                     ? "Connection: keep-alive" CRLF
+                                     : "Connection: close" CRLF);
+    }
+
+    header = req->headers_out.headers.elts;
+    for (i = 0; i < req->headers_out.headers.size; i++) {
+        appendStringInfo(&buf, "%.*s: %.*s" CRLF,
+                         (int) header[i].key.len, header[i].key.base,
+                         (int) header[i].value.len, header[i].value.base);
+    }
+
+    appendStringInfoString(&buf, CRLF);
+
+    MemoryContextSwitchTo(oldctx);
+
+    iov.iov_base = buf.data;
+    iov.iov_len = buf.len;
+
+    return pgrest_http_write(req, &iov, 1);
+}
+
+static void
+pgrest_http_output_empty_handler(evutil_socket_t fd, short events, void *arg)
+{
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http output empty "
+                              "handler")));
+}
+
+/* send what pgrest_http_write() had to queue */
+static void
+pgrest_http_output_handler(evutil_socket_t fd, short events, void *arg)
+{
+    ssize_t                 n;
+    pgrest_buffer_t        *buf;
+    pgrest_connection_t    *conn;
+    pgrest_http_request_t  *req;
+
+    conn = (pgrest_connection_t *) arg;
+    req = conn->data;
+    buf = req->output;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http output handler")));
+
+    while (buf->size) {
+        n = pgrest_conn_send(conn, buf->pos, buf->size);
+
+        if (n == PGREST_ERROR) {
+            conn->error = 1;
+            pgrest_http_close_request(req, 0);
+            return;
+        }
+
+        if (n == PGREST_AGAIN) {
+            if (!pgrest_event_add(conn->wev, EV_WRITE, 0)) {
+                pgrest_http_close_request(req, 0);
+            }
+
+            return;
+        }
+
+        pgrest_buffer_consume(buf, n);
+    }
+
+    if (!(pgrest_event_get_events(conn->wev) & EV_ET)) {
+        if (!pgrest_event_del(conn->wev, EV_WRITE)) {
+            pgrest_http_close_request(req, 0);
+            return;
+        }
+    }
+
+    conn->wev_handler = pgrest_http_output_empty_handler;
+
+    if (req->done) {
+        pgrest_http_finalize_request(req, 0);
+        return;
+    }
+
+    if (req->write_event_handler) {
+        req->write_event_handler(req);
+    }
+}
+
+static bool
+pgrest_http_output_queue(pgrest_http_request_t *req,
+                         struct iovec          *iov,
+                         int                    niov,
+                         size_t                 skip)
+{
+    int              i;
+    size_t           size = 0;
+    unsigned char   *p;
+    pgrest_iovec_t   iovec;
+
+    for (i = 0; i < niov; i++) {
+        size += iov[i].iov_len;
+    }
+
+    size -= skip;
+
+    if (req->output == NULL) {
+        req->output = pgrest_buffer_create(req->pool,
+                                    Max(size, PGREST_HTTP_OUTPUT_BUFFER_SIZE));
+        if (req->output == NULL) {
+            return false;
+        }
+    }
+
+    iovec = pgrest_buffer_reserve(req->pool, &req->output, size);
+    if (iovec.base == NULL) {
+        return false;
+    }
+
+    p = iovec.base;
+
+    for (i = 0; i < niov; i++) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+
+        memcpy(p, (char *) iov[i].iov_base + skip, iov[i].iov_len - skip);
+        p += iov[i].iov_len - skip;
+        skip = 0;
+    }
+
+    req->output->size += size;
+
+    return true;
+}
+
+/*
+ * Write iov to the client. What the socket does not take now is copied
+ * into the request's output buffer and sent from the write event, so
+ * the caller may reuse its memory on return. Returns PGREST_OK when all
+ * was sent, PGREST_AGAIN when part of it was queued and PGREST_ERROR.
+ */
+int
+pgrest_http_write(pgrest_http_request_t *req, struct iovec *iov, int niov)
+{
+    int                  i;
+    ssize_t              n;
+    size_t               size = 0;
+    pgrest_connection_t *conn = req->conn;
+
+    Assert(niov <= PGREST_HTTP_OUTPUT_IOVS);
+
+    if (conn->error) {
+        return PGREST_ERROR;
+    }
+
+    /* keep the order behind what is queued already */
+    if (req->output && req->output->size) {
+        return pgrest_http_output_queue(req, iov, niov, 0)
+               ? PGREST_AGAIN : PGREST_ERROR;
+    }
+
+    for (i = 0; i < niov; i++) {
+        size += iov[i].iov_len;
+    }
+
+    n = pgrest_conn_sendv(conn, iov, niov);
+
+    if (n == PGREST_ERROR) {
+        conn->error = 1;
+        return PGREST_ERROR;
+    }
+
+    if (n == PGREST_AGAIN) {
+        n = 0;
+    }
+
+    if ((size_t) n == size) {
+        return PGREST_OK;
+    }
+
+    if (!pgrest_http_output_queue(req, iov, niov, n)) {
+        return PGREST_ERROR;
+    }
+
+    conn->wev_handler = pgrest_http_output_handler;
+
+    if (!pgrest_event_add(conn->wev, EV_WRITE, 0)) {
+        return PGREST_ERROR;
+    }
+
+    return PGREST_AGAIN;
+}
+
+size_t
+pgrest_http_output_pending(pgrest_http_request_t *req)
+{
+    return req->output ? req->output->size : 0;
+}
+
+/* send a complete response and finalize the request */
+void
+pgrest_http_send_response(pgrest_http_request_t *req,
+                          pgrest_uint_t          status,
+                          const char            *content_type,
+                          pgrest_string_t       *body)
+{
+    int           rc;
+    struct iovec  iov;
+
+    req->headers_out.status = status;
+    req->headers_out.content_length_n = body ? body->len : 0;
+
+    if (content_type && body && body->len) {
+        if (!pgrest_http_set_header(req, "Content-Type", content_type)) {
+            pgrest_http_close_request(req, 0);
+            return;
+        }
+    }
+
+    rc = pgrest_http_send_header(req);
+
+    if (rc != PGREST_ERROR && body && body->len
+        && req->method != PGREST_HTTP_HEAD)
+    {
+        iov.iov_base = body->base;
+        iov.iov_len = body->len;
+
+        rc = pgrest_http_write(req, &iov, 1);
+    }
+
+    if (rc == PGREST_ERROR) {
+        pgrest_http_close_request(req, 0);
+        return;
+    }
+
+    pgrest_http_finalize_request(req, 0);
+}
+
+/* error page for a request finalized with an http error status */
+void
+pgrest_http_special_response(pgrest_http_request_t *req, pgrest_int_t rc)
+{
+    const char      *line;
+    char            *page;
+    pgrest_string_t  body;
+
+    switch (rc) {
+    case PGREST_HTTP_BAD_REQUEST:
+    case PGREST_HTTP_REQUEST_ENTITY_TOO_LARGE:
+    case PGREST_HTTP_REQUEST_URI_TOO_LARGE:
+    case PGREST_HTTP_REQUEST_HEADER_TOO_LARGE:
+    case PGREST_HTTP_INTERNAL_SERVER_ERROR:
+    case PGREST_HTTP_NOT_IMPLEMENTED:
+        /* the rest of the connection can not be trusted */
+        req->headers_in.connection_type = PGREST_HTTP_CONNECTION_CLOSE;
+        break;
+    default:
+        /* an unread body would be taken for the next request */
+        if ((req->headers_in.content_length_n > 0
+             || req->headers_in.chunked)
+            && (req->request_body == NULL || req->request_body->rest != 0))
+        {
+            req->headers_in.connection_type = PGREST_HTTP_CONNECTION_CLOSE;
+        }
+        break;
+    }
+
+    line = pgrest_http_status_line(rc);
+    if (line == NULL) {
+        line = "";
+    }
+
+    page = MemoryContextAlloc(req->pool->mctx, 2 * strlen(line) + 128);
+    body.len = sprintf(page, "<html>" CRLF
+                             "<head><title>%s</title></head>" CRLF
+                             "<body><center><h1>%s</h1></center>" CRLF
+                             "<hr><center>" PGREST_PACKAGE "</center>" CRLF
+                             "</body></html>" CRLF, line, line);
+    body.base = (unsigned char *) page;
+
+    pgrest_http_send_response(req, rc, "text/html", &body);
+}
@@ -20,20 +20,85 @@ static void
 pgrest_http_free_request(pgrest_http_request_t *req, pgrest_int_t rc);
 
 
+/*
+ * An error raised while serving a connection aborts only that connection
+ * and the request on it, the worker goes on with the others. The error
+ * must not propagate into the event loop which could not be reentered.
+ *
+ * This is the cleanup a backend does at the top of its error recovery:
+ * LWLocks taken by the handler, such as a slab pool lock, are released
+ * before the request cleanup handlers which may need them again. The
+ * handlers never raise an error while holding a spinlock.
+ */
+static void
+pgrest_http_handler_error(pgrest_connection_t *conn, MemoryContext mctx)
+{
+    HOLD_INTERRUPTS();
+
+    error_context_stack = NULL;
+    MemoryContextSwitchTo(mctx);
+
+    EmitErrorReport();
+    LWLockReleaseAll();
+
+    /* the request memory goes with its pool */
+    if (conn->fd != (evutil_socket_t) -1) {
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d abort connection "
+                             "%d", pgrest_worker_index, conn->fd)));
+        pgrest_http_conn_abort(conn);
+    }
+
+    FlushErrorState();
+
+    RESUME_INTERRUPTS();
+}
+
 static inline void
 pgrest_http_read_handler(evutil_socket_t fd, short events, void *arg)
 {
     pgrest_connection_t *conn = (pgrest_connection_t *) arg;
+    MemoryContext        mctx = CurrentMemoryContext;
+
+    if (pgrest_event_posting) {
+        pgrest_event_post(&conn->posted_rev,
+                          pgrest_http_read_handler, fd, events, arg);
+        return;
+    }
 
     conn->ready = 1;
-    conn->rev_handler(fd, events, arg);
+
+    PG_TRY();
+    {
+        conn->rev_handler(fd, events, arg);
+    }
+    PG_CATCH();
+    {
+        pgrest_http_handler_error(conn, mctx);
+    }
+    PG_END_TRY();
 }
 
 static inline void
 pgrest_http_write_handler(evutil_socket_t fd, short events, void *arg)
 {
     pgrest_connection_t *conn = (pgrest_connection_t *) arg;
-    conn->wev_handler(fd, events, arg);
+    MemoryContext        mctx = CurrentMemoryContext;
+
+    if (pgrest_event_posting) {
+        pgrest_event_post(&conn->posted_wev,
+                          pgrest_http_write_handler, fd, events, arg);
+        return;
+    }
+
+    PG_TRY();
+    {
+        conn->wev_handler(fd, events, arg);
+    }
+    PG_CATCH();
+    {
+        pgrest_http_handler_error(conn, mctx);
+    }
+    PG_END_TRY();
 }
 
 static inline void
@@ -50,6 +115,7 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
     pgrest_http_port_t       *port;
     pgrest_http_in_addr_t    *addr;
     pgrest_http_connection_t *hconn;
+    pgrest_conn_cold_t       *cold;
     struct event_base        *base;
 #ifdef HAVE_IPV6
     struct sockaddr_in6      *sin6;
@@ -64,10 +130,17 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
     }
 
     conn->data = hconn;
+    cold = pgrest_conn_cold(conn);
     base = pgrest_event_get_base(conn->rev);
 
+    /* no request yet, conn->data is the hconn until one is created */
+    conn->destroyed = 1;
+    cold->abort = pgrest_http_conn_abort;
+
+    pgrest_http_conf_hold(conn);
+
     /* find the server configuration for the address:port */
-    port = conn->listener->servers;
+    port = cold->listener->servers;
     if (port->naddrs > 1) {
         /*
          * there are several addresses on this port and one
@@ -79,10 +152,10 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
             return;
         }
 
-        switch (conn->local_sockaddr->sa_family) {
+        switch (cold->local_sockaddr->sa_family) {
 #ifdef HAVE_IPV6
         case AF_INET6:
-            sin6 = (struct sockaddr_in6 *) conn->local_sockaddr;
+            sin6 = (struct sockaddr_in6 *) cold->local_sockaddr;
 
             addr6 = port->addrs;
 
@@ -97,7 +170,7 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
             break;
 #endif
         default: /* AF_INET */
-            sin = (struct sockaddr_in *) conn->local_sockaddr;
+            sin = (struct sockaddr_in *) cold->local_sockaddr;
 
             addr = port->addrs;
 
@@ -112,7 +185,7 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
             break;
         }
     } else {
-        switch (conn->local_sockaddr->sa_family) {
+        switch (cold->local_sockaddr->sa_family) {
 #ifdef HAVE_IPV6
         case AF_INET6:
             addr6 = port->addrs;
@@ -127,7 +200,8 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
     }
 
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "client addr:%s server addr:"
-                              "%s", conn->addr_text,conn->listener->addr_text)));
+                              "%s", cold->addr_text,
+                               cold->listener->addr_text)));
 
     conn->rev_handler = pgrest_http_init_handler;
     conn->wev_handler = pgrest_http_empty_handler;
@@ -141,13 +215,13 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
 #endif
 
 #ifdef HAVE_DEFERRED_ACCEPT
-    if (conn->listener->deferred_accept) {
+    if (cold->listener->deferred_accept) {
         pgrest_http_read_handler(conn->fd, EV_READ, conn);
         return;
     }
 #endif
 
-    post_accept_timeout = conn->listener->post_accept_timeout;
+    post_accept_timeout = cold->listener->post_accept_timeout;
     pgrest_conn_reusable(conn, 1);
 
     if (pgrest_event_assign(conn->rev, base, conn->fd, EV_READ,
@@ -165,7 +239,7 @@ pgrest_http_conn_init(pgrest_connection_t *conn)
     pgrest_event_priority_set(conn->rev, PGREST_EVENT_PRIORITY);
     pgrest_event_priority_set(conn->wev, PGREST_EVENT_PRIORITY);
 
-    if (!pgrest_event_add(conn->rev, EV_READ, post_accept_timeout)) {
+    if (!pgrest_conn_add_read(conn, post_accept_timeout)) {
         pgrest_http_conn_close(conn);
     }
 }
@@ -181,12 +255,36 @@ pgrest_http_conn_close(pgrest_connection_t *conn)
 
     conn->destroyed = 1;
 
+    pgrest_http_conf_release(conn);
+
     pool = conn->pool;
     pgrest_conn_close(conn);
 
     pgrest_mpool_destroy(pool);
 }
 
+/*
+ * Close a connection whatever state it is in. A request still on it is
+ * closed through pgrest_http_close_request() so that its cleanup handlers
+ * run, e.g. a push stream subscriber is unlinked from its channel.
+ */
+void
+pgrest_http_conn_abort(pgrest_connection_t *conn)
+{
+    pgrest_http_request_t  *req;
+
+    if (conn->destroyed) {
+        pgrest_http_conn_close(conn);
+        return;
+    }
+
+    req = conn->data;
+    req->count = 1;
+    req->keepalive = 0;
+
+    pgrest_http_close_request(req, 0);
+}
+
 pgrest_http_request_t *
 pgrest_http_create_request(pgrest_connection_t *conn)
 {
@@ -210,6 +308,7 @@ pgrest_http_create_request(pgrest_connection_t *conn)
     req->pool = pool;
 
     req->http_conn = hconn;
+    req->http_conf = hconn->addr_conf->default_server;
     req->conn = conn;
 
     req->read_event_handler = pgrest_http_block_reading;
@@ -264,7 +363,7 @@ pgrest_http_keepalive_handler(evutil_socket_t fd, short events, void *arg)
 
     n = pgrest_conn_recv(conn, buf->pos, buf->capacity);
     if (n == PGREST_AGAIN) {
-        if (!pgrest_event_add(conn->rev, EV_READ, 0)) {
+        if (!pgrest_conn_add_read(conn, 0)) {
             pgrest_http_conn_close(conn);
         }
 
@@ -278,7 +377,8 @@ pgrest_http_keepalive_handler(evutil_socket_t fd, short events, void *arg)
 
     if (n == 0) {
         ereport(LOG, (errmsg(PGREST_PACKAGE " " "client %s closed ke"
-                             "epalive connection", conn->addr_text)));
+                             "epalive connection",
+                             pgrest_conn_cold(conn)->addr_text)));
         pgrest_http_conn_close(conn);
         return;
     }
@@ -378,7 +478,7 @@ pgrest_http_set_keepalive(pgrest_http_request_t *req)
         conn->destroyed = 0;
 
         /* TODO event version dected */
-        pgrest_event_del(conn->rev, EV_TIMEOUT);
+        pgrest_conn_del_timer(conn);
 
         conn->rev_handler = pgrest_http_header_handler;
         pgrest_event_active(conn->rev, EV_READ);
@@ -441,7 +541,7 @@ pgrest_http_set_keepalive(pgrest_http_request_t *req)
     conn->idle = 1;
     pgrest_conn_reusable(conn, 1);
 
-    if (!pgrest_event_add(conn->rev, EV_READ, conf->keepalive_timeout)) {
+    if (!pgrest_conn_add_read(conn, conf->keepalive_timeout)) {
         pgrest_http_conn_close(conn);
     }
 
@@ -496,7 +596,7 @@ pgrest_http_lingering_close_handler(evutil_socket_t fd, short events, void *arg)
         timer = conf->lingering_timeout;
     }
 
-    if (!pgrest_event_add(conn->rev, EV_READ, timer)) {
+    if (!pgrest_conn_add_read(conn, timer)) {
         pgrest_http_close_request(req, 0);
     }
 }
@@ -517,7 +617,7 @@ pgrest_http_set_lingering_close(pgrest_http_request_t *req)
     (void) pgrest_event_gettimeofday(pgrest_event_get_base(conn->rev), &now);
 
     req->lingering_time = now.tv_sec + (time_t) (conf->lingering_time / 1000);
-    if (!pgrest_event_add(conn->rev, EV_READ, conf->lingering_timeout)) {
+    if (!pgrest_conn_add_read(conn, conf->lingering_timeout)) {
         pgrest_http_close_request(req, 0);
     }
 
@@ -554,9 +654,11 @@ pgrest_http_finalize_connection(pgrest_http_request_t *req)
         return;
     }
 
+    /* after a reload the next request is served on a new connection */
     if (!pgrest_worker_terminate
          && req->keepalive
-         && conf->keepalive_timeout > 0)
+         && conf->keepalive_timeout > 0
+         && req->conn->conf == pgrest_http_conf)
     {
         pgrest_http_set_keepalive(req);
         return;
@@ -603,6 +705,7 @@ static void
 pgrest_http_free_request(pgrest_http_request_t *req, pgrest_int_t rc)
 {
     pgrest_mpool_t            *pool;
+    pgrest_http_cleanup_t     *cln;
     struct linger              linger;
 
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http close request")));
@@ -612,7 +715,20 @@ pgrest_http_free_request(pgrest_http_request_t *req, pgrest_int_t rc)
         return;
     }
 
-    if (rc > 0 && (req->headers_out.status == 0 || req->conn->sent == 0)) {
+    cln = req->cleanup;
+    req->cleanup = NULL;
+
+    while (cln) {
+        if (cln->handler) {
+            cln->handler(cln->data);
+        }
+
+        cln = cln->next;
+    }
+
+    if (rc > 0 && (req->headers_out.status == 0
+                   || req->conn->sent == 0))
+    {
         req->headers_out.status = rc;
     }
 
@@ -669,12 +785,48 @@ pgrest_http_terminate_handler(pgrest_http_request_t *req)
 void
 pgrest_http_finalize_request(pgrest_http_request_t *req, pgrest_int_t rc)
 {
+    pgrest_connection_t  *conn = req->conn;
 
-    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http finalize request")));
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http finalize "
+                              "request: %d", (int) rc)));
+
+    if (rc == PGREST_ERROR || rc == PGREST_HTTP_CLOSE || conn->error) {
+        pgrest_http_close_request(req, rc);
+        return;
+    }
+
+    if (rc >= PGREST_HTTP_SPECIAL_RESPONSE && !req->header_sent) {
+        /* comes back here with rc 0 */
+        pgrest_http_special_response(req, rc);
+        return;
+    }
+
+    /* finalized again from the output handler once all is sent */
+    if (pgrest_http_output_pending(req)) {
+        req->done = 1;
+        return;
+    }
 
     pgrest_http_finalize_connection(req);
 }
 
+/* handlers run when the request is freed, most recently added first */
+pgrest_http_cleanup_t *
+pgrest_http_cleanup_add(pgrest_http_request_t *req)
+{
+    pgrest_http_cleanup_t  *cln;
+
+    cln = pgrest_mpool_calloc(req->pool, 1, sizeof(pgrest_http_cleanup_t));
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    cln->next = req->cleanup;
+    req->cleanup = cln;
+
+    return cln;
+}
+
 int
 pgrest_http_extend_header_buffer(pgrest_http_request_t *req)
 {
@@ -16,7 +16,16 @@
 #include "pg_rest_core.h"
 #include "pg_rest_http.h"
 
+#define PGREST_HTTP_UPSTREAM_CHECKS            16
+
 static pgrest_array_t *pgrest_http_upstreams = NULL;
+/* of pgrest_http_upstream_check_t by server name, never removed from */
+static HTAB           *pgrest_http_upstream_checks = NULL;
+static uint32          pgrest_http_upstream_generation = 0;
+static void           *pgrest_http_upstream_base = NULL;
+
+static void pgrest_http_upstream_check_handler(evutil_socket_t fd,
+                                               short events, void *arg);
 
 static void *
 pgrest_http_upstream_conf(void *parent)
@@ -34,6 +43,9 @@ pgrest_http_upstream_conf(void *parent)
 
     conf = palloc0(sizeof(pgrest_http_upstream_srv_conf_t));
     conf->policy = PGREST_HTTP_UPSTREAM_UNKNOW;
+    pgrest_string_set(&conf->check_conninfo, "dbname=postgres");
+    conf->check_interval = 1000;
+    conf->check_timeout = 5000;
 
     upstream = pgrest_array_push(pgrest_http_upstreams);
     if (upstream == NULL) {
@@ -110,6 +122,53 @@ pgrest_http_upstream_algorithm(pgrest_conf_command_t *cmd,
     }
 }
 
+static void  
+pgrest_http_upstream_conninfo(pgrest_conf_command_t *cmd, 
+                              void                  *val, 
+                              void                  *parent)
+{
+    pgrest_http_upstream_srv_conf_t *conf = parent;
+    char                            *value = val;
+
+    pgrest_string_init(&conf->check_conninfo, pstrdup(value), strlen(value));
+}
+
+static void  
+pgrest_http_upstream_interval(pgrest_conf_command_t *cmd, 
+                              void                  *val, 
+                              void                  *parent)
+{
+    pgrest_http_upstream_srv_conf_t *conf = parent;
+    int                             *newval = val;
+
+    if (*newval < cmd->min_val || *newval > cmd->max_val) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%d\" must be in the range from %d to %d",
+                         cmd->name, *newval, cmd->min_val, cmd->max_val)));
+    }
+
+    conf->check_interval = *newval;
+}
+
+static void  
+pgrest_http_upstream_timeout(pgrest_conf_command_t *cmd, 
+                             void                  *val, 
+                             void                  *parent)
+{
+    pgrest_http_upstream_srv_conf_t *conf = parent;
+    int                             *newval = val;
+
+    if (*newval < cmd->min_val || *newval > cmd->max_val) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%d\" must be in the range from %d to %d",
+                         cmd->name, *newval, cmd->min_val, cmd->max_val)));
+    }
+
+    conf->check_timeout = *newval;
+}
+
 static void  
 pgrest_http_upstream_saddress(pgrest_conf_command_t *cmd, 
                               void                  *val, 
@@ -133,9 +192,18 @@ pgrest_http_upstream_saddress(pgrest_conf_command_t *cmd,
         }
     }
 
+    if (u.url_len >= NAMEDATALEN * 2) {
+        ereport(ERROR, 
+                (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                        "\"%s\": \"%s\" is too long", cmd->name, value)));
+    }
+
     pgrest_string_init(&server->name, u.url, u.url_len);
     server->addrs = u.addrs;
     server->naddrs = u.naddrs;
+    pgrest_string_init(&server->host, pnstrdup(u.host, u.host_len),
+                       u.host_len);
+    server->port = u.port ? u.port : u.default_port;
 }
 
 bool
@@ -242,6 +310,10 @@ pgrest_http_upstream_add(pgrest_url_t *u,
         MemSet(us, 0, sizeof(pgrest_http_upstream_server_t));
         us->addrs = u->addrs;
         us->naddrs = 1;
+        pgrest_string_init(&us->name, u->url, u->url_len);
+        pgrest_string_init(&us->host, pnstrdup(u->host, u->host_len),
+                           u->host_len);
+        us->port = u->port;
     }
 
     return true;
@@ -256,12 +328,35 @@ pgrest_http_upstream_conf_register(void)
     pgrest_conf_def_cmd("name", 0, 0, 0, pgrest_http_upstream_name);
     pgrest_conf_def_cmd("algorithm", 0, 0, 0, pgrest_http_upstream_algorithm);
     pgrest_conf_def_cmd("uaddress", 0, 0, 0, pgrest_http_upstream_saddress);
+    pgrest_conf_def_cmd("check_conninfo", 0, 0, 0,
+                        pgrest_http_upstream_conninfo);
+    pgrest_conf_def_cmd("check_interval", 0, 100, 3600000,
+                        pgrest_http_upstream_interval);
+    pgrest_conf_def_cmd("check_timeout", 0, 100, 3600000,
+                        pgrest_http_upstream_timeout);
+}
+
+/* upstream blocks are collected into the current set while parsing */
+pgrest_array_t *
+pgrest_http_upstream_swap(pgrest_array_t *upstreams)
+{
+    pgrest_array_t *result = pgrest_http_upstreams;
+
+    pgrest_http_upstreams = upstreams;
+
+    return result;
 }
 
 bool pgrest_http_upstream_init(void)
 {
     pgrest_uint_t                     i;
-    pgrest_http_upstream_srv_conf_t **upstreams = pgrest_http_upstreams->elts;
+    pgrest_http_upstream_srv_conf_t **upstreams;
+
+    if (pgrest_http_upstreams == NULL) {
+        return true;
+    }
+
+    upstreams = pgrest_http_upstreams->elts;
 
     for (i = 0; i < pgrest_http_upstreams->size; i++) {
         if (upstreams[i]->servers->size == 0) {
@@ -284,3 +379,389 @@ bool pgrest_http_upstream_init(void)
 
     return true;
 }
+
+static void
+pgrest_http_upstream_check_close(pgrest_http_upstream_check_t *check)
+{
+    if (check->ev) {
+        (void) pgrest_event_del(check->ev, EV_READ | EV_WRITE);
+        pgrest_event_free(check->ev);
+        check->ev = NULL;
+    }
+
+    if (check->conn) {
+        PQfinish(check->conn);
+        check->conn = NULL;
+    }
+
+    pgrest_timer_del(&check->expire);
+
+    check->connecting = false;
+    check->busy = false;
+}
+
+static void
+pgrest_http_upstream_check_role(pgrest_http_upstream_check_t *check,
+                                pgrest_http_upstream_role_e   role)
+{
+    static const char  *roles[] = { "down", "primary", "replica" };
+
+    if (check->role != role) {
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d upstream server "
+                             "\"%s\" is %s", pgrest_worker_index,
+                             check->name, roles[role])));
+        check->role = role;
+    }
+}
+
+static void
+pgrest_http_upstream_check_failed(pgrest_http_upstream_check_t *check)
+{
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "upstream server \"%s\" "
+                              "check failed: %s", check->name,
+                              check->conn ? PQerrorMessage(check->conn)
+                                          : "out of memory")));
+
+    pgrest_http_upstream_check_close(check);
+    pgrest_http_upstream_check_role(check, PGREST_HTTP_UPSTREAM_ROLE_UNKNOWN);
+}
+
+static bool
+pgrest_http_upstream_check_wait(pgrest_http_upstream_check_t *check,
+                                short                         events)
+{
+    /* still pending from the last wait when the check goes on */
+    if (!pgrest_event_del(check->ev, EV_READ|EV_WRITE)) {
+        return false;
+    }
+
+    if (pgrest_event_assign(check->ev, pgrest_http_upstream_base,
+                            PQsocket(check->conn), events,
+                            pgrest_http_upstream_check_handler, check) < 0)
+    {
+        return false;
+    }
+
+    return pgrest_event_add(check->ev, events, 0);
+}
+
+static bool
+pgrest_http_upstream_check_query(pgrest_http_upstream_check_t *check)
+{
+    if (!PQsendQuery(check->conn, "SELECT pg_is_in_recovery()")) {
+        return false;
+    }
+
+    check->busy = true;
+
+    return PQflush(check->conn) != -1
+           && pgrest_http_upstream_check_wait(check, EV_READ);
+}
+
+static void
+pgrest_http_upstream_check_result(pgrest_http_upstream_check_t *check,
+                                  PGresult                     *res)
+{
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1) {
+        debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "upstream server "
+                                  "\"%s\" check failed: %s", check->name,
+                                  PQresultErrorMessage(res))));
+        pgrest_http_upstream_check_role(check,
+                                        PGREST_HTTP_UPSTREAM_ROLE_UNKNOWN);
+        return;
+    }
+
+    pgrest_http_upstream_check_role(check, PQgetvalue(res, 0, 0)[0] == 't'
+                                           ? PGREST_HTTP_UPSTREAM_ROLE_REPLICA
+                                           : PGREST_HTTP_UPSTREAM_ROLE_PRIMARY);
+}
+
+static void
+pgrest_http_upstream_check_handler(evutil_socket_t fd, short events,
+                                   void *arg)
+{
+    PGresult                      *res;
+    pgrest_http_upstream_check_t  *check = arg;
+
+    if (check->connecting) {
+        switch (PQconnectPoll(check->conn)) {
+        case PGRES_POLLING_READING:
+            if (!pgrest_http_upstream_check_wait(check, EV_READ)) {
+                pgrest_http_upstream_check_failed(check);
+            }
+            return;
+        case PGRES_POLLING_WRITING:
+            if (!pgrest_http_upstream_check_wait(check, EV_WRITE)) {
+                pgrest_http_upstream_check_failed(check);
+            }
+            return;
+        case PGRES_POLLING_OK:
+            break;
+        default:
+            pgrest_http_upstream_check_failed(check);
+            return;
+        }
+
+        check->connecting = false;
+
+        if (!pgrest_http_upstream_check_query(check)) {
+            pgrest_http_upstream_check_failed(check);
+        }
+
+        return;
+    }
+
+    if (!PQconsumeInput(check->conn)) {
+        pgrest_http_upstream_check_failed(check);
+        return;
+    }
+
+    while (!PQisBusy(check->conn)) {
+        res = PQgetResult(check->conn);
+        if (res == NULL) {
+            check->busy = false;
+            pgrest_timer_del(&check->expire);
+            break;
+        }
+
+        pgrest_http_upstream_check_result(check, res);
+        PQclear(res);
+    }
+
+    /* also notices the server going away between two checks */
+    if (!pgrest_http_upstream_check_wait(check, EV_READ)) {
+        pgrest_http_upstream_check_failed(check);
+    }
+}
+
+/* no answer within check_timeout */
+static void
+pgrest_http_upstream_check_expire(pgrest_timer_t *timer)
+{
+    pgrest_http_upstream_check_t  *check = timer->data;
+
+    if (check->connecting || check->busy) {
+        debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "upstream server \"%s\" "
+                                  "check timed out after %d ms", check->name,
+                                   check->timeout)));
+        pgrest_http_upstream_check_failed(check);
+    }
+}
+
+/*
+ * Every interval a check connects if it has to and asks the server if
+ * it is in recovery. A check without an answer within check_timeout
+ * counts as failed, one still waiting for its answer when the interval
+ * comes round is left to run.
+ */
+static void
+pgrest_http_upstream_check_timer(pgrest_timer_t *timer)
+{
+    pgrest_http_upstream_check_t  *check = timer->data;
+
+    if (check->generation != pgrest_http_upstream_generation) {
+        /* no longer in the configuration */
+        pgrest_http_upstream_check_close(check);
+        check->role = PGREST_HTTP_UPSTREAM_ROLE_UNKNOWN;
+        return;
+    }
+
+    pgrest_timer_add(&check->timer, check->interval);
+
+    if (check->connecting || check->busy) {
+        return;
+    }
+
+    pgrest_timer_add(&check->expire, check->timeout);
+
+    if (check->conn) {
+        if (!pgrest_http_upstream_check_query(check)) {
+            pgrest_http_upstream_check_failed(check);
+        }
+
+        return;
+    }
+
+    check->conn = PQconnectStart(check->conninfo);
+
+    if (check->conn == NULL || PQstatus(check->conn) == CONNECTION_BAD
+        || PQsetnonblocking(check->conn, 1) == -1)
+    {
+        pgrest_http_upstream_check_failed(check);
+        return;
+    }
+
+    check->connecting = true;
+
+    check->ev = pgrest_event_new(pgrest_http_upstream_base,
+                                 PQsocket(check->conn), EV_WRITE,
+                                 pgrest_http_upstream_check_handler, check);
+    if (check->ev == NULL || !pgrest_event_add(check->ev, EV_WRITE, 0)) {
+        pgrest_http_upstream_check_failed(check);
+    }
+}
+
+/*
+ * Check the servers of the rw/split upstreams of the current
+ * configuration. The checks are kept by server name across reloads, so
+ * a server staying in the configuration keeps its connection and role,
+ * the checks of the servers gone stop with their next timer.
+ */
+static bool
+pgrest_http_upstream_check_start(void *data, void *base)
+{
+    bool                              found;
+    char                              key[NAMEDATALEN * 2];
+    pgrest_uint_t                     i, j;
+    HASHCTL                           ctl;
+    pgrest_string_t                  *conninfo;
+    pgrest_http_upstream_check_t     *check;
+    pgrest_http_upstream_server_t    *servers;
+    pgrest_http_upstream_srv_conf_t **upstreams;
+
+    pgrest_http_upstream_base = base;
+    pgrest_http_upstream_generation++;
+
+    if (pgrest_http_upstreams == NULL) {
+        return true;
+    }
+
+    if (pgrest_http_upstream_checks == NULL) {
+        MemSet(&ctl, 0, sizeof(ctl));
+        ctl.keysize = NAMEDATALEN * 2;
+        ctl.entrysize = sizeof(pgrest_http_upstream_check_t);
+
+        pgrest_http_upstream_checks = hash_create(PGREST_PACKAGE " " "upstream "
+                                                  "checks",
+                                                  PGREST_HTTP_UPSTREAM_CHECKS,
+                                                  &ctl, HASH_ELEM);
+    }
+
+    upstreams = pgrest_http_upstreams->elts;
+
+    for (i = 0; i < pgrest_http_upstreams->size; i++) {
+        if (upstreams[i]->policy != PGREST_HTTP_UPSTREAM_RWSPLIT
+            || upstreams[i]->servers == NULL)
+        {
+            continue;
+        }
+
+        servers = upstreams[i]->servers->elts;
+        conninfo = &upstreams[i]->check_conninfo;
+
+        for (j = 0; j < upstreams[i]->servers->size; j++) {
+            if (servers[j].host.len == 0) {
+                continue;
+            }
+
+            /* saddress keeps the names shorter than the key */
+            MemSet(key, 0, sizeof(key));
+            memcpy(key, servers[j].name.base,
+                   Min(servers[j].name.len, sizeof(key) - 1));
+
+            check = hash_search(pgrest_http_upstream_checks, key,
+                                HASH_ENTER, &found);
+            if (!found) {
+                check->role = PGREST_HTTP_UPSTREAM_ROLE_UNKNOWN;
+                check->conninfo = NULL;
+                check->conn = NULL;
+                check->ev = NULL;
+                MemSet(&check->timer, 0, sizeof(pgrest_timer_t));
+                check->timer.handler = pgrest_http_upstream_check_timer;
+                check->timer.data = check;
+                MemSet(&check->expire, 0, sizeof(pgrest_timer_t));
+                check->expire.handler = pgrest_http_upstream_check_expire;
+                check->expire.data = check;
+                check->connecting = false;
+                check->busy = false;
+            }
+
+            /* a changed check_conninfo applies from the next connection */
+            if (check->conninfo) {
+                pfree(check->conninfo);
+            }
+
+            check->conninfo = MemoryContextStrdup(TopMemoryContext,
+                                  psprintf("host=%.*s port=%d %.*s",
+                                           (int) servers[j].host.len,
+                                           servers[j].host.base,
+                                           (int) servers[j].port,
+                                           (int) conninfo->len,
+                                           conninfo->base));
+            check->interval = upstreams[i]->check_interval;
+            check->timeout = upstreams[i]->check_timeout;
+            check->generation = pgrest_http_upstream_generation;
+
+            if (!check->timer.set) {
+                pgrest_timer_add(&check->timer, 0);
+            }
+
+            servers[j].check = check;
+        }
+    }
+
+    return true;
+}
+
+void
+pgrest_http_upstream_check_init(void)
+{
+    pgrest_worker_hook_add(pgrest_http_upstream_check_start,
+                           NULL,
+                           "upstream checks",
+                           NULL,
+                           false);
+    pgrest_worker_reload_hook_add(pgrest_http_upstream_check_start,
+                                  "upstream checks",
+                                  NULL);
+}
+
+/*
+ * Pick the server of a rw/split upstream for a request. Writes go to
+ * the primary. Reads go round the replicas that are up, and to the
+ * primary when none is. NULL when that server is not up.
+ */
+pgrest_http_upstream_server_t *
+pgrest_http_upstream_route(pgrest_http_request_t           *req,
+                           pgrest_http_upstream_srv_conf_t *us,
+                           bool                             read_only)
+{
+    pgrest_uint_t                   i, k, n;
+    pgrest_http_upstream_check_t   *check;
+    pgrest_http_upstream_server_t  *servers;
+    pgrest_http_upstream_server_t  *primary = NULL;
+
+    if (us->servers == NULL || us->servers->size == 0) {
+        return NULL;
+    }
+
+    servers = us->servers->elts;
+    n = us->servers->size;
+
+    if (us->policy != PGREST_HTTP_UPSTREAM_RWSPLIT || n == 1) {
+        return &servers[0];
+    }
+
+    for (i = 0; i < n; i++) {
+        k = (us->next + i) % n;
+
+        if ((check = servers[k].check) == NULL) {
+            continue;
+        }
+
+        if (check->role == PGREST_HTTP_UPSTREAM_ROLE_PRIMARY) {
+            if (primary == NULL) {
+                primary = &servers[k];
+            }
+
+            continue;
+        }
+
+        if (read_only && check->role == PGREST_HTTP_UPSTREAM_ROLE_REPLICA) {
+            us->next = k + 1;
+            return &servers[k];
+        }
+    }
+
+    return primary;
+}
@@ -20,6 +20,46 @@ static void
 pgrest_http_entity_handler(evutil_socket_t fd, short events, void *arg);
 
 
+typedef struct {
+    pgrest_string_t               name;
+    int                           method;
+} pgrest_http_method_name_t;
+
+static pgrest_http_method_name_t  pgrest_http_methods[] = {
+    { pgrest_string("GET"),       PGREST_HTTP_GET },
+    { pgrest_string("HEAD"),      PGREST_HTTP_HEAD },
+    { pgrest_string("POST"),      PGREST_HTTP_POST },
+    { pgrest_string("PUT"),       PGREST_HTTP_PUT },
+    { pgrest_string("DELETE"),    PGREST_HTTP_DELETE },
+    { pgrest_string("MKCOL"),     PGREST_HTTP_MKCOL },
+    { pgrest_string("COPY"),      PGREST_HTTP_COPY },
+    { pgrest_string("MOVE"),      PGREST_HTTP_MOVE },
+    { pgrest_string("OPTIONS"),   PGREST_HTTP_OPTIONS },
+    { pgrest_string("PROPFIND"),  PGREST_HTTP_PROPFIND },
+    { pgrest_string("PROPPATCH"), PGREST_HTTP_PROPPATCH },
+    { pgrest_string("LOCK"),      PGREST_HTTP_LOCK },
+    { pgrest_string("UNLOCK"),    PGREST_HTTP_UNLOCK },
+    { pgrest_string("PATCH"),     PGREST_HTTP_PATCH },
+    { pgrest_string("TRACE"),     PGREST_HTTP_TRACE }
+};
+
+static int
+pgrest_http_parse_method(pgrest_string_t *method)
+{
+    pgrest_uint_t  i;
+
+    for (i = 0; i < lengthof(pgrest_http_methods); i++) {
+        if (method->len == pgrest_http_methods[i].name.len
+            && memcmp(method->base, pgrest_http_methods[i].name.base,
+                      method->len) == 0)
+        {
+            return pgrest_http_methods[i].method;
+        }
+    }
+
+    return PGREST_HTTP_UNKNOWN;
+}
+
 static bool
 pgrest_http_init_headers(pgrest_http_request_t *req, 
                          const struct phr_header *headers,
@@ -150,7 +190,7 @@ pgrest_http_read(pgrest_http_request_t *req, pgrest_buffer_t *buf, int timeout)
     }
 
     if (n == PGREST_AGAIN) {
-        if (!pgrest_event_add(conn->rev, EV_READ, timeout)) {
+        if (!pgrest_conn_add_read(conn, timeout)) {
             pgrest_http_close_request(req, PGREST_HTTP_INTERNAL_SERVER_ERROR);
             return PGREST_ERROR;
         }
@@ -450,7 +490,8 @@ pgrest_http_header_handler(evutil_socket_t fd, short events, void *arg)
     pgrest_http_request_t    *req;
     pgrest_connection_t      *conn;
     pgrest_http_connection_t *hconn;
-    pgrest_string_t           method; /* XXX */
+    pgrest_listener_t        *listener;
+    pgrest_string_t           method;
     int                       rv, result, minor_version;
     struct phr_header         headers[PGREST_HTTP_MAX_HEADERS];
     size_t                    num_headers = PGREST_HTTP_MAX_HEADERS;
@@ -459,6 +500,7 @@ pgrest_http_header_handler(evutil_socket_t fd, short events, void *arg)
     conn = (pgrest_connection_t *) arg;
     req = conn->data;
     hconn = req->http_conn;
+    listener = pgrest_conn_cold(conn)->listener;
 
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "http header handler")));
 
@@ -476,7 +518,7 @@ pgrest_http_header_handler(evutil_socket_t fd, short events, void *arg)
 
             n = pgrest_http_read(req, 
                                  req->header_in, 
-                                 conn->listener->post_accept_timeout);
+                                 listener->post_accept_timeout);
             if (n == PGREST_AGAIN || n == PGREST_ERROR) {
                 return;
             }
@@ -496,8 +538,12 @@ pgrest_http_header_handler(evutil_socket_t fd, short events, void *arg)
 
         switch (result) {
         default: /* parse complete */
+            pgrest_conn_del_timer(conn);
+
             req->request_length = result;
-            req->http_version = 0x100 | (minor_version != 0);
+            req->http_version = minor_version ? PGREST_HTTP_VERSION_11
+                                              : PGREST_HTTP_VERSION_10;
+            req->method = pgrest_http_parse_method(&method);
 
             if (!pgrest_http_process_header(req, headers, num_headers)) {
                 return;
@@ -594,8 +640,9 @@ pgrest_http_init_handler(evutil_socket_t fd, short events, void *arg)
 
     n = pgrest_conn_recv(conn, conn->buffer->pos, size);
     if (n == PGREST_AGAIN) {
-        post_accept_timeout = conn->listener->post_accept_timeout;
-        if (!pgrest_event_add(conn->rev, EV_READ, post_accept_timeout)) {
+        post_accept_timeout =
+                        pgrest_conn_cold(conn)->listener->post_accept_timeout;
+        if (!pgrest_conn_add_read(conn, post_accept_timeout)) {
             pgrest_http_conn_close(conn);
         }
 
@@ -624,6 +671,7 @@ pgrest_http_init_handler(evutil_socket_t fd, short events, void *arg)
         return;
     }
 
+    conn->destroyed = 0;
     hconn->parse = 1;
     conn->rev_handler = pgrest_http_header_handler;
     pgrest_http_header_handler(conn->fd, EV_READ, conn);
@@ -0,0 +1,961 @@
+/* -------------------------------------------------------------------------
+ *
+ * pq_rest_http_websocket.c
+ *   websocket (rfc 6455) routines
+ *
+ *
+ *
+ * Copyright (C) 2014-2015, Robert Mu <dbx_c@hotmail.com>
+ *
+ *  src/pg_rest_http_websocket.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#define PGREST_HTTP_WEBSOCKET_GUID   "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define PGREST_HTTP_WEBSOCKET_BUFFER_SIZE     4096
+#define PGREST_HTTP_WEBSOCKET_READ_SIZE       1024
+
+#define pgrest_http_websocket_rol(x, n)  (((x) << (n)) | ((x) >> (32 - (n))))
+
+typedef struct {
+    dlist_node                        node;
+    pgrest_http_websocket_frame_t    *frame;
+} pgrest_http_websocket_link_t;
+
+/* frames outlive the requests that queued them, they go here */
+static MemoryContext  pgrest_http_websocket_mctx = NULL;
+
+static void
+pgrest_http_websocket_sha1_block(uint32 *h, const unsigned char *p)
+{
+    int     i;
+    uint32  a, b, c, d, e, f, k, t;
+    uint32  w[80];
+
+    for (i = 0; i < 16; i++) {
+        w[i] = (uint32) p[4 * i] << 24 | (uint32) p[4 * i + 1] << 16
+               | (uint32) p[4 * i + 2] << 8 | (uint32) p[4 * i + 3];
+    }
+
+    for (i = 16; i < 80; i++) {
+        t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+        w[i] = pgrest_http_websocket_rol(t, 1);
+    }
+
+    a = h[0];
+    b = h[1];
+    c = h[2];
+    d = h[3];
+    e = h[4];
+
+    for (i = 0; i < 80; i++) {
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+
+        t = pgrest_http_websocket_rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = pgrest_http_websocket_rol(b, 30);
+        b = a;
+        a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/* only the handshake needs it, no reason to depend on a crypto library */
+static void
+pgrest_http_websocket_sha1(const unsigned char *data,
+                           size_t               len,
+                           unsigned char       *digest)
+{
+    int            i;
+    size_t         last;
+    uint64         bits = (uint64) len * 8;
+    uint32         h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe,
+                            0x10325476, 0xc3d2e1f0 };
+    unsigned char  tail[128];
+
+    for ( ; len >= 64; data += 64, len -= 64) {
+        pgrest_http_websocket_sha1_block(h, data);
+    }
+
+    last = len < 56 ? 64 : 128;
+
+    memcpy(tail, data, len);
+    tail[len] = 0x80;
+    memset(tail + len + 1, 0, last - len - 1);
+
+    for (i = 0; i < 8; i++) {
+        tail[last - 1 - i] = (unsigned char) (bits >> (8 * i));
+    }
+
+    pgrest_http_websocket_sha1_block(h, tail);
+
+    if (last == 128) {
+        pgrest_http_websocket_sha1_block(h, tail + 64);
+    }
+
+    for (i = 0; i < 20; i++) {
+        digest[i] = (unsigned char) (h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+/*
+ * The Sec-WebSocket-Accept value of a Sec-WebSocket-Key, accept takes
+ * PGREST_HTTP_WEBSOCKET_ACCEPT_LEN + 1 bytes.
+ */
+void
+pgrest_http_websocket_accept_key(const unsigned char *key, char *accept)
+{
+    size_t         n;
+    unsigned char  buf[PGREST_HTTP_WEBSOCKET_KEY_LEN
+                       + sizeof(PGREST_HTTP_WEBSOCKET_GUID) - 1];
+    unsigned char  digest[20];
+
+    memcpy(buf, key, PGREST_HTTP_WEBSOCKET_KEY_LEN);
+    memcpy(buf + PGREST_HTTP_WEBSOCKET_KEY_LEN, PGREST_HTTP_WEBSOCKET_GUID,
+           sizeof(PGREST_HTTP_WEBSOCKET_GUID) - 1);
+
+    pgrest_http_websocket_sha1(buf, sizeof(buf), digest);
+    n = pgrest_encode_base64((unsigned char *) accept, digest,
+                             sizeof(digest));
+    accept[n] = '\0';
+}
+
+/*
+ * Client frames are xored with a four byte key. It is repeated over a
+ * vector register and the payload done a register at a time, only the
+ * tail goes byte by byte.
+ */
+void
+pgrest_http_websocket_unmask(unsigned char       *p,
+                             size_t               len,
+                             const unsigned char *mask)
+{
+    size_t   i = 0;
+    uint32   key;
+
+    memcpy(&key, mask, sizeof(key));
+
+#if defined(__AVX2__)
+    {
+        __m256i  k = _mm256_set1_epi32((int) key);
+
+        for ( ; i + 32 <= len; i += 32) {
+            __m256i  v = _mm256_loadu_si256((__m256i *) (p + i));
+
+            _mm256_storeu_si256((__m256i *) (p + i), _mm256_xor_si256(v, k));
+        }
+    }
+#elif defined(__SSE2__)
+    {
+        __m128i  k = _mm_set1_epi32((int) key);
+
+        for ( ; i + 16 <= len; i += 16) {
+            __m128i  v = _mm_loadu_si128((__m128i *) (p + i));
+
+            _mm_storeu_si128((__m128i *) (p + i), _mm_xor_si128(v, k));
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    {
+        uint8x16_t  k = vreinterpretq_u8_u32(vdupq_n_u32(key));
+
+        for ( ; i + 16 <= len; i += 16) {
+            vst1q_u8(p + i, veorq_u8(vld1q_u8(p + i), k));
+        }
+    }
+#endif
+
+    {
+        uint64  k = (uint64) key << 32 | key;
+        uint64  v;
+
+        for ( ; i + 8 <= len; i += 8) {
+            memcpy(&v, p + i, sizeof(v));
+            v ^= k;
+            memcpy(p + i, &v, sizeof(v));
+        }
+    }
+
+    for ( ; i < len; i++) {
+        p[i] ^= mask[i & 3];
+    }
+}
+
+/* a comma separated header value has the token, case insensitive */
+static bool
+pgrest_http_websocket_has_token(pgrest_param_t *header,
+                                const char     *token,
+                                size_t          len)
+{
+    unsigned char  *p, *end, *last;
+
+    if (header == NULL) {
+        return false;
+    }
+
+    p = header->value.base;
+    last = p + header->value.len;
+
+    for ( ; p < last; p = end + 1) {
+        end = memchr(p, ',', last - p);
+        if (end == NULL) {
+            end = last;
+        }
+
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+
+        if ((size_t) (end - p) >= len
+            && strncasecmp((char *) p, token, len) == 0)
+        {
+            for (p += len; p < end && (*p == ' ' || *p == '\t'); p++) {
+                /* void */
+            }
+
+            if (p == end) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool
+pgrest_http_websocket_is_upgrade(pgrest_http_request_t *req)
+{
+    pgrest_param_t  *upgrade;
+
+    upgrade = pgrest_http_header_find(&req->headers_in.headers,
+                                      "upgrade", sizeof("upgrade") - 1);
+
+    return pgrest_http_websocket_has_token(upgrade, "websocket",
+                                           sizeof("websocket") - 1);
+}
+
+static size_t
+pgrest_http_websocket_header(unsigned char *p, int opcode, size_t len)
+{
+    int  i;
+
+    p[0] = 0x80 | opcode;
+
+    if (len < 126) {
+        p[1] = (unsigned char) len;
+        return 2;
+    }
+
+    if (len <= 0xffff) {
+        p[1] = 126;
+        p[2] = (unsigned char) (len >> 8);
+        p[3] = (unsigned char) len;
+        return 4;
+    }
+
+    p[1] = 127;
+
+    for (i = 0; i < 8; i++) {
+        p[2 + i] = (unsigned char) ((uint64) len >> (56 - 8 * i));
+    }
+
+    return 10;
+}
+
+/* a single unfragmented frame, with a reference for the caller */
+pgrest_http_websocket_frame_t *
+pgrest_http_websocket_frame_create(int                  opcode,
+                                   const unsigned char *data,
+                                   size_t               len)
+{
+    size_t                          hlen;
+    unsigned char                   header[PGREST_HTTP_WEBSOCKET_HEADER_MAX];
+    pgrest_http_websocket_frame_t  *frame;
+
+    if (pgrest_http_websocket_mctx == NULL) {
+        pgrest_http_websocket_mctx = pgrest_util_mctx_create(TopMemoryContext,
+                                         PGREST_PACKAGE " " "websocket frames",
+                                         ALLOCSET_DEFAULT_MINSIZE,
+                                         ALLOCSET_DEFAULT_INITSIZE,
+                                         ALLOCSET_DEFAULT_MAXSIZE);
+        if (pgrest_http_websocket_mctx == NULL) {
+            return NULL;
+        }
+    }
+
+    hlen = pgrest_http_websocket_header(header, opcode, len);
+
+    frame = pgrest_util_alloc(pgrest_http_websocket_mctx,
+                              offsetof(pgrest_http_websocket_frame_t, data)
+                              + hlen + len);
+    if (frame == NULL) {
+        return NULL;
+    }
+
+    frame->refs = 1;
+    frame->len = hlen + len;
+    memcpy(frame->data, header, hlen);
+
+    if (len) {
+        memcpy(frame->data + hlen, data, len);
+    }
+
+    return frame;
+}
+
+void
+pgrest_http_websocket_frame_release(pgrest_http_websocket_frame_t *frame)
+{
+    if (--frame->refs == 0) {
+        pgrest_util_free(frame);
+    }
+}
+
+static void
+pgrest_http_websocket_write_handler(evutil_socket_t fd, short events,
+                                    void *arg)
+{
+    pgrest_connection_t    *conn = (pgrest_connection_t *) arg;
+    pgrest_http_request_t  *req = conn->data;
+
+    req->write_event_handler(req);
+}
+
+/*
+ * Send what is queued, up to PGREST_HTTP_OUTPUT_IOVS frames a writev.
+ * A connection closing with a close frame sent goes once it is out.
+ */
+static void
+pgrest_http_websocket_writing(pgrest_http_request_t *req)
+{
+    int                            niov;
+    ssize_t                        n;
+    size_t                         off, rest;
+    struct iovec                   iov[PGREST_HTTP_OUTPUT_IOVS];
+    dlist_iter                     iter;
+    dlist_node                    *node;
+    pgrest_http_websocket_link_t  *link;
+    pgrest_http_websocket_t       *ws = req->websocket;
+    pgrest_connection_t           *conn = req->conn;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "websocket writing")));
+
+    while (!dlist_is_empty(&ws->out)) {
+        niov = 0;
+        off = ws->sent;
+
+        dlist_foreach(iter, &ws->out) {
+            link = dlist_container(pgrest_http_websocket_link_t, node,
+                                   iter.cur);
+
+            iov[niov].iov_base = link->frame->data + off;
+            iov[niov].iov_len = link->frame->len - off;
+            off = 0;
+
+            if (++niov == PGREST_HTTP_OUTPUT_IOVS) {
+                break;
+            }
+        }
+
+        n = pgrest_conn_sendv(conn, iov, niov);
+
+        if (n == PGREST_ERROR) {
+            conn->error = 1;
+            pgrest_http_close_request(req, 0);
+            return;
+        }
+
+        if (n == PGREST_AGAIN) {
+            conn->wev_handler = pgrest_http_websocket_write_handler;
+
+            if (!pgrest_event_add(conn->wev, EV_WRITE, 0)) {
+                pgrest_http_close_request(req, 0);
+            }
+
+            return;
+        }
+
+        ws->out_bytes -= n;
+
+        while (n > 0) {
+            node = dlist_head_node(&ws->out);
+            link = dlist_container(pgrest_http_websocket_link_t, node, node);
+            rest = link->frame->len - ws->sent;
+
+            if ((size_t) n < rest) {
+                ws->sent += n;
+                break;
+            }
+
+            n -= rest;
+            ws->sent = 0;
+            ws->out_frames--;
+
+            dlist_delete(node);
+            pgrest_http_websocket_frame_release(link->frame);
+            pgrest_util_free(link);
+        }
+    }
+
+    if (!(pgrest_event_get_events(conn->wev) & EV_ET)) {
+        if (!pgrest_event_del(conn->wev, EV_WRITE)) {
+            pgrest_http_close_request(req, 0);
+            return;
+        }
+    }
+
+    if (ws->close_sent) {
+        pgrest_http_close_request(req, 0);
+        return;
+    }
+
+    if (ws->drain_handler) {
+        ws->drain_handler(ws);
+    }
+}
+
+/*
+ * Send a frame, or queue a reference to it for the write event. The
+ * caller keeps its own reference either way. Returns PGREST_OK when it
+ * went out, PGREST_AGAIN when queued and PGREST_ERROR.
+ */
+int
+pgrest_http_websocket_send(pgrest_http_websocket_t       *ws,
+                           pgrest_http_websocket_frame_t *frame)
+{
+    ssize_t                        n = 0;
+    bool                           wait = false;
+    pgrest_http_websocket_link_t  *link;
+    pgrest_connection_t           *conn = ws->req->conn;
+
+    /* nothing may follow a close frame */
+    if (ws->close_sent) {
+        return PGREST_OK;
+    }
+
+    if (conn->error) {
+        return PGREST_ERROR;
+    }
+
+    /* the 101 response may still be on its way */
+    if (dlist_is_empty(&ws->out)
+        && pgrest_http_output_pending(ws->req) == 0)
+    {
+        n = pgrest_conn_send(conn, frame->data, frame->len);
+
+        if (n == PGREST_ERROR) {
+            conn->error = 1;
+            return PGREST_ERROR;
+        }
+
+        if (n == PGREST_AGAIN) {
+            n = 0;
+        }
+
+        if ((size_t) n == frame->len) {
+            return PGREST_OK;
+        }
+
+        wait = true;
+    }
+
+    link = pgrest_util_alloc(pgrest_http_websocket_mctx, sizeof(*link));
+    if (link == NULL) {
+        return PGREST_ERROR;
+    }
+
+    link->frame = frame;
+    frame->refs++;
+
+    if (dlist_is_empty(&ws->out)) {
+        ws->sent = n;
+    }
+
+    dlist_push_tail(&ws->out, &link->node);
+    ws->out_bytes += frame->len - n;
+    ws->out_frames++;
+
+    if (wait) {
+        conn->wev_handler = pgrest_http_websocket_write_handler;
+
+        if (!pgrest_event_add(conn->wev, EV_WRITE, 0)) {
+            return PGREST_ERROR;
+        }
+    }
+
+    return PGREST_AGAIN;
+}
+
+/*
+ * Start the closing handshake, status 0 sends a close frame without a
+ * body. The connection is closed as soon as the frame is out, false is
+ * returned when that was right away and the request is gone.
+ */
+bool
+pgrest_http_websocket_close(pgrest_http_websocket_t *ws, int status)
+{
+    int                             rc;
+    unsigned char                   code[2];
+    pgrest_http_websocket_frame_t  *frame;
+    pgrest_http_request_t          *req = ws->req;
+
+    if (!ws->close_sent) {
+        code[0] = (unsigned char) (status >> 8);
+        code[1] = (unsigned char) status;
+
+        frame = pgrest_http_websocket_frame_create(
+                                             PGREST_HTTP_WEBSOCKET_CLOSE,
+                                             code, status ? 2 : 0);
+        if (frame == NULL) {
+            pgrest_http_close_request(req, 0);
+            return false;
+        }
+
+        rc = pgrest_http_websocket_send(ws, frame);
+        pgrest_http_websocket_frame_release(frame);
+
+        if (rc == PGREST_ERROR) {
+            pgrest_http_close_request(req, 0);
+            return false;
+        }
+
+        ws->close_sent = 1;
+    }
+
+    if (dlist_is_empty(&ws->out) && pgrest_http_output_pending(req) == 0) {
+        pgrest_http_close_request(req, 0);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+pgrest_http_websocket_control(pgrest_http_websocket_t *ws,
+                              int                      opcode,
+                              unsigned char           *data,
+                              size_t                   len)
+{
+    int                             rc;
+    pgrest_http_websocket_frame_t  *frame;
+
+    switch (opcode) {
+    case PGREST_HTTP_WEBSOCKET_CLOSE:
+        debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "websocket close "
+                                  "frame received")));
+
+        /* echo the status code */
+        return pgrest_http_websocket_close(ws, len >= 2
+                                              ? (data[0] << 8) | data[1]
+                                              : 0);
+
+    case PGREST_HTTP_WEBSOCKET_PING:
+        frame = pgrest_http_websocket_frame_create(PGREST_HTTP_WEBSOCKET_PONG,
+                                                   data, len);
+        if (frame == NULL) {
+            pgrest_http_close_request(ws->req, 0);
+            return false;
+        }
+
+        rc = pgrest_http_websocket_send(ws, frame);
+        pgrest_http_websocket_frame_release(frame);
+
+        if (rc == PGREST_ERROR) {
+            pgrest_http_close_request(ws->req, 0);
+            return false;
+        }
+
+        return true;
+
+    case PGREST_HTTP_WEBSOCKET_PONG:
+        return true;
+
+    default:
+        return pgrest_http_websocket_close(ws,
+                                    PGREST_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+    }
+}
+
+/* a data frame, fragments are put together before the handler sees them */
+static bool
+pgrest_http_websocket_data(pgrest_http_websocket_t *ws,
+                           int                      opcode,
+                           bool                     fin,
+                           unsigned char           *data,
+                           size_t                   len)
+{
+    pgrest_iovec_t          iovec;
+    pgrest_buffer_t        *msg;
+    pgrest_http_request_t  *req = ws->req;
+
+    if ((opcode == PGREST_HTTP_WEBSOCKET_CONTINUATION) != (ws->opcode != 0)) {
+        return pgrest_http_websocket_close(ws,
+                                    PGREST_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+    }
+
+    /* the common case, no copy */
+    if (fin && ws->opcode == 0) {
+        if (ws->handler && !ws->close_sent) {
+            ws->handler(ws, opcode, data, len);
+        }
+
+        return true;
+    }
+
+    if (ws->opcode == 0) {
+        ws->opcode = opcode;
+    }
+
+    if (ws->message == NULL) {
+        ws->message = pgrest_buffer_create(req->pool,
+                                           PGREST_HTTP_WEBSOCKET_BUFFER_SIZE);
+        if (ws->message == NULL) {
+            pgrest_http_close_request(req, 0);
+            return false;
+        }
+    }
+
+    msg = ws->message;
+
+    if (msg->size + len > PGREST_HTTP_WEBSOCKET_MESSAGE_MAX) {
+        return pgrest_http_websocket_close(ws,
+                                    PGREST_HTTP_WEBSOCKET_MESSAGE_TOO_BIG);
+    }
+
+    iovec = pgrest_buffer_reserve(req->pool, &ws->message, len);
+    if (iovec.base == NULL) {
+        pgrest_http_close_request(req, 0);
+        return false;
+    }
+
+    msg = ws->message;
+    memcpy(iovec.base, data, len);
+    msg->size += len;
+
+    if (!fin) {
+        return true;
+    }
+
+    if (ws->handler && !ws->close_sent) {
+        ws->handler(ws, ws->opcode, msg->pos, msg->size);
+    }
+
+    ws->opcode = 0;
+    pgrest_buffer_reset(msg);
+
+    return true;
+}
+
+/*
+ * Decode the header of a client frame out of the size bytes at p. Returns
+ * PGREST_OK, PGREST_AGAIN while it is incomplete, otherwise the status to
+ * close the connection with. The mask is counted in h->hlen but is only
+ * there once the payload is.
+ */
+int
+pgrest_http_websocket_parse_header(const unsigned char            *p,
+                                   size_t                          size,
+                                   pgrest_http_websocket_header_t *h)
+{
+    int  i;
+
+    if (size < 2) {
+        return PGREST_AGAIN;
+    }
+
+    h->fin = (p[0] & 0x80) != 0;
+    h->opcode = p[0] & 0x0f;
+    h->len = p[1] & 0x7f;
+    h->hlen = 2;
+
+    /* no extension was negotiated and clients must mask */
+    if ((p[0] & 0x70) || !(p[1] & 0x80)) {
+        return PGREST_HTTP_WEBSOCKET_PROTOCOL_ERROR;
+    }
+
+    if (h->len == 126) {
+        if (size < 4) {
+            return PGREST_AGAIN;
+        }
+
+        h->len = (uint64) p[2] << 8 | p[3];
+        h->hlen = 4;
+
+    } else if (h->len == 127) {
+        if (size < 10) {
+            return PGREST_AGAIN;
+        }
+
+        for (h->len = 0, i = 2; i < 10; i++) {
+            h->len = h->len << 8 | p[i];
+        }
+
+        h->hlen = 10;
+    }
+
+    if ((h->opcode & 0x8) && (!h->fin || h->len > 125)) {
+        return PGREST_HTTP_WEBSOCKET_PROTOCOL_ERROR;
+    }
+
+    if (h->len > PGREST_HTTP_WEBSOCKET_MESSAGE_MAX) {
+        return PGREST_HTTP_WEBSOCKET_MESSAGE_TOO_BIG;
+    }
+
+    h->hlen += 4;
+
+    return PGREST_OK;
+}
+
+/*
+ * Take the complete frames off the input buffer. Returns false once the
+ * request is gone.
+ */
+static bool
+pgrest_http_websocket_parse(pgrest_http_websocket_t *ws)
+{
+    int                             rc;
+    size_t                          len;
+    unsigned char                  *payload;
+    pgrest_buffer_t                *in = ws->in;
+    pgrest_http_websocket_header_t  h;
+
+    for ( ;; ) {
+        rc = pgrest_http_websocket_parse_header(in->pos, in->size, &h);
+
+        if (rc == PGREST_AGAIN) {
+            break;
+        }
+
+        if (rc != PGREST_OK) {
+            return pgrest_http_websocket_close(ws, rc);
+        }
+
+        if (in->size < h.hlen + h.len) {
+            break;
+        }
+
+        len = (size_t) h.len;
+        payload = in->pos + h.hlen;
+        pgrest_http_websocket_unmask(payload, len, payload - 4);
+
+        /* the data stays where it is until the next read */
+        pgrest_buffer_consume(in, h.hlen + len);
+
+        if (ws->close_sent) {
+            continue;
+        }
+
+        if (h.opcode & 0x8) {
+            if (!pgrest_http_websocket_control(ws, h.opcode, payload, len)) {
+                return false;
+            }
+
+        } else if (h.opcode > PGREST_HTTP_WEBSOCKET_BINARY) {
+            return pgrest_http_websocket_close(ws,
+                                        PGREST_HTTP_WEBSOCKET_PROTOCOL_ERROR);
+
+        } else if (!pgrest_http_websocket_data(ws, h.opcode, h.fin, payload,
+                                               len))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+pgrest_http_websocket_reading(pgrest_http_request_t *req)
+{
+    ssize_t                   n;
+    pgrest_iovec_t            iovec;
+    pgrest_http_websocket_t  *ws = req->websocket;
+    pgrest_connection_t      *conn = req->conn;
+
+    for ( ;; ) {
+        iovec = pgrest_buffer_reserve(req->pool, &ws->in,
+                                      PGREST_HTTP_WEBSOCKET_READ_SIZE);
+        if (iovec.base == NULL) {
+            pgrest_http_close_request(req, 0);
+            return;
+        }
+
+        n = pgrest_conn_recv(conn, iovec.base, iovec.len);
+
+        if (n == PGREST_AGAIN) {
+            if (!pgrest_conn_add_read(conn, 0)) {
+                pgrest_http_close_request(req, 0);
+            }
+
+            return;
+        }
+
+        if (n == 0 || n == PGREST_ERROR) {
+            debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "websocket client "
+                                      "closed connection")));
+            conn->error = 1;
+            pgrest_http_close_request(req, PGREST_HTTP_CLIENT_CLOSED_REQUEST);
+            return;
+        }
+
+        ws->in->size += n;
+
+        if (!pgrest_http_websocket_parse(ws)) {
+            return;
+        }
+    }
+}
+
+/* request cleanup, drop the references to what was never sent */
+static void
+pgrest_http_websocket_cleanup(void *data)
+{
+    dlist_node                    *node;
+    pgrest_http_websocket_link_t  *link;
+    pgrest_http_websocket_t       *ws = data;
+
+    while (!dlist_is_empty(&ws->out)) {
+        node = dlist_pop_head_node(&ws->out);
+        link = dlist_container(pgrest_http_websocket_link_t, node, node);
+
+        pgrest_http_websocket_frame_release(link->frame);
+        pgrest_util_free(link);
+    }
+
+    ws->req->websocket = NULL;
+}
+
+/*
+ * Check the opening handshake and answer it with 101, the connection
+ * carries websocket frames from then on and closes with the request.
+ * Messages from the client go to handler, which must not close the
+ * request. Returns PGREST_OK, PGREST_ERROR or an http status for a
+ * request that is not a valid handshake.
+ */
+int
+pgrest_http_websocket_accept(pgrest_http_request_t            *req,
+                             pgrest_http_websocket_message_pt  handler,
+                             void                             *data)
+{
+    pgrest_param_t           *header;
+    pgrest_http_cleanup_t    *cln;
+    pgrest_http_websocket_t  *ws;
+    char                      accept[PGREST_HTTP_WEBSOCKET_ACCEPT_LEN + 1];
+
+    if (req->method != PGREST_HTTP_GET
+        || req->http_version < PGREST_HTTP_VERSION_11
+        || !pgrest_http_websocket_is_upgrade(req))
+    {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    header = pgrest_http_header_find(&req->headers_in.headers,
+                                     "connection", sizeof("connection") - 1);
+    if (!pgrest_http_websocket_has_token(header, "upgrade",
+                                         sizeof("upgrade") - 1))
+    {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    header = pgrest_http_header_find(&req->headers_in.headers,
+                                     "sec-websocket-version",
+                                     sizeof("sec-websocket-version") - 1);
+    if (header == NULL || header->value.len != 2
+        || memcmp(header->value.base, "13", 2) != 0)
+    {
+        if (!pgrest_http_set_header(req, "Sec-WebSocket-Version", "13")) {
+            return PGREST_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        return PGREST_HTTP_UPGRADE_REQUIRED;
+    }
+
+    header = pgrest_http_header_find(&req->headers_in.headers,
+                                     "sec-websocket-key",
+                                     sizeof("sec-websocket-key") - 1);
+    if (header == NULL
+        || header->value.len != PGREST_HTTP_WEBSOCKET_KEY_LEN)
+    {
+        return PGREST_HTTP_BAD_REQUEST;
+    }
+
+    ws = pgrest_mpool_calloc(req->pool, 1, sizeof(pgrest_http_websocket_t));
+    cln = pgrest_http_cleanup_add(req);
+    if (ws == NULL || cln == NULL) {
+        return PGREST_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ws->in = pgrest_buffer_create(req->pool,
+                                  PGREST_HTTP_WEBSOCKET_BUFFER_SIZE);
+    if (ws->in == NULL) {
+        return PGREST_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    ws->req = req;
+    ws->handler = handler;
+    ws->data = data;
+    dlist_init(&ws->out);
+
+    req->websocket = ws;
+    cln->handler = pgrest_http_websocket_cleanup;
+    cln->data = ws;
+
+    pgrest_http_websocket_accept_key(header->value.base, accept);
+
+    req->chunked = 0;
+    req->headers_out.status = PGREST_HTTP_SWITCHING_PROTOCOLS;
+    req->headers_out.content_length_n = -1;
+
+    if (!pgrest_http_set_header(req, "Upgrade", "websocket")
+        || !pgrest_http_set_header(req, "Connection", "Upgrade")
+        || !pgrest_http_set_header(req, "Sec-WebSocket-Accept", accept))
+    {
+        return PGREST_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    if (pgrest_http_send_header(req) == PGREST_ERROR) {
+        return PGREST_ERROR;
+    }
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "websocket accepted")));
+
+    req->read_event_handler = pgrest_http_websocket_reading;
+    req->write_event_handler = pgrest_http_websocket_writing;
+
+    if (!pgrest_conn_add_read(req->conn, 0)) {
+        return PGREST_ERROR;
+    }
+
+    return PGREST_OK;
+}
@@ -21,199 +21,429 @@
 #define LOCAL_SOCKETPAIR_AF AF_UNIX
 #endif
 
+/*
+ * Messages between two workers go through a single producer, single
+ * consumer ring in shared memory, one ring per (sender, receiver) pair.
+ * head and tail are free running offsets, each written by one side only.
+ * The auxiliary processes send as if they were workers numbered from
+ * pgrest_ipc_nworkers on.
+ */
+typedef struct {
+    /* written by the sending worker only */
+    volatile uint32              head;
+    char                         pad1[PG_CACHE_LINE_SIZE - sizeof(uint32)];
+    /* written by the receiving worker only */
+    volatile uint32              tail;
+    char                         pad2[PG_CACHE_LINE_SIZE - sizeof(uint32)];
+    char                         data[PGREST_IPC_RING_SIZE];
+} pgrest_ipc_ring_t;
+
+typedef struct {
+    uint32                       command;
+    uint32                       len;
+} pgrest_ipc_msg_t;
+
+/* fills the end of the ring when a message does not fit before the wrap */
+#define PGREST_IPC_MSG_PAD       0xffffffff
+
+#define pgrest_ipc_msg_size(len)                                            \
+    MAXALIGN(sizeof(pgrest_ipc_msg_t) + (len))
+
 typedef struct {
     evutil_socket_t              sockets[2];
     pgrest_connection_t         *conn;
 } pgrest_ipc_data_t;
 
+typedef union
+{
+    pgrest_ipc_stat_t            stat;
+    char                         pad[PG_CACHE_LINE_SIZE];
+} pgrest_ipc_stat_paded_t;
+
 static pgrest_ipc_data_t        *pgrest_ipc_data;
+static pgrest_ipc_ring_t        *pgrest_ipc_rings;
+static pgrest_ipc_stat_paded_t  *pgrest_ipc_stats;
+static int                       pgrest_ipc_nworkers;
+static int                       pgrest_ipc_nsenders;
 static pgrest_ipc_msg_handler_pt pgrest_ipc_msg_handlers[PGREST_IPC_CMD_MAX];
 
-bool 
-pgrest_ipc_send_notify(int dest_worker, ev_uint8_t command)
+/* notify commands pending per destination worker, one bit per command */
+static uint32                    pgrest_ipc_pending[PGREST_MAX_WORKERS];
+static bool                      pgrest_ipc_dirty = false;
+
+/* notifies kept pending on a full ring are sent again when it fires */
+#define PGREST_IPC_RETRY_DELAY   10
+
+static pgrest_timer_t            pgrest_ipc_retry;
+
+static inline pgrest_ipc_ring_t *
+pgrest_ipc_ring(int src_worker, int dest_worker)
 {
-    pgrest_connection_t *conn;
-    pgrest_iovec_t       iovec;
+    return &pgrest_ipc_rings[src_worker * pgrest_ipc_nworkers + dest_worker];
+}
 
-    conn = pgrest_ipc_data[dest_worker].conn;
-    if (conn == NULL) {
-        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "could not send notify "
-                                 "to worker %d : channel has been destroyed", 
-                                  dest_worker)));
-        return false;
+/* counters of the running worker, written by it only */
+static inline pgrest_ipc_stat_t *
+pgrest_ipc_stat(void)
+{
+    return &pgrest_ipc_stats[pgrest_worker_index].stat;
+}
+
+/*
+ * The socketpair only wakes the receiver up, one byte is sent when a ring
+ * turns non-empty. A full socket buffer already holds a pending wakeup.
+ */
+static void
+pgrest_ipc_doorbell(int dest_worker)
+{
+    char    c = 0;
+
+    if (send(pgrest_ipc_data[dest_worker].sockets[0], &c, 1, 0) == -1
+        && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        ereport(COMMERROR,
+                (errcode_for_socket_access(),
+                 errmsg(PGREST_PACKAGE " " "worker %d send() doorbell to "
+                        "worker %d failed: %m", pgrest_worker_index,
+                         dest_worker)));
     }
+}
 
-    iovec = pgrest_buffer_reserve(conn->pool, &conn->buffer, 1);
-    if (iovec.base == NULL) {
-        return false;
+/*
+ * Queue a message for another worker. The payload is copied into the
+ * ring, the receiver's handler sees it in place and must copy what it
+ * wants to keep. Returns PGREST_AGAIN when the ring is full and
+ * PGREST_ERROR when the receiver is not running.
+ */
+static pgrest_int_t
+pgrest_ipc_put(int dest_worker, pgrest_ipc_cmd_e command,
+               const void *data, size_t len)
+{
+    pgrest_ipc_ring_t   *ring;
+    pgrest_ipc_msg_t    *msg;
+    uint32               head;
+    uint32               tail;
+    uint32               off;
+    uint32               need;
+    uint32               contiguous;
+    uint32               size;
+
+    if (dest_worker == pgrest_worker_index) {
+        if (pgrest_ipc_msg_handlers[command]) {
+            pgrest_ipc_msg_handlers[command](dest_worker, (void *) data, len);
+        }
+
+        return PGREST_OK;
+    }
+
+    if (!pgrest_worker_active(dest_worker)) {
+        debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d is not "
+                                  "running, drop %d command", dest_worker,
+                                   (int) command)));
+        pgrest_ipc_stat()->dropped++;
+        return PGREST_ERROR;
+    }
+
+    ring = pgrest_ipc_ring(pgrest_worker_index, dest_worker);
+
+    head = ring->head;
+    tail = ring->tail;
+    /* the receiver is done with the space up to tail */
+    pg_memory_barrier();
+
+    need = pgrest_ipc_msg_size(len);
+    off = head & (PGREST_IPC_RING_SIZE - 1);
+    contiguous = PGREST_IPC_RING_SIZE - off;
+    size = (need > contiguous) ? contiguous + need : need;
+
+    if (size > PGREST_IPC_RING_SIZE - (head - tail)) {
+        return PGREST_AGAIN;
     }
 
-   *iovec.base = command;
-    conn->buffer->size++;
+    if (need > contiguous) {
+        msg = (pgrest_ipc_msg_t *) (ring->data + off);
+        msg->command = PGREST_IPC_MSG_PAD;
+        msg->len = contiguous - sizeof(pgrest_ipc_msg_t);
+        off = 0;
+    }
+
+    msg = (pgrest_ipc_msg_t *) (ring->data + off);
+    msg->command = command;
+    msg->len = len;
+
+    if (len) {
+        memcpy(msg + 1, data, len);
+    }
 
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d send %d co"
                               "mmand to worker %d", pgrest_worker_index, 
-                               (int)command, dest_worker)));
+                               (int) command, dest_worker)));
 
-    /* schedule the write */
-    (void) pgrest_event_add(conn->rev, EV_WRITE, 0);
+    /* publish the message, then see whether the receiver went idle */
+    pg_write_barrier();
+    ring->head = head + size;
+    pg_memory_barrier();
 
-    return true;
+    if (ring->tail == head) {
+        pgrest_ipc_doorbell(dest_worker);
+    }
+
+    pgrest_ipc_stat()->sent++;
+
+    return PGREST_OK;
 }
 
-static bool
-pgrest_ipc_setup_handler(int worker_index,
-                         struct event_base *base,
-                         evutil_socket_t fd,
-                         short events,
-                         event_callback_fn handler)
+bool
+pgrest_ipc_send(int dest_worker, pgrest_ipc_cmd_e command,
+                const void *data, size_t len)
 {
-    pgrest_connection_t *conn;
-    struct event        *ev;
+    pgrest_int_t  rc;
 
-    if ((conn = pgrest_conn_get(fd)) == NULL) {
+    Assert(command < PGREST_IPC_CMD_MAX);
+
+    if (len > PGREST_IPC_MSG_MAX) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "ipc message of %zu "
+                                 "bytes exceeds %d bytes", len,
+                                  PGREST_IPC_MSG_MAX)));
         return false;
     }
 
-    conn->channel = 1;
+    rc = pgrest_ipc_put(dest_worker, command, data, len);
 
-    if ((conn->pool = pgrest_mpool_create(NULL)) == NULL) {
-        return false;
+    if (rc == PGREST_AGAIN) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "could not send %d "
+                                 "command to worker %d : ring is full",
+                                  (int) command, dest_worker)));
+        pgrest_ipc_stat()->dropped++;
     }
 
-    if((conn->buffer = pgrest_buffer_create(conn->pool, 1024)) == NULL) {
-        return false;
-    }
+    return rc == PGREST_OK;
+}
 
-    ev = events & EV_READ ? conn->rev : conn->wev;
-    if (pgrest_event_assign(ev, base, 
-                            fd, events, handler, conn) < 0) {
-        return false;
-    }
+/*
+ * Notifies carry no payload, so a command already pending for the same
+ * worker is not queued again. Pending notifies are sent by
+ * pgrest_ipc_flush() once per event loop iteration, one that finds the
+ * ring full stays pending and is sent again.
+ */
+bool 
+pgrest_ipc_send_notify(int dest_worker, pgrest_ipc_cmd_e command)
+{
+    uint32  bit = (uint32) 1 << command;
 
-    pgrest_event_priority_set(ev, PGREST_EVENT_PRIORITY);
+    Assert(command < PGREST_IPC_CMD_MAX);
 
-    if (events & EV_READ) {
-        (void) pgrest_event_add(ev, EV_READ, 0); 
+    if (pgrest_ipc_pending[dest_worker] & bit) {
+        pgrest_ipc_stat()->coalesced++;
+        return true;
     }
 
-    pgrest_ipc_data[worker_index].conn = conn;
+    pgrest_ipc_pending[dest_worker] |= bit;
+    pgrest_ipc_dirty = true;
 
     return true;
 }
 
-static void
-pgrest_ipc_set_conn(pgrest_connection_t *conn)
+/* notify every other worker */
+void
+pgrest_ipc_broadcast_notify(pgrest_ipc_cmd_e command)
 {
-    int i;
+    int  i;
 
-    for (i = 0; i < pgrest_setting.worker_processes; i++) {
-        if (conn == pgrest_ipc_data[i].conn) {
-            pgrest_ipc_data[i].conn = NULL;
-            break;
+    for (i = 0; i < pgrest_ipc_nworkers; i++) {
+        if (i != pgrest_worker_index) {
+            (void) pgrest_ipc_send_notify(i, command);
         }
     }
 }
 
-static void 
-pgrest_ipc_read_handler(evutil_socket_t fd, short events, void *arg)
+/* the event loop runs pgrest_ipc_flush() after this */
+static void
+pgrest_ipc_retry_handler(pgrest_timer_t *timer)
 {
-    size_t               i;
-    ssize_t              result;
-    pgrest_connection_t *conn;
-    ev_uint8_t           command[128];
+    pgrest_ipc_dirty = true;
+}
 
-    conn = (pgrest_connection_t *) arg;
+void
+pgrest_ipc_flush(void)
+{
+    int     i;
+    int     command;
+    uint32  bit;
+    uint32  pending;
 
-    for (;;) {
-        result = pgrest_conn_recv(conn, 
-                                  (unsigned char *) command, 
-                                  sizeof(command));
+    if (!pgrest_ipc_dirty) {
+        return;
+    }
 
-        if (result == 0) {
-            ereport(WARNING, (errmsg(PGREST_PACKAGE " " "recv() returned"
-                                      " zero when receiving notify")));
-            goto fail;
+    pgrest_ipc_dirty = false;
+
+    for (i = 0; i < pgrest_ipc_nworkers; i++) {
+        if ((pending = pgrest_ipc_pending[i]) == 0) {
+            continue;
         }
 
-        if (result == PGREST_ERROR) {
-            ereport(COMMERROR,
-                    (errcode_for_socket_access(),
-                     errmsg(PGREST_PACKAGE " " "recv() failed: %m")));
-            goto fail;
+        pgrest_ipc_pending[i] = 0;
+
+        for (command = 0; command < PGREST_IPC_CMD_MAX; command++) {
+            bit = (uint32) 1 << command;
+
+            if (!(pending & bit)
+                || pgrest_ipc_put(i, command, NULL, 0) != PGREST_AGAIN)
+            {
+                continue;
+            }
+
+            /* the receiver is behind, it gets the notify once it caught up */
+            debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "ring to worker %d "
+                                      "is full, retry %d command", i,
+                                       command)));
+            pgrest_ipc_pending[i] |= bit;
         }
 
-        if (result == PGREST_AGAIN) {
-            return;
+        if (pgrest_ipc_pending[i] == 0) {
+            continue;
+        }
+
+        /*
+         * An auxiliary process flushes on its next poll, a worker could
+         * sleep in the event loop until then and needs the timer.
+         */
+        pgrest_ipc_dirty = true;
+
+        if (pgrest_worker_index < pgrest_ipc_nworkers) {
+            pgrest_timer_add(&pgrest_ipc_retry, PGREST_IPC_RETRY_DELAY);
+        }
+    }
+}
+
+void
+pgrest_ipc_stat_get(int worker, pgrest_ipc_stat_t *stat)
+{
+    *stat = pgrest_ipc_stats[worker].stat;
+}
+
+/*
+ * Handle every message queued by src_worker. tail is published and head
+ * read again so a message sent meanwhile is either seen here or comes
+ * with a doorbell.
+ */
+static void
+pgrest_ipc_ring_drain(int src_worker)
+{
+    pgrest_ipc_ring_t   *ring;
+    pgrest_ipc_msg_t    *msg;
+    uint32               head;
+    uint32               tail;
+
+    ring = pgrest_ipc_ring(src_worker, pgrest_worker_index);
+    tail = ring->tail;
+
+    for ( ;; ) {
+        head = ring->head;
+        pg_read_barrier();
+
+        if (head == tail) {
+            break;
         }
 
-        for(i = 0; i < result; i++) {
+        while (tail != head) {
+            msg = (pgrest_ipc_msg_t *) 
+                      (ring->data + (tail & (PGREST_IPC_RING_SIZE - 1)));
 
-            Assert(command[i] < PGREST_IPC_CMD_MAX);
+            if (msg->command < PGREST_IPC_CMD_MAX) {
+                debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d "
+                                          "received %d command from worker "
+                                          "%d", pgrest_worker_index,
+                                           (int) msg->command, src_worker)));
 
-            debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d received"
-                                      " %d command", pgrest_worker_index, 
-                                       (int) command[i])));
+                if (pgrest_ipc_msg_handlers[msg->command]) {
+                    pgrest_ipc_msg_handlers[msg->command](src_worker,
+                                                          msg + 1, msg->len);
+                }
 
-            if (pgrest_ipc_msg_handlers[command[i]]) {
-                pgrest_ipc_msg_handlers[command[i]]();
+                pgrest_ipc_stat()->received++;
             }
+
+            tail += pgrest_ipc_msg_size(msg->len);
         }
+
+        pg_memory_barrier();
+        ring->tail = tail;
+        pg_memory_barrier();
     }
+}
 
-    return;
+static bool
+pgrest_ipc_setup_handler(int worker_index,
+                         struct event_base *base,
+                         evutil_socket_t fd,
+                         event_callback_fn handler)
+{
+    pgrest_connection_t *conn;
 
-fail:
-    pgrest_conn_close(conn);
-    pgrest_ipc_set_conn(conn);
+    if ((conn = pgrest_conn_get(fd)) == NULL) {
+        return false;
+    }
+
+    conn->channel = 1;
+
+    if (pgrest_event_assign(conn->rev, base, 
+                            fd, EV_READ | EV_PERSIST, handler, conn) < 0) {
+        return false;
+    }
+
+    pgrest_event_priority_set(conn->rev, PGREST_EVENT_PRIORITY);
+    (void) pgrest_event_add(conn->rev, EV_READ, 0); 
+
+    pgrest_ipc_data[worker_index].conn = conn;
+
+    return true;
 }
 
 static void 
-pgrest_ipc_write_handler(evutil_socket_t fd, short events, void *arg)
+pgrest_ipc_read_handler(evutil_socket_t fd, short events, void *arg)
 {
+    int                  i;
     ssize_t              result;
     pgrest_connection_t *conn;
-    pgrest_buffer_t     *buf;
+    unsigned char        doorbell[128];
 
     conn = (pgrest_connection_t *) arg;
-    buf = conn->buffer;
 
-    if (buf->size == 0) {
-        (void) pgrest_event_del(conn->wev, EV_WRITE);
-        return;
-    }
-
-    result = pgrest_conn_send(conn, buf->pos, buf->size);
+    /* any number of pending doorbells is a single wakeup */
+    for (;;) {
+        result = pgrest_conn_recv(conn, doorbell, sizeof(doorbell));
 
-    if (result == 0) {
-        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "send() returned"
-                                  " zero when send notify")));
-        goto schedule;
-    }
+        if (result == 0) {
+            ereport(WARNING, (errmsg(PGREST_PACKAGE " " "recv() returned"
+                                      " zero when receiving notify")));
+            goto fail;
+        }
 
-    if (result == PGREST_AGAIN) {
-        goto schedule;
-    }
+        if (result == PGREST_ERROR) {
+            ereport(COMMERROR,
+                    (errcode_for_socket_access(),
+                     errmsg(PGREST_PACKAGE " " "recv() failed: %m")));
+            goto fail;
+        }
 
-    if (result == PGREST_ERROR) {
-        ereport(COMMERROR,
-                (errcode_for_socket_access(),
-                 errmsg(PGREST_PACKAGE " " "send() failed: %m")));
-        goto fail;
+        if (result == PGREST_AGAIN) {
+            break;
+        }
     }
 
-    pgrest_buffer_consume(buf, result);
-
-schedule:
-    if (buf->size) {
-        (void) pgrest_event_add(conn->rev, EV_WRITE, 0);
+    for (i = 0; i < pgrest_ipc_nsenders; i++) {
+        if (i != pgrest_worker_index) {
+            pgrest_ipc_ring_drain(i);
+        }
     }
 
     return;
 
 fail:
     pgrest_conn_close(conn);
-    pgrest_ipc_set_conn(conn);
+    pgrest_ipc_data[pgrest_worker_index].conn = NULL;
 }
 
 void
@@ -224,6 +454,29 @@ pgrest_ipc_setup_msg_handler(pgrest_ipc_cmd_e command,
     pgrest_ipc_msg_handlers[command] = handler;
 }
 
+/*
+ * Called by an auxiliary process before sending anything, it keeps the
+ * doorbells of the workers only. A restarted one goes on where its
+ * predecessor stopped, the receivers still own the tails.
+ */
+void
+pgrest_ipc_aux_init(pgrest_ipc_aux_e aux)
+{
+    int  i;
+
+    Assert(aux < PGREST_IPC_AUX_MAX);
+
+    pgrest_worker_index = pgrest_ipc_nworkers + aux;
+
+    for (i = 0; i < pgrest_ipc_nworkers; i++) {
+        evutil_closesocket(pgrest_ipc_data[i].sockets[1]);
+    }
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "auxiliary process %d "
+                              "initialize ipc channel successfull",
+                               pgrest_worker_index)));
+}
+
 void
 pgrest_ipc_close_channel(evutil_socket_t *sockets)
 {
@@ -236,8 +489,10 @@ pgrest_ipc_worker_init(void *data, void *base)
 {
     int                 i;
     evutil_socket_t    *sockets;
+    pgrest_ipc_ring_t  *ring;
     int                 worker_processes = (intptr_t) data;
 
+    /* keep the sending ends as doorbells of the other workers */
     for (i = 0; i < worker_processes; i++) {
         if (i == pgrest_worker_index) {
             continue;
@@ -246,23 +501,26 @@ pgrest_ipc_worker_init(void *data, void *base)
         sockets = pgrest_ipc_data[i].sockets;
         evutil_closesocket(sockets[1]);
 
-        if (!pgrest_ipc_setup_handler(i,
-                                      base,
-                                      sockets[0], 
-                                      EV_WRITE, 
-                                      pgrest_ipc_write_handler)) 
-        {
-            return false;
-        }
+        /* messages left for a previous incarnation of this worker */
+        ring = pgrest_ipc_ring(i, pgrest_worker_index);
+        ring->tail = ring->head;
     }
 
+    for (i = pgrest_ipc_nworkers; i < pgrest_ipc_nsenders; i++) {
+        ring = pgrest_ipc_ring(i, pgrest_worker_index);
+        ring->tail = ring->head;
+    }
+
+    pg_memory_barrier();
+
+    pgrest_ipc_retry.handler = pgrest_ipc_retry_handler;
+
     sockets = pgrest_ipc_data[pgrest_worker_index].sockets;
     evutil_closesocket(sockets[0]);
 
     if (!pgrest_ipc_setup_handler(pgrest_worker_index,
                                   base,
                                   sockets[1], 
-                                  EV_READ | EV_PERSIST, 
                                   pgrest_ipc_read_handler)) 
     {
         return false;
@@ -280,10 +538,17 @@ pgrest_ipc_worker_exit(void *data, void *base)
     int                    i;
     pgrest_connection_t   *conn;
 
-    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d ipc_exit",
-                               pgrest_worker_index)));
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d ipc_exit, "
+                              "sent %lu coalesced %lu dropped %lu received "
+                              "%lu", pgrest_worker_index,
+                               (unsigned long) pgrest_ipc_stat()->sent,
+                               (unsigned long) pgrest_ipc_stat()->coalesced,
+                               (unsigned long) pgrest_ipc_stat()->dropped,
+                               (unsigned long) pgrest_ipc_stat()->received)));
+
+    pgrest_timer_del(&pgrest_ipc_retry);
 
-    for (i = 0; i < pgrest_setting.worker_processes; i++) {
+    for (i = 0; i < pgrest_setting.worker_processes_max; i++) {
         conn = pgrest_ipc_data[i].conn;
         if (conn) {
             pgrest_conn_close(conn);
@@ -361,6 +626,55 @@ fail:
     return false;
 }
 
+static bool 
+pgrest_ipc_ring_data_init(pgrest_shm_seg_t *seg)
+{
+    int                 i;
+    pgrest_ipc_ring_t  *ring;
+
+    pgrest_ipc_rings = (pgrest_ipc_ring_t *) CACHELINEALIGN(seg->addr);
+    pgrest_ipc_stats = (pgrest_ipc_stat_paded_t *) 
+                         (pgrest_ipc_rings + 
+                            pgrest_ipc_nsenders * pgrest_ipc_nworkers);
+
+    for (i = 0; i < pgrest_ipc_nsenders * pgrest_ipc_nworkers; i++) {
+        ring = &pgrest_ipc_rings[i];
+        ring->head = 0;
+        ring->tail = 0;
+    }
+
+    MemSet(pgrest_ipc_stats, 0, 
+           sizeof(pgrest_ipc_stat_paded_t) * pgrest_ipc_nsenders);
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "initialize ipc rings "
+                              "successfull")));
+    return true;
+}
+
+static void
+pgrest_ipc_ring_init(int worker_processes)
+{
+    pgrest_shm_seg_t *seg;
+    size_t            size;
+
+    pgrest_ipc_nworkers = worker_processes;
+    pgrest_ipc_nsenders = worker_processes + PGREST_IPC_AUX_MAX;
+
+    size = sizeof(pgrest_ipc_ring_t) * pgrest_ipc_nsenders * worker_processes
+               + sizeof(pgrest_ipc_stat_paded_t) * pgrest_ipc_nsenders
+               + PG_CACHE_LINE_SIZE;
+    seg = pgrest_shm_seg_add(PGREST_PACKAGE " " "ipc ring", 
+                             size,
+                             false, 
+                             false);
+    if (seg == NULL) {
+        ereport(ERROR,
+                (errmsg(PGREST_PACKAGE " " "initialize ipc ring failed")));
+    }
+
+    seg->init = pgrest_ipc_ring_data_init;
+}
+
 static void
 pgrest_ipc_fini2(int status, Datum arg)
 {
@@ -378,6 +692,8 @@ pgrest_ipc_init(int worker_processes)
                 (errmsg(PGREST_PACKAGE " " "initialize ipc channel failed")));
     }
 
+    pgrest_ipc_ring_init(worker_processes);
+
     pgrest_worker_hook_add(pgrest_ipc_worker_init, 
                            pgrest_ipc_worker_exit,
                            "ipc channel",
@@ -15,7 +15,30 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
-static List *pgrest_listener_listeners = NIL;
+#if defined(HAVE_REUSEPORT) && defined(__linux__)
+#include <linux/filter.h>
+#endif
+#ifdef HAVE_EPOLLEXCLUSIVE
+#include <sys/epoll.h>
+
+#define PGREST_LISTENER_EPOLL_EVENTS   32
+
+/*
+ * In exclusive accept mode the shared listening sockets are registered
+ * with EPOLLEXCLUSIVE in a private epoll instance of each worker, so the
+ * kernel wakes only one worker per new connection. The epoll fd itself
+ * is watched by the event loop.
+ */
+static evutil_socket_t pgrest_listener_epfd = -1;
+static struct event   *pgrest_listener_epev = NULL;
+#endif
+
+PG_FUNCTION_INFO_V1(pgrest_listener_stats);
+
+static List                   *pgrest_listener_listeners = NIL;
+static pgrest_listener_stat_t *pgrest_listener_stat = NULL;
+/* counts of a listener without a shared slot */
+static pgrest_listener_stat_t  pgrest_listener_stat_local;
 
 pgrest_listener_t *
 pgrest_listener_create(void *sockaddr, socklen_t socklen)
@@ -56,6 +79,7 @@ pgrest_listener_create(void *sockaddr, socklen_t socklen)
 
     listener->fd = (evutil_socket_t) -1;
     listener->type = SOCK_STREAM;
+    listener->worker = -1;
     listener->backlog = DEFAUlT_PGREST_LISTEN_BACKLOG;
     listener->rcvbuf = -1;
     listener->sndbuf = -1;
@@ -71,6 +95,51 @@ pgrest_listener_create(void *sockaddr, socklen_t socklen)
     return listener;
 }
 
+#ifdef HAVE_REUSEPORT
+/*
+ * Give every worker its own socket in the SO_REUSEPORT group, so the
+ * kernel balances new connections between them. Clones are opened by the
+ * postmaster in worker order, which makes the socket index within the
+ * group equal to the worker index. The postmaster keeps them open, so a
+ * restarted worker gets its socket back at the same index.
+ */
+static void
+pgrest_listener_clone(int worker_processes)
+{
+    int                  i;
+    ListCell            *cell;
+    pgrest_listener_t   *listener;
+    pgrest_listener_t   *clone;
+    List                *clones = NIL;
+
+    foreach(cell, pgrest_listener_listeners) {
+        listener = lfirst(cell);
+
+        if (!listener->reuseport || listener->worker != -1) {
+            continue;
+        }
+
+        listener->worker = 0;
+        listener->steer = 1;
+
+        for (i = 1; i < worker_processes; i++) {
+            clone = (pgrest_listener_t *) palloc(sizeof(pgrest_listener_t));
+            memcpy(clone, listener, sizeof(pgrest_listener_t));
+
+            clone->worker = i;
+            clones = lappend(clones, clone);
+        }
+    }
+
+    foreach(cell, clones) {
+        pgrest_listener_listeners = lappend(pgrest_listener_listeners,
+                                            lfirst(cell));
+    }
+
+    list_free(clones);
+}
+#endif
+
 static bool
 pgrest_listener_open(List *listeners)
 {
@@ -395,17 +464,39 @@ pgrest_listener_resume(void)
     foreach(cell, pgrest_listener_listeners) {
         listener = lfirst(cell);
         conn = listener->connection;
-        ev = conn->rev;
 
-        if (conn == NULL || ev == NULL) {
+        if (conn == NULL || (ev = conn->rev) == NULL) {
             continue;
         }
+#ifdef HAVE_REUSEPORT
+        if (listener->reuseport) {
+            if (!pgrest_event_add(ev, EV_READ, 0)) {
+                return false;
+            }
+
+            continue;
+        }
+#endif
+#ifdef HAVE_EPOLLEXCLUSIVE
+        /* polled through pgrest_listener_epev, as enable set it up */
+        if (pgrest_listener_epev) {
+            continue;
+        }
+#endif
 
         if(!pgrest_event_add(ev, EV_READ, 0)) {
             return false;
         }
     }
 
+#ifdef HAVE_EPOLLEXCLUSIVE
+    if (pgrest_listener_epev && !pgrest_event_add(pgrest_listener_epev,
+                                                  EV_READ, 0))
+    {
+        return false;
+    }
+#endif
+
     return true;
 }
 
@@ -420,9 +511,8 @@ pgrest_listener_pause(bool all)
     foreach(cell, pgrest_listener_listeners) {
         listener = lfirst(cell);
         conn = listener->connection;
-        ev = conn->rev;
 
-        if (conn == NULL || ev == NULL) {
+        if (conn == NULL || (ev = conn->rev) == NULL) {
             continue;
         }
 #ifdef HAVE_REUSEPORT
@@ -436,52 +526,301 @@ pgrest_listener_pause(bool all)
         }
     }
 
+#ifdef HAVE_EPOLLEXCLUSIVE
+    if (pgrest_listener_epev && all
+        && !pgrest_event_del(pgrest_listener_epev, EV_READ))
+    {
+        return false;
+    }
+#endif
+
     return true;
 }
 
-static bool
-pgrest_listener_worker_init(void *data, void *base)
+#ifdef HAVE_EPOLLEXCLUSIVE
+static void
+pgrest_listener_exclusive_handler(evutil_socket_t fd, short events, void *arg)
 {
-    ListCell            *cell;
-    pgrest_listener_t   *listener;
+    int                  i;
+    int                  n;
     pgrest_connection_t *conn;
-    List                *listeners = data;
+    struct epoll_event   ee[PGREST_LISTENER_EPOLL_EVENTS];
 
-    /* for each listening socket */
-    foreach(cell, listeners) {
-        listener = lfirst(cell);
+    n = epoll_wait(fd, ee, PGREST_LISTENER_EPOLL_EVENTS, 0);
+
+    if (n == -1) {
+        if (errno != EINTR) {
+            ereport(LOG,
+                    (errmsg(PGREST_PACKAGE " " "worker %d epoll_wait() "
+                            "failed: %m", pgrest_worker_index)));
+        }
 
-        conn = pgrest_conn_get(listener->fd);
-        if (conn == NULL) {
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        conn = ee[i].data.ptr;
+        pgrest_acceptor_accept_handler(conn->fd, EV_READ, conn);
+    }
+}
+
+static bool
+pgrest_listener_exclusive_add(pgrest_connection_t *conn,
+                              struct event_base *base)
+{
+    struct epoll_event   ee;
+
+    if (pgrest_listener_epfd == -1) {
+        pgrest_listener_epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (pgrest_listener_epfd == -1) {
+            ereport(WARNING,
+                    (errmsg(PGREST_PACKAGE " " "worker %d epoll_create1() "
+                            "failed: %m", pgrest_worker_index)));
             return false;
         }
 
-        conn->type = listener->type;
-        conn->listener = listener;
+        pgrest_listener_epev = pgrest_event_new(base, pgrest_listener_epfd,
+                                        EV_READ | EV_PERSIST,
+                                        pgrest_listener_exclusive_handler,
+                                        NULL);
+        if (pgrest_listener_epev == NULL) {
+            return false;
+        }
 
-        listener->connection = conn;
-        if (pgrest_event_assign(conn->rev, base, 
-                                conn->fd, EV_READ | EV_PERSIST, 
-                                pgrest_acceptor_accept_handler, conn) < 0) 
-        {
+        pgrest_event_priority_set(pgrest_listener_epev, 0);
+
+        if (!pgrest_event_add(pgrest_listener_epev, EV_READ, 0)) {
             return false;
         }
+    }
 
-        pgrest_event_priority_set(conn->rev, 0);
-#ifdef HAVE_REUSEPORT
-        if (listener->reuseport) {
-            if (!pgrest_event_add(conn->rev, EV_READ, 0)) {
-                return false;
+    ee.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ee.data.ptr = conn;
+
+    if (epoll_ctl(pgrest_listener_epfd, EPOLL_CTL_ADD, conn->fd, &ee) == -1) {
+        ereport(WARNING,
+                (errmsg(PGREST_PACKAGE " " "worker %d epoll_ctl(EPOLL"
+                        "EXCLUSIVE) failed: %m", pgrest_worker_index)));
+        return false;
+    }
+
+    return true;
+}
+
+static void
+pgrest_listener_exclusive_del(pgrest_connection_t *conn)
+{
+    if (pgrest_listener_epfd != -1) {
+        (void) epoll_ctl(pgrest_listener_epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    }
+}
+
+static void
+pgrest_listener_exclusive_close(void)
+{
+    if (pgrest_listener_epev) {
+        (void) pgrest_event_del(pgrest_listener_epev, EV_READ);
+        pgrest_event_free(pgrest_listener_epev);
+        pgrest_listener_epev = NULL;
+    }
+
+    if (pgrest_listener_epfd != -1) {
+        closesocket(pgrest_listener_epfd);
+        pgrest_listener_epfd = -1;
+    }
+}
+#endif
+
+static bool 
+pgrest_listener_stat_data_init(pgrest_shm_seg_t *seg)
+{
+    pgrest_listener_stat = (pgrest_listener_stat_t *) 
+                                CACHELINEALIGN(seg->addr);
+
+    MemSet(pgrest_listener_stat, 0, sizeof(pgrest_listener_stat_t)
+                                    * PGREST_LISTENER_STAT_MAX
+                                    * pgrest_setting.worker_processes_max);
+    return true;
+}
+
+/* one row of PGREST_LISTENER_STAT_MAX slots per possible worker */
+static void
+pgrest_listener_stat_init(void)
+{
+    pgrest_shm_seg_t *seg;
+    size_t            size;
+
+    size = sizeof(pgrest_listener_stat_t) * PGREST_LISTENER_STAT_MAX
+           * pgrest_setting.worker_processes_max + PG_CACHE_LINE_SIZE;
+    seg = pgrest_shm_seg_add(PGREST_PACKAGE " " "listener stat", 
+                             size,
+                             false, 
+                             false);
+    if (seg == NULL) {
+        ereport(ERROR,
+                (errmsg(PGREST_PACKAGE " " "initialize listener stat "
+                        "failed")));
+    }
+
+    seg->init = pgrest_listener_stat_data_init;
+}
+
+/*
+ * Find the slot of the listener address in the row of this worker, or
+ * take the first free one. Slots are never released, so a reloaded or
+ * restarted worker carries on with the counters it had.
+ */
+static pgrest_listener_stat_t *
+pgrest_listener_stat_get(pgrest_listener_t *listener)
+{
+    pgrest_listener_stat_t  *stat;
+    int                      i;
+
+    if (pgrest_listener_stat == NULL) {
+        return &pgrest_listener_stat_local;
+    }
+
+    stat = &pgrest_listener_stat[pgrest_worker_index
+                                 * PGREST_LISTENER_STAT_MAX];
+
+    for (i = 0; i < PGREST_LISTENER_STAT_MAX; i++) {
+        if (stat[i].addr[0] == '\0') {
+            StrNCpy(stat[i].addr, listener->addr_text, sizeof(stat[i].addr));
+            return &stat[i];
+        }
+
+        if (strcmp(stat[i].addr, listener->addr_text) == 0) {
+            return &stat[i];
+        }
+    }
+
+    ereport(WARNING,
+            (errmsg(PGREST_PACKAGE " " "worker %d has no accept counters "
+                    "left for listener %s", pgrest_worker_index,
+                     listener->addr_text)));
+
+    return &pgrest_listener_stat_local;
+}
+
+/*
+ * pgrest_listener_stats()
+ *
+ * One row per listener of every worker: worker, listener address and the
+ * accept counters. The counters are written by their worker only and read
+ * without a lock.
+ */
+Datum
+pgrest_listener_stats(PG_FUNCTION_ARGS)
+{
+    int                          i, n;
+    pgrest_listener_stat_t      *stat;
+    TupleDesc                    tupdesc;
+    Tuplestorestate             *tupstore;
+    Datum                        values[6];
+    bool                         nulls[6];
+
+    tupstore = pgrest_shm_tuplestore(fcinfo, &tupdesc);
+
+    if (pgrest_listener_stat == NULL) {
+        return (Datum) 0;
+    }
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    for (i = 0; i < pgrest_setting.worker_processes_max; i++) {
+        stat = &pgrest_listener_stat[i * PGREST_LISTENER_STAT_MAX];
+
+        for (n = 0; n < PGREST_LISTENER_STAT_MAX; n++) {
+            if (stat[n].addr[0] == '\0') {
+                break;
             }
 
-            continue;
+            values[0] = Int32GetDatum(i);
+            values[1] = CStringGetTextDatum(stat[n].addr);
+            values[2] = Int64GetDatum(stat[n].wakeups);
+            values[3] = Int64GetDatum(stat[n].accepted);
+            values[4] = Int64GetDatum(stat[n].eagain);
+            values[5] = Int64GetDatum(stat[n].errors);
+
+            tuplestore_putvalues(tupstore, tupdesc, values, nulls);
         }
+    }
+
+    return (Datum) 0;
+}
+
+static bool
+pgrest_listener_enable(pgrest_listener_t *listener, struct event_base *base)
+{
+    pgrest_connection_t *conn;
+
+    conn = pgrest_conn_get(listener->fd);
+    if (conn == NULL) {
+        return false;
+    }
+
+    pgrest_conn_cold(conn)->type = listener->type;
+    pgrest_conn_cold(conn)->listener = listener;
+
+    listener->connection = conn;
+    listener->accept_batch = 1;
+    listener->stat = pgrest_listener_stat_get(listener);
+#ifdef HAVE_INCOMING_CPU
+    /* prefer connections whose rx queue is serviced by our cpu */
+    if (listener->worker == pgrest_worker_index
+        && pgrest_worker_cpu != -1
+        && setsockopt(listener->fd, SOL_SOCKET, SO_INCOMING_CPU,
+                      (const void *) &pgrest_worker_cpu, sizeof(int)) == -1)
+    {
+        ereport(WARNING,
+                (errmsg(PGREST_PACKAGE " " "setsockopt(SO_INCOMING_CPU, "
+                        "%d) for %s failed, ignored: %m",
+                         pgrest_worker_cpu, listener->addr_text)));
+    }
+#endif
+    if (pgrest_event_assign(conn->rev, base, 
+                            conn->fd, EV_READ | EV_PERSIST, 
+                            pgrest_acceptor_accept_handler, conn) < 0) 
+    {
+        return false;
+    }
+
+    pgrest_event_priority_set(conn->rev, 0);
+#ifdef HAVE_REUSEPORT
+    if (listener->reuseport) {
+        return pgrest_event_add(conn->rev, EV_READ, 0);
+    }
 #endif
-        if (pgrest_acceptor_use_mutex) {
+#ifdef HAVE_EPOLLEXCLUSIVE
+    if (pgrest_setting.acceptor_mode == PGREST_ACCEPT_MODE_EXCLUSIVE) {
+        return pgrest_listener_exclusive_add(conn, base);
+    }
+#endif
+    if (pgrest_acceptor_use_mutex) {
+        return true;
+    }
+
+    return pgrest_event_add(conn->rev, EV_READ, 0);
+}
+
+static bool
+pgrest_listener_worker_init(void *data, void *base)
+{
+    ListCell            *cell;
+    pgrest_listener_t   *listener;
+
+    /* for each listening socket */
+    foreach(cell, pgrest_listener_listeners) {
+        listener = lfirst(cell);
+
+        /* reuseport socket of another worker */
+        if (listener->worker != -1
+            && listener->worker != pgrest_worker_index)
+        {
             continue;
         }
 
-        if (!pgrest_event_add(conn->rev, EV_READ, 0)) {
+        if (!pgrest_listener_enable(listener, base)) {
             return false;
         }
     }
@@ -492,15 +831,184 @@ pgrest_listener_worker_init(void *data, void *base)
 static bool
 pgrest_listener_worker_exit(void *data, void *base)
 {
-    List       *listeners = data;
-
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d listener_exit",
                                pgrest_worker_index)));
+#if PGREST_DEBUG
+    pgrest_listener_info_print();
+#endif
 
-    pgrest_listener_close(listeners);
+#ifdef HAVE_EPOLLEXCLUSIVE
+    pgrest_listener_exclusive_close();
+#endif
+    pgrest_listener_close(pgrest_listener_listeners);
     return true;
 }
 
+/*
+ * Listeners are created into the current list, a reload builds its own
+ * list after swapping the current one out.
+ */
+List *
+pgrest_listener_swap(List *listeners)
+{
+    List *result = pgrest_listener_listeners;
+
+    pgrest_listener_listeners = listeners;
+
+    return result;
+}
+
+static pgrest_listener_t *
+pgrest_listener_find(pgrest_listener_t *listener)
+{
+    ListCell            *cell;
+    pgrest_listener_t   *old;
+
+    foreach(cell, pgrest_listener_listeners) {
+        old = lfirst(cell);
+
+        if (old->connection != NULL
+            && old->fd != (evutil_socket_t) -1
+            && pgrest_inet_cmp_sockaddr(old->sockaddr, old->socklen,
+                                        listener->sockaddr, listener->socklen,
+                                        true))
+        {
+            return old;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+pgrest_listener_adopt(pgrest_listener_t *listener, pgrest_listener_t *old)
+{
+    listener->fd = old->fd;
+    listener->worker = old->worker;
+    listener->connection = old->connection;
+    listener->bound = old->bound;
+    listener->listen = old->listen;
+    listener->nonblocking = old->nonblocking;
+#ifdef HAVE_REUSEPORT
+    listener->reuseport = old->reuseport;
+    listener->steer = old->steer;
+#endif
+    listener->accept_batch = old->accept_batch;
+    listener->stat = old->stat;
+
+    pgrest_conn_cold(old->connection)->listener = listener;
+
+    old->fd = (evutil_socket_t) -1;
+    old->connection = NULL;
+}
+
+static bool
+pgrest_listener_add(pgrest_listener_t *listener, struct event_base *base)
+{
+#ifdef HAVE_REUSEPORT
+    List   *listeners;
+    bool    result;
+
+    /*
+     * Other workers bind the same address, each gets its own socket. They
+     * join the group in the order the workers reload, and a restarted
+     * worker opens a new one, so the group is never steered.
+     */
+    listener->reuseport = 1;
+    listener->steer = 0;
+    listener->worker = pgrest_worker_index;
+
+    listeners = list_make1(listener);
+    result = pgrest_listener_open(listeners);
+    if (result) {
+        pgrest_listener_configure(listeners);
+        result = pgrest_listener_enable(listener, base);
+    }
+    list_free(listeners);
+
+    return result;
+#else
+    ereport(WARNING,
+            (errmsg(PGREST_PACKAGE " " "worker %d can not listen on new "
+                    "address %s without SO_REUSEPORT, restart required",
+                     pgrest_worker_index, listener->addr_text)));
+    return false;
+#endif
+}
+
+/*
+ * Switch to the listeners of a reloaded configuration. A socket whose
+ * address is still configured is handed over as is, so no connection is
+ * refused meanwhile. A removed address is shut down rather than just
+ * closed: the postmaster and the other workers share the socket, and it
+ * would otherwise keep queueing connections nobody accepts.
+ */
+void
+pgrest_listener_reload(List *listeners, void *base)
+{
+    ListCell            *cell;
+    pgrest_listener_t   *listener;
+    pgrest_listener_t   *old;
+    pgrest_connection_t *conn;
+
+    foreach(cell, listeners) {
+        listener = lfirst(cell);
+
+        old = pgrest_listener_find(listener);
+        if (old) {
+            pgrest_listener_adopt(listener, old);
+            continue;
+        }
+
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d add listener %s",
+                              pgrest_worker_index, listener->addr_text)));
+
+        if (!pgrest_listener_add(listener, base)) {
+            if (listener->connection) {
+                (void) pgrest_event_del(listener->connection->rev, EV_READ);
+                pgrest_conn_free(listener->connection);
+                listener->connection = NULL;
+            }
+
+            if (listener->fd != (evutil_socket_t) -1) {
+                closesocket(listener->fd);
+                listener->fd = (evutil_socket_t) -1;
+            }
+        }
+    }
+
+    foreach(cell, pgrest_listener_listeners) {
+        old = lfirst(cell);
+
+        if (old->fd == (evutil_socket_t) -1) {
+            continue;
+        }
+
+        conn = old->connection;
+
+        /* removed address of this worker, otherwise an idle copy */
+        if (conn) {
+            ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d remove "
+                                 "listener %s", pgrest_worker_index,
+                                  old->addr_text)));
+
+            (void) pgrest_event_del(conn->rev, EV_READ);
+#ifdef HAVE_EPOLLEXCLUSIVE
+            pgrest_listener_exclusive_del(conn);
+#endif
+            (void) shutdown(old->fd, SHUT_RDWR);
+            pgrest_conn_free(conn);
+            conn->fd = (evutil_socket_t) -1;
+            old->connection = NULL;
+        }
+
+        closesocket(old->fd);
+        old->fd = (evutil_socket_t) -1;
+    }
+
+    pgrest_listener_listeners = listeners;
+}
+
 static StringInfo
 pgrest_listener_info_format(List *listeners)
 {
@@ -520,6 +1028,8 @@ pgrest_listener_info_format(List *listeners)
             "!\tlistener addr:%s\n", listener->addr_text);
         appendStringInfo(result,
             "!\tlistener open:%d\n", listener->open);
+        appendStringInfo(result,
+            "!\tlistener worker:%d\n", listener->worker);
 #if (HAVE_REUSEPORT)
         appendStringInfo(result,
             "!\tlistener reuseport:%d\n", listener->reuseport);
@@ -559,7 +1069,25 @@ pgrest_listener_info_format(List *listeners)
         appendStringInfo(result,
             "!\tlistener fastopen:%d\n", listener->fastopen);
 #endif
+        appendStringInfo(result,
+            "!\tlistener accept_batch:%d\n", listener->accept_batch);
 
+        if (listener->stat == NULL) {
+            continue;
+        }
+
+        appendStringInfo(result,
+            "!\tlistener accept_wakeups:" UINT64_FORMAT "\n",
+            listener->stat->wakeups);
+        appendStringInfo(result,
+            "!\tlistener accepted:" UINT64_FORMAT "\n",
+            listener->stat->accepted);
+        appendStringInfo(result,
+            "!\tlistener accept_eagain:" UINT64_FORMAT "\n",
+            listener->stat->eagain);
+        appendStringInfo(result,
+            "!\tlistener accept_errors:" UINT64_FORMAT "\n",
+            listener->stat->errors);
     }
 
     return result;
@@ -596,17 +1124,22 @@ pgrest_listener_init(void)
                 (errmsg(PGREST_PACKAGE " " "could not create any listener")));
     }
 
+#ifdef HAVE_REUSEPORT
+    pgrest_listener_clone(pgrest_setting.worker_processes);
+#endif
+
     if (pgrest_listener_open(pgrest_listener_listeners) == false) {
         ereport(FATAL,
                 (errmsg(PGREST_PACKAGE " " "failed to open socket listener")));
     }
 
     pgrest_listener_configure(pgrest_listener_listeners);
+    pgrest_listener_stat_init();
 
     pgrest_worker_hook_add(pgrest_listener_worker_init, 
                            pgrest_listener_worker_exit, 
                            "listener", 
-                           pgrest_listener_listeners, 
+                           NULL, 
                            false);
 
     on_proc_exit(pgrest_listener_fini2, 0);
@@ -615,6 +1148,108 @@ pgrest_listener_init(void)
 #endif
 }
 
+bool
+pgrest_listener_reuseport(void)
+{
+#ifdef HAVE_REUSEPORT
+    ListCell            *cell;
+    pgrest_listener_t   *listener;
+
+    foreach(cell, pgrest_listener_listeners) {
+        listener = lfirst(cell);
+
+        if (listener->reuseport) {
+            return true;
+        }
+    }
+#endif
+
+    return false;
+}
+
+#if defined(HAVE_REUSEPORT) && defined(SO_ATTACH_REUSEPORT_CBPF)
+static void
+pgrest_listener_bpf(struct sock_filter *insn, unsigned short code, 
+                    unsigned char jt, unsigned char jf, uint32 k)
+{
+    insn->code = code;
+    insn->jt = jt;
+    insn->jf = jf;
+    insn->k = k;
+}
+#endif
+
+/*
+ * Steer new connections of every reuseport group to the given workers
+ * only. The attached classic BPF program picks one of them at random and
+ * returns it as the socket index, so only the groups cloned at startup,
+ * whose socket order follows the worker order, are steered; the others
+ * keep the plain SO_REUSEPORT hash. The program is shared by the whole
+ * group so only the sockets owned by this worker are used to attach it.
+ */
+bool
+pgrest_listener_steer(int *workers, int nworkers)
+{
+#if defined(HAVE_REUSEPORT) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    int                  i;
+    int                  n;
+    ListCell            *cell;
+    pgrest_listener_t   *listener;
+    struct sock_fprog    prog;
+    struct sock_filter   code[3 + 2 * PGREST_MAX_WORKERS];
+
+    if (nworkers <= 0 || nworkers > PGREST_MAX_WORKERS) {
+        return false;
+    }
+
+    n = 0;
+
+    /* A = random() % nworkers */
+    pgrest_listener_bpf(&code[n++], BPF_LD | BPF_W | BPF_ABS, 0, 0,
+                        SKF_AD_OFF + SKF_AD_RANDOM);
+    pgrest_listener_bpf(&code[n++], BPF_ALU | BPF_MOD | BPF_K, 0, 0,
+                        nworkers);
+
+    /* return workers[A] */
+    for (i = 0; i < nworkers; i++) {
+        pgrest_listener_bpf(&code[n++], BPF_JMP | BPF_JEQ | BPF_K, 0, 1, i);
+        pgrest_listener_bpf(&code[n++], BPF_RET | BPF_K, 0, 0, workers[i]);
+    }
+
+    pgrest_listener_bpf(&code[n++], BPF_RET | BPF_K, 0, 0, workers[0]);
+
+    prog.len = n;
+    prog.filter = code;
+
+    foreach(cell, pgrest_listener_listeners) {
+        listener = lfirst(cell);
+
+        if (!listener->reuseport
+            || !listener->steer
+            || listener->worker != pgrest_worker_index
+            || listener->fd == (evutil_socket_t) -1)
+        {
+            continue;
+        }
+
+        if (setsockopt(listener->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                       (const void *) &prog, sizeof(prog)) == -1)
+        {
+            ereport(LOG,
+                    (errcode_for_socket_access(),
+                     errmsg(PGREST_PACKAGE " " "setsockopt("
+                            "SO_ATTACH_REUSEPORT_CBPF) for %s failed: %m",
+                             listener->addr_text)));
+            return false;
+        }
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 void
 pgrest_listener_fini(void)
 {
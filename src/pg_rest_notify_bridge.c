@@ -0,0 +1,307 @@
+/* -------------------------------------------------------------------------
+ *
+ * pq_rest_notify_bridge.c
+ *   LISTEN/NOTIFY bridge
+ *
+ *
+ *
+ * Copyright (C) 2014-2015, Robert Mu <dbx_c@hotmail.com>
+ *
+ *  src/pg_rest_notify_bridge.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#include "pg_rest_http_push_stream.h"
+
+/* the worker holding the connection */
+#define PGREST_NOTIFY_BRIDGE_WORKER   0
+
+/*
+ * A single libpq connection LISTENs on the configured channels, its
+ * notifications are published to the push stream channels of the same
+ * names. It is driven by the event loop of the worker like a client
+ * connection and comes back after notify_reconnect_delay when lost.
+ */
+typedef struct {
+    struct event_base          *base;
+    PGconn                     *conn;
+    /* on the socket of conn, which may change while connecting */
+    struct event               *ev;
+    struct event               *timer;
+    /* "LISTEN a;LISTEN b;" */
+    char                       *listen;
+    bool                        connecting;
+} pgrest_notify_bridge_t;
+
+static pgrest_notify_bridge_t   pgrest_notify_bridge;
+
+static void pgrest_notify_bridge_handler(evutil_socket_t fd, short events,
+                                         void *arg);
+
+static void
+pgrest_notify_bridge_close(pgrest_notify_bridge_t *bridge)
+{
+    if (bridge->ev) {
+        (void) pgrest_event_del(bridge->ev, EV_READ | EV_WRITE);
+        pgrest_event_free(bridge->ev);
+        bridge->ev = NULL;
+    }
+
+    if (bridge->conn) {
+        PQfinish(bridge->conn);
+        bridge->conn = NULL;
+    }
+}
+
+/* drop the connection and try again later */
+static void
+pgrest_notify_bridge_reset(pgrest_notify_bridge_t *bridge)
+{
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "notify bridge connection "
+                         "failed: %s", bridge->conn
+                                       ? PQerrorMessage(bridge->conn)
+                                       : "out of memory")));
+
+    pgrest_notify_bridge_close(bridge);
+
+    (void) pgrest_event_add(bridge->timer, EV_TIMEOUT,
+                            pgrest_setting.notify_reconnect_delay);
+}
+
+static bool
+pgrest_notify_bridge_wait(pgrest_notify_bridge_t *bridge, short events)
+{
+    if (pgrest_event_assign(bridge->ev, bridge->base, PQsocket(bridge->conn),
+                            events, pgrest_notify_bridge_handler,
+                            bridge) < 0)
+    {
+        return false;
+    }
+
+    return pgrest_event_add(bridge->ev, events, 0);
+}
+
+static void
+pgrest_notify_bridge_connect(evutil_socket_t fd, short events, void *arg)
+{
+    pgrest_notify_bridge_t  *bridge = arg;
+
+    bridge->conn = PQconnectStart(pgrest_setting.notify_conninfo);
+
+    if (bridge->conn == NULL || PQstatus(bridge->conn) == CONNECTION_BAD
+        || PQsetnonblocking(bridge->conn, 1) == -1)
+    {
+        pgrest_notify_bridge_reset(bridge);
+        return;
+    }
+
+    bridge->connecting = true;
+
+    /* PQconnectPoll() is first called once the socket is writable */
+    bridge->ev = pgrest_event_new(bridge->base, PQsocket(bridge->conn),
+                                  EV_WRITE, pgrest_notify_bridge_handler,
+                                  bridge);
+    if (bridge->ev == NULL || !pgrest_event_add(bridge->ev, EV_WRITE, 0)) {
+        pgrest_notify_bridge_reset(bridge);
+    }
+}
+
+/*
+ * Returns the number of notifications published. The channel name is
+ * percent-encoded like the change feed channels, so that subscribers
+ * can name a channel whatever the characters of the notify channel.
+ */
+static int
+pgrest_notify_bridge_publish(pgrest_notify_bridge_t *bridge,
+                             uint64                 *workers)
+{
+    int              n = 0;
+    PGnotify        *notify;
+    pgrest_string_t  id;
+    StringInfoData   buf;
+
+    initStringInfo(&buf);
+
+    while ((notify = PQnotifies(bridge->conn)) != NULL) {
+        resetStringInfo(&buf);
+        pgrest_http_push_stream_id_append(&buf, notify->relname);
+
+        id.base = (unsigned char *) buf.data;
+        id.len = buf.len;
+
+        if (id.len > PGREST_HTTP_PUSH_STREAM_ID_MAX) {
+            debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "notify bridge "
+                                      "skip channel \"%s\", longer than "
+                                      "%d bytes encoded", notify->relname,
+                                       PGREST_HTTP_PUSH_STREAM_ID_MAX)));
+
+        } else if (pgrest_http_push_stream_publish(&id,
+                                            (unsigned char *) notify->extra,
+                                            strlen(notify->extra),
+                                            NULL,
+                                            pgrest_setting.notify_max_messages,
+                                            workers, NULL) == PGREST_OK)
+        {
+            n++;
+        }
+
+        PQfreemem(notify);
+    }
+
+    pfree(buf.data);
+
+    return n;
+}
+
+static void
+pgrest_notify_bridge_handler(evutil_socket_t fd, short events, void *arg)
+{
+    int                      rc;
+    PGresult                *res;
+    uint64                   workers[PGREST_HTTP_PUSH_STREAM_WORDS];
+    pgrest_notify_bridge_t  *bridge = arg;
+
+    if (bridge->connecting) {
+        switch (PQconnectPoll(bridge->conn)) {
+        case PGRES_POLLING_READING:
+            if (!pgrest_notify_bridge_wait(bridge, EV_READ)) {
+                pgrest_notify_bridge_reset(bridge);
+            }
+            return;
+        case PGRES_POLLING_WRITING:
+            if (!pgrest_notify_bridge_wait(bridge, EV_WRITE)) {
+                pgrest_notify_bridge_reset(bridge);
+            }
+            return;
+        case PGRES_POLLING_OK:
+            break;
+        default:
+            pgrest_notify_bridge_reset(bridge);
+            return;
+        }
+
+        bridge->connecting = false;
+
+        if (!PQsendQuery(bridge->conn, bridge->listen)) {
+            pgrest_notify_bridge_reset(bridge);
+            return;
+        }
+
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d notify bridge "
+                             "connected", pgrest_worker_index)));
+    }
+
+    /* what PQsendQuery() could not send at once */
+    if ((rc = PQflush(bridge->conn)) == -1
+        || !PQconsumeInput(bridge->conn))
+    {
+        pgrest_notify_bridge_reset(bridge);
+        return;
+    }
+
+    while (!PQisBusy(bridge->conn)
+           && (res = PQgetResult(bridge->conn)) != NULL)
+    {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            ereport(LOG, (errmsg(PGREST_PACKAGE " " "notify bridge LISTEN "
+                                 "failed: %s", PQresultErrorMessage(res))));
+        }
+
+        PQclear(res);
+    }
+
+    /* all notifications of this wakeup, then a single check per worker */
+    MemSet(workers, 0, sizeof(workers));
+
+    if (pgrest_notify_bridge_publish(bridge, workers)) {
+        pgrest_http_push_stream_notify(workers,
+                                       PGREST_IPC_CMD_DB_PUSH_CHECK);
+    }
+
+    if (!pgrest_notify_bridge_wait(bridge,
+                                   rc == 1 ? EV_READ | EV_WRITE : EV_READ))
+    {
+        pgrest_notify_bridge_reset(bridge);
+    }
+}
+
+static bool
+pgrest_notify_bridge_startup(void *data, void *base)
+{
+    pgrest_notify_bridge_t  *bridge = &pgrest_notify_bridge;
+
+    if (pgrest_worker_index != PGREST_NOTIFY_BRIDGE_WORKER) {
+        return true;
+    }
+
+    bridge->base = base;
+    bridge->timer = pgrest_event_new(base, -1, 0,
+                                     pgrest_notify_bridge_connect, bridge);
+    if (bridge->timer == NULL) {
+        return false;
+    }
+
+    pgrest_notify_bridge_connect(-1, 0, bridge);
+
+    return true;
+}
+
+static bool
+pgrest_notify_bridge_shutdown(void *data, void *base)
+{
+    pgrest_notify_bridge_t  *bridge = &pgrest_notify_bridge;
+
+    if (bridge->timer == NULL) {
+        return true;
+    }
+
+    pgrest_notify_bridge_close(bridge);
+
+    (void) pgrest_event_del(bridge->timer, EV_TIMEOUT);
+    pgrest_event_free(bridge->timer);
+    bridge->timer = NULL;
+
+    return true;
+}
+
+void
+pgrest_notify_bridge_init(void)
+{
+    List            *names;
+    ListCell        *cell;
+    StringInfoData   buf;
+
+    if (pgrest_setting.notify_conninfo[0] == '\0') {
+        return;
+    }
+
+    /* LISTEN takes identifiers, unquoted ones are folded to lower case */
+    if (!SplitIdentifierString(pstrdup(pgrest_setting.notify_channels), ',',
+                               &names) || names == NIL)
+    {
+        ereport(LOG, (errmsg(PGREST_PACKAGE " " "invalid value for directive "
+                             "\"notify_channels\": \"%s\", notify bridge "
+                             "disabled", pgrest_setting.notify_channels)));
+        return;
+    }
+
+    initStringInfo(&buf);
+
+    foreach(cell, names) {
+        appendStringInfo(&buf, "LISTEN %s;",
+                         quote_identifier((char *) lfirst(cell)));
+    }
+
+    pgrest_notify_bridge.listen = buf.data;
+
+    pgrest_worker_hook_add(pgrest_notify_bridge_startup,
+                           pgrest_notify_bridge_shutdown,
+                           "notify bridge",
+                           NULL,
+                           false);
+}
@@ -15,6 +15,8 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
+#define PGREST_SHM_NAME_LEN  64
+
 static shmem_startup_hook_type   pgrest_shm_pre_hook = NULL;
 static List                     *pgrest_shm_segments = NIL;
 #if PGSQL_VERSION >= 96
@@ -22,6 +24,10 @@ static int                       pgrest_shm_lock_index = 0;
 #endif 
 
 static void pgrest_shm_shutdown(int code, Datum arg);
+static void pgrest_shm_dyn_cleanup(int code, Datum arg);
+
+PG_FUNCTION_INFO_V1(pgrest_slab_stats);
+PG_FUNCTION_INFO_V1(pgrest_slab_pages);
 
 static size_t
 pgrest_shm_mem_size(void)
@@ -33,7 +39,13 @@ pgrest_shm_mem_size(void)
     /* for each shared memory segment */
     foreach(cell, pgrest_shm_segments) {
         seg = lfirst(cell);
-        result += seg->size;
+
+        /* dynamic segments keep only their state in the main segment */
+        if (seg->dynamic) {
+            result += sizeof(pgrest_shm_dyn_t);
+        } else {
+            result += seg->size;
+        }
     }
 
     return result;
@@ -68,6 +80,10 @@ pgrest_shm_lock_count(void)
         if (seg->lock) {
             result++;
         }
+
+        if (seg->dynamic && seg->pool) {
+            result++;
+        }
     }
 
     return result;
@@ -115,6 +131,352 @@ pgrest_shm_seg_add(char *name, size_t size, bool lock, bool pool)
     return seg;
 }
 
+/*
+ * Add a segment living outside the main shared memory, so that it can be
+ * resized without a restart. max bytes of address space are reserved in
+ * the postmaster and inherited by the workers, every generation of the
+ * segment is mapped there and so shows up at the same address in all
+ * processes, like the main segment.
+ */
+pgrest_shm_seg_t *
+pgrest_shm_seg_add_dynamic(char *name, size_t size, size_t max, bool pool)
+{
+    pgrest_shm_seg_t   *seg;
+
+    size = TYPEALIGN(pgrest_pagesize, size);
+    max = TYPEALIGN(pgrest_pagesize, Max(size, max));
+
+    seg = pgrest_shm_seg_add(name, size, true, false);
+    if (seg == NULL) {
+        return NULL;
+    }
+
+    seg->dynamic = 1;
+    seg->pool = pool;
+    seg->max = max;
+
+    return seg;
+}
+
+static void
+pgrest_shm_pool_init(pgrest_shm_seg_t *seg)
+{
+    pgrest_slab_pool_t *pool;
+
+    pool = (pgrest_slab_pool_t *) seg->addr;
+    pool->end = seg->addr + seg->size;
+    pool->min_shift = 3;
+    pool->addr = seg->addr;
+
+    pgrest_slab_init(pool);
+}
+
+static void
+pgrest_shm_dyn_name(pgrest_shm_seg_t *seg, uint32 generation, char *name)
+{
+    snprintf(name, PGREST_SHM_NAME_LEN, "/" PGREST_PACKAGE ".%d.%d.%u",
+             (int) PostmasterPid, seg->dyn->id, generation);
+}
+
+/* turn the address range back into an inaccessible reservation */
+static bool
+pgrest_shm_dyn_reserve(char *addr, size_t size)
+{
+    if (mmap(addr, size, PROT_NONE,
+             MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE|MAP_FIXED,
+             -1, 0) == MAP_FAILED)
+    {
+        ereport(LOG,
+                (errmsg(PGREST_PACKAGE " " "mmap(%zu) reserve failed: %m",
+                        size)));
+        return false;
+    }
+
+    return true;
+}
+
+static void
+pgrest_shm_dyn_startup(pgrest_shm_seg_t *seg, int id)
+{
+    pgrest_shm_dyn_t   *dyn;
+    void               *addr;
+    bool                found;
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+    dyn = ShmemInitStruct(seg->name, sizeof(pgrest_shm_dyn_t), &found);
+
+    LWLockRelease(AddinShmemInitLock);
+
+    Assert(!found);
+
+    dyn->lock = pgrest_shm_get_lock();
+    if (seg->pool) {
+        dyn->pool_lock = pgrest_shm_get_lock();
+    }
+
+    dyn->id = id;
+    dyn->generation = 0;
+    dyn->size = seg->size;
+
+    seg->dyn = dyn;
+    seg->generation = 0;
+
+    /* kept across a crash restart, the children inherit it */
+    if (seg->addr == NULL) {
+        addr = mmap(NULL, seg->max, PROT_NONE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) {
+            ereport(ERROR,
+                    (errmsg(PGREST_PACKAGE " " "reserve %zu bytes for shared "
+                            "memory segment \"%s\" failed: %m",
+                            seg->max, seg->name)));
+        }
+
+        seg->addr = addr;
+    }
+}
+
+/*
+ * Map generation of a dynamic segment at its reserved address, creating
+ * the shared memory object first if asked to. Called with dyn->lock.
+ */
+static bool
+pgrest_shm_dyn_map(pgrest_shm_seg_t *seg, size_t size, uint32 generation,
+                   bool create)
+{
+    char                name[PGREST_SHM_NAME_LEN];
+    const char         *prompt;
+    void               *addr;
+    int                 fd;
+    int                 rc;
+    int                 save_errno;
+
+    pgrest_shm_dyn_name(seg, generation, name);
+
+    fd = shm_open(name, create ? O_RDWR|O_CREAT|O_EXCL : O_RDWR, 0600);
+    if (fd == -1) {
+        prompt = "shm_open";
+        goto fail;
+    }
+
+    /* allocate now rather than take a SIGBUS on first touch */
+    if (create && (rc = posix_fallocate(fd, 0, size)) != 0) {
+        errno = rc;
+        prompt = "posix_fallocate";
+        close(fd);
+        goto fail;
+    }
+
+    /* the previous generation is gone from here on */
+    if (seg->generation && seg->pool) {
+        pgrest_slab_cache_discard((pgrest_slab_pool_t *) seg->addr);
+    }
+
+    addr = mmap(seg->addr, size, PROT_READ|PROT_WRITE,
+                MAP_SHARED|MAP_FIXED, fd, 0);
+    save_errno = errno;
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        (void) pgrest_shm_dyn_reserve(seg->addr, seg->max);
+        seg->generation = 0;
+        errno = save_errno;
+        prompt = "mmap";
+        goto fail;
+    }
+
+    if (seg->generation && seg->size > size) {
+        (void) pgrest_shm_dyn_reserve(seg->addr + size, seg->size - size);
+    }
+
+    seg->generation = generation;
+    seg->size = size;
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d mapped shared "
+                              "memory segment \"%s\" generation %u, %zu "
+                              "bytes", pgrest_worker_index, seg->name,
+                               generation, size)));
+    return true;
+
+fail:
+    ereport(LOG,
+            (errmsg(PGREST_PACKAGE " " "%s \"%s\" for shared memory segment "
+                    "\"%s\" failed: %m", prompt, name, seg->name)));
+
+    if (create && fd != -1) {
+        (void) shm_unlink(name);
+    }
+
+    return false;
+}
+
+/*
+ * Create the next generation of a dynamic segment with size bytes and
+ * publish it. Called with dyn->lock.
+ */
+static bool
+pgrest_shm_dyn_create(pgrest_shm_seg_t *seg, size_t size)
+{
+    char                name[PGREST_SHM_NAME_LEN];
+    pgrest_shm_dyn_t   *dyn = seg->dyn;
+    pgrest_slab_pool_t *pool;
+    uint32              generation = dyn->generation + 1;
+
+    if (!pgrest_shm_dyn_map(seg, size, generation, true)) {
+        return false;
+    }
+
+    if (seg->pool) {
+        pool = (pgrest_slab_pool_t *) seg->addr;
+        pool->lock = dyn->pool_lock;
+        pgrest_shm_pool_init(seg);
+    }
+
+    if (seg->init && seg->init(seg) == false) {
+        ereport(LOG,
+                (errmsg(PGREST_PACKAGE " " "initialize shared memory "
+                        "segment \"%s\" failed", seg->name)));
+
+        pgrest_shm_dyn_name(seg, generation, name);
+        (void) shm_unlink(name);
+        (void) pgrest_shm_dyn_reserve(seg->addr, seg->max);
+        seg->generation = 0;
+
+        return false;
+    }
+
+    /* the previous generation goes away with its last mapping */
+    if (dyn->generation) {
+        pgrest_shm_dyn_name(seg, dyn->generation, name);
+        (void) shm_unlink(name);
+    }
+
+    dyn->generation = generation;
+    dyn->size = size;
+
+    return true;
+}
+
+/*
+ * Map the current generation of a dynamic segment, the first worker
+ * creates it. seg->generation tells the owner whether it changed.
+ */
+bool
+pgrest_shm_seg_attach(pgrest_shm_seg_t *seg)
+{
+    pgrest_shm_dyn_t   *dyn = seg->dyn;
+    bool                result = true;
+
+    Assert(seg->dynamic);
+
+    LWLockAcquire(dyn->lock, LW_EXCLUSIVE);
+
+    if (dyn->generation == 0) {
+        result = pgrest_shm_dyn_create(seg, dyn->size);
+
+    } else if (seg->generation != dyn->generation) {
+        result = pgrest_shm_dyn_map(seg, dyn->size, dyn->generation, false);
+    }
+
+    LWLockRelease(dyn->lock);
+
+    return result;
+}
+
+/*
+ * Switch a dynamic segment to size bytes, normally from a reload hook.
+ * The first worker asking for a new size creates a new, empty generation
+ * and the others map it when they ask for the same size. Workers that
+ * did not reload yet keep using the previous generation until then, so
+ * only caches that may start over should live in a dynamic segment.
+ */
+bool
+pgrest_shm_seg_resize(pgrest_shm_seg_t *seg, size_t size)
+{
+    pgrest_shm_dyn_t   *dyn = seg->dyn;
+    bool                result = true;
+
+    Assert(seg->dynamic);
+
+    size = TYPEALIGN(pgrest_pagesize, size);
+
+    if (size > seg->max) {
+        ereport(LOG,
+                (errmsg(PGREST_PACKAGE " " "size %zu of shared memory "
+                        "segment \"%s\" exceeds reserved size %zu",
+                        size, seg->name, seg->max)));
+        return false;
+    }
+
+    LWLockAcquire(dyn->lock, LW_EXCLUSIVE);
+
+    if (dyn->generation && dyn->size == size) {
+        if (seg->generation != dyn->generation) {
+            result = pgrest_shm_dyn_map(seg, size, dyn->generation, false);
+        }
+
+    } else {
+        result = pgrest_shm_dyn_create(seg, size);
+
+        /* fall back to the current generation */
+        if (!result && dyn->generation && seg->generation == 0) {
+            (void) pgrest_shm_dyn_map(seg, dyn->size, dyn->generation,
+                                      false);
+        }
+    }
+
+    LWLockRelease(dyn->lock);
+
+    return result;
+}
+
+static void
+pgrest_shm_dyn_cleanup(int code, Datum arg)
+{
+    char                name[PGREST_SHM_NAME_LEN];
+    ListCell           *cell;
+    pgrest_shm_seg_t   *seg;
+
+    /* for each shared memory segment */
+    foreach(cell, pgrest_shm_segments) {
+        seg = lfirst(cell);
+
+        if (seg->dynamic && seg->dyn && seg->dyn->generation) {
+            pgrest_shm_dyn_name(seg, seg->dyn->generation, name);
+            (void) shm_unlink(name);
+        }
+    }
+}
+
+/* another process ran short of a pool, see pgrest_slab_alloc() */
+static void
+pgrest_shm_slab_reclaim(int src_worker, void *data, size_t len)
+{
+    pgrest_slab_cache_reclaim();
+}
+
+static bool
+pgrest_shm_worker_init(void *data, void *base)
+{
+    ListCell           *cell;
+    pgrest_shm_seg_t   *seg;
+
+    pgrest_ipc_setup_msg_handler(PGREST_IPC_CMD_SLAB_RECLAIM,
+                                 pgrest_shm_slab_reclaim);
+
+    /* for each shared memory segment */
+    foreach(cell, pgrest_shm_segments) {
+        seg = lfirst(cell);
+
+        if (seg->dynamic && !pgrest_shm_seg_attach(seg)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static void
 pgrest_shm_startup(void)
 {
@@ -123,6 +485,7 @@ pgrest_shm_startup(void)
     bool                found;
     void               *addr;
     pgrest_slab_pool_t *pool;
+    int                 id = 0;
 
     if (pgrest_shm_pre_hook) {
         pgrest_shm_pre_hook();
@@ -132,6 +495,12 @@ pgrest_shm_startup(void)
     foreach(cell, pgrest_shm_segments) {
         seg = lfirst(cell);
 
+        /* mapped by the workers */
+        if (seg->dynamic) {
+            pgrest_shm_dyn_startup(seg, id++);
+            continue;
+        }
+
         LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
 
         addr = ShmemInitStruct(seg->name, seg->size, &found);
@@ -143,20 +512,12 @@ pgrest_shm_startup(void)
         seg->addr = addr;
         if (seg->pool) {
             pool = (pgrest_slab_pool_t *) seg->addr;
-            pool->end = seg->addr + seg->size;
-            pool->min_shift = 3;
-            pool->addr = seg->addr;
 
             if (seg->lock) {
-#if PGSQL_VERSION >= 96
-                pool->lock = &((GetNamedLWLockTranche(PGREST_PACKAGE))
-                                [pgrest_shm_lock_index++].lock);
-#else
-                pool->lock = LWLockAssign();
-#endif
+                pool->lock = pgrest_shm_get_lock();
             }
 
-            pgrest_slab_init(pool);
+            pgrest_shm_pool_init(seg);
         }
 
         if (seg->init) {
@@ -171,8 +532,10 @@ pgrest_shm_startup(void)
      * If we're in the postmaster (or a standalone backend...), set up a
      * shmem exit hook to do other work
      */
-    if (!IsUnderPostmaster)
+    if (!IsUnderPostmaster) {
         on_shmem_exit(pgrest_shm_shutdown, (Datum) 0);
+        on_shmem_exit(pgrest_shm_dyn_cleanup, (Datum) 0);
+    }
 
 #if (PGREST_DEBUG)
     pgrest_shm_info_print();
@@ -224,6 +587,8 @@ pgrest_shm_info_format(List *shm_segments)
             "!\tsegment lock %d\n", seg->lock);
         appendStringInfo(result,
             "!\tsegment pool %d\n", seg->pool);
+        appendStringInfo(result,
+            "!\tsegment dynamic %d\n", seg->dynamic);
     }
 
     return result;
@@ -246,6 +611,193 @@ pgrest_shm_info_print(void)
     pfree(buffer);
 }
 
+/*
+ * Set up a materialized result set for the stat functions, the caller
+ * fills the returned tuplestore.
+ */
+Tuplestorestate *
+pgrest_shm_tuplestore(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+    ReturnSetInfo      *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    Tuplestorestate    *tupstore;
+    MemoryContext       oldctx;
+
+    if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo)
+        || !(rsinfo->allowedModes & SFRM_Materialize)) {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg(PGREST_PACKAGE " " "set-valued function called "
+                        "in context that cannot accept a set")));
+    }
+
+    if (get_call_result_type(fcinfo, NULL, tupdesc) != TYPEFUNC_COMPOSITE) {
+        ereport(ERROR,
+                (errmsg(PGREST_PACKAGE " " "return type must be "
+                        "a row type")));
+    }
+
+    oldctx = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+    *tupdesc = CreateTupleDescCopy(*tupdesc);
+    tupstore = tuplestore_begin_heap(true, false, work_mem);
+
+    rsinfo->returnMode = SFRM_Materialize;
+    rsinfo->setResult = tupstore;
+    rsinfo->setDesc = *tupdesc;
+
+    MemoryContextSwitchTo(oldctx);
+
+    return tupstore;
+}
+
+/*
+ * Pool of a segment for the stat functions. A backend maps the current
+ * generation of a dynamic segment itself but never creates one, the
+ * mapping stays until the generation changes.
+ */
+static pgrest_slab_pool_t *
+pgrest_shm_stat_pool(pgrest_shm_seg_t *seg)
+{
+    pgrest_shm_dyn_t   *dyn = seg->dyn;
+    bool                mapped = true;
+
+    if (!seg->pool || seg->addr == NULL) {
+        return NULL;
+    }
+
+    if (seg->dynamic) {
+        LWLockAcquire(dyn->lock, LW_SHARED);
+
+        if (dyn->generation == 0) {
+            mapped = false;
+
+        } else if (seg->generation != dyn->generation) {
+            mapped = pgrest_shm_dyn_map(seg, dyn->size, dyn->generation,
+                                        false);
+        }
+
+        LWLockRelease(dyn->lock);
+    }
+
+    return mapped ? (pgrest_slab_pool_t *) seg->addr : NULL;
+}
+
+/*
+ * pgrest_slab_stats()
+ *
+ * One row per slot of every slab pool segment: segment, slot_size,
+ * total, used, cached, reqs, frees, fails. cached are the free chunks
+ * held by the processes, used does not take them in.
+ */
+Datum
+pgrest_slab_stats(PG_FUNCTION_ARGS)
+{
+    ListCell           *cell;
+    pgrest_shm_seg_t   *seg;
+    pgrest_slab_pool_t *pool;
+    pgrest_slab_stat_t *stats;
+    pgrest_slab_stat_t  page_stat;
+    pgrest_slab_info_t  info;
+    pgrest_uint_t       i, n;
+    TupleDesc           tupdesc;
+    Tuplestorestate    *tupstore;
+    Datum               values[8];
+    bool                nulls[8];
+
+    tupstore = pgrest_shm_tuplestore(fcinfo, &tupdesc);
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    /* for each shared memory segment */
+    foreach(cell, pgrest_shm_segments) {
+        seg = lfirst(cell);
+
+        if ((pool = pgrest_shm_stat_pool(seg)) == NULL) {
+            continue;
+        }
+
+        n = pgrest_slab_nslots(pool);
+        stats = palloc(n * sizeof(pgrest_slab_stat_t));
+
+        pgrest_slab_stat_get(pool, stats, &page_stat, &info);
+
+        for (i = 0; i < n; i++) {
+            values[0] = CStringGetTextDatum(seg->name);
+            values[1] = Int64GetDatum(pgrest_slab_slot_size(pool, i));
+            values[2] = Int64GetDatum(stats[i].total);
+            values[3] = Int64GetDatum(stats[i].used - stats[i].cached);
+            values[4] = Int64GetDatum(stats[i].cached);
+            values[5] = Int64GetDatum(stats[i].reqs);
+            values[6] = Int64GetDatum(stats[i].frees);
+            values[7] = Int64GetDatum(stats[i].fails);
+
+            tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+        }
+
+        pfree(stats);
+    }
+
+    return (Datum) 0;
+}
+
+/*
+ * pgrest_slab_pages()
+ *
+ * One row per slab pool segment: segment, pages, free_pages, free_runs,
+ * largest_free_run. Many short runs next to plenty of free pages means
+ * the pool is fragmented. Allocations of more than half a page take
+ * whole pages: large_pages they hold, large_used of them are live, and
+ * their large_reqs, large_frees and large_fails.
+ */
+Datum
+pgrest_slab_pages(PG_FUNCTION_ARGS)
+{
+    ListCell           *cell;
+    pgrest_shm_seg_t   *seg;
+    pgrest_slab_pool_t *pool;
+    pgrest_slab_stat_t *stats;
+    pgrest_slab_stat_t  page_stat;
+    pgrest_slab_info_t  info;
+    TupleDesc           tupdesc;
+    Tuplestorestate    *tupstore;
+    Datum               values[10];
+    bool                nulls[10];
+
+    tupstore = pgrest_shm_tuplestore(fcinfo, &tupdesc);
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    /* for each shared memory segment */
+    foreach(cell, pgrest_shm_segments) {
+        seg = lfirst(cell);
+
+        if ((pool = pgrest_shm_stat_pool(seg)) == NULL) {
+            continue;
+        }
+
+        stats = palloc(pgrest_slab_nslots(pool) * sizeof(pgrest_slab_stat_t));
+
+        pgrest_slab_stat_get(pool, stats, &page_stat, &info);
+
+        values[0] = CStringGetTextDatum(seg->name);
+        values[1] = Int64GetDatum(info.pages);
+        values[2] = Int64GetDatum(info.free);
+        values[3] = Int64GetDatum(info.runs);
+        values[4] = Int64GetDatum(info.largest);
+        values[5] = Int64GetDatum(page_stat.total);
+        values[6] = Int64GetDatum(page_stat.used);
+        values[7] = Int64GetDatum(page_stat.reqs);
+        values[8] = Int64GetDatum(page_stat.frees);
+        values[9] = Int64GetDatum(page_stat.fails);
+
+        tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+        pfree(stats);
+    }
+
+    return (Datum) 0;
+}
+
 void
 pgrest_shm_init(void)
 {
@@ -258,4 +810,82 @@ pgrest_shm_init(void)
     /* Install hooks */
     pgrest_shm_pre_hook = shmem_startup_hook;
     shmem_startup_hook = pgrest_shm_startup;
+
+    /* map the dynamic segments before anything uses them */
+    pgrest_worker_hook_add(pgrest_shm_worker_init,
+                           NULL,
+                           "shm",
+                           NULL,
+                           true);
+}
+
+/*
+ * Append the counters of pgrest_slab_pages() and pgrest_slab_stats() to
+ * buf as a json object, one entry per slab pool segment, for the http
+ * slab_stats location.
+ */
+void
+pgrest_shm_slab_stat_json(StringInfo buf)
+{
+    ListCell           *cell;
+    pgrest_shm_seg_t   *seg;
+    pgrest_slab_pool_t *pool;
+    pgrest_slab_stat_t *stats;
+    pgrest_slab_stat_t  page_stat;
+    pgrest_slab_info_t  info;
+    pgrest_uint_t       i, n;
+    bool                first = true;
+
+    appendStringInfoString(buf, "{\"segments\": [");
+
+    /* for each shared memory segment */
+    foreach(cell, pgrest_shm_segments) {
+        seg = lfirst(cell);
+
+        if ((pool = pgrest_shm_stat_pool(seg)) == NULL) {
+            continue;
+        }
+
+        n = pgrest_slab_nslots(pool);
+        stats = palloc(n * sizeof(pgrest_slab_stat_t));
+
+        pgrest_slab_stat_get(pool, stats, &page_stat, &info);
+
+        if (!first) {
+            appendStringInfoString(buf, ", ");
+        }
+
+        first = false;
+
+        appendStringInfoString(buf, "{\"segment\": ");
+        escape_json(buf, seg->name);
+
+        appendStringInfo(buf, ", \"pages\": %lu, \"free_pages\": %lu, "
+                         "\"free_runs\": %lu, \"largest_free_run\": %lu, "
+                         "\"large_pages\": %lu, \"large_used\": %lu, "
+                         "\"large_reqs\": %lu, \"large_frees\": %lu, "
+                         "\"large_fails\": %lu, \"slots\": [",
+                         info.pages, info.free, info.runs, info.largest,
+                         page_stat.total, page_stat.used, page_stat.reqs,
+                         page_stat.frees, page_stat.fails);
+
+        for (i = 0; i < n; i++) {
+            appendStringInfo(buf, "%s{\"slot_size\": %zu, \"total\": %lu, "
+                             "\"used\": %lu, \"cached\": %lu, "
+                             "\"reqs\": %lu, \"frees\": %lu, "
+                             "\"fails\": %lu}",
+                             i ? ", " : "",
+                             pgrest_slab_slot_size(pool, i),
+                             stats[i].total,
+                             stats[i].used - stats[i].cached,
+                             stats[i].cached, stats[i].reqs,
+                             stats[i].frees, stats[i].fails);
+        }
+
+        appendStringInfoString(buf, "]}");
+
+        pfree(stats);
+    }
+
+    appendStringInfoString(buf, "]}");
 }
@@ -55,9 +55,41 @@
 #define pgrest_slab_junk(p, size)
 #endif
 
+/*
+ * Every worker keeps a magazine of free chunks per pool and slot, chunks
+ * are taken from and returned to it without the pool lock. An empty
+ * magazine is refilled and a full one flushed by half under the lock.
+ * When the pool runs out the processes give back their cached chunks,
+ * see pgrest_slab_alloc_retry().
+ */
+#define PGREST_SLAB_MAGAZINE_SIZE   32
+#define PGREST_SLAB_MAGAZINE_BATCH  (PGREST_SLAB_MAGAZINE_SIZE / 2)
+
+/* reqs, frees and cached go into the pool counters with the lock */
+typedef struct {
+    pgrest_uint_t        n;
+    pgrest_uint_t        cached;
+    pgrest_uint_t        reqs;
+    pgrest_uint_t        frees;
+    void                *chunks[PGREST_SLAB_MAGAZINE_SIZE];
+} pgrest_slab_magazine_t;
+
+typedef struct pgrest_slab_cache_s  pgrest_slab_cache_t;
+
+struct pgrest_slab_cache_s {
+    pgrest_slab_pool_t      *pool;
+    pgrest_slab_cache_t     *next;
+    pgrest_uint_t            nslots;
+    pgrest_uint_t            reclaim;
+    pgrest_slab_magazine_t   magazines[FLEXIBLE_ARRAY_MEMBER];
+};
+
 pgrest_uint_t  pgrest_pagesize;
 pgrest_uint_t  pgrest_pagesize_shift;
 
+static pgrest_slab_cache_t *pgrest_slab_caches = NULL;
+static pgrest_slab_cache_t *pgrest_slab_last_cache = NULL;
+
 static pgrest_uint_t  pgrest_slab_max_size;
 static pgrest_uint_t  pgrest_slab_exact_size;
 static pgrest_uint_t  pgrest_slab_exact_shift;
@@ -68,8 +100,10 @@ static void  pgrest_slab_free_pages(pgrest_slab_pool_t *pool,
                                     pgrest_slab_page_t *page,
                                     pgrest_uint_t pages);
 static void *pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size);
-static void *pgrest_slab_do_calloc(pgrest_slab_pool_t *pool, size_t size);
 static void  pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p);
+static pgrest_slab_cache_t *pgrest_slab_cache(pgrest_slab_pool_t *pool);
+static void  pgrest_slab_cache_release(pgrest_slab_cache_t *cache);
+static void  pgrest_slab_cache_flush(int code, Datum arg);
 
 void
 pgrest_slab_init(pgrest_slab_pool_t *pool)
@@ -108,6 +142,14 @@ pgrest_slab_init(pgrest_slab_pool_t *pool)
 
     p += n * sizeof(pgrest_slab_page_t);
 
+    pool->stats = (pgrest_slab_stat_t *) p;
+    MemSet(pool->stats, 0, n * sizeof(pgrest_slab_stat_t));
+    MemSet(&pool->page_stat, 0, sizeof(pgrest_slab_stat_t));
+
+    p += n * sizeof(pgrest_slab_stat_t);
+
+    size -= n * (sizeof(pgrest_slab_page_t) + sizeof(pgrest_slab_stat_t));
+
     pages = (pgrest_uint_t) (size / (pgrest_pagesize + sizeof(pgrest_slab_page_t)));
 
     MemSet(p, 0, pages * sizeof(pgrest_slab_page_t));
@@ -132,20 +174,411 @@ pgrest_slab_init(pgrest_slab_pool_t *pool)
     }
 
     pool->last = pool->pages + pages;
+    pool->pfree = pages;
+    pool->reclaim = 0;
+}
+
+
+static pgrest_slab_cache_t *
+pgrest_slab_cache(pgrest_slab_pool_t *pool)
+{
+    pgrest_slab_cache_t  *cache;
+    pgrest_uint_t         nslots;
+
+    if (pgrest_slab_last_cache && pgrest_slab_last_cache->pool == pool) {
+        cache = pgrest_slab_last_cache;
+        goto found;
+    }
+
+    for (cache = pgrest_slab_caches; cache; cache = cache->next) {
+        if (cache->pool == pool) {
+            pgrest_slab_last_cache = cache;
+            goto found;
+        }
+    }
+
+    /* the postmaster never allocates from a cache it would hand down */
+    if (!IsUnderPostmaster) {
+        return NULL;
+    }
+
+    nslots = pgrest_pagesize_shift - pool->min_shift;
+
+    cache = MemoryContextAllocZero(TopMemoryContext,
+                         offsetof(pgrest_slab_cache_t, magazines)
+                         + nslots * sizeof(pgrest_slab_magazine_t));
+    cache->pool = pool;
+    cache->nslots = nslots;
+    cache->reclaim = pool->reclaim;
+
+    if (pgrest_slab_caches == NULL) {
+        on_shmem_exit(pgrest_slab_cache_flush, (Datum) 0);
+    }
+
+    cache->next = pgrest_slab_caches;
+    pgrest_slab_caches = cache;
+    pgrest_slab_last_cache = cache;
+
+    return cache;
+
+found:
+
+    /* another process ran short, read without the lock as a hint only */
+    if (cache->reclaim != pool->reclaim) {
+        cache->reclaim = pool->reclaim;
+        pgrest_slab_cache_release(cache);
+    }
+
+    return cache;
+}
+
+/* shift of the slot serving an allocation of size, 0 for whole pages */
+static pgrest_uint_t
+pgrest_slab_shift(pgrest_slab_pool_t *pool, size_t size)
+{
+    size_t         s;
+    pgrest_uint_t  shift;
+
+    if (size > pgrest_slab_max_size) {
+        return 0;
+    }
+
+    if (size <= pool->min_size) {
+        return pool->min_shift;
+    }
+
+    shift = 1;
+    for (s = size - 1; s >>= 1; shift++) { /* void */ }
+
+    return shift;
+}
+
+/*
+ * Shift of the slot a chunk belongs to, 0 for whole pages. The slot type
+ * and shift of a page do not change while one of its chunks is
+ * allocated, so they are read without the lock.
+ */
+static pgrest_uint_t
+pgrest_slab_shift_of(pgrest_slab_pool_t *pool, void *p)
+{
+    pgrest_slab_page_t  *page;
+
+    if ((char *) p < pool->start || (char *) p >= pool->end) {
+        return 0;
+    }
+
+    page = &pool->pages[((char *) p - pool->start) >> pgrest_pagesize_shift];
+
+    switch (page->prev & PGREST_SLAB_PAGE_MASK) {
+
+    case PGREST_SLAB_SMALL:
+    case PGREST_SLAB_BIG:
+        return page->slab & PGREST_SLAB_SHIFT_MASK;
+
+    case PGREST_SLAB_EXACT:
+        return pgrest_slab_exact_shift;
+
+    default: /* PGREST_SLAB_PAGE */
+        return 0;
+    }
+}
+
+static inline pgrest_slab_stat_t *
+pgrest_slab_stat(pgrest_slab_pool_t *pool, pgrest_uint_t shift)
+{
+    return shift ? &pool->stats[shift - pool->min_shift] : &pool->page_stat;
+}
+
+/* magazine of the slot with shift, NULL for whole pages */
+static pgrest_slab_magazine_t *
+pgrest_slab_magazine(pgrest_slab_pool_t *pool, pgrest_uint_t shift)
+{
+    pgrest_slab_cache_t  *cache;
+
+    if (shift == 0 || (cache = pgrest_slab_cache(pool)) == NULL) {
+        return NULL;
+    }
+
+    return &cache->magazines[shift - pool->min_shift];
+}
+
+/*
+ * Add what a magazine did since the last time to the pool counters, so
+ * that they count the calls rather than the batches. Called with the
+ * lock.
+ */
+static void
+pgrest_slab_magazine_fold(pgrest_slab_pool_t *pool,
+                          pgrest_slab_magazine_t *magazine,
+                          pgrest_uint_t shift)
+{
+    pgrest_slab_stat_t  *stat = pgrest_slab_stat(pool, shift);
+
+    stat->reqs += magazine->reqs;
+    stat->frees += magazine->frees;
+    stat->cached += magazine->n - magazine->cached;
+
+    magazine->reqs = 0;
+    magazine->frees = 0;
+    magazine->cached = magazine->n;
+}
+
+#ifdef USE_ASSERT_CHECKING
+/*
+ * The checks of pgrest_slab_do_free() for a chunk that goes into a
+ * magazine instead: it must be the start of a chunk, allocated in the
+ * pool and not already in the magazine.
+ */
+static bool
+pgrest_slab_magazine_check(pgrest_slab_pool_t *pool,
+                           pgrest_slab_magazine_t *magazine,
+                           void *p, pgrest_uint_t shift)
+{
+    uintptr_t            m, *bitmap;
+    pgrest_uint_t        i, n;
+    pgrest_slab_page_t  *page;
+    bool                 busy;
+
+    if ((uintptr_t) p & (((uintptr_t) 1 << shift) - 1)) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "pgrest_slab_free(): "
+                                 "pointer to wrong chunk")));
+        return false;
+    }
+
+    for (i = 0; i < magazine->n; i++) {
+        if (magazine->chunks[i] == p) {
+            goto chunk_already_free;
+        }
+    }
+
+    n = ((char *) p - pool->start) >> pgrest_pagesize_shift;
+    page = &pool->pages[n];
+
+    LWLockAcquire(pool->lock, LW_SHARED);
+
+    switch (page->prev & PGREST_SLAB_PAGE_MASK) {
+
+    case PGREST_SLAB_SMALL:
+        n = ((uintptr_t) p & (pgrest_pagesize - 1)) >> shift;
+        m = (uintptr_t) 1 << (n & (sizeof(uintptr_t) * 8 - 1));
+        n /= (sizeof(uintptr_t) * 8);
+        bitmap = (uintptr_t *)
+                     ((uintptr_t) p & ~((uintptr_t) pgrest_pagesize - 1));
+        busy = (bitmap[n] & m) != 0;
+        break;
+
+    case PGREST_SLAB_EXACT:
+        m = (uintptr_t) 1 << (((uintptr_t) p & (pgrest_pagesize - 1))
+                              >> pgrest_slab_exact_shift);
+        busy = (page->slab & m) != 0;
+        break;
+
+    default: /* PGREST_SLAB_BIG */
+        m = (uintptr_t) 1 << ((((uintptr_t) p & (pgrest_pagesize - 1))
+                               >> shift) + PGREST_SLAB_MAP_SHIFT);
+        busy = (page->slab & m) != 0;
+        break;
+    }
+
+    LWLockRelease(pool->lock);
+
+    if (busy) {
+        return true;
+    }
+
+chunk_already_free:
+
+    ereport(WARNING, (errmsg(PGREST_PACKAGE " " "pgrest_slab_free(): "
+                             "chunk is already free")));
+    return false;
 }
+#endif
+
+static void
+pgrest_slab_magazine_refill(pgrest_slab_pool_t *pool,
+                            pgrest_slab_magazine_t *magazine,
+                            pgrest_uint_t shift)
+{
+    void  *p;
+
+    LWLockAcquire(pool->lock, LW_EXCLUSIVE);
+
+    while (magazine->n < PGREST_SLAB_MAGAZINE_BATCH) {
+        p = pgrest_slab_do_alloc(pool, (size_t) 1 << shift);
+        if (p == NULL) {
+            break;
+        }
+
+        magazine->chunks[magazine->n++] = p;
+    }
+
+    pgrest_slab_magazine_fold(pool, magazine, shift);
 
+    LWLockRelease(pool->lock);
+}
+
+static void
+pgrest_slab_magazine_flush(pgrest_slab_pool_t *pool,
+                           pgrest_slab_magazine_t *magazine,
+                           pgrest_uint_t shift,
+                           pgrest_uint_t keep)
+{
+    LWLockAcquire(pool->lock, LW_EXCLUSIVE);
+
+    while (magazine->n > keep) {
+        pgrest_slab_do_free(pool, magazine->chunks[--magazine->n]);
+    }
+
+    pgrest_slab_magazine_fold(pool, magazine, shift);
+
+    LWLockRelease(pool->lock);
+}
+
+static void
+pgrest_slab_cache_release(pgrest_slab_cache_t *cache)
+{
+    pgrest_uint_t            i;
+    pgrest_slab_magazine_t  *magazine;
+
+    for (i = 0; i < cache->nslots; i++) {
+        magazine = &cache->magazines[i];
+
+        if (magazine->n || magazine->reqs || magazine->frees) {
+            pgrest_slab_magazine_flush(cache->pool, magazine,
+                                       i + cache->pool->min_shift, 0);
+        }
+    }
+}
+
+/* give the cached chunks back before the process goes away */
+static void
+pgrest_slab_cache_flush(int code, Datum arg)
+{
+    pgrest_slab_cache_t  *cache;
+
+    /* an error may have left a pool lock held */
+    LWLockReleaseAll();
+
+    for (cache = pgrest_slab_caches; cache; cache = cache->next) {
+        pgrest_slab_cache_release(cache);
+    }
+}
+
+/*
+ * Give back the cached chunks of the pools another process ran short
+ * of, the PGREST_IPC_CMD_SLAB_RECLAIM handler of the workers.
+ */
+void
+pgrest_slab_cache_reclaim(void)
+{
+    pgrest_slab_cache_t  *cache;
+
+    for (cache = pgrest_slab_caches; cache; cache = cache->next) {
+        if (cache->reclaim != cache->pool->reclaim) {
+            cache->reclaim = cache->pool->reclaim;
+            pgrest_slab_cache_release(cache);
+        }
+    }
+}
+
+/*
+ * The pool is out of memory while the magazines may still hold free
+ * chunks, up to PGREST_SLAB_MAGAZINE_SIZE per slot and process. Those
+ * of this process go back at once, which may free whole pages, and the
+ * pool is tried again. The other processes are asked to give theirs
+ * back so that a later allocation finds them.
+ */
+static void *
+pgrest_slab_alloc_retry(pgrest_slab_pool_t *pool, size_t size)
+{
+    void                 *p = NULL;
+    pgrest_slab_cache_t  *cache;
+
+    cache = pgrest_slab_cache(pool);
+    if (cache) {
+        pgrest_slab_cache_release(cache);
+    }
+
+    LWLockAcquire(pool->lock, LW_EXCLUSIVE);
+
+    if (cache) {
+        cache->reclaim = ++pool->reclaim;
+        p = pgrest_slab_do_alloc(pool, size);
+    }
+
+    if (p == NULL) {
+        pgrest_slab_stat(pool, pgrest_slab_shift(pool, size))->fails++;
+    }
+
+    LWLockRelease(pool->lock);
+
+    if (cache) {
+        pgrest_ipc_broadcast_notify(PGREST_IPC_CMD_SLAB_RECLAIM);
+    }
+
+    return p;
+}
+
+/*
+ * Forget the cached chunks of a pool whose memory was replaced, they
+ * belong to the previous mapping and must not be handed out again.
+ */
+void
+pgrest_slab_cache_discard(pgrest_slab_pool_t *pool)
+{
+    pgrest_uint_t         i;
+    pgrest_slab_cache_t  *cache;
+
+    for (cache = pgrest_slab_caches; cache; cache = cache->next) {
+        if (cache->pool != pool) {
+            continue;
+        }
+
+        /* the counters went with the previous generation too */
+        for (i = 0; i < cache->nslots; i++) {
+            cache->magazines[i].n = 0;
+            cache->magazines[i].cached = 0;
+            cache->magazines[i].reqs = 0;
+            cache->magazines[i].frees = 0;
+        }
+    }
+}
 
 void *
 pgrest_slab_alloc(pgrest_slab_pool_t *pool, size_t size)
 {
-    void  *p;
+    void                    *p;
+    pgrest_uint_t            shift;
+    pgrest_slab_magazine_t  *magazine;
+
+    shift = pgrest_slab_shift(pool, size);
+
+    magazine = pgrest_slab_magazine(pool, shift);
+    if (magazine) {
+        magazine->reqs++;
+
+        if (magazine->n == 0) {
+            pgrest_slab_magazine_refill(pool, magazine, shift);
+        }
+
+        if (magazine->n) {
+            return magazine->chunks[--magazine->n];
+        }
+
+        return pgrest_slab_alloc_retry(pool, size);
+    }
 
     LWLockAcquire(pool->lock, LW_EXCLUSIVE);
 
+    pgrest_slab_stat(pool, shift)->reqs++;
     p = pgrest_slab_do_alloc(pool, size);
 
     LWLockRelease(pool->lock);
 
+    if (p == NULL) {
+        p = pgrest_slab_alloc_retry(pool, size);
+    }
+
     return p;
 }
 
@@ -157,17 +590,24 @@ pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size)
     uintptr_t            p, n, m, mask, *bitmap;
     pgrest_uint_t        i, slot, shift, map;
     pgrest_slab_page_t  *page, *prev, *slots;
+    pgrest_slab_stat_t  *stat = NULL;
 
     if (size > pgrest_slab_max_size) {
 
         ereport(DEBUG1, (errmsg(PGREST_PACKAGE " " "slab alloc: %zu", size)));
 
-        page = pgrest_slab_alloc_pages(pool, (size >> pgrest_pagesize_shift)
-                                          + ((size % pgrest_pagesize) ? 1 : 0));
+        n = (size >> pgrest_pagesize_shift)
+            + ((size % pgrest_pagesize) ? 1 : 0);
+
+        page = pgrest_slab_alloc_pages(pool, n);
         if (page) {
             p = (page - pool->pages) << pgrest_pagesize_shift;
             p += (uintptr_t) pool->start;
 
+            /* total in pages, used in allocations */
+            stat = &pool->page_stat;
+            stat->total += n;
+
         } else {
             p = 0;
         }
@@ -186,6 +626,8 @@ pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size)
         slot = 0;
     }
 
+    stat = &pool->stats[slot];
+
     slots = (pgrest_slab_page_t *) ((char *) pool + sizeof(pgrest_slab_pool_t));
     page = slots[slot].next;
 
@@ -352,6 +794,8 @@ pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size)
             p = ((page - pool->pages) << pgrest_pagesize_shift) + s * n;
             p += (uintptr_t) pool->start;
 
+            stat->total += (pgrest_pagesize >> shift) - n;
+
             goto done;
 
         } else if (shift == pgrest_slab_exact_shift) {
@@ -365,6 +809,8 @@ pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size)
             p = (page - pool->pages) << pgrest_pagesize_shift;
             p += (uintptr_t) pool->start;
 
+            stat->total += 8 * sizeof(uintptr_t);
+
             goto done;
 
         } else { /* shift > pgrest_slab_exact_shift */
@@ -378,6 +824,8 @@ pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size)
             p = (page - pool->pages) << pgrest_pagesize_shift;
             p += (uintptr_t) pool->start;
 
+            stat->total += pgrest_pagesize >> shift;
+
             goto done;
         }
     }
@@ -386,6 +834,10 @@ pgrest_slab_do_alloc(pgrest_slab_pool_t *pool, size_t size)
 
 done:
 
+    if (p) {
+        stat->used++;
+    }
+
     ereport(DEBUG1, (errmsg(PGREST_PACKAGE " " "slab alloc: %p", (void *)p)));
 
     return (void *) p;
@@ -397,36 +849,96 @@ pgrest_slab_calloc(pgrest_slab_pool_t *pool, size_t size)
 {
     void  *p;
 
+    p = pgrest_slab_alloc(pool, size);
+    if (p) {
+        MemSet(p, 0, size);
+    }
+
+    return p;
+}
+
+
+void
+pgrest_slab_free(pgrest_slab_pool_t *pool, void *p)
+{
+    pgrest_uint_t            shift;
+    pgrest_slab_magazine_t  *magazine;
+
+    shift = pgrest_slab_shift_of(pool, p);
+
+    magazine = pgrest_slab_magazine(pool, shift);
+    if (magazine) {
+#ifdef USE_ASSERT_CHECKING
+        if (!pgrest_slab_magazine_check(pool, magazine, p, shift)) {
+            return;
+        }
+#endif
+        pgrest_slab_junk(p, (size_t) 1 << shift);
+
+        magazine->frees++;
+
+        if (magazine->n == PGREST_SLAB_MAGAZINE_SIZE) {
+            pgrest_slab_magazine_flush(pool, magazine, shift,
+                                       PGREST_SLAB_MAGAZINE_BATCH);
+        }
+
+        magazine->chunks[magazine->n++] = p;
+        return;
+    }
+
     LWLockAcquire(pool->lock, LW_EXCLUSIVE);
 
-    p = pgrest_slab_do_calloc(pool, size);
+    pgrest_slab_stat(pool, shift)->frees++;
+    pgrest_slab_do_free(pool, p);
 
     LWLockRelease(pool->lock);
-
-    return p;
 }
 
 
-static void *
-pgrest_slab_do_calloc(pgrest_slab_pool_t *pool, size_t size)
+pgrest_uint_t
+pgrest_slab_nslots(pgrest_slab_pool_t *pool)
 {
-    void  *p;
+    return pgrest_pagesize_shift - pool->min_shift;
+}
 
-    p = pgrest_slab_do_alloc(pool, size);
-    if (p) {
-        MemSet(p, 0, size);
-    }
 
-    return p;
+size_t
+pgrest_slab_slot_size(pgrest_slab_pool_t *pool, pgrest_uint_t slot)
+{
+    return (size_t) 1 << (slot + pool->min_shift);
 }
 
 
+/*
+ * Copy the per slot counters into stats, which must have room for
+ * pgrest_slab_nslots() entries, and those of the whole page allocations
+ * into page_stat. Walk the free page list for the number and size of
+ * the free runs.
+ */
 void
-pgrest_slab_free(pgrest_slab_pool_t *pool, void *p)
+pgrest_slab_stat_get(pgrest_slab_pool_t *pool, pgrest_slab_stat_t *stats,
+                     pgrest_slab_stat_t *page_stat, pgrest_slab_info_t *info)
 {
-    LWLockAcquire(pool->lock, LW_EXCLUSIVE);
+    pgrest_slab_page_t  *page;
 
-    pgrest_slab_do_free(pool, p);
+    MemSet(info, 0, sizeof(pgrest_slab_info_t));
+
+    LWLockAcquire(pool->lock, LW_SHARED);
+
+    memcpy(stats, pool->stats,
+           pgrest_slab_nslots(pool) * sizeof(pgrest_slab_stat_t));
+    *page_stat = pool->page_stat;
+
+    info->pages = pool->last - pool->pages;
+    info->free = pool->pfree;
+
+    for (page = pool->free.next; page != &pool->free; page = page->next) {
+        info->runs++;
+
+        if (page->slab > info->largest) {
+            info->largest = page->slab;
+        }
+    }
 
     LWLockRelease(pool->lock);
 }
@@ -439,6 +951,7 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
     uintptr_t            slab, m, *bitmap;
     pgrest_uint_t        n, type, slot, shift, map;
     pgrest_slab_page_t  *slots, *page;
+    pgrest_slab_stat_t  *stat;
 
     ereport(DEBUG1, (errmsg(PGREST_PACKAGE " " "slab free: %p", p)));
 
@@ -458,6 +971,7 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
 
         shift = slab & PGREST_SLAB_SHIFT_MASK;
         size = 1 << shift;
+        stat = &pool->stats[shift - pool->min_shift];
 
         if ((uintptr_t) p & (size - 1)) {
             goto wrong_chunk;
@@ -503,6 +1017,9 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
                 }
             }
 
+            n = (1 << (pgrest_pagesize_shift - shift)) / 8 / (1 << shift);
+            stat->total -= (pgrest_pagesize >> shift) - (n ? n : 1);
+
             pgrest_slab_free_pages(pool, page, 1);
 
             goto done;
@@ -515,6 +1032,7 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
         m = (uintptr_t) 1 <<
                 (((uintptr_t) p & (pgrest_pagesize - 1)) >> pgrest_slab_exact_shift);
         size = pgrest_slab_exact_size;
+        stat = &pool->stats[pgrest_slab_exact_shift - pool->min_shift];
 
         if ((uintptr_t) p & (size - 1)) {
             goto wrong_chunk;
@@ -539,6 +1057,8 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
                 goto done;
             }
 
+            stat->total -= 8 * sizeof(uintptr_t);
+
             pgrest_slab_free_pages(pool, page, 1);
 
             goto done;
@@ -550,6 +1070,7 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
 
         shift = slab & PGREST_SLAB_SHIFT_MASK;
         size = 1 << shift;
+        stat = &pool->stats[shift - pool->min_shift];
 
         if ((uintptr_t) p & (size - 1)) {
             goto wrong_chunk;
@@ -578,6 +1099,8 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
                 goto done;
             }
 
+            stat->total -= pgrest_pagesize >> shift;
+
             pgrest_slab_free_pages(pool, page, 1);
 
             goto done;
@@ -604,6 +1127,9 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
         n = ((char *) p - pool->start) >> pgrest_pagesize_shift;
         size = slab & ~PGREST_SLAB_PAGE_START;
 
+        pool->page_stat.total -= size;
+        pool->page_stat.used--;
+
         pgrest_slab_free_pages(pool, &pool->pages[n], size);
 
         pgrest_slab_junk(p, size << pgrest_pagesize_shift);
@@ -617,6 +1143,8 @@ pgrest_slab_do_free(pgrest_slab_pool_t *pool, void *p)
 
 done:
 
+    stat->used--;
+
     pgrest_slab_junk(p, size);
 
     return;
@@ -667,6 +1195,8 @@ pgrest_slab_alloc_pages(pgrest_slab_pool_t *pool, pgrest_uint_t pages)
             page->next = NULL;
             page->prev = PGREST_SLAB_PAGE;
 
+            pool->pfree -= pages;
+
             if (--pages == 0) {
                 return page;
             }
@@ -695,6 +1225,8 @@ pgrest_slab_free_pages(pgrest_slab_pool_t *pool, pgrest_slab_page_t *page,
     pgrest_uint_t        type;
     pgrest_slab_page_t  *prev, *join;
 
+    pool->pfree += pages;
+
     page->slab = pages--;
 
     if (pages) {
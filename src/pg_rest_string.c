@@ -114,3 +114,39 @@ pgrest_atotm(unsigned char *line, size_t n)
 
     return value;
 }
+
+/* dst must have room for 4 * ((len + 2) / 3) bytes, returns their count */
+size_t
+pgrest_encode_base64(unsigned char *dst, const unsigned char *src, size_t len)
+{
+    unsigned char        *d = dst;
+    static const char     basis[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                    "abcdefghijklmnopqrstuvwxyz"
+                                    "0123456789+/";
+
+    while (len > 2) {
+        *d++ = basis[(src[0] >> 2) & 0x3f];
+        *d++ = basis[((src[0] & 3) << 4) | (src[1] >> 4)];
+        *d++ = basis[((src[1] & 0x0f) << 2) | (src[2] >> 6)];
+        *d++ = basis[src[2] & 0x3f];
+
+        src += 3;
+        len -= 3;
+    }
+
+    if (len) {
+        *d++ = basis[(src[0] >> 2) & 0x3f];
+
+        if (len == 1) {
+            *d++ = basis[(src[0] & 3) << 4];
+            *d++ = '=';
+        } else {
+            *d++ = basis[((src[0] & 3) << 4) | (src[1] >> 4)];
+            *d++ = basis[(src[1] & 0x0f) << 2];
+        }
+
+        *d++ = '=';
+    }
+
+    return d - dst;
+}
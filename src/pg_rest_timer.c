@@ -0,0 +1,242 @@
+/* -------------------------------------------------------------------------
+ *
+ * pq_rest_timer.c
+ *   coarse-grained timer wheel for connection timeouts
+ *
+ *
+ *
+ * Copyright (C) 2014-2015, Robert Mu <dbx_c@hotmail.com>
+ *
+ *  src/pg_rest_timer.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+#define PGREST_TIMER_WHEEL_MASK       (PGREST_TIMER_WHEEL_SIZE - 1)
+
+/*
+ * Timeouts are rounded up to the wheel resolution and hashed into a slot by
+ * their expire tick, so linking and unlinking a timer is O(1). A timer that
+ * is more than one revolution away just stays in its slot until its tick
+ * comes. A single libevent timer drives the wheel while it is not empty.
+ */
+typedef struct {
+    dlist_head              *slots;
+    uint64                   current;
+    int                      resolution;
+    int                      count;
+    struct event_base       *base;
+    struct event            *tick;
+} pgrest_timer_wheel_t;
+
+static pgrest_timer_wheel_t  pgrest_timer_wheel;
+
+static uint64
+pgrest_timer_now(void)
+{
+    struct timeval  tv;
+
+    (void) pgrest_event_gettimeofday(pgrest_timer_wheel.base, &tv);
+
+    return ((uint64) tv.tv_sec * 1000 + tv.tv_usec / 1000)
+           / pgrest_timer_wheel.resolution;
+}
+
+/*
+ * Fire the timers expired by tick now. They are taken off their slots
+ * first and their handlers run afterwards, so a handler may delete or
+ * re-arm any timer, one that expired along with it included.
+ */
+void
+pgrest_timer_expire(uint64 now)
+{
+    uint64              n;
+    dlist_head         *slot;
+    dlist_head          expired;
+    dlist_mutable_iter  iter;
+    pgrest_timer_t     *timer;
+
+    n = now - pgrest_timer_wheel.current;
+
+    if (n > PGREST_TIMER_WHEEL_SIZE) {
+        n = PGREST_TIMER_WHEEL_SIZE;
+    }
+
+    dlist_init(&expired);
+
+    while (n--) {
+        pgrest_timer_wheel.current++;
+        slot = &pgrest_timer_wheel.slots[pgrest_timer_wheel.current
+                                         & PGREST_TIMER_WHEEL_MASK];
+
+        dlist_foreach_modify(iter, slot) {
+            timer = dlist_container(pgrest_timer_t, node, iter.cur);
+
+            /* a later revolution */
+            if (timer->expire > now) {
+                continue;
+            }
+
+            dlist_delete(&timer->node);
+            dlist_push_tail(&expired, &timer->node);
+        }
+    }
+
+    pgrest_timer_wheel.current = now;
+
+    /* still set, pgrest_timer_del() and _add() take them off expired */
+    while (!dlist_is_empty(&expired)) {
+        timer = dlist_container(pgrest_timer_t, node,
+                                dlist_pop_head_node(&expired));
+        timer->set = 0;
+        pgrest_timer_wheel.count--;
+
+        timer->handler(timer);
+    }
+}
+
+static void
+pgrest_timer_tick_handler(evutil_socket_t fd, short events, void *arg)
+{
+    pgrest_timer_expire(pgrest_timer_now());
+
+    if (pgrest_timer_wheel.count == 0) {
+        (void) pgrest_event_del(pgrest_timer_wheel.tick, EV_TIMEOUT);
+    }
+}
+
+void
+pgrest_timer_add(pgrest_timer_t *timer, int timeout)
+{
+    pgrest_timer_add_at(timer, timeout, pgrest_timer_now());
+}
+
+/* pgrest_timer_add() as of tick now */
+void
+pgrest_timer_add_at(pgrest_timer_t *timer, int timeout, uint64 now)
+{
+    uint64  expire;
+
+    if (pgrest_timer_wheel.count == 0) {
+        /* the wheel was idle, catch up with the clock */
+        pgrest_timer_wheel.current = now;
+    }
+
+    expire = now + (timeout + pgrest_timer_wheel.resolution - 1)
+                   / pgrest_timer_wheel.resolution;
+
+    if (expire <= pgrest_timer_wheel.current) {
+        expire = pgrest_timer_wheel.current + 1;
+    }
+
+    if (timer->set) {
+        if (timer->expire == expire) {
+            return;
+        }
+
+        /* re-arm: just move the timer to its new slot */
+        dlist_delete(&timer->node);
+    } else {
+        if (pgrest_timer_wheel.count++ == 0
+            && pgrest_timer_wheel.tick
+            && !pgrest_event_add(pgrest_timer_wheel.tick, EV_TIMEOUT,
+                                 pgrest_timer_wheel.resolution))
+        {
+            pgrest_worker_event_error = true;
+        }
+
+        timer->set = 1;
+    }
+
+    timer->expire = expire;
+    dlist_push_tail(&pgrest_timer_wheel.slots[expire
+                                              & PGREST_TIMER_WHEEL_MASK],
+                    &timer->node);
+}
+
+void
+pgrest_timer_del(pgrest_timer_t *timer)
+{
+    if (!timer->set) {
+        return;
+    }
+
+    dlist_delete(&timer->node);
+    timer->set = 0;
+    pgrest_timer_wheel.count--;
+}
+
+/*
+ * An empty wheel in the current memory context, at tick now. Without an
+ * event base nothing drives it but pgrest_timer_expire().
+ */
+void
+pgrest_timer_wheel_init(int resolution, uint64 now)
+{
+    int   i;
+
+    pgrest_timer_wheel.resolution = resolution;
+    pgrest_timer_wheel.current = now;
+    pgrest_timer_wheel.count = 0;
+    pgrest_timer_wheel.tick = NULL;
+    pgrest_timer_wheel.slots = palloc(sizeof(dlist_head)
+                                      * PGREST_TIMER_WHEEL_SIZE);
+
+    for (i = 0; i < PGREST_TIMER_WHEEL_SIZE; i++) {
+        dlist_init(&pgrest_timer_wheel.slots[i]);
+    }
+}
+
+static bool
+pgrest_timer_worker_init(void *data, void *base)
+{
+    pgrest_timer_wheel.base = base;
+    pgrest_timer_wheel_init((intptr_t) data, 0);
+
+    pgrest_timer_wheel.tick = pgrest_event_new(base, -1, EV_PERSIST,
+                                               pgrest_timer_tick_handler,
+                                               NULL);
+    if (pgrest_timer_wheel.tick == NULL) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "worker %d create event"
+                                 " object failed", pgrest_worker_index)));
+        return false;
+    }
+
+    pgrest_event_priority_set(pgrest_timer_wheel.tick, PGREST_EVENT_PRIORITY);
+    pgrest_timer_wheel.current = pgrest_timer_now();
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d initialize "
+                              "timer wheel successfull, resolution %dms",
+                               pgrest_worker_index,
+                               pgrest_timer_wheel.resolution)));
+
+    return true;
+}
+
+static bool
+pgrest_timer_worker_exit(void *data, void *base)
+{
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d timer_exit",
+                               pgrest_worker_index)));
+
+    if (pgrest_timer_wheel.tick) {
+        (void) pgrest_event_del(pgrest_timer_wheel.tick, EV_TIMEOUT);
+        pgrest_event_free(pgrest_timer_wheel.tick);
+        pgrest_timer_wheel.tick = NULL;
+    }
+
+    return true;
+}
+
+void
+pgrest_timer_init(int resolution)
+{
+    pgrest_worker_hook_add(pgrest_timer_worker_init,
+                           pgrest_timer_worker_exit,
+                           "timer",
+                           (void *) (intptr_t) resolution,
+                           false);
+}
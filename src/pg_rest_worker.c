@@ -15,19 +15,39 @@
 #include "pg_rest_config.h"
 #include "pg_rest_core.h"
 
+PG_FUNCTION_INFO_V1(pgrest_worker_stats);
+
+/* consecutive scale_interval samples needed to start or retire a worker */
+#define PGREST_WORKER_SCALE_SAMPLES 3
+/* seconds a started dynamic worker may take to come up */
+#define PGREST_WORKER_START_TIMEOUT 60
+
 typedef struct {
 #if PGSQL_VERSION >= 95
     pg_atomic_uint32                connections;
+    pg_atomic_uint32                active;
 #else
     slock_t                         stat_mutex;
     uint32                          connections;
+    uint32                          active;
 #endif
+    /* written by the owning worker only, kept across its restarts */
+    time_t                          started;
+    uint32                          restarts;
+    pid_t                           pid;
+    /*
+     * Set by worker 0 when it starts a dynamic worker, cleared by that
+     * worker once running. With the pid it stands for the handle, which
+     * is private to the process that registered the worker.
+     */
+    time_t                          registered;
 } pgrest_worker_stat_t;
 
 typedef union
 {
     pgrest_worker_stat_t            stat;
-    char                            pad[PG_CACHE_LINE_SIZE];
+    char                            pad[TYPEALIGN(PG_CACHE_LINE_SIZE,
+                                           sizeof(pgrest_worker_stat_t))];
 } pgrest_worker_stat_paded_t;
 
 typedef struct {
@@ -39,10 +59,17 @@ typedef struct {
 
 static volatile sig_atomic_t        pgrest_worker_reconfigure = false;
 static List                        *pgrest_worker_hooks = NIL;
+static List                        *pgrest_worker_reload_hooks = NIL;
 static pgrest_worker_stat_paded_t  *pgrest_worker_stat = NULL;
+static volatile bool                pgrest_worker_timedout = false;
+#if PGSQL_VERSION >= 94
+static struct event                *pgrest_worker_scale_timer = NULL;
+static int                          pgrest_worker_scale_samples = 0;
+#endif
 
 sig_atomic_t                        pgrest_worker_terminate = false;
 int                                 pgrest_worker_index;
+int                                 pgrest_worker_cpu = -1;
 bool                                pgrest_worker_event_error = false;
 
 #if PGSQL_VERSION >= 95
@@ -137,6 +164,44 @@ pgrest_worker_guc_check(void)
         }
     }
 #endif
+
+    if (pgrest_setting.worker_processes_max <= 
+                                         pgrest_setting.worker_processes) {
+        pgrest_setting.worker_processes_max = pgrest_setting.worker_processes;
+        return;
+    }
+
+#if PGSQL_VERSION >= 94
+    /* idle reuseport sockets of stopped workers would strand connections */
+    if (pgrest_listener_reuseport()) {
+        ereport(WARNING,
+                (errmsg(PGREST_PACKAGE " " "worker_processes_max is not "
+                        "supported with reuseport listeners, ignored")));
+        pgrest_setting.worker_processes_max = pgrest_setting.worker_processes;
+    }
+#else
+    ereport(WARNING,
+            (errmsg(PGREST_PACKAGE " " "worker_processes_max requires dynamic"
+                    " background workers, ignored")));
+    pgrest_setting.worker_processes_max = pgrest_setting.worker_processes;
+#endif
+}
+
+static void
+pgrest_worker_fill(BackgroundWorker *worker, int index)
+{
+    MemSet(worker, 0, sizeof(BackgroundWorker));
+
+    snprintf(worker->bgw_name, BGW_MAXLEN, PGREST_PACKAGE " " "worker");
+    worker->bgw_flags = BGWORKER_SHMEM_ACCESS;
+    worker->bgw_start_time = BgWorkerStart_RecoveryFinished;
+    /* -1 is BGW_NEVER_RESTART */
+    worker->bgw_restart_time = pgrest_setting.worker_restart_delay;
+    worker->bgw_main = pgrest_worker_main;
+    worker->bgw_main_arg = Int32GetDatum(index);
+#if PGSQL_VERSION >= 94
+    worker->bgw_notify_pid = 0;
+#endif
 }
 
 static void
@@ -145,18 +210,8 @@ pgrest_worker_register(int worker_processes)
     BackgroundWorker  worker;
     int               i;
 
-    worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
-    worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
-    worker.bgw_restart_time = BGW_NEVER_RESTART;
-    worker.bgw_main = pgrest_worker_main;
-#if PGSQL_VERSION >= 94
-    worker.bgw_notify_pid = 0;
-#endif
-
     for (i = 0; i < worker_processes; i++) {
-        snprintf(worker.bgw_name, BGW_MAXLEN, PGREST_PACKAGE " " "worker");
-        worker.bgw_main_arg = Int32GetDatum(i);
-
+        pgrest_worker_fill(&worker, i);
         RegisterBackgroundWorker(&worker);
     }
 }
@@ -169,13 +224,19 @@ pgrest_worker_stat_data_init(pgrest_shm_seg_t *seg)
     pgrest_worker_stat = (pgrest_worker_stat_paded_t *) 
                             CACHELINEALIGN(seg->addr);
 
-    for (i = 0; i < pgrest_setting.worker_processes; i++) {
+    for (i = 0; i < PGREST_MAX_WORKERS; i++) {
 #if PGSQL_VERSION >= 95
         pg_atomic_init_u32(&pgrest_worker_stat[i].stat.connections, 0);
+        pg_atomic_init_u32(&pgrest_worker_stat[i].stat.active, 0);
 #else
         SpinLockInit(&pgrest_worker_stat[i].stat.stat_mutex);
         pgrest_worker_stat[i].stat.connections = 0;
+        pgrest_worker_stat[i].stat.active = 0;
 #endif
+        pgrest_worker_stat[i].stat.started = 0;
+        pgrest_worker_stat[i].stat.restarts = 0;
+        pgrest_worker_stat[i].stat.pid = 0;
+        pgrest_worker_stat[i].stat.registered = 0;
     }
 
     debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d initialize shared"
@@ -183,13 +244,14 @@ pgrest_worker_stat_data_init(pgrest_shm_seg_t *seg)
     return true;
 }
 
+/* sized for every possible worker, dynamic ones included */
 static void
-pgrest_worker_stat_init(int worker_processes)
+pgrest_worker_stat_init(void)
 {
     pgrest_shm_seg_t *seg;
     size_t            size;
 
-    size = sizeof(pgrest_worker_stat_paded_t) * worker_processes + 
+    size = sizeof(pgrest_worker_stat_paded_t) * PGREST_MAX_WORKERS + 
                                                 PG_CACHE_LINE_SIZE;
     seg = pgrest_shm_seg_add(PGREST_PACKAGE " " "worker stat", 
                              size,
@@ -203,6 +265,371 @@ pgrest_worker_stat_init(int worker_processes)
     seg->init = pgrest_worker_stat_data_init;
 }
 
+void
+pgrest_worker_stat_add(int32 n)
+{
+    pgrest_worker_stat_t *stat;
+
+    if (pgrest_worker_stat == NULL) {
+        return;
+    }
+
+    stat = &pgrest_worker_stat[pgrest_worker_index].stat;
+
+#if PGSQL_VERSION >= 95
+    (void) pg_atomic_fetch_add_u32(&stat->connections, n);
+#else
+    SpinLockAcquire(&stat->stat_mutex);
+    stat->connections += n;
+    SpinLockRelease(&stat->stat_mutex);
+#endif
+}
+
+/*
+ * pgrest_worker_stats()
+ *
+ * One row per worker slot: worker, pid, active, connections and restarts,
+ * which are kept across restarts of the worker.
+ */
+Datum
+pgrest_worker_stats(PG_FUNCTION_ARGS)
+{
+    int                          i;
+    pgrest_worker_stat_t        *stat;
+    TupleDesc                    tupdesc;
+    Tuplestorestate             *tupstore;
+    Datum                        values[5];
+    bool                         nulls[5];
+
+    tupstore = pgrest_shm_tuplestore(fcinfo, &tupdesc);
+
+    if (pgrest_worker_stat == NULL) {
+        return (Datum) 0;
+    }
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    for (i = 0; i < pgrest_setting.worker_processes_max; i++) {
+        stat = &pgrest_worker_stat[i].stat;
+
+        values[0] = Int32GetDatum(i);
+        values[1] = Int32GetDatum(stat->pid);
+        nulls[1] = stat->pid == 0;
+        values[2] = BoolGetDatum(pgrest_worker_active(i));
+        values[3] = Int64GetDatum(pgrest_worker_stat_get(i));
+        values[4] = Int64GetDatum(stat->restarts);
+
+        tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
+
+/* a worker is active between its subsystems startup and shutdown */
+static void
+pgrest_worker_stat_active(bool active)
+{
+    pgrest_worker_stat_t *stat;
+
+    if (pgrest_worker_stat == NULL) {
+        return;
+    }
+
+    stat = &pgrest_worker_stat[pgrest_worker_index].stat;
+
+#if PGSQL_VERSION >= 95
+    pg_atomic_write_u32(&stat->active, active ? 1 : 0);
+#else
+    SpinLockAcquire(&stat->stat_mutex);
+    stat->active = active ? 1 : 0;
+    SpinLockRelease(&stat->stat_mutex);
+#endif
+}
+
+static void
+pgrest_worker_stat_exit(int code, Datum arg)
+{
+    pgrest_worker_stat_active(false);
+    pgrest_worker_stat[pgrest_worker_index].stat.pid = 0;
+}
+
+/*
+ * Claim the slot before the subsystems start: the connections left
+ * counted by a failed predecessor are dropped first, so the listener and
+ * ipc connections opened next are the first ones counted. The slot is
+ * released by whatever way the process exits.
+ */
+static void
+pgrest_worker_stat_start(void)
+{
+    pgrest_worker_stat_t *stat;
+
+    if (pgrest_worker_stat == NULL) {
+        return;
+    }
+
+    stat = &pgrest_worker_stat[pgrest_worker_index].stat;
+
+#if PGSQL_VERSION >= 95
+    pg_atomic_write_u32(&stat->connections, 0);
+#else
+    SpinLockAcquire(&stat->stat_mutex);
+    stat->connections = 0;
+    SpinLockRelease(&stat->stat_mutex);
+#endif
+
+    stat->pid = MyProcPid;
+    stat->registered = 0;
+
+    on_proc_exit(pgrest_worker_stat_exit, 0);
+}
+
+bool
+pgrest_worker_active(int worker)
+{
+    pgrest_worker_stat_t *stat;
+    uint32                active;
+
+    if (pgrest_worker_stat == NULL) {
+        return false;
+    }
+
+    stat = &pgrest_worker_stat[worker].stat;
+
+#if PGSQL_VERSION >= 95
+    active = pg_atomic_read_u32(&stat->active);
+#else
+    SpinLockAcquire(&stat->stat_mutex);
+    active = stat->active;
+    SpinLockRelease(&stat->stat_mutex);
+#endif
+
+    return active != 0;
+}
+
+uint32
+pgrest_worker_stat_get(int worker)
+{
+    pgrest_worker_stat_t *stat;
+    uint32                connections;
+
+    stat = &pgrest_worker_stat[worker].stat;
+
+#if PGSQL_VERSION >= 95
+    connections = pg_atomic_read_u32(&stat->connections);
+#else
+    SpinLockAcquire(&stat->stat_mutex);
+    connections = stat->connections;
+    SpinLockRelease(&stat->stat_mutex);
+#endif
+
+    return connections;
+}
+
+/*
+ * A worker is overloaded when its active connections exceed the mean of
+ * all running workers by more than accept.balance_threshold percent.
+ */
+bool
+pgrest_worker_overloaded(int worker)
+{
+    int      i;
+    uint64   total;
+    uint64   own;
+    int      threshold = pgrest_setting.acceptor_balance_threshold;
+    int      nworkers;
+
+    if (threshold == 0 || pgrest_setting.worker_processes_max < 2
+        || pgrest_worker_stat == NULL)
+    {
+        return false;
+    }
+
+    total = 0;
+    nworkers = 0;
+    for (i = 0; i < pgrest_setting.worker_processes_max; i++) {
+        if (pgrest_worker_active(i)) {
+            total += pgrest_worker_stat_get(i);
+            nworkers++;
+        }
+    }
+
+    if (nworkers < 2) {
+        return false;
+    }
+
+    own = pgrest_worker_stat_get(worker);
+
+    return own * nworkers * 100 > total * (100 + threshold);
+}
+
+#if PGSQL_VERSION >= 94
+static void
+pgrest_worker_scale_up(void)
+{
+    BackgroundWorker      worker;
+    pgrest_worker_stat_t *stat;
+    time_t                now;
+    int                   i;
+
+    now = time(NULL);
+
+    for (i = pgrest_setting.worker_processes;
+         i < pgrest_setting.worker_processes_max; i++)
+    {
+        stat = &pgrest_worker_stat[i].stat;
+
+        /* neither running nor on its way */
+        if (stat->pid == 0
+            && now - stat->registered > PGREST_WORKER_START_TIMEOUT)
+        {
+            break;
+        }
+    }
+
+    if (i == pgrest_setting.worker_processes_max) {
+        return;
+    }
+
+    pgrest_worker_fill(&worker, i);
+
+    /* a failed one is started again by the next scale up */
+    worker.bgw_restart_time = BGW_NEVER_RESTART;
+
+    if (!RegisterDynamicBackgroundWorker(&worker, NULL)) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "could not start worker "
+                                 "%d, no background worker slot left", i)));
+        return;
+    }
+
+    stat->registered = now;
+
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "workers saturated, starting "
+                         "worker %d", i)));
+}
+
+static void
+pgrest_worker_scale_down(void)
+{
+    int     i;
+    pid_t   pid = 0;
+
+    for (i = pgrest_setting.worker_processes_max - 1;
+         i >= pgrest_setting.worker_processes; i--)
+    {
+        if ((pid = pgrest_worker_stat[i].stat.pid) != 0) {
+            break;
+        }
+    }
+
+    if (i < pgrest_setting.worker_processes) {
+        return;
+    }
+
+    ereport(LOG, (errmsg(PGREST_PACKAGE " " "workers idle, retiring "
+                         "worker %d", i)));
+
+    /* drains like on shutdown and, never restarted, stays down */
+    if (kill(pid, SIGTERM) == -1) {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "could not signal "
+                                 "worker %d (pid %d): %m", i, (int) pid)));
+    }
+}
+
+/*
+ * Runs in worker 0 every scale_interval. The load is the share of
+ * worker_connections in use, averaged over the running workers; a worker
+ * is started or retired once it stays beyond a threshold for
+ * PGREST_WORKER_SCALE_SAMPLES samples in a row.
+ */
+static void
+pgrest_worker_scale_handler(evutil_socket_t fd, short events, void *arg)
+{
+    int      i;
+    int      running;
+    int      load;
+    uint64   total;
+
+    running = 0;
+    total = 0;
+
+    for (i = 0; i < pgrest_setting.worker_processes_max; i++) {
+        if (pgrest_worker_active(i)) {
+            total += pgrest_worker_stat_get(i);
+            running++;
+        }
+    }
+
+    if (running == 0) {
+        return;
+    }
+
+    load = (int) (total * 100 / ((uint64) running *
+                                 pgrest_setting.worker_noconn));
+
+    if (load >= pgrest_setting.worker_scale_up) {
+        pgrest_worker_scale_samples = Max(pgrest_worker_scale_samples, 0) + 1;
+    } else if (load <= pgrest_setting.worker_scale_down) {
+        pgrest_worker_scale_samples = Min(pgrest_worker_scale_samples, 0) - 1;
+    } else {
+        pgrest_worker_scale_samples = 0;
+    }
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d scale check, "
+                              "%d running, load %d%%", pgrest_worker_index,
+                               running, load)));
+
+    if (pgrest_worker_scale_samples >= PGREST_WORKER_SCALE_SAMPLES) {
+        pgrest_worker_scale_samples = 0;
+        pgrest_worker_scale_up();
+
+    } else if (pgrest_worker_scale_samples <= -PGREST_WORKER_SCALE_SAMPLES) {
+        pgrest_worker_scale_samples = 0;
+        pgrest_worker_scale_down();
+    }
+}
+
+/*
+ * The dynamic workers are found through the worker stat segment, so a
+ * restarted worker 0 keeps scaling the ones its predecessor started.
+ */
+static bool
+pgrest_worker_scale_init(void *data, void *base)
+{
+    if (pgrest_worker_index != 0 || pgrest_worker_stat == NULL) {
+        return true;
+    }
+
+    pgrest_worker_scale_timer = pgrest_event_new(base, -1, EV_PERSIST,
+                                                 pgrest_worker_scale_handler,
+                                                 NULL);
+    if (pgrest_worker_scale_timer == NULL
+        || !pgrest_event_add(pgrest_worker_scale_timer, EV_TIMEOUT,
+                             pgrest_setting.worker_scale_interval))
+    {
+        ereport(WARNING, (errmsg(PGREST_PACKAGE " " "worker %d create "
+                                 "scale timer failed", pgrest_worker_index)));
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+pgrest_worker_scale_exit(void *data, void *base)
+{
+    if (pgrest_worker_scale_timer == NULL) {
+        return true;
+    }
+
+    (void) pgrest_event_del(pgrest_worker_scale_timer, EV_TIMEOUT);
+    pgrest_event_free(pgrest_worker_scale_timer);
+    pgrest_worker_scale_timer = NULL;
+
+    return true;
+}
+#endif
+
 void
 pgrest_worker_hook_add(pgrest_worker_hook_pt  startup, 
                        pgrest_worker_hook_pt  shutdown,
@@ -226,6 +653,110 @@ pgrest_worker_hook_add(pgrest_worker_hook_pt  startup,
     }
 }
 
+void
+pgrest_worker_reload_hook_add(pgrest_worker_hook_pt  reload,
+                              const char            *name,
+                              void                  *data)
+{
+    pgrest_worker_hook_t  *hook;
+
+    hook = (pgrest_worker_hook_t *) palloc0fast(sizeof(pgrest_worker_hook_t));
+
+    hook->name = name;
+    hook->startup = reload;
+    hook->data = data;
+
+    pgrest_worker_reload_hooks = lappend(pgrest_worker_reload_hooks, hook);
+}
+
+static void
+pgrest_worker_reload(struct event_base *base)
+{
+    ListCell         *cell;
+
+    foreach(cell, pgrest_worker_reload_hooks) {
+        pgrest_worker_hook_t *hook = lfirst(cell);
+
+        if (hook->startup(hook->data, base) == false) {
+            ereport(LOG, (errmsg(PGREST_PACKAGE " " "worker %d reload %s "
+                                 "failed, keep the current configuration",
+                                  pgrest_worker_index, hook->name)));
+        }
+    }
+}
+
+/*
+ * Pin the worker before it allocates anything: with the default local
+ * allocation policy its memory context blocks, connection array and
+ * events are then first touched, and so placed, on its own NUMA node.
+ */
+static void
+pgrest_worker_cpu_affinity(void)
+{
+#ifdef HAVE_CPU_AFFINITY
+    cpu_set_t       mask;
+    cpu_set_t       allowed;
+    uint64         *masks;
+    pgrest_uint_t   i;
+    int             cpu;
+    int             n;
+
+    CPU_ZERO(&mask);
+
+    if (pgrest_setting.worker_cpu_affinity_auto) {
+        /* spread over the cpus we may run on, e.g. within a cpuset */
+        if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == -1) {
+            ereport(WARNING,
+                    (errmsg(PGREST_PACKAGE " " "sched_getaffinity() failed:"
+                            " %m")));
+            return;
+        }
+
+        n = pgrest_worker_index % CPU_COUNT(&allowed);
+
+        for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+                CPU_SET(cpu, &mask);
+                break;
+            }
+        }
+
+    } else if (pgrest_setting.worker_cpu_affinity.size) {
+        masks = pgrest_setting.worker_cpu_affinity.elts;
+        i = Min((pgrest_uint_t) pgrest_worker_index,
+                pgrest_setting.worker_cpu_affinity.size - 1);
+
+        for (cpu = 0; cpu < 64; cpu++) {
+            if (masks[i] & ((uint64) 1 << cpu)) {
+                CPU_SET(cpu, &mask);
+            }
+        }
+
+    } else {
+        return;
+    }
+
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &mask) == -1) {
+        ereport(WARNING,
+                (errmsg(PGREST_PACKAGE " " "sched_setaffinity() failed: %m")));
+        return;
+    }
+
+    /* a single cpu lets the listeners ask for its connections */
+    if (CPU_COUNT(&mask) == 1) {
+        for (cpu = 0; !CPU_ISSET(cpu, &mask); cpu++) {
+            /* void */
+        }
+
+        pgrest_worker_cpu = cpu;
+    }
+
+    debug_log(DEBUG1, (errmsg(PGREST_PACKAGE " " "worker %d cpu affinity "
+                              "set, cpu %d", pgrest_worker_index,
+                               pgrest_worker_cpu)));
+#endif
+}
+
 static void
 pgrest_worker_process_init(struct event_base *base)
 {
@@ -315,6 +846,20 @@ pgrest_worker_event_dispatch(struct event_base *base,
         return true; 
     }
 
+    /* leave the accept mutex to less loaded workers */
+    if (pgrest_worker_overloaded(pgrest_worker_index)) {
+        if (pgrest_acceptor_mutex_held) {
+            if (!pgrest_listener_pause(false)) {
+                return false;
+            }
+
+            pgrest_acceptor_mutex_held = false;
+        }
+
+        pgrest_event_loop_once(base);
+        return true;
+    }
+
     if (!pgrest_acceptor_trylock_mutex()) {
         return true;
     }
@@ -325,8 +870,13 @@ pgrest_worker_event_dispatch(struct event_base *base,
         return false;
     }
 
-    /* TODO only invoke low priority event callback */
-    pgrest_event_dispatch(base);
+    /*
+     * While the mutex is held only accept callbacks run, connection I/O
+     * is posted and handled after the mutex has been released, so other
+     * workers are not kept waiting by request processing.
+     */
+    pgrest_event_posting = pgrest_acceptor_mutex_held;
+    pgrest_event_loop_once(base);
 
     if (pgrest_acceptor_mutex_held) {
         pgrest_acceptor_unlock_mutex();
@@ -334,12 +884,155 @@ pgrest_worker_event_dispatch(struct event_base *base,
         return false;
     }
 
-    /* TODO invoke I/O handler(high priority) */
-    pgrest_event_run_pending(base);
+    pgrest_event_run_pending();
 
     return true;
 }
 
+static void
+pgrest_worker_timeout_handler(evutil_socket_t fd, short events, void *arg)
+{
+    pgrest_worker_timedout = true;
+}
+
+/*
+ * Stop accepting and give in-flight requests up to shutdown_timeout to
+ * complete. Connections waiting for a request are closed right away, the
+ * others are not kept alive after their response.
+ */
+static void
+pgrest_worker_drain(struct event_base *base, MemoryContext mctx)
+{
+    struct event  *ev;
+    int            nconn;
+
+    pgrest_worker_stat_active(false);
+
+    if (!pgrest_listener_pause(true)) {
+        return;
+    }
+
+    if (pgrest_acceptor_mutex_held) {
+        pgrest_acceptor_mutex_held = false;
+        pgrest_acceptor_unlock_mutex();
+    }
+
+    pgrest_event_run_pending();
+    pgrest_conn_close_idle();
+
+    if ((nconn = pgrest_conn_active()) == 0
+        || pgrest_setting.worker_shutdown_timeout == 0)
+    {
+        return;
+    }
+
+    ereport(LOG,(errmsg(PGREST_PACKAGE " " "worker %d draining %d "
+                        "connections", pgrest_worker_index, nconn)));
+
+    ev = pgrest_event_new(base, -1, 0, pgrest_worker_timeout_handler, NULL);
+    if (ev == NULL
+        || !pgrest_event_add(ev, EV_TIMEOUT,
+                             pgrest_setting.worker_shutdown_timeout))
+    {
+        return;
+    }
+
+    PG_TRY();
+    {
+        while (!pgrest_worker_timedout
+               && !pgrest_worker_event_error
+               && pgrest_conn_active() > 0)
+        {
+            pgrest_event_loop_once(base);
+            pgrest_event_run_pending();
+            pgrest_ipc_flush();
+        }
+    }
+    PG_CATCH();
+    {
+        EmitErrorReport();
+        FlushErrorState();
+        MemoryContextSwitchTo(mctx);
+    }
+    PG_END_TRY();
+
+    if (pgrest_worker_timedout) {
+        ereport(LOG,(errmsg(PGREST_PACKAGE " " "worker %d shutdown_timeout "
+                            "expired with %d connections",
+                             pgrest_worker_index, pgrest_conn_active())));
+    }
+
+    (void) pgrest_event_del(ev, EV_TIMEOUT);
+    pgrest_event_free(ev);
+}
+
+/*
+ * The postmaster restarts a worker that exited with an error after
+ * restart_delay seconds. When it keeps failing within restart_delay_max
+ * seconds of its startup, every further restart waits twice as long, up
+ * to restart_delay_max.
+ */
+static void
+pgrest_worker_backoff(struct event_base *base)
+{
+    pgrest_worker_stat_t *stat;
+    struct event         *ev;
+    time_t                now;
+    int                   delay;
+
+    /* dynamic workers are never restarted by the postmaster */
+    if (pgrest_worker_stat == NULL
+        || pgrest_worker_index >= pgrest_setting.worker_processes)
+    {
+        return;
+    }
+
+    stat = &pgrest_worker_stat[pgrest_worker_index].stat;
+    now = time(NULL);
+
+    if (stat->started != 0
+        && now - stat->started < pgrest_setting.worker_restart_delay_max)
+    {
+        stat->restarts++;
+    } else {
+        stat->restarts = 0;
+    }
+
+    stat->started = now;
+
+    if (stat->restarts == 0 || pgrest_setting.worker_restart_delay < 0) {
+        return;
+    }
+
+    delay = Max(pgrest_setting.worker_restart_delay, 1)
+                << Min(stat->restarts, 12);
+    delay = Min(delay, pgrest_setting.worker_restart_delay_max)
+                - pgrest_setting.worker_restart_delay;
+
+    if (delay <= 0) {
+        return;
+    }
+
+    ereport(LOG,(errmsg(PGREST_PACKAGE " " "worker %d restarted %u times "
+                        "in a row, delaying startup for %d seconds",
+                         pgrest_worker_index, stat->restarts, delay)));
+
+    ev = pgrest_event_new(base, -1, 0, pgrest_worker_timeout_handler, NULL);
+    if (ev == NULL || !pgrest_event_add(ev, EV_TIMEOUT, delay * 1000)) {
+        return;
+    }
+
+    while (!pgrest_worker_timedout && !pgrest_worker_terminate) {
+        pgrest_event_loop_once(base);
+    }
+
+    (void) pgrest_event_del(ev, EV_TIMEOUT);
+    pgrest_event_free(ev);
+
+    pgrest_worker_timedout = false;
+    stat->started = time(NULL);
+}
+
 static MemoryContext 
 pgrest_worker_mm_init(void)
 {
@@ -433,17 +1126,27 @@ pgrest_worker_main(Datum arg)
     MemoryContext       mctx;
     struct event_base  *base;
     struct event       *ev_timer = NULL;
+    volatile bool       failed = false;
 
     pgrest_worker_index = DatumGetInt32(arg);
 
+    pgrest_worker_cpu_affinity();
     mctx = pgrest_worker_mm_init();
     base = pgrest_worker_event_init(&ev_timer);
 #if PGREST_DEBUG
     pgrest_worker_info_debug();
 #endif
+    pgrest_worker_signal_setup(base);
+    pgrest_worker_backoff(base);
+    pgrest_worker_stat_start();
     /* initialize subsystems */
     pgrest_worker_process_init(base);
-    pgrest_worker_signal_setup(base);
+    pgrest_worker_stat_active(true);
+
+    /* started after the configure file was changed and reloaded */
+    if (pgrest_conf_changed(pgrest_setting.configure_file)) {
+        pgrest_worker_reload(base);
+    }
 
     ereport(LOG,(errmsg(PGREST_PACKAGE " " "worker %d started",
                          pgrest_worker_index)));
@@ -452,6 +1155,9 @@ pgrest_worker_main(Datum arg)
     {
         while(pgrest_worker_event_dispatch(base, ev_timer)) {
 
+            /* send the notifies queued by this iteration */
+            pgrest_ipc_flush();
+
             /* got SIGTERM */
             if (pgrest_worker_terminate) {
                 ereport(LOG,(errmsg(PGREST_PACKAGE " " "worker %d got "
@@ -464,6 +1170,7 @@ pgrest_worker_main(Datum arg)
                 ereport(LOG,(errmsg(PGREST_PACKAGE " " "worker %d got "
                                     "SIGHUP", pgrest_worker_index)));
                 pgrest_worker_reconfigure = false;
+                pgrest_worker_reload(base);
             }
 
             /* event internal error */
@@ -476,17 +1183,45 @@ pgrest_worker_main(Datum arg)
     }
     PG_CATCH();
     {
-        pgrest_acceptor_unlock_mutex();
+        /* errors of a single connection are handled by the protocol */
+        HOLD_INTERRUPTS();
+        failed = true;
+        pgrest_event_posting = false;
+
+        /* the mutex is another worker's unless this one took it */
+        if (pgrest_acceptor_use_mutex && pgrest_acceptor_mutex_held) {
+            pgrest_acceptor_mutex_held = false;
+            pgrest_acceptor_unlock_mutex();
+        }
+
         EmitErrorReport();
+
+        /* the exit hooks below take the slab pool locks again */
+        LWLockReleaseAll();
         FlushErrorState();
         MemoryContextSwitchTo(mctx);
+        RESUME_INTERRUPTS();
     }
     PG_END_TRY();
 
+    if (pgrest_worker_terminate && !pgrest_worker_event_error) {
+        pgrest_worker_drain(base, mctx);
+    }
+
+    pgrest_worker_stat_active(false);
     pgrest_worker_process_exit(base);
     pgrest_worker_event_fini(base, ev_timer);
     pgrest_worker_mm_fini(mctx);
 
+    /* exit code 1 has the postmaster restart us after restart_delay */
+    if (failed || pgrest_worker_event_error) {
+        proc_exit(1);
+    }
+
+    if (pgrest_worker_stat) {
+        pgrest_worker_stat[pgrest_worker_index].stat.started = 0;
+    }
+
     proc_exit(0);
 }
 
@@ -536,8 +1271,17 @@ void
 pgrest_worker_init(int worker_processes)
 {
     pgrest_worker_guc_check();
-    pgrest_worker_stat_init(worker_processes);
+    pgrest_worker_stat_init();
     pgrest_worker_register(worker_processes);
+#if PGSQL_VERSION >= 94
+    if (pgrest_setting.worker_processes_max > worker_processes) {
+        pgrest_worker_hook_add(pgrest_worker_scale_init,
+                               pgrest_worker_scale_exit,
+                               "worker scale",
+                               NULL,
+                               false);
+    }
+#endif
 #if PGREST_DEBUG
     pgrest_worker_info_print();
 #endif 
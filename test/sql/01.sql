@@ -0,0 +1,26 @@
+--
+-- change feed channel ids
+--
+CREATE FUNCTION pgrest_test_channel(text, text, text[]) RETURNS text
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+CREATE FUNCTION pgrest_test_channel_id(text) RETURNS text
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+-- the table channel and the channel of a row
+SELECT pgrest_test_channel('public', 'orders', '{}') AS channel;
+SELECT pgrest_test_channel('public', 'order_items', '{42,7}') AS channel;
+-- separators and anything else in names and values are percent-encoded
+SELECT pgrest_test_channel('public', 'users',
+                           ARRAY['a,b:c.d', 'x y%z']) AS channel;
+SELECT pgrest_test_channel('My Schema', 'tbl.name', '{1}') AS channel;
+-- subscribers get the same channel for the same row
+SELECT pgrest_test_channel_id('public.users:a%2cb%3ac%2ed,x%20y%25z')
+    AS channel;
+SELECT pgrest_test_channel_id(pgrest_test_channel('public', 'users',
+                              ARRAY['a,b:c.d', 'x y%z']))
+    = pgrest_test_channel('public', 'users', ARRAY['a,b:c.d', 'x y%z'])
+    AS same;
+-- and malformed ids are refused
+SELECT pgrest_test_channel_id('public.users:a b') IS NULL AS rejected;
+SELECT pgrest_test_channel_id('public.users:%2') IS NULL AS rejected;
+SELECT pgrest_test_channel_id('public.users:%zz') IS NULL AS rejected;
+SELECT pgrest_test_channel_id(repeat('a', 256)) IS NULL AS rejected;
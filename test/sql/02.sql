@@ -0,0 +1,32 @@
+--
+-- websocket handshake, unmasking and frame headers
+--
+CREATE FUNCTION pgrest_test_websocket_accept(text) RETURNS text
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+CREATE FUNCTION pgrest_test_websocket_unmask(integer) RETURNS boolean
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+CREATE FUNCTION pgrest_test_websocket_header(integer) RETURNS text
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+CREATE FUNCTION pgrest_test_websocket_parse(integer, integer) RETURNS text
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+-- the key and accept pair of rfc 6455 section 1.3
+SELECT pgrest_test_websocket_accept('dGhlIHNhbXBsZSBub25jZQ==') AS accept;
+-- keys of another length are refused
+SELECT pgrest_test_websocket_accept('dGhlIHNhbXBsZSBub25jZQ') IS NULL
+    AS rejected;
+-- the vector, word and byte loops agree with xoring byte by byte
+SELECT count(*) AS failed FROM generate_series(0, 65) AS len
+    WHERE NOT pgrest_test_websocket_unmask(len);
+-- 7 bit, 16 bit and 64 bit payload lengths
+SELECT pgrest_test_websocket_header(125) AS header;
+SELECT pgrest_test_websocket_header(126) AS header;
+SELECT pgrest_test_websocket_header(65535) AS header;
+SELECT pgrest_test_websocket_header(65536) AS header;
+-- client frames decode back to them, the mask included
+SELECT pgrest_test_websocket_parse(1, 125) AS parsed;
+SELECT pgrest_test_websocket_parse(1, 126) AS parsed;
+SELECT pgrest_test_websocket_parse(1, 65535) AS parsed;
+SELECT pgrest_test_websocket_parse(1, 65536) AS parsed;
+-- too big messages and long control frames close the connection
+SELECT pgrest_test_websocket_parse(1, 65537) AS status;
+SELECT pgrest_test_websocket_parse(8, 126) AS status;
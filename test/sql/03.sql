@@ -0,0 +1,7 @@
+--
+-- connection layout
+--
+CREATE FUNCTION pgrest_test_conn_layout(OUT property text, OUT ok boolean)
+    RETURNS SETOF record
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+SELECT * FROM pgrest_test_conn_layout();
@@ -0,0 +1,12 @@
+--
+-- slab magazines
+--
+CREATE FUNCTION pgrest_test_slab_magazine(integer, OUT step text,
+                                          OUT used bigint, OUT cached bigint,
+                                          OUT reqs bigint, OUT frees bigint,
+                                          OUT all_free boolean)
+    RETURNS SETOF record
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+-- the pool is visited once per 16 allocations, a full magazine keeps 16
+-- of the chunks freed into it, and every page comes back on reclaim
+SELECT * FROM pgrest_test_slab_magazine(40);
@@ -0,0 +1,9 @@
+--
+-- timer wheel
+--
+CREATE FUNCTION pgrest_test_timer_wheel(OUT tick bigint, OUT fired text)
+    RETURNS SETOF record
+    AS '$libdir/pg_rest' LANGUAGE C STRICT;
+-- timers re-armed or deleted before or while firing, a slot shared across
+-- revolutions, and ticks skipped by more than a revolution
+SELECT * FROM pgrest_test_timer_wheel();
@@ -0,0 +1,69 @@
+/*************************************************************************
+	> File Name: test01.c
+	> Author: 
+	> Mail: 
+	> Created Time: Mon 19 Oct 2026 10:12:03 AM PDT
+ ************************************************************************/
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+#include "pg_rest_http_push_stream.h"
+
+#include <utils/array.h>
+
+#include "test.h"
+
+PG_FUNCTION_INFO_V1(pgrest_test_channel);
+PG_FUNCTION_INFO_V1(pgrest_test_channel_id);
+
+/*
+ * pgrest_test_channel(schema text, tbl text, key text[])
+ *
+ * The channel the change feed publishes a row of the table with the
+ * key values to, the table's own channel for an empty key.
+ */
+Datum
+pgrest_test_channel(PG_FUNCTION_ARGS)
+{
+    int              i, n;
+    Datum           *elems;
+    bool            *nulls;
+    List            *values = NIL;
+    StringInfoData   id;
+
+    deconstruct_array(PG_GETARG_ARRAYTYPE_P(2), TEXTOID, -1, false, 'i',
+                      &elems, &nulls, &n);
+
+    for (i = 0; i < n; i++) {
+        values = lappend(values,
+                         nulls[i] ? NULL : TextDatumGetCString(elems[i]));
+    }
+
+    initStringInfo(&id);
+    pgrest_change_feed_channel(&id, text_to_cstring(PG_GETARG_TEXT_PP(0)),
+                               text_to_cstring(PG_GETARG_TEXT_PP(1)),
+                               values);
+
+    PG_RETURN_TEXT_P(cstring_to_text_with_len(id.data, id.len));
+}
+
+/*
+ * pgrest_test_channel_id(id text)
+ *
+ * The channel a subscriber sending id gets, NULL when the id is refused.
+ */
+Datum
+pgrest_test_channel_id(PG_FUNCTION_ARGS)
+{
+    pgrest_string_t  id;
+
+    id.base = (unsigned char *) text_to_cstring(PG_GETARG_TEXT_PP(0));
+    id.len = strlen((char *) id.base);
+
+    if (!pgrest_http_push_stream_id_valid(&id)) {
+        PG_RETURN_NULL();
+    }
+
+    PG_RETURN_TEXT_P(cstring_to_text_with_len((char *) id.base, id.len));
+}
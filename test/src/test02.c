@@ -0,0 +1,162 @@
+/*************************************************************************
+	> File Name: test02.c
+	> Author: 
+	> Mail: 
+	> Created Time: Mon 19 Oct 2026 02:41:17 PM PDT
+ ************************************************************************/
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+#include "pg_rest_http.h"
+
+#include "test.h"
+
+PG_FUNCTION_INFO_V1(pgrest_test_websocket_accept);
+PG_FUNCTION_INFO_V1(pgrest_test_websocket_unmask);
+PG_FUNCTION_INFO_V1(pgrest_test_websocket_header);
+PG_FUNCTION_INFO_V1(pgrest_test_websocket_parse);
+
+/*
+ * pgrest_test_websocket_accept(key text)
+ *
+ * The Sec-WebSocket-Accept value answering the key.
+ */
+Datum
+pgrest_test_websocket_accept(PG_FUNCTION_ARGS)
+{
+    char  *key = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    char   accept[PGREST_HTTP_WEBSOCKET_ACCEPT_LEN + 1];
+
+    if (strlen(key) != PGREST_HTTP_WEBSOCKET_KEY_LEN) {
+        PG_RETURN_NULL();
+    }
+
+    pgrest_http_websocket_accept_key((unsigned char *) key, accept);
+
+    PG_RETURN_TEXT_P(cstring_to_text(accept));
+}
+
+/*
+ * pgrest_test_websocket_unmask(len integer)
+ *
+ * Whether len bytes unmask the same as xoring them one at a time, at
+ * every alignment of the payload within a vector register.
+ */
+Datum
+pgrest_test_websocket_unmask(PG_FUNCTION_ARGS)
+{
+    int             i, off;
+    int             len = PG_GETARG_INT32(0);
+    unsigned char  *p, *expected;
+    unsigned char   mask[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+    if (len < 0) {
+        PG_RETURN_NULL();
+    }
+
+    p = palloc(len + 32);
+    expected = palloc(len + 1);
+
+    for (off = 0; off < 32; off++) {
+
+        for (i = 0; i < len; i++) {
+            p[off + i] = (unsigned char) (i * 7 + off);
+            expected[i] = p[off + i] ^ mask[i & 3];
+        }
+
+        pgrest_http_websocket_unmask(p + off, len, mask);
+
+        if (memcmp(p + off, expected, len) != 0) {
+            PG_RETURN_BOOL(false);
+        }
+    }
+
+    PG_RETURN_BOOL(true);
+}
+
+/*
+ * pgrest_test_websocket_header(len integer)
+ *
+ * The header of a server text frame with a payload of len bytes, in hex.
+ */
+Datum
+pgrest_test_websocket_header(PG_FUNCTION_ARGS)
+{
+    int                             i;
+    int                             len = PG_GETARG_INT32(0);
+    unsigned char                  *data;
+    StringInfoData                  hex;
+    pgrest_http_websocket_frame_t  *frame;
+
+    if (len < 0) {
+        PG_RETURN_NULL();
+    }
+
+    data = palloc0(len + 1);
+    frame = pgrest_http_websocket_frame_create(PGREST_HTTP_WEBSOCKET_TEXT,
+                                               data, len);
+    if (frame == NULL) {
+        elog(ERROR, "out of memory");
+    }
+
+    initStringInfo(&hex);
+
+    for (i = 0; i < (int) frame->len - len; i++) {
+        appendStringInfo(&hex, "%s%02x", i ? " " : "", frame->data[i]);
+    }
+
+    pgrest_http_websocket_frame_release(frame);
+
+    PG_RETURN_TEXT_P(cstring_to_text_with_len(hex.data, hex.len));
+}
+
+/*
+ * pgrest_test_websocket_parse(opcode integer, len integer)
+ *
+ * Decode the header of a masked client frame with the opcode and a
+ * payload of len bytes. Reads "hlen len" once decoded, else the close
+ * status. Every shorter prefix of the header must ask for more.
+ */
+Datum
+pgrest_test_websocket_parse(PG_FUNCTION_ARGS)
+{
+    int                             rc;
+    size_t                          n, hlen;
+    int                             len = PG_GETARG_INT32(1);
+    unsigned char                   p[PGREST_HTTP_WEBSOCKET_HEADER_MAX + 4];
+    unsigned char                  *data;
+    pgrest_http_websocket_header_t  h;
+    pgrest_http_websocket_frame_t  *frame;
+
+    if (len < 0) {
+        PG_RETURN_NULL();
+    }
+
+    data = palloc0(len + 1);
+    frame = pgrest_http_websocket_frame_create(PG_GETARG_INT32(0), data, len);
+    if (frame == NULL) {
+        elog(ERROR, "out of memory");
+    }
+
+    /* a client sets the mask bit and sends the key after the header */
+    hlen = frame->len - len;
+    memcpy(p, frame->data, hlen);
+    memset(p + hlen, 0x5a, 4);
+    p[1] |= 0x80;
+
+    pgrest_http_websocket_frame_release(frame);
+
+    for (n = 0; n < hlen; n++) {
+        if (pgrest_http_websocket_parse_header(p, n, &h) != PGREST_AGAIN) {
+            elog(ERROR, "header decoded from %zu of %zu bytes", n, hlen);
+        }
+    }
+
+    rc = pgrest_http_websocket_parse_header(p, hlen + 4, &h);
+    if (rc != PGREST_OK) {
+        PG_RETURN_TEXT_P(cstring_to_text(psprintf("%d", rc)));
+    }
+
+    PG_RETURN_TEXT_P(cstring_to_text(psprintf("%zu " UINT64_FORMAT,
+                                              h.hlen, h.len)));
+}
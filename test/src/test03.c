@@ -0,0 +1,56 @@
+/*************************************************************************
+	> File Name: test03.c
+	> Author: 
+	> Mail: 
+	> Created Time: Mon 19 Oct 2026 03:26:40 PM PDT
+ ************************************************************************/
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+#include "test.h"
+
+/* the smallest cache line of the platforms served */
+#define PGREST_TEST_CACHE_LINE  64
+
+PG_FUNCTION_INFO_V1(pgrest_test_conn_layout);
+
+/*
+ * pgrest_test_conn_layout()
+ *
+ * Whether the hot part of a connection is laid out as pg_rest_conn.h
+ * says: what every event touches within the first cache line, and the
+ * part a whole number of cache lines so the array keeps them aligned.
+ */
+Datum
+pgrest_test_conn_layout(PG_FUNCTION_ARGS)
+{
+    int                  i;
+    TupleDesc            tupdesc;
+    Tuplestorestate     *tupstore;
+    Datum                values[2];
+    bool                 nulls[2];
+    struct {
+        const char      *property;
+        bool             ok;
+    } checks[] = {
+        { "events in the first line",
+          offsetof(pgrest_connection_t, wev_handler)
+          + sizeof(event_callback_fn) <= PGREST_TEST_CACHE_LINE },
+        { "whole cache lines",
+          sizeof(pgrest_connection_t) % PG_CACHE_LINE_SIZE == 0 }
+    };
+
+    tupstore = pgrest_shm_tuplestore(fcinfo, &tupdesc);
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    for (i = 0; i < (int) lengthof(checks); i++) {
+        values[0] = CStringGetTextDatum(checks[i].property);
+        values[1] = BoolGetDatum(checks[i].ok);
+
+        tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
@@ -0,0 +1,158 @@
+/*************************************************************************
+	> File Name: test04.c
+	> Author: 
+	> Mail: 
+	> Created Time: Mon 19 Oct 2026 03:58:12 PM PDT
+ ************************************************************************/
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+#include "test.h"
+
+/* pages of the private pool, and the slot the test allocates from */
+#define PGREST_TEST_SLAB_PAGES   64
+#define PGREST_TEST_SLAB_SIZE    64
+
+PG_FUNCTION_INFO_V1(pgrest_test_slab_magazine);
+
+/*
+ * A pool of this backend alone, the lock is not shared with anyone. It
+ * is never freed: the magazine cache of the backend refers to it until
+ * exit.
+ */
+static pgrest_slab_pool_t *
+pgrest_test_slab_pool(void)
+{
+    size_t               size;
+    pgrest_slab_pool_t  *pool;
+
+    size = sizeof(pgrest_slab_pool_t)
+           + (PGREST_TEST_SLAB_PAGES + 1) * (pgrest_pagesize
+                                             + sizeof(pgrest_slab_page_t)
+                                             + sizeof(pgrest_slab_stat_t));
+
+    pool = MemoryContextAllocZero(TopMemoryContext, size);
+    pool->end = (char *) pool + size;
+    pool->min_shift = 3;
+    pool->addr = pool;
+
+#if PGSQL_VERSION >= 96
+    pool->lock = MemoryContextAllocZero(TopMemoryContext, sizeof(LWLock));
+    LWLockInitialize(pool->lock, LWLockNewTrancheId());
+#else
+    elog(ERROR, "private slab pools need PostgreSQL 9.6 or later");
+#endif
+
+    pgrest_slab_init(pool);
+
+    return pool;
+}
+
+static int
+pgrest_test_ptr_cmp(const void *a, const void *b)
+{
+    uintptr_t  pa = (uintptr_t) *(void * const *) a;
+    uintptr_t  pb = (uintptr_t) *(void * const *) b;
+
+    return pa < pb ? -1 : pa > pb;
+}
+
+static void
+pgrest_test_slab_row(Tuplestorestate *tupstore, TupleDesc tupdesc,
+                     pgrest_slab_pool_t *pool, const char *step)
+{
+    pgrest_uint_t        slot;
+    pgrest_slab_stat_t  *stats;
+    pgrest_slab_stat_t   page_stat;
+    pgrest_slab_info_t   info;
+    Datum                values[6];
+    bool                 nulls[6];
+
+    stats = palloc(pgrest_slab_nslots(pool) * sizeof(pgrest_slab_stat_t));
+    pgrest_slab_stat_get(pool, stats, &page_stat, &info);
+
+    for (slot = 0;
+         pgrest_slab_slot_size(pool, slot) < PGREST_TEST_SLAB_SIZE;
+         slot++)
+    {
+        /* void */
+    }
+
+    MemSet(nulls, 0, sizeof(nulls));
+
+    values[0] = CStringGetTextDatum(step);
+    values[1] = Int64GetDatum(stats[slot].used);
+    values[2] = Int64GetDatum(stats[slot].cached);
+    values[3] = Int64GetDatum(stats[slot].reqs);
+    values[4] = Int64GetDatum(stats[slot].frees);
+    values[5] = BoolGetDatum(info.free == info.pages);
+
+    tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+    pfree(stats);
+}
+
+/*
+ * pgrest_test_slab_magazine(n integer)
+ *
+ * Allocate n chunks from a new private pool, free them and have the
+ * backend give its cached chunks back. After each step, the counters of
+ * the slot: chunks taken from the pool, cached by the backend as of the
+ * last refill or flush, the calls folded in so far, and whether every
+ * page of the pool is free.
+ */
+Datum
+pgrest_test_slab_magazine(PG_FUNCTION_ARGS)
+{
+    int                  i;
+    int                  n = PG_GETARG_INT32(0);
+    void               **chunks;
+    TupleDesc            tupdesc;
+    Tuplestorestate     *tupstore;
+    pgrest_slab_pool_t  *pool;
+
+    if (n < 0) {
+        elog(ERROR, "negative number of chunks");
+    }
+
+    tupstore = pgrest_shm_tuplestore(fcinfo, &tupdesc);
+
+    pool = pgrest_test_slab_pool();
+    chunks = palloc((n + 1) * sizeof(void *));
+
+    for (i = 0; i < n; i++) {
+        chunks[i] = pgrest_slab_alloc(pool, PGREST_TEST_SLAB_SIZE);
+        if (chunks[i] == NULL) {
+            elog(ERROR, "chunk %d of %d not allocated", i, n);
+        }
+    }
+
+    pgrest_test_slab_row(tupstore, tupdesc, pool, "alloc");
+
+    qsort(chunks, n, sizeof(void *), pgrest_test_ptr_cmp);
+
+    for (i = 1; i < n; i++) {
+        if ((char *) chunks[i] - (char *) chunks[i - 1]
+            < PGREST_TEST_SLAB_SIZE)
+        {
+            elog(ERROR, "chunks %p and %p overlap", chunks[i - 1], chunks[i]);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        pgrest_slab_free(pool, chunks[i]);
+    }
+
+    pgrest_test_slab_row(tupstore, tupdesc, pool, "free");
+
+    /* as when another process ran short */
+    pool->reclaim++;
+    pgrest_slab_cache_reclaim();
+
+    pgrest_test_slab_row(tupstore, tupdesc, pool, "reclaim");
+
+    pfree(chunks);
+
+    return (Datum) 0;
+}
@@ -0,0 +1,151 @@
+/*************************************************************************
+	> File Name: test05.c
+	> Author: 
+	> Mail: 
+	> Created Time: Mon 19 Oct 2026 04:37:55 PM PDT
+ ************************************************************************/
+
+#include "pg_rest_config.h"
+#include "pg_rest_core.h"
+
+#include "test.h"
+
+/* far from 0, so that a tick never goes below where the wheel started */
+#define PGREST_TEST_TIMER_START  1000000
+
+PG_FUNCTION_INFO_V1(pgrest_test_timer_wheel);
+
+typedef struct {
+    pgrest_timer_t       timer;
+    const char          *name;
+    /* re-armed that many times with timeout from the handler */
+    int                  rearm;
+    int                  timeout;
+    /* deleted by the handler */
+    pgrest_timer_t      *kill[2];
+} pgrest_test_timer_t;
+
+static Tuplestorestate  *pgrest_test_tupstore;
+static TupleDesc         pgrest_test_tupdesc;
+static uint64            pgrest_test_now;
+
+static void
+pgrest_test_timer_row(const char *name)
+{
+    Datum  values[2];
+    bool   nulls[2] = { false, false };
+
+    values[0] = Int64GetDatum(pgrest_test_now - PGREST_TEST_TIMER_START);
+    values[1] = CStringGetTextDatum(name);
+
+    tuplestore_putvalues(pgrest_test_tupstore, pgrest_test_tupdesc,
+                         values, nulls);
+}
+
+static void
+pgrest_test_timer_handler(pgrest_timer_t *timer)
+{
+    int                   i;
+    pgrest_test_timer_t  *t = timer->data;
+
+    pgrest_test_timer_row(t->name);
+
+    for (i = 0; i < (int) lengthof(t->kill); i++) {
+        if (t->kill[i]) {
+            pgrest_timer_del(t->kill[i]);
+        }
+    }
+
+    if (t->rearm > 0) {
+        t->rearm--;
+        pgrest_timer_add_at(timer, t->timeout, pgrest_test_now);
+    }
+}
+
+static void
+pgrest_test_timer_add(pgrest_test_timer_t *t, const char *name, int timeout)
+{
+    MemSet(t, 0, sizeof(pgrest_test_timer_t));
+
+    t->name = name;
+    t->timeout = timeout;
+    t->timer.handler = pgrest_test_timer_handler;
+    t->timer.data = t;
+
+    pgrest_timer_add_at(&t->timer, timeout, pgrest_test_now);
+}
+
+static void
+pgrest_test_timer_expire(int tick)
+{
+    pgrest_test_now = PGREST_TEST_TIMER_START + tick;
+    pgrest_timer_expire(pgrest_test_now);
+}
+
+/*
+ * pgrest_test_timer_wheel()
+ *
+ * Drive a private wheel of 1ms ticks by hand, one row per timer fired:
+ * the tick it fired at and its name. Timers still set at the end are
+ * listed with a NULL tick.
+ */
+Datum
+pgrest_test_timer_wheel(PG_FUNCTION_ARGS)
+{
+    int                   i;
+    Datum                 values[2];
+    bool                  nulls[2] = { true, false };
+    pgrest_test_timer_t   t[9];
+
+    pgrest_test_tupstore = pgrest_shm_tuplestore(fcinfo,
+                                                 &pgrest_test_tupdesc);
+
+    pgrest_test_now = PGREST_TEST_TIMER_START;
+    pgrest_timer_wheel_init(1, pgrest_test_now);
+
+    /* the same slot, one revolution apart */
+    pgrest_test_timer_add(&t[0], "wrap", PGREST_TIMER_WHEEL_SIZE + 5);
+    pgrest_test_timer_add(&t[1], "short", 5);
+
+    /* re-armed before it expires, it fires once at the later tick */
+    pgrest_test_timer_add(&t[2], "rearm", 10);
+    pgrest_timer_add_at(&t[2].timer, 20, pgrest_test_now);
+
+    /* deletes the next one of its slot and one of a later slot */
+    pgrest_test_timer_add(&t[3], "killer", 30);
+    pgrest_test_timer_add(&t[4], "victim", 30);
+    pgrest_test_timer_add(&t[5], "other", 35);
+    t[3].kill[0] = &t[4].timer;
+    t[3].kill[1] = &t[5].timer;
+
+    /* re-armed by its handler */
+    pgrest_test_timer_add(&t[6], "periodic", 50);
+    t[6].rearm = 1;
+
+    /* several revolutions ahead */
+    pgrest_test_timer_add(&t[7], "far", 3 * PGREST_TIMER_WHEEL_SIZE);
+
+    /* deleted before it expires */
+    pgrest_test_timer_add(&t[8], "deleted", 60);
+    pgrest_timer_del(&t[8].timer);
+
+    pgrest_test_timer_expire(5);
+    pgrest_test_timer_expire(10);
+    pgrest_test_timer_expire(20);
+    pgrest_test_timer_expire(40);
+    pgrest_test_timer_expire(100);
+    pgrest_test_timer_expire(PGREST_TIMER_WHEEL_SIZE + 4);
+    pgrest_test_timer_expire(PGREST_TIMER_WHEEL_SIZE + 5);
+    /* more than a revolution at once */
+    pgrest_test_timer_expire(5 * PGREST_TIMER_WHEEL_SIZE);
+
+    for (i = 0; i < 9; i++) {
+        if (t[i].timer.set) {
+            values[1] = CStringGetTextDatum(t[i].name);
+            tuplestore_putvalues(pgrest_test_tupstore, pgrest_test_tupdesc,
+                                 values, nulls);
+        }
+    }
+
+    return (Datum) 0;
+}